@@ -0,0 +1,277 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "AutoDetectionPrepass.h"
+#include "AutoDetectionPrepass.h.moc"
+#include "WorkerThread.h"
+#include "ThreadPriority.h"
+#include "ProjectPages.h"
+#include "PageSequence.h"
+#include "PageView.h"
+#include "ThreadPool.h"
+#include "OutOfMemoryHandler.h"
+#include <boost/foreach.hpp>
+#include <algorithm>
+#include <new>
+#include <assert.h>
+
+namespace
+{
+
+/**
+ * A result standing for a task that produced nothing,
+ * because it was cancelled or ran out of memory.
+ */
+class NoResult : public FilterResult
+{
+public:
+	virtual void updateUI(FilterUiInterface*) {}
+
+	virtual IntrusivePtr<AbstractFilter> filter() {
+		return IntrusivePtr<AbstractFilter>();
+	}
+};
+
+/**
+ * \brief Makes sure every task posts a result back.
+ *
+ * WorkerThread doesn't post null results and swallows std::bad_alloc,
+ * while AutoDetectionPrepass only frees a worker when its task
+ * reports back.
+ */
+class CompletionReportingTask : public BackgroundTask
+{
+public:
+	CompletionReportingTask(BackgroundTaskPtr const& task)
+	:	BackgroundTask(task->type()), m_ptrTask(task) {}
+
+	virtual FilterResultPtr operator()() {
+		try {
+			FilterResultPtr const result((*m_ptrTask)());
+			if (result) {
+				return result;
+			}
+		} catch (std::bad_alloc const&) {
+			OutOfMemoryHandler::instance().handleOutOfMemorySituation();
+		}
+		return FilterResultPtr(new NoResult);
+	}
+
+	virtual void cancel() {
+		BackgroundTask::cancel();
+		m_ptrTask->cancel();
+	}
+private:
+	BackgroundTaskPtr m_ptrTask;
+};
+
+} // anonymous namespace
+
+AutoDetectionPrepass::AutoDetectionPrepass(
+	IntrusivePtr<ProjectPages> const& pages,
+	IntrusivePtr<TaskFactory> const& task_factory,
+	int const page_split_filter_idx, int const last_filter_idx,
+	QObject* parent)
+:	QObject(parent),
+	m_ptrPages(pages),
+	m_ptrTaskFactory(task_factory),
+	m_pageSplitFilterIdx(page_split_filter_idx),
+	m_lastFilterIdx(last_filter_idx),
+	m_numActiveWorkers(0),
+	m_numBusyWorkers(0),
+	m_numImages(0),
+	m_numImagesDone(0)
+{
+}
+
+AutoDetectionPrepass::~AutoDetectionPrepass()
+{
+	cancel();
+
+	// Wait for the threads now rather than when QObject deletes them,
+	// as they may still be using our members.
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		m_workers[i].thread->shutdown();
+	}
+}
+
+void
+AutoDetectionPrepass::start()
+{
+	cancel();
+
+	// Leave one core to interactive processing.  The thread cap may have
+	// changed since the last run, so threads beyond it are kept idle.
+	m_numActiveWorkers = std::max(1, ThreadPool::instance().maxThreads() - 1);
+	while ((int)m_workers.size() < m_numActiveWorkers) {
+		WorkerThread* thread = new WorkerThread(ThreadPriority::Lowest, this);
+		connect(
+			thread, SIGNAL(taskResult(BackgroundTaskPtr const&, FilterResultPtr const&)),
+			this, SLOT(workerResult(BackgroundTaskPtr const&, FilterResultPtr const&))
+		);
+		m_workers.push_back(Worker(thread));
+	}
+
+	PageSequence const images(m_ptrPages->toPageSequence(IMAGE_VIEW));
+	size_t const num_images = images.numPages();
+	for (size_t i = 0; i < num_images; ++i) {
+		m_imageJobs.push_back(Job(images.pageAt(i), true));
+	}
+	m_numImages = num_images;
+	m_numImagesDone = 0;
+
+	for (int i = 0; i < m_numActiveWorkers; ++i) {
+		dispatch(m_workers[i]);
+	}
+
+	if (m_numBusyWorkers == 0) {
+		emit finished();
+	} else {
+		emit progress(m_numImagesDone, m_numImages);
+	}
+}
+
+void
+AutoDetectionPrepass::cancel()
+{
+	m_imageJobs.clear();
+	m_pageJobs.clear();
+	m_pendingPages.clear();
+
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		Worker& worker = m_workers[i];
+		if (worker.task) {
+			worker.task->cancel();
+			worker.task.reset();
+		}
+	}
+
+	// Cancelled tasks don't report back, so we consider
+	// the workers free right away.  A new task for a worker
+	// will be queued behind the cancelled one.
+	m_numBusyWorkers = 0;
+}
+
+void
+AutoDetectionPrepass::workerResult(
+	BackgroundTaskPtr const& task, FilterResultPtr const& result)
+{
+	std::vector<Worker>::iterator it(m_workers.begin());
+	for (; it != m_workers.end() && it->task != task; ++it) {}
+	if (it == m_workers.end()) {
+		// A task from before cancel().
+		return;
+	}
+
+	Worker& worker = *it;
+	Job const job(worker.job);
+	worker.task.reset();
+	--m_numBusyWorkers;
+
+	if (result->filter()) {
+		emit pageProcessed(job.page);
+	}
+
+	jobFinished(job);
+
+	for (int i = 0; i < m_numActiveWorkers; ++i) {
+		if (!m_workers[i].task) {
+			dispatch(m_workers[i]);
+		}
+	}
+
+	if (m_numBusyWorkers == 0) {
+		emit finished();
+	}
+}
+
+void
+AutoDetectionPrepass::dispatch(Worker& worker)
+{
+	assert(!worker.task);
+
+	for (;;) {
+		std::deque<Job>* queue = 0;
+		if (!m_pageJobs.empty()) {
+			queue = &m_pageJobs;
+		} else if (!m_imageJobs.empty()) {
+			queue = &m_imageJobs;
+		} else {
+			return;
+		}
+
+		Job const job(queue->front());
+		queue->pop_front();
+
+		int const last_filter_idx = job.wholeImage ? m_pageSplitFilterIdx : m_lastFilterIdx;
+		BackgroundTaskPtr const task((*m_ptrTaskFactory)(job.page, last_filter_idx));
+		if (!task) {
+			jobFinished(job);
+			continue;
+		}
+
+		worker.task.reset(new CompletionReportingTask(task));
+		worker.job = job;
+		++m_numBusyWorkers;
+		worker.thread->performTask(worker.task);
+		return;
+	}
+}
+
+void
+AutoDetectionPrepass::jobFinished(Job const& job)
+{
+	ImageId const& image_id = job.page.imageId();
+
+	if (!job.wholeImage) {
+		std::map<ImageId, int>::iterator const it(m_pendingPages.find(image_id));
+		if (it != m_pendingPages.end() && --it->second == 0) {
+			m_pendingPages.erase(it);
+			imageFinished();
+		}
+		return;
+	}
+
+	// Now that the image went through page splitting, we know its pages.
+	std::vector<PageInfo> const pages(m_ptrPages->pagesOfImage(image_id));
+	if (!pages.empty() && (int)pages.size() != job.page.imageSubPages()) {
+		// The page set of this image has changed, so PageIds shown
+		// in PAGE_VIEW no longer match those in ProjectPages.
+		emit imagePagesChanged(image_id);
+	}
+
+	if (pages.empty() || m_lastFilterIdx <= m_pageSplitFilterIdx) {
+		// Removed from the project in the meantime,
+		// or there is nothing left to do for its pages.
+		imageFinished();
+		return;
+	}
+
+	BOOST_FOREACH(PageInfo const& page, pages) {
+		m_pageJobs.push_back(Job(page, false));
+	}
+	m_pendingPages[image_id] = pages.size();
+}
+
+void
+AutoDetectionPrepass::imageFinished()
+{
+	++m_numImagesDone;
+	emit progress(m_numImagesDone, m_numImages);
+}
@@ -0,0 +1,148 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef AUTO_DETECTION_PREPASS_H_
+#define AUTO_DETECTION_PREPASS_H_
+
+#include "NonCopyable.h"
+#include "IntrusivePtr.h"
+#include "AbstractCommand.h"
+#include "BackgroundTask.h"
+#include "FilterResult.h"
+#include "PageInfo.h"
+#include "ImageId.h"
+#include <QObject>
+#include <deque>
+#include <vector>
+#include <map>
+
+class ProjectPages;
+class WorkerThread;
+
+/**
+ * \brief Runs automatic detection stages for every page of a project
+ *        in the background, at the lowest priority, on as many threads
+ *        as the ThreadPool cap allows, minus one for interactive work.
+ *
+ * Each image is first taken through page splitting.  Once it's known
+ * what pages an image has, those pages are taken through the rest of
+ * the stages, ahead of the images still waiting, so results become
+ * available roughly in page order.  Tasks are created in batch mode,
+ * so they store their results in filter settings the same way batch
+ * processing does.
+ *
+ * All methods are to be called from the GUI thread.
+ */
+class AutoDetectionPrepass : public QObject
+{
+	Q_OBJECT
+	DECLARE_NON_COPYABLE(AutoDetectionPrepass)
+public:
+	/**
+	 * Creates a batch task processing the given page
+	 * up to and including the given filter.
+	 */
+	typedef AbstractCommand2<BackgroundTaskPtr, PageInfo const&, int> TaskFactory;
+
+	AutoDetectionPrepass(
+		IntrusivePtr<ProjectPages> const& pages,
+		IntrusivePtr<TaskFactory> const& task_factory,
+		int page_split_filter_idx, int last_filter_idx,
+		QObject* parent = 0);
+
+	virtual ~AutoDetectionPrepass();
+
+	void start();
+
+	/**
+	 * \brief Cancels running tasks and forgets the queued ones.
+	 *
+	 * Results already stored in settings stay there.
+	 */
+	void cancel();
+
+	bool isRunning() const { return m_numBusyWorkers != 0; }
+signals:
+	/**
+	 * Emitted for every image taken through page splitting, and for every
+	 * page taken through the remaining stages.  Load errors are not reported.
+	 *
+	 * \note Results are not supposed to be passed to FilterResult::updateUI(),
+	 *       as that would replace the options of the page being displayed.
+	 */
+	void pageProcessed(PageInfo const& page_info);
+
+	/**
+	 * Emitted when page splitting changed the number of pages an image has,
+	 * meaning the pages of that image in PAGE_VIEW are no longer valid.
+	 */
+	void imagePagesChanged(ImageId const& image_id);
+
+	void progress(int images_done, int images_total);
+
+	void finished();
+private slots:
+	void workerResult(BackgroundTaskPtr const& task, FilterResultPtr const& result);
+private:
+	struct Job
+	{
+		PageInfo page;
+		bool wholeImage;
+
+		Job(PageInfo const& p, bool whole_image) : page(p), wholeImage(whole_image) {}
+	};
+
+	struct Worker
+	{
+		WorkerThread* thread;
+		BackgroundTaskPtr task;
+		Job job;
+
+		Worker(WorkerThread* t) : thread(t), job(PageInfo(), false) {}
+	};
+
+	/**
+	 * Gives the worker the next job, if there is one.
+	 */
+	void dispatch(Worker& worker);
+
+	void jobFinished(Job const& job);
+
+	void imageFinished();
+
+	IntrusivePtr<ProjectPages> m_ptrPages;
+	IntrusivePtr<TaskFactory> m_ptrTaskFactory;
+	int m_pageSplitFilterIdx;
+	int m_lastFilterIdx;
+	std::vector<Worker> m_workers;
+
+	/** The first this many workers get jobs, subject to the thread cap. */
+	int m_numActiveWorkers;
+	std::deque<Job> m_imageJobs;
+	std::deque<Job> m_pageJobs;
+
+	/** Page jobs queued or running, per image. */
+	std::map<ImageId, int> m_pendingPages;
+
+	int m_numBusyWorkers;
+	int m_numImages;
+	int m_numImagesDone;
+};
+
+#endif
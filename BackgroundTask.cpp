@@ -24,6 +24,18 @@ BackgroundTask::CancelledException::what() const throw()
 	return "BackgroundTask cancelled";
 }
 
+TransferableException*
+BackgroundTask::CancelledException::clone() const
+{
+	return new CancelledException(*this);
+}
+
+void
+BackgroundTask::CancelledException::raise() const
+{
+	throw *this;
+}
+
 void
 BackgroundTask::throwIfCancelled() const
 {
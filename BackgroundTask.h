@@ -23,6 +23,7 @@
 #include "IntrusivePtr.h"
 #include "FilterResult.h"
 #include "TaskStatus.h"
+#include "TransferableException.h"
 #include <QAtomicInt>
 #include <exception>
 
@@ -31,10 +32,18 @@ class BackgroundTask : public AbstractCommand0<FilterResultPtr>, public TaskStat
 public:
 	enum Type { INTERACTIVE, BATCH };
 
-	class CancelledException : public std::exception
+	/**
+	 * Derived from TransferableException, so that cancellation
+	 * noticed on a ThreadPool thread is reported as such.
+	 */
+	class CancelledException : public TransferableException
 	{
 	public:
 		virtual char const* what() const throw();
+
+		virtual TransferableException* clone() const;
+
+		virtual void raise() const;
 	};
 	
 	BackgroundTask(Type type) : m_type(type) {}
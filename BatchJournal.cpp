@@ -0,0 +1,374 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "BatchJournal.h"
+#include "ProjectPages.h"
+#include "ProjectReader.h"
+#include "ProjectWriter.h"
+#include "StageSequence.h"
+#include "PageSequence.h"
+#include "PageView.h"
+#include "PageInfo.h"
+#include "ImageId.h"
+#include "SelectedPage.h"
+#include <QDomDocument>
+#include <QDomElement>
+#include <QDomNamedNodeMap>
+#include <QDomAttr>
+#include <QByteArray>
+#include <QFileInfo>
+#include <QDir>
+#include <boost/foreach.hpp>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#if defined(Q_OS_UNIX)
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+template<typename Id>
+class NumericIdCollector
+{
+public:
+	NumericIdCollector(std::map<Id, int>& ids) : m_pIds(&ids) {}
+	
+	void operator()(Id const& id, int numeric_id) { (*m_pIds)[id] = numeric_id; }
+private:
+	std::map<Id, int>* m_pIds;
+};
+
+
+/**
+ * Merges per-page and per-image filter settings from journal records
+ * into a project document.  Whatever a record has for a page or an image
+ * replaces what the document has for it.
+ */
+class SettingsMerger
+{
+public:
+	SettingsMerger(QDomDocument& doc, ProjectWriter const& writer);
+	
+	void merge(ProjectReader const& record_reader, QDomElement const& record_filters_el);
+private:
+	typedef std::map<QString, QDomElement> ElementIndex;
+	
+	QDomElement filterElement(QString const& name);
+	
+	int numericId(ProjectReader const& record_reader, QDomElement const& el) const;
+	
+	static QString indexKey(QString const& filter_name, QDomElement const& el);
+	
+	QDomDocument& m_rDoc;
+	QDomElement m_filtersEl;
+	std::map<PageId, int> m_pageIds;
+	std::map<ImageId, int> m_imageIds;
+	ElementIndex m_index;
+};
+
+SettingsMerger::SettingsMerger(QDomDocument& doc, ProjectWriter const& writer)
+:	m_rDoc(doc),
+	m_filtersEl(doc.documentElement().namedItem("filters").toElement())
+{
+	writer.enumPages(NumericIdCollector<PageId>(m_pageIds));
+	writer.enumImages(NumericIdCollector<ImageId>(m_imageIds));
+}
+
+void
+SettingsMerger::merge(ProjectReader const& record_reader, QDomElement const& record_filters_el)
+{
+	QDomNode filter_node(record_filters_el.firstChild());
+	for (; !filter_node.isNull(); filter_node = filter_node.nextSibling()) {
+		if (!filter_node.isElement()) {
+			continue;
+		}
+		QDomElement const record_filter_el(filter_node.toElement());
+		QString const filter_name(record_filter_el.tagName());
+		QDomElement filter_el(filterElement(filter_name));
+		
+		// Filter-wide settings, like the default layout type of page split.
+		QDomNamedNodeMap const attrs(record_filter_el.attributes());
+		for (int i = 0; i < attrs.count(); ++i) {
+			QDomAttr const attr(attrs.item(i).toAttr());
+			filter_el.setAttribute(attr.name(), attr.value());
+		}
+		
+		QDomNode node(record_filter_el.firstChild());
+		for (; !node.isNull(); node = node.nextSibling()) {
+			if (!node.isElement()) {
+				continue;
+			}
+			
+			int const id = numericId(record_reader, node.toElement());
+			if (id < 0) {
+				continue;
+			}
+			
+			QDomElement el(m_rDoc.importNode(node, true).toElement());
+			el.setAttribute("id", id);
+			
+			QString const key(indexKey(filter_name, el));
+			ElementIndex::iterator const it(m_index.find(key));
+			if (it != m_index.end()) {
+				filter_el.replaceChild(el, it->second);
+				it->second = el;
+			} else {
+				filter_el.appendChild(el);
+				m_index.insert(ElementIndex::value_type(key, el));
+			}
+		}
+	}
+}
+
+QDomElement
+SettingsMerger::filterElement(QString const& name)
+{
+	QDomElement filter_el(m_filtersEl.namedItem(name).toElement());
+	if (!filter_el.isNull()) {
+		return filter_el;
+	}
+	
+	filter_el = m_rDoc.createElement(name);
+	m_filtersEl.appendChild(filter_el);
+	
+	return filter_el;
+}
+
+int
+SettingsMerger::numericId(ProjectReader const& record_reader, QDomElement const& el) const
+{
+	bool ok = true;
+	int const record_id = el.attribute("id").toInt(&ok);
+	if (!ok) {
+		return -1;
+	}
+	
+	if (el.tagName() == "page") {
+		std::map<PageId, int>::const_iterator const it(
+			m_pageIds.find(record_reader.pageId(record_id))
+		);
+		if (it != m_pageIds.end()) {
+			return it->second;
+		}
+	} else if (el.tagName() == "image") {
+		std::map<ImageId, int>::const_iterator const it(
+			m_imageIds.find(record_reader.imageId(record_id))
+		);
+		if (it != m_imageIds.end()) {
+			return it->second;
+		}
+	}
+	
+	return -1;
+}
+
+QString
+SettingsMerger::indexKey(QString const& filter_name, QDomElement const& el)
+{
+	return filter_name + '/' + el.tagName() + '/' + el.attribute("id");
+}
+
+} // anonymous namespace
+
+BatchJournal::BatchJournal(
+	QString const& file_path,
+	IntrusivePtr<ProjectPages> const& pages,
+	IntrusivePtr<StageSequence> const& stages,
+	OutputFileNameGenerator const& out_file_name_gen)
+:	m_file(file_path),
+	m_ptrPages(pages),
+	m_ptrStages(stages),
+	m_outFileNameGen(out_file_name_gen)
+{
+}
+
+BatchJournal::~BatchJournal()
+{
+}
+
+void
+BatchJournal::open(bool const resume)
+{
+	QDir().mkpath(QFileInfo(m_file.fileName()).absolutePath());
+	if (!m_file.open(QIODevice::ReadWrite)) {
+		throw std::runtime_error("Unable to open the batch journal.");
+	}
+	
+	qint64 end = 0;
+	if (resume) {
+		end = replay();
+	}
+	
+	// Get rid of a partially written record, if any.
+	m_file.resize(end);
+	m_file.seek(end);
+}
+
+bool
+BatchJournal::isCompleted(PageId const& page_id, int const last_filter_idx) const
+{
+	CompletedStages::const_iterator const it(m_completedStages.find(page_id));
+	return it != m_completedStages.end() && it->second >= last_filter_idx;
+}
+
+void
+BatchJournal::recordCompleted(PageId const& page_id, int const last_filter_idx)
+{
+	// The record covers the image as it is now.  If it got split, the page
+	// we were given may no longer exist, but the record is still needed
+	// for the new layout.
+	std::vector<PageInfo> const pages(m_ptrPages->pagesOfImage(page_id.imageId()));
+	if (pages.empty()) {
+		return;
+	}
+	PageSequence image_pages;
+	BOOST_FOREACH(PageInfo const& page, pages) {
+		image_pages.append(page);
+	}
+	
+	ProjectWriter const writer(
+		image_pages, m_ptrPages->layoutDirection(), SelectedPage(), m_outFileNameGen
+	);
+	QDomDocument doc(writer.toDocument(m_ptrStages->filters()));
+	
+	std::map<PageId, int> page_ids;
+	writer.enumPages(NumericIdCollector<PageId>(page_ids));
+	std::map<PageId, int>::const_iterator const it(page_ids.find(page_id));
+	if (it != page_ids.end()) {
+		QDomElement completed_el(doc.createElement("completed"));
+		completed_el.setAttribute("page", it->second);
+		completed_el.setAttribute("stage", last_filter_idx);
+		doc.documentElement().appendChild(completed_el);
+		
+		int& stage = m_completedStages.insert(
+			CompletedStages::value_type(page_id, last_filter_idx)
+		).first->second;
+		stage = std::max(stage, last_filter_idx);
+	}
+	
+	QByteArray const data(doc.toByteArray(0));
+	QByteArray record(QByteArray::number(data.size()));
+	record += '\n';
+	record += data;
+	record += '\n';
+	
+	if (m_file.write(record) != record.size() || !m_file.flush()) {
+		throw std::runtime_error("Unable to write to the batch journal.");
+	}
+#if defined(Q_OS_UNIX)
+	// Make it survive a power loss as well.
+	fsync(m_file.handle());
+#endif
+}
+
+void
+BatchJournal::remove()
+{
+	if (!m_file.remove()) {
+		throw std::runtime_error("Unable to delete the batch journal.");
+	}
+}
+
+qint64
+BatchJournal::replay()
+{
+	std::vector<QDomDocument> records;
+	qint64 end = 0;
+	
+	for (;;) {
+		QByteArray const header(m_file.readLine());
+		if (!header.endsWith('\n')) {
+			break;
+		}
+		
+		bool ok = true;
+		int const size = header.trimmed().toInt(&ok);
+		if (!ok || size < 0) {
+			break;
+		}
+		
+		QByteArray const data(m_file.read(size));
+		char terminator = 0;
+		if (data.size() != size || !m_file.getChar(&terminator) || terminator != '\n') {
+			break;
+		}
+		
+		QDomDocument doc;
+		if (!doc.setContent(data)) {
+			break;
+		}
+		
+		records.push_back(doc);
+		end = m_file.pos();
+	}
+	
+	if (records.empty()) {
+		return end;
+	}
+	
+	// Page layouts go first, as they determine which pages there are.
+	std::vector<QDomDocument>::const_iterator it(records.begin());
+	std::vector<QDomDocument>::const_iterator const records_end(records.end());
+	for (; it != records_end; ++it) {
+		ProjectReader const reader(*it);
+		if (!reader.success()) {
+			continue;
+		}
+		
+		PageSequence const images(reader.pages()->toPageSequence(IMAGE_VIEW));
+		for (unsigned i = 0; i < images.numPages(); ++i) {
+			PageInfo const& image = images.pageAt(i);
+			m_ptrPages->setLayoutTypeFor(
+				image.imageId(), image.imageSubPages() > 1
+				? ProjectPages::TWO_PAGE_LAYOUT : ProjectPages::ONE_PAGE_LAYOUT
+			);
+		}
+		
+		QDomElement const completed_el(
+			it->documentElement().namedItem("completed").toElement()
+		);
+		PageId const page_id(reader.pageId(completed_el.attribute("page").toInt()));
+		if (!page_id.isNull()) {
+			int const last_filter_idx = completed_el.attribute("stage").toInt();
+			int& stage = m_completedStages.insert(
+				CompletedStages::value_type(page_id, last_filter_idx)
+			).first->second;
+			stage = std::max(stage, last_filter_idx);
+		}
+	}
+	
+	// Then filter settings.  We merge them into the project as a whole
+	// and load them from there, as filters only know how to load all
+	// of their settings at once.
+	ProjectWriter const writer(m_ptrPages, SelectedPage(), m_outFileNameGen);
+	QDomDocument doc(writer.toDocument(m_ptrStages->filters()));
+	SettingsMerger merger(doc, writer);
+	for (it = records.begin(); it != records_end; ++it) {
+		ProjectReader const reader(*it);
+		if (reader.success()) {
+			merger.merge(reader, it->documentElement().namedItem("filters").toElement());
+		}
+	}
+	
+	ProjectReader(doc).readFilterSettings(m_ptrStages->filters());
+	
+	return end;
+}
@@ -0,0 +1,103 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BATCH_JOURNAL_H_
+#define BATCH_JOURNAL_H_
+
+#include "NonCopyable.h"
+#include "IntrusivePtr.h"
+#include "PageId.h"
+#include "OutputFileNameGenerator.h"
+#include <QString>
+#include <QFile>
+#include <map>
+
+class ProjectPages;
+class StageSequence;
+
+/**
+ * \brief An append-only record of pages completed by a command line batch.
+ *
+ * Every time a page goes through a range of filters, a record is appended
+ * to the journal.  A record is a small project file covering the image
+ * the page belongs to, so it carries the page layout of the image and
+ * the settings every filter has for its pages.
+ *
+ * When resuming an interrupted batch, the journal is replayed into the
+ * project before processing starts, and pages it reports as completed
+ * may be skipped.  A record that was only partially written when the
+ * batch got interrupted is ignored.  Once the batch completes, the journal
+ * is deleted.
+ */
+class BatchJournal
+{
+	DECLARE_NON_COPYABLE(BatchJournal)
+public:
+	BatchJournal(QString const& file_path,
+		IntrusivePtr<ProjectPages> const& pages,
+		IntrusivePtr<StageSequence> const& stages,
+		OutputFileNameGenerator const& out_file_name_gen);
+	
+	~BatchJournal();
+	
+	/**
+	 * \brief Opens the journal for appending.
+	 *
+	 * \param resume If set, the existing records are replayed first.
+	 *        Otherwise, the journal is truncated.
+	 * \throw std::runtime_error if the journal can't be opened.
+	 */
+	void open(bool resume);
+	
+	/**
+	 * \brief Returns true if the journal says a page went through
+	 *        filters up to and including \p last_filter_idx.
+	 */
+	bool isCompleted(PageId const& page_id, int last_filter_idx) const;
+	
+	/**
+	 * \brief Appends a record saying a page went through filters up to
+	 *        and including \p last_filter_idx.
+	 */
+	void recordCompleted(PageId const& page_id, int last_filter_idx);
+	
+	/**
+	 * \brief Closes and deletes the journal.
+	 *
+	 * To be called once the batch it records has completed,
+	 * as there is nothing left to resume.
+	 */
+	void remove();
+private:
+	typedef std::map<PageId, int> CompletedStages;
+	
+	/**
+	 * Reads records from the journal and applies them to the project.
+	 * Returns the file position right after the last complete record.
+	 */
+	qint64 replay();
+	
+	QFile m_file;
+	IntrusivePtr<ProjectPages> m_ptrPages;
+	IntrusivePtr<StageSequence> m_ptrStages;
+	OutputFileNameGenerator m_outFileNameGen;
+	CompletedStages m_completedStages;
+};
+
+#endif
@@ -19,6 +19,7 @@
 */
 
 #include <cstdlib>
+#include <algorithm>
 #include <assert.h>
 #include <iostream>
 
@@ -166,6 +167,9 @@ CommandLine::setup()
 	m_deskewAngle = fetchDeskewAngle();
 	m_startFilterIdx = fetchStartFilterIdx();
 	m_endFilterIdx = fetchEndFilterIdx();
+	m_spillThreshold = fetchSpillThreshold();
+	m_memoryBudget = fetchMemoryBudget();
+	m_threads = fetchThreads();
 }
 
 
@@ -226,6 +230,7 @@ CommandLine::printHelp()
 	std::cout << "\t--color-mode=<black_and_white|color_grayscale|mixed>\n\t\t\t\t\t\t-- default: black_and_white" << "\n";
 	std::cout << "\t--white-margins\t\t\t\t-- default: false" << "\n";
 	std::cout << "\t--normalize-illumination\t\t-- default: false" << "\n";
+	std::cout << "\t--layered-output\t\t\t-- write mixed pages as MRC layers; default: false" << "\n";
 	std::cout << "\t--threshold=<n>\t\t\t\t-- n<0 thinner, n>0 thicker; default: 0" << "\n";
 	std::cout << "\t--despeckle=<off|cautious|normal|aggressive>\n\t\t\t\t\t\t-- default: normal" << "\n";
 	std::cout << "\t--dewarping=<off|auto>\t\t\t-- default: off" << "\n";
@@ -233,6 +238,11 @@ CommandLine::printHelp()
 	std::cout << "\t--start-filter=<1...6>\t\t\t-- default: 4" << "\n";
 	std::cout << "\t--end-filter=<1...6>\t\t\t-- default: 6" << "\n";
 	std::cout << "\t--output-project=, -o=<project_name>" << "\n";
+	std::cout << "\t--resume\t\t\t\t-- skip pages completed by an interrupted run" << "\n";
+	std::cout << "\t--spill-dir=<directory>\t\t\t-- keep large image buffers in temporary files there" << "\n";
+	std::cout << "\t--spill-threshold=<MB>\t\t\t-- buffers this large always go to disk; default: 256" << "\n";
+	std::cout << "\t--memory-budget=<MB>\t\t\t-- buffers exceeding this go to disk; default: unlimited" << "\n";
+	std::cout << "\t--threads=<n>\t\t\t\t-- max threads working on a single image; default: 0 (number of CPUs)" << "\n";
 	std::cout << "\n";
 }
 
@@ -458,6 +468,33 @@ CommandLine::fetchEndFilterIdx()
 	return m_options.value("end-filter").toInt() - 1;
 }
 
+int
+CommandLine::fetchSpillThreshold()
+{
+	if (!hasSpillThreshold())
+		return hasSpillStorage() ? 256 : 0;
+
+	return m_options.value("spill-threshold").toInt();
+}
+
+int
+CommandLine::fetchMemoryBudget()
+{
+	if (!hasMemoryBudget())
+		return 0;
+
+	return m_options.value("memory-budget").toInt();
+}
+
+int
+CommandLine::fetchThreads()
+{
+	if (!hasThreads())
+		return 0;
+
+	return std::max(m_options.value("threads").toInt(), 0);
+}
+
 output::DewarpingMode
 CommandLine::fetchDewarpingMode()
 {
@@ -54,6 +54,7 @@ public:
 
 	bool isGui() const { return m_gui; }
 	bool isVerbose() const { return contains("verbose"); }
+	bool isResume() const { return contains("resume"); }
 
 	std::vector<ImageFileInfo> const& images() const { return m_images; }
 	QString const& outputDirectory() const { return m_outputDirectory; }
@@ -77,10 +78,16 @@ public:
 	bool hasColorMode() const { return contains("color-mode"); }
 	bool hasWhiteMargins() const { return contains("white-margins"); }
 	bool hasNormalizeIllumination() const { return contains("normalize-illumination"); }
+	bool hasLayeredOutput() const { return contains("layered-output"); }
 	bool hasThreshold() const { return contains("threshold"); }
 	bool hasDespeckle() const { return contains("despeckle"); }
 	bool hasDewarping() const { return contains("dewarping"); }
 	bool hasDepthPerception() const { return contains("dewarping"); }
+	bool hasSpillDirectory() const { return contains("spill-dir"); }
+	bool hasSpillThreshold() const { return contains("spill-threshold"); }
+	bool hasMemoryBudget() const { return contains("memory-budget"); }
+	bool hasSpillStorage() const { return hasSpillDirectory() || hasSpillThreshold() || hasMemoryBudget(); }
+	bool hasThreads() const { return contains("threads"); }
 
 	page_split::LayoutType getLayout() const { return m_layoutType; }
 	Qt::LayoutDirection getLayoutDirection() const { return m_layoutDirection; }
@@ -99,6 +106,10 @@ public:
 	output::DewarpingMode getDewarpingMode() const { return m_dewarpingMode; }
 	output::DespeckleLevel getDespeckleLevel() const { return m_despeckleLevel; }
 	output::DepthPerception getDepthPerception() const { return m_depthPerception; }
+	QString getSpillDirectory() const { return m_options.value("spill-dir"); }
+	int getSpillThreshold() const { return m_spillThreshold; }
+	int getMemoryBudget() const { return m_memoryBudget; }
+	int getThreads() const { return m_threads; }
 
 	bool help() { return m_options.contains("help"); }
 	void printHelp();
@@ -140,6 +151,9 @@ private:
 	output::DewarpingMode m_dewarpingMode;
 	output::DespeckleLevel m_despeckleLevel;
 	output::DepthPerception m_depthPerception;
+	int m_spillThreshold;
+	int m_memoryBudget;
+	int m_threads;
 
 	void parseCli(QStringList const& argv);
 	void addImage(QString const& path);
@@ -158,6 +172,9 @@ private:
 	double fetchDeskewAngle();
 	int fetchStartFilterIdx();
 	int fetchEndFilterIdx();
+	int fetchSpillThreshold();
+	int fetchMemoryBudget();
+	int fetchThreads();
 	output::DewarpingMode fetchDewarpingMode();
 	output::DespeckleLevel fetchDespeckleLevel();
 	output::DepthPerception fetchDepthPerception();
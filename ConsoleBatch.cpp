@@ -20,6 +20,8 @@
 
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <set>
 #include <assert.h>
 
 #include "Utils.h"
@@ -36,8 +38,10 @@
 #include "ImageId.h"
 #include "ThumbnailPixmapCache.h"
 #include "LoadFileTask.h"
+#include "InputPrefetcher.h"
 #include "ProjectWriter.h"
 #include "ProjectReader.h"
+#include "BatchJournal.h"
 #include "OrthogonalRotation.h"
 #include "SelectedPage.h"
 
@@ -68,6 +72,7 @@
 #include "filters/output/CacheDrivenTask.h"
 
 #include <QMap>
+#include <QDir>
 #include <QDomDocument>
 
 #include "ConsoleBatch.h"
@@ -83,6 +88,9 @@ ConsoleBatch::ConsoleBatch(std::vector<ImageFileInfo> const& images, QString con
 
 	//m_ptrThumbnailCache = IntrusivePtr<ThumbnailPixmapCache>(new ThumbnailPixmapCache(output_dir+"/cache/thumbs", QSize(200,200), 40, 5));
 	m_ptrThumbnailCache = Utils::createThumbnailCache(output_directory);
+	// Nobody looks at thumbnails in batch mode.  Just make sure
+	// the outdated ones get removed.
+	m_ptrThumbnailCache->setWritingEnabled(false);
 	m_outFileNameGen = OutputFileNameGenerator(m_ptrDisambiguator, output_directory, m_ptrPages->layoutDirection());
 }
 
@@ -118,6 +126,9 @@ ConsoleBatch::ConsoleBatch(QString const project_file)
 
 	//m_ptrThumbnailCache = IntrusivePtr<ThumbnailPixmapCache>(new ThumbnailPixmapCache(output_directory+"/cache/thumbs", QSize(200,200), 40, 5));
 	m_ptrThumbnailCache = Utils::createThumbnailCache(output_directory);
+	// Nobody looks at thumbnails in batch mode.  Just make sure
+	// the outdated ones get removed.
+	m_ptrThumbnailCache->setWritingEnabled(false);
 	m_outFileNameGen = OutputFileNameGenerator(m_ptrDisambiguator, output_directory, m_ptrPages->layoutDirection());
 }
 
@@ -176,10 +187,14 @@ ConsoleBatch::createCompositeTask(
 	}
 	assert(fix_orientation_task);
 	
+	// Stages before output only analyse grayscale versions of images.
+	bool const grayscale_only = !output_task;
+
 	return BackgroundTaskPtr(
 		new LoadFileTask(
 			BackgroundTask::BATCH,
-			page, m_ptrThumbnailCache, m_ptrPages, fix_orientation_task
+			page, m_ptrThumbnailCache, m_ptrPages, fix_orientation_task,
+			grayscale_only
 		)
 	);
 }
@@ -207,20 +222,142 @@ ConsoleBatch::process()
 		endFilterIdx = ef;
 	}
 
-	for (int j=startFilterIdx; j<=endFilterIdx; j++) {
-		if (cli.isVerbose())
-			std::cout << "Filter: " << (j+1) << "\n";
+	// Completed pages are journaled as we go, so that an interrupted
+	// batch can be resumed rather than started over.
+	m_ptrJournal.reset(
+		new BatchJournal(
+			QDir(m_outFileNameGen.outDir()).absoluteFilePath("cache/batch.journal"),
+			m_ptrPages, m_ptrStages, m_outFileNameGen
+		)
+	);
+	m_ptrJournal->open(cli.isResume());
+
+	// Stages up to and including page layout are run in one chain per page,
+	// so that each image is decoded once for all of them.  Output needs the
+	// aggregate page size, which is only final once page layout has seen
+	// every page, so it goes in a separate pass.
+	int const lastChainedFilterIdx = std::min(endFilterIdx, m_ptrStages->pageLayoutFilterIdx());
+	if (startFilterIdx <= lastChainedFilterIdx) {
+		processPages(startFilterIdx, lastChainedFilterIdx);
+		if (lastChainedFilterIdx >= m_ptrStages->pageLayoutFilterIdx()) {
+			// Splitting pages leaves behind settings for pages that no longer exist.
+			m_ptrStages->pageLayoutFilter()->getSettings()->removePagesMissingFrom(
+				m_ptrPages->toPageSequence(PAGE_VIEW)
+			);
+		}
+	}
+
+	for (int j=std::max(startFilterIdx, lastChainedFilterIdx+1); j<=endFilterIdx; j++) {
+		processPages(j, j);
+	}
+
+	InputPrefetcher::instance().clearSchedule();
+	m_ptrStages->outputFilter()->waitForPendingWrites();
+
+	// Nothing is left to resume.
+	m_ptrJournal->remove();
+}
+
+void
+ConsoleBatch::processPages(int const first_filter_idx, int const last_filter_idx)
+{
+	CommandLine const& cli = CommandLine::get();
+
+	if (cli.isVerbose()) {
+		if (first_filter_idx == last_filter_idx)
+			std::cout << "Filter: " << (first_filter_idx+1) << "\n";
+		else
+			std::cout << "Filters: " << (first_filter_idx+1) << "-" << (last_filter_idx+1) << "\n";
+	}
+
+	// Splitting a page in the middle of a chain makes new pages appear,
+	// so we keep going until every page in the sequence was processed.
+	// The page split stage stops the chain for a page it replaced,
+	// leaving the following stages to the pages that replaced it.
+	std::set<PageId> processed;
+	for (bool first_round = true;; first_round = false) {
+		PageSequence const page_sequence = m_ptrPages->toPageSequence(PAGE_VIEW);
 
-		PageSequence page_sequence = m_ptrPages->toPageSequence(PAGE_VIEW);
-		setupFilter(j, page_sequence.selectAll());
+		std::vector<PageInfo> pending;
+		std::set<PageId> pending_ids;
 		for (unsigned i=0; i<page_sequence.numPages(); i++) {
-			PageInfo page = page_sequence.pageAt(i);
+			PageInfo const& page = page_sequence.pageAt(i);
+			if (!processed.insert(page.id()).second)
+				continue;
+			if (m_ptrJournal->isCompleted(page.id(), last_filter_idx)) {
+				if (cli.isVerbose())
+					std::cout << "\tCompleted: " << page.imageId().filePath().toAscii().constData() << "\n";
+				continue;
+			}
+			pending.push_back(page);
+			pending_ids.insert(page.id());
+		}
+		if (pending.empty())
+			break;
+
+		// Stages up to page split work on whole images and were already
+		// set up for the pages the new ones were split from.
+		int setup_from = first_filter_idx;
+		if (!first_round)
+			setup_from = std::max(setup_from, m_ptrStages->pageSplitFilterIdx()+1);
+		for (int j=setup_from; j<=last_filter_idx; j++)
+			setupFilter(j, pending_ids);
+
+		std::vector<QString> file_paths;
+		file_paths.reserve(pending.size());
+		for (unsigned i=0; i<pending.size(); i++) {
+			file_paths.push_back(pending[i].imageId().filePath());
+		}
+		InputPrefetcher::instance().setSchedule(file_paths);
+
+		// A page is journaled once the next one was processed, giving
+		// its output files time to be written in the background.
+		PageId to_journal;
+		for (unsigned i=0; i<pending.size(); i++) {
+			PageInfo const& page = pending[i];
 			if (cli.isVerbose())
 				std::cout << "\tProcessing: " << page.imageId().filePath().toAscii().constData() << "\n";
-			BackgroundTaskPtr bgTask = createCompositeTask(page, j);
-			(*bgTask)();
+			BackgroundTaskPtr bgTask = createCompositeTask(page, last_filter_idx);
+			FilterResultPtr const result((*bgTask)());
+
+			if (!to_journal.isNull())
+				journalPage(to_journal, last_filter_idx);
+			to_journal = PageId();
+
+			// A result not coming from a filter means the image failed to load.
+			// A page replaced by splitting its image is no longer there to journal.
+			if ((!result || result->filter()) && pageExists(page))
+				to_journal = page.id();
+		}
+		if (!to_journal.isNull())
+			journalPage(to_journal, last_filter_idx);
+	}
+}
+
+bool
+ConsoleBatch::pageExists(PageInfo const& page) const
+{
+	std::vector<PageInfo> const pages(m_ptrPages->pagesOfImage(page.imageId()));
+	for (unsigned i=0; i<pages.size(); i++) {
+		if (pages[i].id() == page.id())
+			return true;
+	}
+	return false;
+}
+
+void
+ConsoleBatch::journalPage(PageId const& page_id, int const last_filter_idx)
+{
+	if (last_filter_idx >= m_ptrStages->outputFilterIdx()) {
+		IntrusivePtr<output::Filter> const output = m_ptrStages->outputFilter();
+		output->waitForPendingWrites(page_id);
+		if (!output->getSettings()->getOutputParams(page_id).get()) {
+			// Output files failed to be written.
+			return;
 		}
 	}
+
+	m_ptrJournal->recordCompleted(page_id, last_filter_idx);
 }
 
 void
@@ -388,6 +525,9 @@ ConsoleBatch::setupOutput(std::set<PageId> allPages)
 			colorParams.setColorGrayscaleOptions(cgo);
 		}
 
+		if (cli.hasLayeredOutput())
+			colorParams.setLayeredOutput(true);
+
 		if (cli.hasThreshold()) {
 			output::BlackWhiteOptions bwo;
 			bwo.setThresholdAdjustment(cli.getThreshold());
@@ -38,6 +38,7 @@
 #include "StageSequence.h"
 #include "PageSelectionAccessor.h"
 #include "ProjectReader.h"
+#include "BatchJournal.h"
 
 
 class ConsoleBatch
@@ -62,6 +63,18 @@ private:
 	OutputFileNameGenerator m_outFileNameGen;
 	IntrusivePtr<ThumbnailPixmapCache> m_ptrThumbnailCache;
 	std::auto_ptr<ProjectReader> m_ptrReader;
+	std::auto_ptr<BatchJournal> m_ptrJournal;
+
+	/**
+	 * Runs the filters from first_filter_idx to last_filter_idx
+	 * on every page, one page at a time.
+	 */
+	void processPages(int first_filter_idx, int last_filter_idx);
+
+	void journalPage(PageId const& page_id, int last_filter_idx);
+
+	/** Returns false for a page replaced by splitting its image. */
+	bool pageExists(PageInfo const& page) const;
 
 	void setupFilter(int idx, std::set<PageId> allPages);
 	void setupFixOrientation(std::set<PageId> allPages);
@@ -20,21 +20,76 @@
 #include "Dpm.h"
 #include "Dpi.h"
 #include "imageproc/Grayscale.h"
+#include <QMutexLocker>
 
 using namespace imageproc;
 
 FilterData::FilterData(QImage const& image)
 :	m_origImage(image),
-	m_grayImage(toGrayscale(m_origImage)),
 	m_xform(image.rect(), Dpm(image)),
-	m_bwThreshold(BinaryThreshold::otsuThreshold(m_grayImage))
+	m_ptrDerived(new Derived(image))
 {
 }
 
 FilterData::FilterData(FilterData const& other, ImageTransformation const& xform)
 :	m_origImage(other.m_origImage),
-	m_grayImage(other.m_grayImage),
 	m_xform(xform),
-	m_bwThreshold(other.m_bwThreshold)
+	m_ptrDerived(other.m_ptrDerived)
 {
 }
+
+BinaryThreshold
+FilterData::bwThreshold() const
+{
+	return m_ptrDerived->bwThreshold();
+}
+
+GrayImage const&
+FilterData::grayImage() const
+{
+	return m_ptrDerived->grayImage();
+}
+
+
+/*=========================== FilterData::Derived ==========================*/
+
+FilterData::Derived::Derived(QImage const& orig_image)
+:	m_origImage(orig_image),
+	m_bwThreshold(0),
+	m_grayImageReady(false),
+	m_bwThresholdReady(false)
+{
+}
+
+GrayImage const&
+FilterData::Derived::grayImage()
+{
+	QMutexLocker const locker(&m_mutex);
+	return grayImageLocked();
+}
+
+BinaryThreshold
+FilterData::Derived::bwThreshold()
+{
+	QMutexLocker const locker(&m_mutex);
+	
+	if (!m_bwThresholdReady) {
+		m_bwThreshold = BinaryThreshold::otsuThreshold(grayImageLocked());
+		m_bwThresholdReady = true;
+	}
+	
+	return BinaryThreshold(m_bwThreshold);
+}
+
+GrayImage const&
+FilterData::Derived::grayImageLocked()
+{
+	if (!m_grayImageReady) {
+		m_grayImage = GrayImage(toGrayscale(m_origImage));
+		m_grayImageReady = true;
+	}
+
+	// Once computed, m_grayImage is never modified again, so it's safe
+	// to hand out references to it after releasing the mutex.
+	return m_grayImage;
+}
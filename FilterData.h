@@ -22,7 +22,11 @@
 #include "imageproc/BinaryThreshold.h"
 #include "imageproc/GrayImage.h"
 #include "ImageTransformation.h"
+#include "RefCountable.h"
+#include "IntrusivePtr.h"
+#include "NonCopyable.h"
 #include <QImage>
+#include <QMutex>
 
 class FilterData
 {
@@ -32,18 +36,53 @@ public:
 	
 	FilterData(FilterData const& other, ImageTransformation const& xform);
 		
-	imageproc::BinaryThreshold bwThreshold() const { return m_bwThreshold; }
+	/**
+	 * \brief The Otsu threshold of grayImage().
+	 *
+	 * Computed on first access and shared with all copies.
+	 */
+	imageproc::BinaryThreshold bwThreshold() const;
 	
 	ImageTransformation const& xform() const { return m_xform; }
 
 	QImage const& origImage() const {return m_origImage;}
 
-	imageproc::GrayImage const& grayImage() const {return m_grayImage;}
+	/**
+	 * \brief A grayscale version of origImage().
+	 *
+	 * Computed on first access and shared with all copies.  Cached and
+	 * no-op runs of the filter chain never get to pay for it.
+	 */
+	imageproc::GrayImage const& grayImage() const;
 private:
+	/**
+	 * Data derived from the original image.  Copies of FilterData made
+	 * with a different transformation share the same instance, which
+	 * may be accessed from several threads.
+	 */
+	class Derived : public RefCountable
+	{
+		DECLARE_NON_COPYABLE(Derived)
+	public:
+		Derived(QImage const& orig_image);
+
+		imageproc::GrayImage const& grayImage();
+
+		imageproc::BinaryThreshold bwThreshold();
+	private:
+		imageproc::GrayImage const& grayImageLocked();
+
+		QMutex m_mutex;
+		QImage m_origImage;
+		imageproc::GrayImage m_grayImage;
+		int m_bwThreshold;
+		bool m_grayImageReady;
+		bool m_bwThresholdReady;
+	};
+
 	QImage m_origImage;
-	imageproc::GrayImage m_grayImage;
 	ImageTransformation m_xform;
-	imageproc::BinaryThreshold m_bwThreshold;
+	IntrusivePtr<Derived> m_ptrDerived;
 };
 
 #endif
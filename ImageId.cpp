@@ -17,23 +17,40 @@
 */
 
 #include "ImageId.h"
+#include "ImageIdTable.h"
 #include <QFileInfo>
 
 ImageId::ImageId(QString const& file_path, int const page)
 :	m_filePath(file_path),
-	m_page(page)
+	m_page(page),
+	m_handle(ImageIdTable::instance().handleFor(file_path, page))
 {
 }
 
 ImageId::ImageId(QFileInfo const& file_info, int const page)
 :	m_filePath(file_info.absoluteFilePath()),
-	m_page(page)
+	m_page(page),
+	m_handle(ImageIdTable::instance().handleFor(m_filePath, page))
 {
 }
 
+void
+ImageId::setFilePath(QString const& path)
+{
+	m_filePath = path;
+	m_handle = ImageIdTable::instance().handleFor(m_filePath, m_page);
+}
+
+void
+ImageId::setPage(int const page)
+{
+	m_page = page;
+	m_handle = ImageIdTable::instance().handleFor(m_filePath, m_page);
+}
+
 bool operator==(ImageId const& lhs, ImageId const& rhs)
 {
-	return lhs.page() == rhs.page() && lhs.filePath() == rhs.filePath();
+	return lhs.handle() == rhs.handle();
 }
 
 bool operator!=(ImageId const& lhs, ImageId const& rhs)
@@ -43,11 +60,10 @@ bool operator!=(ImageId const& lhs, ImageId const& rhs)
 
 bool operator<(ImageId const& lhs, ImageId const& rhs)
 {
-	int const comp = lhs.filePath().compare(rhs.filePath());
-	if (comp < 0) {
-		return true;
-	} else if (comp > 0) {
-		return false;
-	}
-	return lhs.page() < rhs.page();
+	return lhs.handle() < rhs.handle();
+}
+
+uint qHash(ImageId const& image_id)
+{
+	return uint(image_id.handle());
 }
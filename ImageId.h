@@ -20,6 +20,7 @@
 #define IMAGEID_H_
 
 #include <QString>
+#include <QtGlobal>
 
 class QFileInfo;
 
@@ -27,7 +28,7 @@ class ImageId
 {
 	// Member-wise copying is OK.
 public:
-	ImageId() : m_filePath(), m_page(0) {}
+	ImageId() : m_filePath(), m_page(0), m_handle(0) {}
 	
 	explicit ImageId(QString const& file_path, int page = 0);
 	
@@ -37,11 +38,18 @@ public:
 	
 	QString const& filePath() const { return m_filePath; }
 
-	void setFilePath(QString const& path) { m_filePath = path; }
+	void setFilePath(QString const& path);
 	
 	int page() const { return m_page; }
 
-	void setPage(int page) { m_page = page; }
+	void setPage(int page);
+
+	/**
+	 * \brief A process-wide unique integer for the file path and page number.
+	 *
+	 * \see ImageIdTable
+	 */
+	int handle() const { return m_handle; }
 
 	int zeroBasedPage() const { return m_page > 0 ? m_page - 1 : 0; } 
 
@@ -54,10 +62,19 @@ private:
 	 * If above zero, indicates Nth page in a multipage file.
 	 */
 	int m_page;
+
+	int m_handle;
 };
 
 bool operator==(ImageId const& lhs, ImageId const& rhs);
 bool operator!=(ImageId const& lhs, ImageId const& rhs);
+
+/**
+ * \note The ordering is by handle, not by file path.  It's stable within
+ *       a process, but may differ between processes.
+ */
 bool operator<(ImageId const& lhs, ImageId const& rhs);
 
+uint qHash(ImageId const& image_id);
+
 #endif
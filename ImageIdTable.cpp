@@ -0,0 +1,56 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ImageIdTable.h"
+#include <QMutexLocker>
+
+ImageIdTable&
+ImageIdTable::instance()
+{
+	// Depending on the compiler, this may not be thread-safe,
+	// so we make sure it's called from the main thread early on.
+	static ImageIdTable object;
+	return object;
+}
+
+ImageIdTable::ImageIdTable()
+{
+}
+
+int
+ImageIdTable::handleFor(QString const& file_path, int const page)
+{
+	if (file_path.isEmpty() && page == 0) {
+		// That's what a default-constructed ImageId has.
+		return 0;
+	}
+
+	QPair<QString, int> const key(file_path, page);
+
+	QMutexLocker const locker(&m_mutex);
+
+	Handles::const_iterator const it(m_handles.constFind(key));
+	if (it != m_handles.constEnd()) {
+		return it.value();
+	}
+
+	int const handle = m_handles.size() + 1;
+	m_handles.insert(key, handle);
+	return handle;
+}
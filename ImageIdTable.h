@@ -0,0 +1,64 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef IMAGE_ID_TABLE_H_
+#define IMAGE_ID_TABLE_H_
+
+#include "NonCopyable.h"
+#include <QString>
+#include <QHash>
+#include <QPair>
+#include <QMutex>
+
+/**
+ * \brief Assigns small integer handles to (file path, page number) pairs.
+ *
+ * ImageId keeps the handle of its file path and page number next to them,
+ * which makes comparing image and page ids (and so looking them up in
+ * per-page settings) a matter of comparing integers rather than paths.
+ *
+ * Handles are dense, start from 1 and are never reused.  Handle 0 is
+ * reserved for a null or empty path with page number 0, which is what
+ * a default-constructed ImageId has.  The table is process-wide and only
+ * grows, which is fine, as the number of distinct images a process sees
+ * stays within the size of the projects it opens.
+ *
+ * \note All methods of this class are thread-safe.
+ */
+class ImageIdTable
+{
+	DECLARE_NON_COPYABLE(ImageIdTable)
+public:
+	static ImageIdTable& instance();
+
+	/**
+	 * \brief Returns the handle for a file path and page number,
+	 *        allocating a new one if necessary.
+	 */
+	int handleFor(QString const& file_path, int page);
+private:
+	typedef QHash<QPair<QString, int>, int> Handles;
+
+	ImageIdTable();
+
+	QMutex m_mutex;
+	Handles m_handles;
+};
+
+#endif
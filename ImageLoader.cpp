@@ -18,9 +18,12 @@
 
 #include "ImageLoader.h"
 #include "TiffReader.h"
+#include "JpegReader.h"
 #include "ImageId.h"
+#include "imageproc/Grayscale.h"
 #include <QImage>
 #include <QString>
+#include <QSize>
 #include <QIODevice>
 #include <QFile>
 
@@ -52,7 +55,76 @@ ImageLoader::load(QIODevice& io_dev, int const page_num)
 		return QImage();
 	}
 	
+	if (JpegReader::canRead(io_dev)) {
+		QImage const image(loadJpeg(io_dev, QSize()));
+		if (!image.isNull()) {
+			return image;
+		}
+	}
+	
 	QImage image;
 	image.load(&io_dev, 0);
 	return image;
 }
+
+QImage
+ImageLoader::loadReduced(ImageId const& image_id, QSize const& target_size)
+{
+	QFile file(image_id.filePath());
+	if (!file.open(QIODevice::ReadOnly)) {
+		return QImage();
+	}
+	
+	QImage image;
+	if (image_id.zeroBasedPage() == 0 && JpegReader::canRead(file)) {
+		image = loadJpeg(file, target_size);
+	}
+	
+	if (image.isNull()) {
+		image = load(file, image_id.zeroBasedPage());
+	}
+	
+	return image;
+}
+
+QImage
+ImageLoader::loadGrayscale(ImageId const& image_id)
+{
+	QFile file(image_id.filePath());
+	if (!file.open(QIODevice::ReadOnly)) {
+		return QImage();
+	}
+	
+	QImage image;
+	if (image_id.zeroBasedPage() == 0 && JpegReader::canRead(file)) {
+		image = loadJpeg(file, QSize(), true);
+	}
+	
+	if (image.isNull()) {
+		image = load(file, image_id.zeroBasedPage());
+	}
+	
+	if (image.isNull() || (image.format() == QImage::Format_Indexed8 && image.isGrayscale())) {
+		return image;
+	}
+	
+	QImage gray(imageproc::toGrayscale(image));
+	gray.setDotsPerMeterX(image.dotsPerMeterX());
+	gray.setDotsPerMeterY(image.dotsPerMeterY());
+	return gray;
+}
+
+QImage
+ImageLoader::loadJpeg(QIODevice& io_dev, QSize const& target_size, bool const grayscale)
+{
+	qint64 const orig_pos = io_dev.pos();
+	
+	QImage const image(JpegReader::readImage(io_dev, target_size, grayscale));
+	if (image.isNull() && !io_dev.isSequential()) {
+		// Unsupported colour spaces (CMYK) are left to Qt,
+		// so we rewind the device for it.
+		io_dev.seek(orig_pos);
+	}
+	
+	return image;
+}
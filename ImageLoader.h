@@ -22,6 +22,7 @@
 class ImageId;
 class QImage;
 class QString;
+class QSize;
 class QIODevice;
 
 class ImageLoader
@@ -32,6 +33,30 @@ public:
 	static QImage load(ImageId const& image_id);
 	
 	static QImage load(QIODevice& io_dev, int page_num);
+	
+	/**
+	 * \brief Loads an image, possibly at a reduced resolution.
+	 *
+	 * \param image_id The image to load.
+	 * \param target_size If not empty, the image may be loaded at a reduced
+	 *        resolution, for as long as it can still be scaled to fit
+	 *        \p target_size with Qt::KeepAspectRatio without upscaling.
+	 *        At the moment, only JPEG images are reduced that way.
+	 *        Others are loaded at their original resolution.
+	 */
+	static QImage loadReduced(ImageId const& image_id, QSize const& target_size);
+
+	/**
+	 * \brief Loads a grayscale version of an image.
+	 *
+	 * This is meant for analysis that doesn't look at colours anyway.
+	 * For JPEG images, only the luminance channel is decoded.  Others
+	 * are loaded as usual, then converted to grayscale.
+	 */
+	static QImage loadGrayscale(ImageId const& image_id);
+private:
+	static QImage loadJpeg(
+		QIODevice& io_dev, QSize const& target_size, bool grayscale = false);
 };
 
 #endif
@@ -0,0 +1,208 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "InputPrefetcher.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QMutexLocker>
+#include <vector>
+
+#if defined(Q_OS_UNIX)
+#include <fcntl.h>
+#endif
+
+class InputPrefetcher::PrefetchThread : public QThread
+{
+public:
+	PrefetchThread(InputPrefetcher& owner) : m_rOwner(owner) {}
+protected:
+	virtual void run() { m_rOwner.prefetchLoop(); }
+private:
+	InputPrefetcher& m_rOwner;
+};
+
+
+InputPrefetcher::InputPrefetcher()
+:	m_position(0),
+	m_nextToPrefetch(0),
+	m_generation(0),
+	m_shuttingDown(false),
+	m_ptrThread(new PrefetchThread(*this))
+{
+	m_ptrThread->start(QThread::LowPriority);
+}
+
+InputPrefetcher::~InputPrefetcher()
+{
+	{
+		QMutexLocker const locker(&m_mutex);
+		m_shuttingDown = true;
+		++m_generation;
+		m_workAvailable.wakeAll();
+	}
+
+	m_ptrThread->wait();
+}
+
+InputPrefetcher&
+InputPrefetcher::instance()
+{
+	// Depending on the compiler, this may not be thread-safe,
+	// so we make sure it's called from the main thread early on.
+	static InputPrefetcher object;
+	return object;
+}
+
+void
+InputPrefetcher::setSchedule(std::vector<QString> const& file_paths)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	m_schedule.clear();
+	m_schedule.reserve(file_paths.size());
+
+	// Consecutive pages often come from the same file.
+	for (size_t i = 0; i < file_paths.size(); ++i) {
+		if (m_schedule.empty() || m_schedule.back() != file_paths[i]) {
+			m_schedule.push_back(file_paths[i]);
+		}
+	}
+
+	m_fileSizes.assign(m_schedule.size(), -1);
+	m_position = 0;
+	m_nextToPrefetch = 0;
+	++m_generation;
+	m_workAvailable.wakeAll();
+}
+
+void
+InputPrefetcher::clearSchedule()
+{
+	setSchedule(std::vector<QString>());
+}
+
+void
+InputPrefetcher::loading(QString const& file_path)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	for (size_t i = m_position; i < m_schedule.size(); ++i) {
+		if (m_schedule[i] == file_path) {
+			m_position = i;
+			if (m_nextToPrefetch <= i) {
+				// We've fallen behind.  There is no point in prefetching
+				// the file being loaded right now.
+				m_nextToPrefetch = i + 1;
+			}
+			m_workAvailable.wakeAll();
+			return;
+		}
+	}
+}
+
+void
+InputPrefetcher::prefetchLoop()
+{
+	QMutexLocker locker(&m_mutex);
+
+	for (;;) {
+		if (m_shuttingDown) {
+			return;
+		}
+
+		int const idx = nextToPrefetchLocked();
+		if (idx < 0) {
+			m_workAvailable.wait(&m_mutex);
+			continue;
+		}
+
+		QString const file_path(m_schedule[idx]);
+		unsigned const generation = m_generation;
+		m_nextToPrefetch = idx + 1;
+
+		locker.unlock();
+		qint64 const file_size = QFileInfo(file_path).size();
+		bool const completed = prefetchFile(file_path, generation);
+		locker.relock();
+
+		if (completed && generation == m_generation) {
+			m_fileSizes[idx] = file_size;
+		}
+	}
+}
+
+int
+InputPrefetcher::nextToPrefetchLocked() const
+{
+	if (m_nextToPrefetch >= m_schedule.size()) {
+		return -1;
+	}
+
+	if (m_nextToPrefetch > m_position + MAX_FILES_AHEAD) {
+		return -1;
+	}
+
+	qint64 bytes_ahead = 0;
+	for (size_t i = m_position + 1; i < m_nextToPrefetch; ++i) {
+		if (m_fileSizes[i] > 0) {
+			bytes_ahead += m_fileSizes[i];
+		}
+	}
+
+	// Note that we always allow at least one file to be read ahead,
+	// no matter how large it is.
+	qint64 const max_bytes_ahead = qint64(MAX_MB_AHEAD) << 20;
+	if (bytes_ahead > 0 && bytes_ahead >= max_bytes_ahead) {
+		return -1;
+	}
+	
+	return (int)m_nextToPrefetch;
+}
+
+bool
+InputPrefetcher::prefetchFile(QString const& file_path, unsigned const generation)
+{
+	QFile file(file_path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+
+#if defined(Q_OS_UNIX) && defined(POSIX_FADV_WILLNEED)
+	// This alone would be enough for local disks.
+	posix_fadvise(file.handle(), 0, 0, POSIX_FADV_WILLNEED);
+#endif
+
+	// Network file systems may ignore the above hint, so we read
+	// the file through.  The data itself is discarded, what we are
+	// after is the OS caching it.
+	std::vector<char> buf(CHUNK_SIZE);
+	for (;;) {
+		{
+			QMutexLocker const locker(&m_mutex);
+			if (generation != m_generation) {
+				return false;
+			}
+		}
+		
+		qint64 const bytes_read = file.read(&buf[0], CHUNK_SIZE);
+		if (bytes_read <= 0) {
+			return bytes_read == 0;
+		}
+	}
+}
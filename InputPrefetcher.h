@@ -0,0 +1,122 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INPUT_PREFETCHER_H_
+#define INPUT_PREFETCHER_H_
+
+#include "NonCopyable.h"
+#include <QString>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QtGlobal>
+#include <vector>
+#include <memory>
+#include <stddef.h>
+
+/**
+ * \brief Reads input files ahead of batch processing.
+ *
+ * While a page is being processed, the files of the next few pages
+ * are read on a background thread, so that they come from the operating
+ * system's file cache by the time they are loaded.  This matters most
+ * with input files on network storage.
+ *
+ * Batch processing announces the order of files with setSchedule().
+ * LoadFileTask reports every file it's about to load through loading(),
+ * which is how the prefetcher knows where the batch is.  Files are never
+ * read ahead by more than MAX_FILES_AHEAD files or MAX_MB_AHEAD megabytes.
+ *
+ * \note All methods of this class are thread-safe.
+ */
+class InputPrefetcher
+{
+	DECLARE_NON_COPYABLE(InputPrefetcher)
+public:
+	static InputPrefetcher& instance();
+
+	~InputPrefetcher();
+
+	/**
+	 * \brief Sets the files batch processing is going to load, in order.
+	 *
+	 * Replaces the previous schedule, if any.
+	 */
+	void setSchedule(std::vector<QString> const& file_paths);
+
+	/**
+	 * \brief Stops prefetching, until the next setSchedule().
+	 */
+	void clearSchedule();
+
+	/**
+	 * \brief To be called right before loading a file.
+	 *
+	 * If the file is on the schedule, the files following it are prefetched.
+	 * Otherwise, the call is ignored.
+	 */
+	void loading(QString const& file_path);
+private:
+	class PrefetchThread;
+
+	/** The maximum number of files to be read ahead of the one being loaded. */
+	enum { MAX_FILES_AHEAD = 3 };
+
+	/** The maximum total size of files read ahead, in megabytes. */
+	enum { MAX_MB_AHEAD = 256 };
+
+	/** Files are read in chunks of this size. */
+	enum { CHUNK_SIZE = 1 << 20 };
+
+	InputPrefetcher();
+
+	void prefetchLoop();
+
+	/**
+	 * \brief Reads a file, hinting the OS to cache it.
+	 *
+	 * \return false if prefetching was interrupted by a schedule change.
+	 */
+	bool prefetchFile(QString const& file_path, unsigned generation);
+
+	/**
+	 * \brief Returns the index of the next file to prefetch, or -1 if
+	 *        we've gone far enough ahead for now.
+	 */
+	int nextToPrefetchLocked() const;
+
+	QMutex m_mutex;
+	QWaitCondition m_workAvailable;
+	std::vector<QString> m_schedule;
+
+	/** The sizes of files on the schedule, known once they were prefetched. */
+	std::vector<qint64> m_fileSizes;
+
+	/** The index in m_schedule of the file being loaded. */
+	size_t m_position;
+
+	/** The index in m_schedule of the next file to prefetch. */
+	size_t m_nextToPrefetch;
+
+	/** Incremented on every schedule change. */
+	unsigned m_generation;
+
+	bool m_shuttingDown;
+	std::auto_ptr<PrefetchThread> m_ptrThread;
+};
+
+#endif
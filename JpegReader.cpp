@@ -0,0 +1,569 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C) 2007-2009  Joseph Artsimovich <joseph_a@mail.ru>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "JpegReader.h"
+#include "ImageMetadata.h"
+#include "NonCopyable.h"
+#include "Dpi.h"
+#include "Dpm.h"
+#include "imageproc/Grayscale.h"
+#include <QtGlobal>
+#include <QIODevice>
+#include <QImage>
+#include <QColor>
+#include <QSize>
+#include <QDebug>
+#include <new>
+#include <setjmp.h>
+#include <string.h>
+#include <assert.h>
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+using namespace imageproc;
+
+namespace
+{
+
+/*============================= JpegErrorManager ===========================*/
+
+class JpegErrorManager : public jpeg_error_mgr
+{
+	DECLARE_NON_COPYABLE(JpegErrorManager)
+public:
+	JpegErrorManager();
+	
+	jmp_buf& jmpBuf() { return m_jmpBuf; }
+private:
+	static void errorExit(j_common_ptr cinfo);
+	
+	static JpegErrorManager* object(j_common_ptr cinfo);
+	
+	jmp_buf m_jmpBuf;
+};
+
+JpegErrorManager::JpegErrorManager()
+{
+	jpeg_std_error(this);
+	error_exit = &JpegErrorManager::errorExit;
+}
+
+void
+JpegErrorManager::errorExit(j_common_ptr cinfo)
+{
+	longjmp(object(cinfo)->jmpBuf(), 1);
+}
+
+JpegErrorManager*
+JpegErrorManager::object(j_common_ptr cinfo)
+{
+	return static_cast<JpegErrorManager*>(cinfo->err);
+}
+
+
+/*======================== JpegDecompressionHandle =======================*/
+
+class JpegDecompressHandle
+{
+	DECLARE_NON_COPYABLE(JpegDecompressHandle)
+public:
+	/**
+	 * \throw std::bad_alloc if libjpeg fails to initialize, which at
+	 *        run time can only happen due to running out of memory.
+	 */
+	JpegDecompressHandle(JpegErrorManager& err_mgr, jpeg_source_mgr* src_mgr);
+	
+	~JpegDecompressHandle();
+	
+	jpeg_decompress_struct* ptr() { return &m_info; }
+	
+	jpeg_decompress_struct* operator->() { return &m_info; }
+private:
+	jpeg_decompress_struct m_info;
+};
+
+JpegDecompressHandle::JpegDecompressHandle(
+	JpegErrorManager& err_mgr, jpeg_source_mgr* src_mgr)
+{
+	// We are constructed before the caller's setjmp(), so errors
+	// have to be caught here.  jpeg_create_decompress() cleans up
+	// after itself before reporting an error.
+	if (setjmp(err_mgr.jmpBuf())) {
+		throw std::bad_alloc();
+	}
+
+	m_info.err = &err_mgr;
+	jpeg_create_decompress(&m_info);
+	m_info.src = src_mgr;
+}
+
+JpegDecompressHandle::~JpegDecompressHandle()
+{
+	jpeg_destroy_decompress(&m_info);
+}
+
+
+/*============================ JpegSourceManager =========================*/
+
+class JpegSourceManager : public jpeg_source_mgr
+{
+	DECLARE_NON_COPYABLE(JpegSourceManager)
+public:
+	JpegSourceManager(QIODevice& io_device);
+private:
+	static void initSource(j_decompress_ptr cinfo);
+	
+	static boolean fillInputBuffer(j_decompress_ptr cinfo);
+	
+	boolean fillInputBufferImpl();
+	
+	static void skipInputData(j_decompress_ptr cinfo, long num_bytes);
+	
+	void skipInputDataImpl(long num_bytes);
+	
+	static void termSource(j_decompress_ptr cinfo);
+	
+	static JpegSourceManager* object(j_decompress_ptr cinfo);
+	
+	QIODevice& m_rDevice;
+	JOCTET m_buf[4096];
+};
+
+JpegSourceManager::JpegSourceManager(QIODevice& io_device)
+:	m_rDevice(io_device)
+{
+	init_source = &JpegSourceManager::initSource;
+	fill_input_buffer = &JpegSourceManager::fillInputBuffer;
+	skip_input_data = &JpegSourceManager::skipInputData;
+	resync_to_restart = &jpeg_resync_to_restart;
+	term_source = &JpegSourceManager::termSource;
+	bytes_in_buffer = 0;
+	next_input_byte = m_buf;
+}
+
+void
+JpegSourceManager::initSource(j_decompress_ptr cinfo)
+{
+	// No-op.
+}
+
+boolean
+JpegSourceManager::fillInputBuffer(j_decompress_ptr cinfo)
+{
+	return object(cinfo)->fillInputBufferImpl();
+}
+
+boolean
+JpegSourceManager::fillInputBufferImpl()
+{
+	qint64 const bytes_read = m_rDevice.read((char*)m_buf, sizeof(m_buf));
+	if (bytes_read > 0) {
+		bytes_in_buffer = bytes_read;
+	} else {
+		// Insert a fake EOI marker.
+		m_buf[0] = 0xFF;
+		m_buf[1] = JPEG_EOI;
+		bytes_in_buffer = 2;
+	}
+	next_input_byte = m_buf;
+	return 1;
+}
+
+void
+JpegSourceManager::skipInputData(j_decompress_ptr cinfo, long num_bytes)
+{
+	object(cinfo)->skipInputDataImpl(num_bytes);
+}
+
+void
+JpegSourceManager::skipInputDataImpl(long num_bytes)
+{
+	if (num_bytes <= 0) {
+		return;
+	}
+	
+	while (num_bytes > (long)bytes_in_buffer) {
+		num_bytes -= (long)bytes_in_buffer;
+		fillInputBufferImpl();
+	}
+	next_input_byte += num_bytes;
+	bytes_in_buffer -= num_bytes;
+}
+
+void
+JpegSourceManager::termSource(j_decompress_ptr cinfo)
+{
+	// No-op.
+}
+
+JpegSourceManager*
+JpegSourceManager::object(j_decompress_ptr cinfo)
+{
+	return static_cast<JpegSourceManager*>(cinfo->src);
+}
+
+
+/*================================= EXIF =================================*/
+
+unsigned exifShort(unsigned char const* p, bool big_endian)
+{
+	if (big_endian) {
+		return (unsigned(p[0]) << 8) | p[1];
+	} else {
+		return (unsigned(p[1]) << 8) | p[0];
+	}
+}
+
+unsigned long exifLong(unsigned char const* p, bool big_endian)
+{
+	if (big_endian) {
+		return (exifShort(p, true) << 16) | exifShort(p + 2, true);
+	} else {
+		return (exifShort(p + 2, false) << 16) | exifShort(p, false);
+	}
+}
+
+/**
+ * Extracts XResolution, YResolution and ResolutionUnit from IFD0
+ * of the EXIF data embedded into an APP1 marker.
+ */
+Dpi exifDpi(jpeg_saved_marker_ptr marker)
+{
+	static unsigned char const exif_signature[] = { 'E', 'x', 'i', 'f', 0, 0 };
+	static unsigned const sig_size = sizeof(exif_signature);
+
+	enum { TAG_XRESOLUTION = 0x011a, TAG_YRESOLUTION = 0x011b, TAG_RESOLUTIONUNIT = 0x0128 };
+	enum { TYPE_SHORT = 3, TYPE_RATIONAL = 5 };
+	enum { RESUNIT_INCH = 2, RESUNIT_CENTIMETER = 3 };
+
+	for (; marker; marker = marker->next) {
+		if (marker->marker != JPEG_APP0 + 1 || marker->data_length < sig_size + 8) {
+			continue;
+		}
+		if (memcmp(marker->data, exif_signature, sig_size) != 0) {
+			continue;
+		}
+
+		// What follows the signature is a TIFF structure.
+		unsigned char const* const tiff = marker->data + sig_size;
+		unsigned long const tiff_size = marker->data_length - sig_size;
+
+		bool big_endian = false;
+		if (tiff[0] == 'M' && tiff[1] == 'M') {
+			big_endian = true;
+		} else if (tiff[0] != 'I' || tiff[1] != 'I') {
+			continue;
+		}
+
+		unsigned long const ifd_offset = exifLong(tiff + 4, big_endian);
+		if (ifd_offset + 2 > tiff_size) {
+			continue;
+		}
+
+		double xres = 0;
+		double yres = 0;
+		unsigned res_unit = RESUNIT_INCH; // The default, according to the spec.
+
+		unsigned const num_entries = exifShort(tiff + ifd_offset, big_endian);
+		for (unsigned i = 0; i < num_entries; ++i) {
+			unsigned long const entry_offset = ifd_offset + 2 + i * 12;
+			if (entry_offset + 12 > tiff_size) {
+				break;
+			}
+
+			unsigned char const* const entry = tiff + entry_offset;
+			unsigned const tag = exifShort(entry, big_endian);
+			unsigned const type = exifShort(entry + 2, big_endian);
+
+			if (tag == TAG_RESOLUTIONUNIT && type == TYPE_SHORT) {
+				res_unit = exifShort(entry + 8, big_endian);
+			} else if ((tag == TAG_XRESOLUTION || tag == TAG_YRESOLUTION) && type == TYPE_RATIONAL) {
+				unsigned long const value_offset = exifLong(entry + 8, big_endian);
+				if (value_offset + 8 > tiff_size) {
+					continue;
+				}
+				unsigned long const numerator = exifLong(tiff + value_offset, big_endian);
+				unsigned long const denominator = exifLong(tiff + value_offset + 4, big_endian);
+				if (denominator == 0) {
+					continue;
+				}
+				double const value = double(numerator) / double(denominator);
+				if (tag == TAG_XRESOLUTION) {
+					xres = value;
+				} else {
+					yres = value;
+				}
+			}
+		}
+
+		if (xres <= 0 || yres <= 0) {
+			continue;
+		}
+
+		if (res_unit == RESUNIT_INCH) {
+			return Dpi(qRound(xres), qRound(yres));
+		} else if (res_unit == RESUNIT_CENTIMETER) {
+			return Dpm(qRound(xres * 100), qRound(yres * 100));
+		}
+	}
+
+	return Dpi();
+}
+
+/**
+ * Takes DPI from the JFIF header, falling back to EXIF data.
+ * Requires APP1 markers to be saved with jpeg_save_markers().
+ */
+Dpi readDpi(jpeg_decompress_struct const& cinfo)
+{
+	if (cinfo.X_density > 0 && cinfo.Y_density > 0) {
+		if (cinfo.density_unit == 1) {
+			// Dots per inch.
+			return Dpi(cinfo.X_density, cinfo.Y_density);
+		} else if (cinfo.density_unit == 2) {
+			// Dots per centimeter.
+			return Dpm(cinfo.X_density * 100, cinfo.Y_density * 100);
+		}
+	}
+
+	return exifDpi(cinfo.marker_list);
+}
+
+
+/*================================ Decoding ==============================*/
+
+#if defined(JCS_ALPHA_EXTENSIONS)
+// libjpeg-turbo can write pixels in Format_RGB32 layout by itself.
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+J_COLOR_SPACE const RGB32_COLOR_SPACE = JCS_EXT_BGRA;
+#else
+J_COLOR_SPACE const RGB32_COLOR_SPACE = JCS_EXT_ARGB;
+#endif
+#else
+J_COLOR_SPACE const RGB32_COLOR_SPACE = JCS_RGB;
+#endif
+
+/**
+ * Returns the largest of 1, 2, 4, 8 such that an image reduced by that
+ * factor can still be scaled to fit \p target_size without upscaling.
+ */
+unsigned reductionFactor(unsigned width, unsigned height, QSize const& target_size)
+{
+	if (target_size.isEmpty() || width == 0 || height == 0) {
+		return 1;
+	}
+
+	QSize to_size(width, height);
+	to_size.scale(target_size, Qt::KeepAspectRatio);
+
+	for (unsigned factor = 8; factor > 1; factor >>= 1) {
+		// libjpeg rounds the reduced dimensions up.
+		unsigned const reduced_width = (width + factor - 1) / factor;
+		unsigned const reduced_height = (height + factor - 1) / factor;
+		if ((int)reduced_width >= to_size.width() && (int)reduced_height >= to_size.height()) {
+			return factor;
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * Decompresses an image whose header was already read.  Leaves \p image
+ * null if the colour space of the image is not supported.
+ *
+ * As libjpeg reports errors with longjmp(), this function must not have
+ * local variables with non-trivial destructors.  That's why the image
+ * is decoded straight into \p image, which belongs to the caller and
+ * has to be declared before the caller's setjmp().  Exceptions are fine,
+ * as there are no C frames between here and the caller.
+ */
+void decompress(JpegDecompressHandle& cinfo,
+	QSize const& target_size, bool const grayscale, QImage& image)
+{
+	QImage::Format format = QImage::Format_Indexed8;
+	switch (cinfo->jpeg_color_space) {
+		case JCS_GRAYSCALE:
+			cinfo->out_color_space = JCS_GRAYSCALE;
+			break;
+		case JCS_YCbCr:
+			if (grayscale) {
+				// The Y channel is the luminance.  libjpeg then skips
+				// the inverse DCT, upsampling and colour conversion
+				// of the chroma channels altogether.
+				cinfo->out_color_space = JCS_GRAYSCALE;
+				break;
+			}
+			// Fall through.
+		case JCS_RGB:
+			cinfo->out_color_space = RGB32_COLOR_SPACE;
+			format = QImage::Format_RGB32;
+			break;
+		default:
+			// CMYK and YCCK are left to Qt.
+			return;
+	}
+
+	unsigned const factor = reductionFactor(
+		cinfo->image_width, cinfo->image_height, target_size
+	);
+	cinfo->scale_num = 1;
+	cinfo->scale_denom = factor;
+
+	// The APP1 markers holding EXIF data are freed by jpeg_finish_decompress().
+	Dpi const dpi(readDpi(*cinfo.ptr()));
+
+	if (!jpeg_start_decompress(cinfo.ptr())) {
+		// libjpeg doesn't support all compression types.
+		return;
+	}
+
+	image = QImage(cinfo->output_width, cinfo->output_height, format);
+	if (image.isNull()) {
+		throw std::bad_alloc();
+	}
+	if (format == QImage::Format_Indexed8) {
+		image.setColorTable(createGrayscalePalette());
+	}
+
+	// Only needed if libjpeg can't produce Format_RGB32 pixels by itself.
+	JSAMPARRAY rgb_row = 0;
+	if (format == QImage::Format_RGB32 && cinfo->out_color_space == JCS_RGB) {
+		rgb_row = (*cinfo->mem->alloc_sarray)(
+			(j_common_ptr)cinfo.ptr(), JPOOL_IMAGE, cinfo->output_width * 3, 1
+		);
+	}
+
+	int const width = cinfo->output_width;
+	while (cinfo->output_scanline < cinfo->output_height) {
+		uchar* const line = image.scanLine(cinfo->output_scanline);
+		if (rgb_row) {
+			jpeg_read_scanlines(cinfo.ptr(), rgb_row, 1);
+			JSAMPLE const* src = rgb_row[0];
+			QRgb* dst = (QRgb*)line;
+			for (int x = 0; x < width; ++x, src += 3) {
+				dst[x] = qRgb(src[0], src[1], src[2]);
+			}
+		} else {
+			JSAMPROW row = line;
+			jpeg_read_scanlines(cinfo.ptr(), &row, 1);
+		}
+	}
+
+	jpeg_finish_decompress(cinfo.ptr());
+
+	if (!dpi.isNull()) {
+		Dpm const dpm(Dpi(dpi.horizontal() / factor, dpi.vertical() / factor));
+		image.setDotsPerMeterX(dpm.horizontal());
+		image.setDotsPerMeterY(dpm.vertical());
+	}
+}
+
+} // anonymous namespace
+
+
+/*=============================== JpegReader ===============================*/
+
+bool
+JpegReader::canRead(QIODevice& device)
+{
+	if (!device.isReadable()) {
+		return false;
+	}
+
+	static unsigned char const jpeg_signature[] = { 0xff, 0xd8, 0xff };
+	static int const sig_size = sizeof(jpeg_signature);
+
+	unsigned char signature[sig_size];
+	if (device.peek((char*)signature, sig_size) != sig_size) {
+		return false;
+	}
+
+	return memcmp(jpeg_signature, signature, sig_size) == 0;
+}
+
+ImageMetadataLoader::Status
+JpegReader::readMetadata(
+	QIODevice& device,
+	VirtualFunction1<void, ImageMetadata const&>& out)
+{
+	if (!device.isReadable()) {
+		return ImageMetadataLoader::GENERIC_ERROR;
+	}
+	if (!canRead(device)) {
+		return ImageMetadataLoader::FORMAT_NOT_RECOGNIZED;
+	}
+	
+	// Everything with a destructor has to be constructed before setjmp(),
+	// as longjmp() would skip destroying it.
+	JpegErrorManager err_mgr;
+	JpegSourceManager src_mgr(device);
+	JpegDecompressHandle cinfo(err_mgr, &src_mgr);
+	if (setjmp(err_mgr.jmpBuf())) {
+		// Returning from longjmp().
+		return ImageMetadataLoader::GENERIC_ERROR;
+	}
+	
+	jpeg_save_markers(cinfo.ptr(), JPEG_APP0 + 1, 0xffff);
+	
+	int const header_status = jpeg_read_header(cinfo.ptr(), 0);
+	if (header_status == JPEG_HEADER_TABLES_ONLY) {
+		return ImageMetadataLoader::NO_IMAGES;
+	}
+	
+	// The other possible value is JPEG_SUSPENDED, but we never suspend it.
+	assert(header_status == JPEG_HEADER_OK);
+	
+	// Note that we don't call jpeg_start_decompress(), as everything
+	// we need is in the header.  For progressive JPEGs, starting
+	// decompression would mean reading the whole file.
+	QSize const size(cinfo->image_width, cinfo->image_height);
+	out(ImageMetadata(size, readDpi(*cinfo.ptr())));
+	return ImageMetadataLoader::LOADED;
+}
+
+QImage
+JpegReader::readImage(
+	QIODevice& device, QSize const& target_size, bool const grayscale)
+{
+	if (!canRead(device)) {
+		return QImage();
+	}
+	
+	// Everything with a destructor has to be constructed before setjmp(),
+	// as longjmp() would skip destroying it.
+	QImage image;
+	JpegErrorManager err_mgr;
+	JpegSourceManager src_mgr(device);
+	JpegDecompressHandle cinfo(err_mgr, &src_mgr);
+	if (setjmp(err_mgr.jmpBuf())) {
+		// Returning from longjmp().
+		return QImage();
+	}
+	
+	jpeg_save_markers(cinfo.ptr(), JPEG_APP0 + 1, 0xffff);
+	
+	if (jpeg_read_header(cinfo.ptr(), 1) != JPEG_HEADER_OK) {
+		return QImage();
+	}
+	
+	decompress(cinfo, target_size, grayscale, image);
+	return image;
+}
@@ -0,0 +1,74 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JPEGREADER_H_
+#define JPEGREADER_H_
+
+#include "ImageMetadataLoader.h"
+#include "VirtualFunction.h"
+
+class QIODevice;
+class QImage;
+class QSize;
+class ImageMetadata;
+
+/**
+ * \brief Reads JPEG images through libjpeg directly.
+ *
+ * Compared to going through Qt's image plugin, this allows us to decode
+ * just the luminance channel when only a grayscale image is needed, and
+ * to have libjpeg downscale the image in the DCT domain when only
+ * a reduced version of it is needed.
+ */
+class JpegReader
+{
+public:
+	static bool canRead(QIODevice& device);
+
+	/**
+	 * \brief Reads image size and DPI.
+	 *
+	 * DPI is taken from the JFIF header, or failing that, from EXIF data.
+	 */
+	static ImageMetadataLoader::Status readMetadata(
+		QIODevice& device,
+		VirtualFunction1<void, ImageMetadata const&>& out);
+
+	/**
+	 * \brief Reads the image from io device to QImage.
+	 *
+	 * \param device The device to read from.  This device must be
+	 *        opened for reading.
+	 * \param target_size If not empty, the image may be reduced by a factor
+	 *        of 2, 4 or 8, for as long as it can still be scaled to fit
+	 *        \p target_size with Qt::KeepAspectRatio without upscaling.
+	 *        The DPI of the resulting image is adjusted accordingly.
+	 * \param grayscale If set, YCbCr images are decoded from the luminance
+	 *        channel only, producing Format_Indexed8 grayscale images.
+	 *        RGB ones are still decoded in colour.
+	 * \return The resulting image, or a null image in case of failure or
+	 *         if the colour space of the image is not supported.
+	 *         Grayscale JPEGs produce Format_Indexed8 images and colour
+	 *         ones produce Format_RGB32 images.
+	 * \throw std::bad_alloc
+	 */
+	static QImage readImage(
+		QIODevice& device, QSize const& target_size, bool grayscale = false);
+};
+
+#endif
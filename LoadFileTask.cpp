@@ -31,6 +31,8 @@
 #include "Dpm.h"
 #include "FilterData.h"
 #include "ImageLoader.h"
+#include "InputPrefetcher.h"
+#include "PerformanceStats.h"
 #include <QCoreApplication>
 #include <QFile>
 #include <QDir>
@@ -62,13 +64,15 @@ LoadFileTask::LoadFileTask(
 	Type type, PageInfo const& page,
 	IntrusivePtr<ThumbnailPixmapCache> const& thumbnail_cache,
 	IntrusivePtr<ProjectPages> const& pages,
-	IntrusivePtr<fix_orientation::Task> const& next_task)
+	IntrusivePtr<fix_orientation::Task> const& next_task,
+	bool const grayscale_only)
 :	BackgroundTask(type),
 	m_ptrThumbnailCache(thumbnail_cache),
 	m_imageId(page.imageId()),
 	m_imageMetadata(page.metadata()),
 	m_ptrPages(pages),
-	m_ptrNextTask(next_task)
+	m_ptrNextTask(next_task),
+	m_grayscaleOnly(grayscale_only)
 {
 	assert(m_ptrNextTask);
 }
@@ -80,7 +84,13 @@ LoadFileTask::~LoadFileTask()
 FilterResultPtr
 LoadFileTask::operator()()
 {
-	QImage image(ImageLoader::load(m_imageId));
+	PerformanceStats::StageTimer const stage_timer(PerformanceStats::LOAD_STAGE);
+	
+	InputPrefetcher::instance().loading(m_imageId.filePath());
+	QImage image(
+		m_grayscaleOnly ? ImageLoader::loadGrayscale(m_imageId)
+		: ImageLoader::load(m_imageId)
+	);
 	
 	try {
 		throwIfCancelled();
@@ -90,8 +100,14 @@ LoadFileTask::operator()()
 		} else {
 			updateImageSizeIfChanged(image);
 			overrideDpi(image);
-			m_ptrThumbnailCache->ensureThumbnailExists(m_imageId, image);
-			return m_ptrNextTask->process(*this, FilterData(image));
+			if (!m_grayscaleOnly) {
+				m_ptrThumbnailCache->ensureThumbnailExists(m_imageId, image);
+			}
+			FilterResultPtr const result(m_ptrNextTask->process(*this, FilterData(image)));
+			if (type() == BATCH) {
+				PerformanceStats::instance().recordPageCompleted();
+			}
+			return result;
 		}
 	} catch (CancelledException const&) {
 		return FilterResultPtr();
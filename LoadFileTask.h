@@ -40,10 +40,19 @@ class LoadFileTask : public BackgroundTask
 {
 	DECLARE_NON_COPYABLE(LoadFileTask)
 public:
+	/**
+	 * \param grayscale_only Set it if no filter in the chain is going
+	 *        to look at colours or show the image, which is the case for
+	 *        batch processing that stops short of the output stage.
+	 *        The image is then loaded in grayscale, which for JPEGs means
+	 *        decoding the luminance channel only.  No thumbnail is made
+	 *        of it, as that would be a grayscale one.
+	 */
 	LoadFileTask(Type type, PageInfo const& page,
 		IntrusivePtr<ThumbnailPixmapCache> const& thumbnail_cache,
 		IntrusivePtr<ProjectPages> const& pages,
-		IntrusivePtr<fix_orientation::Task> const& next_task);
+		IntrusivePtr<fix_orientation::Task> const& next_task,
+		bool grayscale_only = false);
 	
 	virtual ~LoadFileTask();
 	
@@ -60,6 +69,7 @@ private:
 	ImageMetadata m_imageMetadata;
 	IntrusivePtr<ProjectPages> const m_ptrPages;
 	IntrusivePtr<fix_orientation::Task> const m_ptrNextTask;
+	bool m_grayscaleOnly;
 };
 
 #endif
@@ -53,6 +53,9 @@
 #include "ProjectOpeningContext.h"
 #include "SkinnedButton.h"
 #include "SystemLoadWidget.h"
+#include "PerformancePanel.h"
+#include "PerformanceStats.h"
+#include "AutoDetectionPrepass.h"
 #include "ProcessingIndicationWidget.h"
 #include "ImageMetadataLoader.h"
 #include "SmartFilenameOrdering.h"
@@ -84,6 +87,7 @@
 #include "filters/output/Task.h"
 #include "filters/output/CacheDrivenTask.h"
 #include "LoadFileTask.h"
+#include "InputPrefetcher.h"
 #include "CompositeCacheDrivenTask.h"
 #include "ScopedIncDec.h"
 #include "ui_AboutDialog.h"
@@ -103,6 +107,8 @@
 #include <QDialog>
 #include <QCloseEvent>
 #include <QStackedLayout>
+#include <QDockWidget>
+#include <QAction>
 #include <QGridLayout>
 #include <QVBoxLayout>
 #include <QLayoutItem>
@@ -154,6 +160,23 @@ private:
 	QPointer<MainWindow> m_ptrWnd;
 };
 
+class MainWindow::PrepassTaskFactory : public AutoDetectionPrepass::TaskFactory
+{
+public:
+	PrepassTaskFactory(MainWindow* wnd) : m_ptrWnd(wnd) {}
+	
+	virtual BackgroundTaskPtr operator()(PageInfo const& page, int last_filter_idx) {
+		if (!m_ptrWnd) {
+			return BackgroundTaskPtr();
+		}
+		return m_ptrWnd->createCompositeTask(
+			page, last_filter_idx, /*batch=*/true, /*debug=*/false
+		);
+	}
+private:
+	QPointer<MainWindow> m_ptrWnd;
+};
+
 
 MainWindow::MainWindow()
 :	m_ptrPages(new ProjectPages),
@@ -163,6 +186,7 @@ MainWindow::MainWindow()
 	m_ptrOutOfMemoryDialog(new OutOfMemoryDialog),
 	m_curFilter(0),
 	m_ignoreSelectionChanges(0),
+	m_ignorePrepassToggles(0),
 	m_ignorePageOrderingChanges(0),
 	m_debug(false),
 	m_closing(false)
@@ -173,13 +197,14 @@ MainWindow::MainWindow()
 	setupUi(this);
 	sortOptions->setVisible(false);
 
-#if !defined(ENABLE_OPENGL)
-	// Right now the only setting is 3D acceleration, so get rid of
-	// the whole Settings dialog, if it's inaccessible.
-	actionSettings->setVisible(false);
-#endif
-
 	createBatchProcessingWidget();
+	createPerformancePanel();
+	
+	// Page set changes reported by the prepass are applied in bulk,
+	// as rebuilding the thumbnail list for each one would be wasteful.
+	m_thumbRefreshTimer.setSingleShot(true);
+	m_thumbRefreshTimer.setInterval(500);
+	connect(&m_thumbRefreshTimer, SIGNAL(timeout()), SLOT(refreshThumbSequencePages()));
 	m_ptrProcessingIndicationWidget.reset(new ProcessingIndicationWidget);
 	
 	filterList->setStages(m_ptrStages);
@@ -267,6 +292,7 @@ MainWindow::MainWindow()
 	connect(actionFixDpi, SIGNAL(triggered(bool)), SLOT(fixDpiDialogRequested()));
 	connect(actionRelinking, SIGNAL(triggered(bool)), SLOT(showRelinkingDialog()));
 	connect(actionDebug, SIGNAL(toggled(bool)), SLOT(debugToggled(bool)));
+	connect(actionAnalyzePages, SIGNAL(toggled(bool)), SLOT(analyzePagesToggled(bool)));
 
 	connect(
 		actionSettings, SIGNAL(triggered(bool)),
@@ -311,11 +337,13 @@ MainWindow::MainWindow()
 			resize(1014, 689); // A sensible value.
 		}
 	}
+	restoreState(settings.value("mainWindow/state").toByteArray());
 }
 
 
 MainWindow::~MainWindow()
 {
+	stopAutoDetectionPrepass();
 	m_ptrInteractiveQueue->cancelAndClear();
 	if (m_ptrBatchQueue.get()) {
 		m_ptrBatchQueue->cancelAndClear();
@@ -352,6 +380,7 @@ MainWindow::switchToNewProject(
 	ProjectReader const* project_reader)
 {
 	stopBatchProcessing(CLEAR_MAIN_AREA);
+	stopAutoDetectionPrepass();
 	m_ptrInteractiveQueue->cancelAndClear();
 
 	Utils::maybeCreateCacheDir(out_dir);
@@ -514,6 +543,20 @@ MainWindow::createBatchProcessingWidget()
 	connect(stop_btn, SIGNAL(clicked()), SLOT(stopBatchProcessing()));
 }
 
+void
+MainWindow::createPerformancePanel()
+{
+	QDockWidget* dock = new QDockWidget(tr("Performance"), this);
+	dock->setObjectName("performancePanel"); // For saveState() / restoreState().
+	dock->setWidget(new PerformancePanel(dock));
+	addDockWidget(Qt::RightDockWidgetArea, dock);
+	dock->hide();
+	
+	QAction* action = dock->toggleViewAction();
+	action->setText(tr("Performance Panel"));
+	menuDebug->insertAction(actionDebug, action);
+}
+
 void
 MainWindow::setupThumbView()
 {
@@ -550,6 +593,7 @@ MainWindow::timerEvent(QTimerEvent* const event)
 		m_closing = true;
 		QSettings settings;
 		settings.setValue("mainWindow/maximized", isMaximized());
+		settings.setValue("mainWindow/state", saveState());
 		if (!isMaximized()) {
 			settings.setValue(
 				"mainWindow/nonMaximizedGeometry", saveGeometry()
@@ -1171,12 +1215,15 @@ MainWindow::startBatchProcessing()
 			: ProcessingTaskQueue::SEQUENTIAL_ORDER
 		)
 	);
+	std::vector<QString> file_paths;
 	PageInfo page(m_ptrThumbSequence->selectionLeader());
 	for (; !page.isNull(); page = m_ptrThumbSequence->nextPage(page.id())) {
 		m_ptrBatchQueue->addProcessingTask(
 			page, createCompositeTask(page, m_curFilter, /*batch=*/true, m_debug)
 		);
+		file_paths.push_back(page.imageId().filePath());
 	}
+	InputPrefetcher::instance().setSchedule(file_paths);
 
 	focusButton->setChecked(true);
 	
@@ -1187,6 +1234,7 @@ MainWindow::startBatchProcessing()
 	BackgroundTaskPtr const task(m_ptrBatchQueue->takeForProcessing());
 	if (task) {
 		m_ptrWorkerThread->performTask(task);
+		updateTaskQueueStats();
 	} else {
 		stopBatchProcessing();
 	}
@@ -1214,6 +1262,8 @@ MainWindow::stopBatchProcessing(MainAreaAction main_area)
 
 	m_ptrBatchQueue->cancelAndClear();
 	m_ptrBatchQueue.reset();
+	InputPrefetcher::instance().clearSchedule();
+	updateTaskQueueStats();
 	
 	filterList->setBatchProcessingInProgress(false);
 	filterList->setEnabled(true);
@@ -1280,6 +1330,7 @@ MainWindow::filterResult(BackgroundTaskPtr const& task, FilterResultPtr const& r
 		if (task) {
 			m_ptrWorkerThread->performTask(task);
 		}
+		updateTaskQueueStats();
 
 		PageInfo const page(m_ptrBatchQueue->selectedPage());
 		if (!page.isNull()) {
@@ -1294,6 +1345,136 @@ MainWindow::debugToggled(bool const enabled)
 	m_debug = enabled;
 }
 
+void
+MainWindow::analyzePagesToggled(bool const enabled)
+{
+	if (m_ignorePrepassToggles) {
+		return;
+	}
+	
+	if (enabled) {
+		startAutoDetectionPrepass();
+	} else {
+		stopAutoDetectionPrepass();
+	}
+}
+
+void
+MainWindow::prepassPageProcessed(PageInfo const& page_info)
+{
+	m_ptrThumbSequence->invalidateThumbnail(page_info.id());
+}
+
+void
+MainWindow::prepassImagePagesChanged()
+{
+	if (!m_thumbRefreshTimer.isActive()) {
+		m_thumbRefreshTimer.start();
+	}
+}
+
+void
+MainWindow::refreshThumbSequencePages()
+{
+	if (!isProjectLoaded() || getCurrentView() != PAGE_VIEW) {
+		// IMAGE_VIEW doesn't depend on the page set of an image.
+		return;
+	}
+	
+	m_ptrThumbSequence->reset(
+		m_ptrPages->toPageSequence(PAGE_VIEW),
+		ThumbnailSequence::KEEP_SELECTION, m_ptrThumbSequence->pageOrderProvider()
+	);
+	
+	if (!m_ptrThumbSequence->selectionLeader().isNull()) {
+		return;
+	}
+	
+	// The selected page was replaced by the halves of its image.
+	PageId const page(m_selectedPage.get(PAGE_VIEW));
+	if (m_ptrThumbSequence->setSelection(PageId(page.imageId(), PageId::LEFT_PAGE))) {
+		// OK
+	} else if (m_ptrThumbSequence->setSelection(PageId(page.imageId(), PageId::RIGHT_PAGE))) {
+		// OK
+	} else if (m_ptrThumbSequence->setSelection(PageId(page.imageId(), PageId::SINGLE_PAGE))) {
+		// OK
+	} else {
+		m_ptrThumbSequence->setSelection(m_ptrThumbSequence->firstPage().id());
+	}
+}
+
+void
+MainWindow::prepassProgress(int const images_done, int const images_total)
+{
+	QMainWindow::statusBar()->showMessage(
+		tr("Analyzing pages: %1 of %2 images done").arg(images_done).arg(images_total)
+	);
+}
+
+void
+MainWindow::prepassFinished()
+{
+	QMainWindow::statusBar()->showMessage(tr("Page analysis finished."), 5000);
+	
+	// We keep the object around to avoid deleting it from its own signal.
+	ScopedIncDec<int> const guard(m_ignorePrepassToggles);
+	actionAnalyzePages->setChecked(false);
+}
+
+void
+MainWindow::startAutoDetectionPrepass()
+{
+	if (!isProjectLoaded()) {
+		return;
+	}
+	
+	if (!m_ptrPrepass.get()) {
+		m_ptrPrepass.reset(
+			new AutoDetectionPrepass(
+				m_ptrPages, IntrusivePtr<AutoDetectionPrepass::TaskFactory>(
+					new PrepassTaskFactory(this)
+				),
+				m_ptrStages->pageSplitFilterIdx(),
+				m_ptrStages->selectContentFilterIdx()
+			)
+		);
+		connect(
+			m_ptrPrepass.get(), SIGNAL(pageProcessed(PageInfo const&)),
+			this, SLOT(prepassPageProcessed(PageInfo const&))
+		);
+		connect(
+			m_ptrPrepass.get(), SIGNAL(imagePagesChanged(ImageId const&)),
+			this, SLOT(prepassImagePagesChanged())
+		);
+		connect(
+			m_ptrPrepass.get(), SIGNAL(progress(int, int)),
+			this, SLOT(prepassProgress(int, int))
+		);
+		connect(
+			m_ptrPrepass.get(), SIGNAL(finished()),
+			this, SLOT(prepassFinished())
+		);
+	}
+	
+	{
+		ScopedIncDec<int> const guard(m_ignorePrepassToggles);
+		actionAnalyzePages->setChecked(true);
+	}
+	m_ptrPrepass->start();
+}
+
+void
+MainWindow::stopAutoDetectionPrepass()
+{
+	if (m_ptrPrepass.get()) {
+		m_ptrPrepass.reset();
+		QMainWindow::statusBar()->clearMessage();
+	}
+	
+	ScopedIncDec<int> const guard(m_ignorePrepassToggles);
+	actionAnalyzePages->setChecked(false);
+}
+
 void
 MainWindow::fixDpiDialogRequested()
 {
@@ -1421,6 +1602,10 @@ MainWindow::newProjectCreated(ProjectCreationContext* context)
 		)
 	);
 	switchToNewProject(pages, context->outDir());
+	
+	if (context->analyzePages()) {
+		startAutoDetectionPrepass();
+	}
 }
 
 void
@@ -1576,6 +1761,7 @@ MainWindow::updateProjectActions()
 	actionSaveProjectAs->setEnabled(loaded);
 	actionFixDpi->setEnabled(loaded);
 	actionRelinking->setEnabled(loaded);
+	actionAnalyzePages->setEnabled(loaded);
 }
 
 bool
@@ -1584,6 +1770,14 @@ MainWindow::isBatchProcessingInProgress() const
 	return m_ptrBatchQueue.get() != 0;
 }
 
+void
+MainWindow::updateTaskQueueStats()
+{
+	PerformanceStats::instance().setTaskQueueDepth(
+		m_ptrBatchQueue.get() ? m_ptrBatchQueue->numPendingTasks() : 0
+	);
+}
+
 bool
 MainWindow::isProjectLoaded() const
 {
@@ -2004,6 +2198,7 @@ MainWindow::removeFromProject(std::set<PageId> const& pages)
 	m_ptrInteractiveQueue->cancelAndRemove(pages);
 	if (m_ptrBatchQueue.get()) {
 		m_ptrBatchQueue->cancelAndRemove(pages);
+		updateTaskQueueStats();
 	}
 
 	m_ptrPages->removePages(pages);
@@ -2099,10 +2294,15 @@ MainWindow::createCompositeTask(
 	}
 	assert(fix_orientation_task);
 	
+	// Stages before output only analyse grayscale versions of images,
+	// and in batch mode, they don't show them either.
+	bool const grayscale_only = batch && !output_task;
+
 	return BackgroundTaskPtr(
 		new LoadFileTask(
 			batch ? BackgroundTask::BATCH : BackgroundTask::INTERACTIVE,
-			page, m_ptrThumbnailCache, m_ptrPages, fix_orientation_task
+			page, m_ptrThumbnailCache, m_ptrPages, fix_orientation_task,
+			grayscale_only
 		)
 	);
 }
@@ -39,6 +39,7 @@
 #include <QMainWindow>
 #include <QString>
 #include <QPointer>
+#include <QTimer>
 #include <QObjectCleanupHandler>
 #include <QSizeF>
 #include <memory>
@@ -70,6 +71,7 @@ class TabbedDebugImages;
 class ProcessingTaskQueue;
 class FixDpiDialog;
 class OutOfMemoryDialog;
+class AutoDetectionPrepass;
 class QLineF;
 class QRectF;
 class QLayout;
@@ -147,6 +149,18 @@ private slots:
 	
 	void debugToggled(bool enabled);
 	
+	void analyzePagesToggled(bool enabled);
+	
+	void prepassPageProcessed(PageInfo const& page_info);
+	
+	void prepassImagePagesChanged();
+	
+	void refreshThumbSequencePages();
+	
+	void prepassProgress(int images_done, int images_total);
+	
+	void prepassFinished();
+	
 	void fixDpiDialogRequested();
 
 	void fixedDpiSubmitted();
@@ -172,6 +186,7 @@ private slots:
 	void handleOutOfMemorySituation();
 private:
 	class PageSelectionProviderImpl;
+	class PrepassTaskFactory;
 	enum SavePromptResult { SAVE, DONT_SAVE, CANCEL };
 	
 	typedef IntrusivePtr<AbstractFilter> FilterPtr;
@@ -217,6 +232,8 @@ private:
 	void updateProjectActions();
 	
 	bool isBatchProcessingInProgress() const;
+	
+	void updateTaskQueueStats();
 
 	bool isProjectLoaded() const;
 	
@@ -266,6 +283,12 @@ private:
 	
 	void createBatchProcessingWidget();
 
+	void createPerformancePanel();
+
+	void startAutoDetectionPrepass();
+
+	void stopAutoDetectionPrepass();
+
 	void updateDisambiguationRecords(PageSequence const& pages);
 
 	void performRelinking(IntrusivePtr<AbstractRelinker> const& relinker);
@@ -282,6 +305,7 @@ private:
 	std::auto_ptr<WorkerThread> m_ptrWorkerThread;
 	std::auto_ptr<ProcessingTaskQueue> m_ptrBatchQueue;
 	std::auto_ptr<ProcessingTaskQueue> m_ptrInteractiveQueue;
+	std::auto_ptr<AutoDetectionPrepass> m_ptrPrepass;
 	QStackedLayout* m_pImageFrameLayout;
 	QStackedLayout* m_pOptionsFrameLayout;
 	QPointer<FilterOptionsWidget> m_ptrOptionsWidget;
@@ -298,6 +322,8 @@ private:
 	std::auto_ptr<OutOfMemoryDialog> m_ptrOutOfMemoryDialog;
 	int m_curFilter;
 	int m_ignoreSelectionChanges;
+	int m_ignorePrepassToggles;
+	QTimer m_thumbRefreshTimer;
 	int m_ignorePageOrderingChanges;
 	bool m_debug;
 	bool m_closing;
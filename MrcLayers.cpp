@@ -0,0 +1,378 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "MrcLayers.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/GrayImage.h"
+#include "imageproc/Grayscale.h"
+#include "imageproc/Scale.h"
+#include "imageproc/ParallelLines.h"
+#include <QSize>
+#include <Qt>
+#include <vector>
+#include <algorithm>
+#include <new>
+#include <stdint.h>
+#include <assert.h>
+
+using namespace imageproc;
+
+namespace
+{
+
+/**
+ * Marks the pixels of a mixed output image reserved for B/W content.
+ */
+class MaskExtraction
+{
+public:
+	MaskExtraction(QImage const& mixed, BinaryImage& text, BinaryImage& mask)
+	:	m_pMixed(mixed.bits()),
+		m_pText(text.data()),
+		m_pMask(mask.data()),
+		m_mixedStride(mixed.bytesPerLine()),
+		m_bitsStride(text.wordsPerLine()),
+		m_width(mixed.width()),
+		m_gray(mixed.format() == QImage::Format_Indexed8)
+	{
+		if (m_gray) {
+			QVector<QRgb> const palette(mixed.colorTable());
+			m_grayLevels.resize(256, 0);
+			for (int i = 0; i < palette.size() && i < 256; ++i) {
+				m_grayLevels[i] = static_cast<uint8_t>(qGray(palette[i]));
+			}
+		}
+	}
+
+	void operator()(int const first_line, int const end_line) const
+	{
+		uint32_t const msb = uint32_t(1) << 31;
+
+		for (int y = first_line; y < end_line; ++y) {
+			uint8_t const* const line = m_pMixed + y * m_mixedStride;
+			uint32_t* const text_line = m_pText + y * m_bitsStride;
+			uint32_t* const mask_line = m_pMask + y * m_bitsStride;
+
+			for (int x = 0; x < m_width; ++x) {
+				bool black = false;
+				bool white = false;
+				if (m_gray) {
+					uint8_t const gray = m_grayLevels[line[x]];
+					black = (gray == 0x00);
+					white = (gray == 0xff);
+				} else {
+					uint32_t const rgb = reinterpret_cast<uint32_t const*>(line)[x] & 0x00ffffff;
+					black = (rgb == 0x00000000);
+					white = (rgb == 0x00ffffff);
+				}
+				if (black || white) {
+					mask_line[x >> 5] |= msb >> (x & 31);
+					if (black) {
+						text_line[x >> 5] |= msb >> (x & 31);
+					}
+				}
+			}
+		}
+	}
+private:
+	uint8_t const* m_pMixed;
+	uint32_t* m_pText;
+	uint32_t* m_pMask;
+	int m_mixedStride;
+	int m_bitsStride;
+	int m_width;
+	bool m_gray;
+	std::vector<uint8_t> m_grayLevels;
+};
+
+/**
+ * Produces lines of blocks of the background layer by averaging
+ * the pixels of a mixed output image not covered by the mask.
+ */
+class BackgroundReduction
+{
+public:
+	BackgroundReduction(QImage const& mixed, BinaryImage const& mask,
+		QImage& background, int reduction)
+	:	m_pMixed(mixed.bits()),
+		m_pMask(mask.data()),
+		m_pBackground(background.bits()),
+		m_mixedStride(mixed.bytesPerLine()),
+		m_maskStride(mask.wordsPerLine()),
+		m_backgroundStride(background.bytesPerLine()),
+		m_width(mixed.width()),
+		m_height(mixed.height()),
+		m_backgroundWidth(background.width()),
+		m_reduction(reduction),
+		m_gray(mixed.format() == QImage::Format_Indexed8)
+	{
+		if (m_gray) {
+			QVector<QRgb> const palette(mixed.colorTable());
+			m_grayLevels.resize(256, 0);
+			for (int i = 0; i < palette.size() && i < 256; ++i) {
+				m_grayLevels[i] = static_cast<uint8_t>(qGray(palette[i]));
+			}
+		}
+	}
+
+	void operator()(int const first_block_line, int const end_block_line) const
+	{
+		int const num_channels = m_gray ? 1 : 3;
+		std::vector<unsigned> sums(m_backgroundWidth * num_channels);
+		std::vector<unsigned> counts(m_backgroundWidth);
+
+		for (int by = first_block_line; by < end_block_line; ++by) {
+			std::fill(sums.begin(), sums.end(), 0);
+			std::fill(counts.begin(), counts.end(), 0);
+
+			int const y_end = std::min(m_height, (by + 1) * m_reduction);
+			for (int y = by * m_reduction; y < y_end; ++y) {
+				if (m_gray) {
+					accumulateGrayLine(y, sums, counts);
+				} else {
+					accumulateColorLine(y, sums, counts);
+				}
+			}
+
+			uint8_t* const bg_line = m_pBackground + by * m_backgroundStride;
+			for (int bx = 0; bx < m_backgroundWidth; ++bx) {
+				unsigned const count = counts[bx];
+				if (m_gray) {
+					bg_line[bx] = count ? (sums[bx] + count / 2) / count : 0xff;
+					continue;
+				}
+
+				uint32_t pixel = 0xffffffff;
+				if (count) {
+					unsigned const* s = &sums[bx * 3];
+					pixel = 0xff000000
+						| (((s[0] + count / 2) / count) << 16)
+						| (((s[1] + count / 2) / count) << 8)
+						| ((s[2] + count / 2) / count);
+				}
+				reinterpret_cast<uint32_t*>(bg_line)[bx] = pixel;
+			}
+		}
+	}
+private:
+	void accumulateGrayLine(int const y, std::vector<unsigned>& sums,
+		std::vector<unsigned>& counts) const
+	{
+		uint8_t const* const line = m_pMixed + y * m_mixedStride;
+		uint32_t const* const mask_line = m_pMask + y * m_maskStride;
+		uint32_t const msb = uint32_t(1) << 31;
+
+		for (int x = 0; x < m_width; ++x) {
+			if (!(mask_line[x >> 5] & (msb >> (x & 31)))) {
+				int const bx = x / m_reduction;
+				sums[bx] += m_grayLevels[line[x]];
+				++counts[bx];
+			}
+		}
+	}
+
+	void accumulateColorLine(int const y, std::vector<unsigned>& sums,
+		std::vector<unsigned>& counts) const
+	{
+		uint32_t const* const line = reinterpret_cast<uint32_t const*>(
+			m_pMixed + y * m_mixedStride
+		);
+		uint32_t const* const mask_line = m_pMask + y * m_maskStride;
+		uint32_t const msb = uint32_t(1) << 31;
+
+		for (int x = 0; x < m_width; ++x) {
+			if (!(mask_line[x >> 5] & (msb >> (x & 31)))) {
+				uint32_t const rgb = line[x];
+				unsigned* const s = &sums[(x / m_reduction) * 3];
+				s[0] += (rgb >> 16) & 0xff;
+				s[1] += (rgb >> 8) & 0xff;
+				s[2] += rgb & 0xff;
+				++counts[x / m_reduction];
+			}
+		}
+	}
+
+	uint8_t const* m_pMixed;
+	uint32_t const* m_pMask;
+	uint8_t* m_pBackground;
+	int m_mixedStride;
+	int m_maskStride;
+	int m_backgroundStride;
+	int m_width;
+	int m_height;
+	int m_backgroundWidth;
+	int m_reduction;
+	bool m_gray;
+	std::vector<uint8_t> m_grayLevels;
+};
+
+/**
+ * Converts \p mixed to one of the formats the functors above support.
+ */
+QImage toSupportedFormat(QImage const& mixed)
+{
+	if (mixed.format() == QImage::Format_Indexed8 && mixed.isGrayscale()) {
+		return mixed;
+	}
+	if (mixed.format() == QImage::Format_RGB32 || mixed.format() == QImage::Format_ARGB32) {
+		return mixed;
+	}
+	
+	QImage const converted(mixed.convertToFormat(QImage::Format_RGB32));
+	if (converted.isNull()) {
+		throw std::bad_alloc();
+	}
+	return converted;
+}
+
+} // anonymous namespace
+
+MrcLayers::MrcLayers(
+	BinaryImage const& text, BinaryImage const& mask,
+	QImage const& background, Dpm const& dpm)
+:	m_text(text),
+	m_mask(mask),
+	m_background(background),
+	m_dpm(dpm)
+{
+}
+
+MrcLayers
+MrcLayers::split(QImage const& mixed, int const background_reduction)
+{
+	if (mixed.isNull()) {
+		return MrcLayers();
+	}
+
+	QImage const src(toSupportedFormat(mixed));
+	int const width = src.width();
+	int const height = src.height();
+
+	BinaryImage text(width, height, WHITE);
+	BinaryImage mask(width, height, WHITE);
+	processLinesInParallel(
+		height, 32, double(width) * height, MaskExtraction(src, text, mask)
+	);
+
+	return fromMixed(src, text, mask, Dpm(src), background_reduction);
+}
+
+MrcLayers
+MrcLayers::fromMixed(
+	QImage const& mixed, BinaryImage const& text, BinaryImage const& mask,
+	Dpm const& dpm, int const background_reduction)
+{
+	if (mixed.isNull()) {
+		return MrcLayers();
+	}
+
+	assert(text.size() == mixed.size() && mask.size() == mixed.size());
+
+	QImage const src(toSupportedFormat(mixed));
+	bool const gray = src.format() == QImage::Format_Indexed8;
+	int const width = src.width();
+	int const height = src.height();
+	int const reduction = std::max(1, background_reduction);
+
+	QImage background(
+		(width + reduction - 1) / reduction, (height + reduction - 1) / reduction,
+		gray ? QImage::Format_Indexed8 : QImage::Format_RGB32
+	);
+	if (background.isNull()) {
+		throw std::bad_alloc();
+	}
+	if (gray) {
+		background.setColorTable(createGrayscalePalette());
+	}
+
+	if (!dpm.isNull()) {
+		background.setDotsPerMeterX(dpm.horizontal() / reduction);
+		background.setDotsPerMeterY(dpm.vertical() / reduction);
+	}
+
+	processLinesInParallel(
+		background.height(), 8, double(width) * height,
+		BackgroundReduction(src, mask, background, reduction)
+	);
+
+	return MrcLayers(text, mask, background, dpm);
+}
+
+QImage
+MrcLayers::compose() const
+{
+	if (isNull()) {
+		return QImage();
+	}
+
+	QSize const size(m_text.size());
+	bool const gray = m_background.format() == QImage::Format_Indexed8;
+
+	QImage composed;
+	if (gray) {
+		composed = scaleToGray(GrayImage(m_background), size).toQImage();
+	} else {
+		composed = m_background.scaled(
+			size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation
+		).convertToFormat(QImage::Format_RGB32);
+	}
+	if (composed.isNull()) {
+		throw std::bad_alloc();
+	}
+
+	int const width = size.width();
+	int const height = size.height();
+	int const bits_stride = m_text.wordsPerLine();
+	uint32_t const* text_line = m_text.data();
+	uint32_t const* mask_line = m_mask.data();
+	uint32_t const msb = uint32_t(1) << 31;
+
+	for (int y = 0; y < height; ++y) {
+		uint8_t* const line = composed.scanLine(y);
+		for (int x = 0; x < width; ++x) {
+			uint32_t const bit = msb >> (x & 31);
+			if (gray) {
+				uint8_t& pixel = line[x];
+				if (mask_line[x >> 5] & bit) {
+					pixel = (text_line[x >> 5] & bit) ? 0x00 : 0xff;
+				} else {
+					pixel = std::min<uint8_t>(std::max<uint8_t>(pixel, 0x01), 0xfe);
+				}
+			} else {
+				uint32_t& pixel = reinterpret_cast<uint32_t*>(line)[x];
+				if (mask_line[x >> 5] & bit) {
+					pixel = (text_line[x >> 5] & bit) ? 0xff000000 : 0xffffffff;
+				} else if ((pixel & 0x00ffffff) == 0x00000000) {
+					pixel = 0xff010101;
+				} else if ((pixel & 0x00ffffff) == 0x00ffffff) {
+					pixel = 0xfffefefe;
+				}
+			}
+		}
+		text_line += bits_stride;
+		mask_line += bits_stride;
+	}
+
+	if (!m_dpm.isNull()) {
+		composed.setDotsPerMeterX(m_dpm.horizontal());
+		composed.setDotsPerMeterY(m_dpm.vertical());
+	}
+
+	return composed;
+}
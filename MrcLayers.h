@@ -0,0 +1,114 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef MRC_LAYERS_H_
+#define MRC_LAYERS_H_
+
+#include "Dpm.h"
+#include "imageproc/BinaryImage.h"
+#include <QImage>
+
+/**
+ * \brief Mixed output split into Mixed Raster Content layers.
+ *
+ * \li A full resolution mask, black where the B/W content is.
+ * \li A full resolution text layer, black where the B/W content is black.
+ * \li A reduced resolution background with the rest of the content.
+ *
+ * The background layer is the only lossy one.  Its pixels under the mask
+ * don't matter and are filled to compress well.
+ */
+class MrcLayers
+{
+public:
+	enum { DEFAULT_BACKGROUND_REDUCTION = 3 };
+
+	MrcLayers() {}
+
+	MrcLayers(imageproc::BinaryImage const& text,
+		imageproc::BinaryImage const& mask,
+		QImage const& background, Dpm const& dpm);
+
+	/**
+	 * \brief Builds layers from a mixed output image and its B/W layers.
+	 *
+	 * This is what OutputGenerator uses, as it has the B/W layers at hand.
+	 *
+	 * \param mixed An Indexed8 grayscale, RGB32 or ARGB32 image.
+	 *        Other formats are converted to RGB32.  Only the pixels
+	 *        not covered by \p mask are looked at.
+	 * \param text The B/W content, the same size as \p mixed.
+	 *        It has to be white where \p mask is.
+	 * \param mask Black where the B/W content is, the same size as \p mixed.
+	 * \param dpm The resolution of \p mixed.
+	 * \param background_reduction How many times the background
+	 *        layer is to be smaller than \p mixed in each direction.
+	 */
+	static MrcLayers fromMixed(
+		QImage const& mixed, imageproc::BinaryImage const& text,
+		imageproc::BinaryImage const& mask, Dpm const& dpm,
+		int background_reduction = DEFAULT_BACKGROUND_REDUCTION);
+
+	/**
+	 * \brief Splits a mixed output image into layers.
+	 *
+	 * Mixed output reserves pure black and pure white for its B/W content
+	 * (see reserveBlackAndWhite() in OutputGenerator.cpp), which is what
+	 * tells the B/W content apart here.  Use it when only the final image
+	 * is available, such as when converting an existing output file.
+	 *
+	 * \param mixed An Indexed8 grayscale, RGB32 or ARGB32 image.
+	 *        Other formats are converted to RGB32.
+	 * \param background_reduction How many times the background
+	 *        layer is to be smaller than \p mixed in each direction.
+	 */
+	static MrcLayers split(
+		QImage const& mixed, int background_reduction = DEFAULT_BACKGROUND_REDUCTION);
+
+	bool isNull() const { return m_text.isNull(); }
+
+	imageproc::BinaryImage const& text() const { return m_text; }
+
+	imageproc::BinaryImage const& mask() const { return m_mask; }
+
+	/**
+	 * An Indexed8 grayscale image for grayscale input,
+	 * an RGB32 one otherwise.
+	 */
+	QImage const& background() const { return m_background; }
+
+	/** The resolution of the text and mask layers. */
+	Dpm const& dpm() const { return m_dpm; }
+
+	/**
+	 * \brief Puts the layers back together.
+	 *
+	 * The result has the full resolution.  It's Indexed8 grayscale
+	 * if the background is, and RGB32 otherwise.  Pure black and white
+	 * remain reserved for the B/W content.
+	 */
+	QImage compose() const;
+private:
+	imageproc::BinaryImage m_text;
+	imageproc::BinaryImage m_mask;
+	QImage m_background;
+	Dpm m_dpm;
+};
+
+#endif
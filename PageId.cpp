@@ -76,7 +76,7 @@ PageId::subPageFromString(QString const& string, bool* ok)
 
 bool operator==(PageId const& lhs, PageId const& rhs)
 {
-	return lhs.subPage() == rhs.subPage() && lhs.imageId() == rhs.imageId();
+	return lhs.handle() == rhs.handle();
 }
 
 bool operator!=(PageId const& lhs, PageId const& rhs)
@@ -86,11 +86,10 @@ bool operator!=(PageId const& lhs, PageId const& rhs)
 
 bool operator<(PageId const& lhs, PageId const& rhs)
 {
-	if (lhs.imageId() < rhs.imageId()) {
-		return true;
-	} else if (rhs.imageId() < lhs.imageId()) {
-		return false;
-	} else {
-		return lhs.subPage() < rhs.subPage();
-	}
+	return lhs.handle() < rhs.handle();
+}
+
+uint qHash(PageId const& page_id)
+{
+	return uint(page_id.handle());
 }
@@ -20,6 +20,7 @@
 #define PAGEID_H_
 
 #include "ImageId.h"
+#include <QtGlobal>
 
 class QString;
 
@@ -52,6 +53,13 @@ public:
 	
 	SubPage subPage() const { return m_subPage; }
 	
+	/**
+	 * \brief A process-wide unique integer for the page.
+	 *
+	 * Handles of pages on the same image are consecutive.
+	 */
+	int handle() const { return m_imageId.handle() * 3 + m_subPage; }
+	
 	QString subPageAsString() const { return subPageToString(m_subPage); }
 	
 	static QString subPageToString(SubPage sub_page);
@@ -66,4 +74,6 @@ bool operator==(PageId const& lhs, PageId const& rhs);
 bool operator!=(PageId const& lhs, PageId const& rhs);
 bool operator<(PageId const& lhs, PageId const& rhs);
 
+uint qHash(PageId const& page_id);
+
 #endif
@@ -0,0 +1,49 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PageOrderProvider.h"
+#include "PageId.h"
+
+PageOrderProvider::SortKey
+PageOrderProvider::sortKey(PageId const& page, bool const incomplete) const
+{
+	std::vector<PageId> const pages(1, page);
+	std::vector<bool> const incomplete_flags(1, incomplete);
+	std::vector<SortKey> keys;
+	keys.reserve(1);
+
+	sortKeys(pages, incomplete_flags, keys);
+
+	return keys.front();
+}
+
+bool
+PageOrderProvider::precedes(
+	PageId const& lhs_page, SortKey const& lhs_key,
+	PageId const& rhs_page, SortKey const& rhs_key) const
+{
+	if (lhs_key < rhs_key) {
+		return true;
+	} else if (rhs_key < lhs_key) {
+		return false;
+	} else if (orderTiesByPageId()) {
+		return lhs_page < rhs_page;
+	} else {
+		return false;
+	}
+}
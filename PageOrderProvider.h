@@ -20,23 +20,80 @@
 #define PAGE_ORDER_PROVIDER_H_
 
 #include "RefCountable.h"
+#include <vector>
 
 class PageId;
 
 /**
  * A base class for different page ordering strategies.
+ *
+ * Rather than comparing pages directly, which would mean querying settings
+ * twice per comparison, an order provider maps every page to a SortKey.
+ * Keys for many pages are extracted at once by sortKeys(), allowing
+ * implementations to take a single snapshot of their settings.
  */
 class PageOrderProvider : public RefCountable
 {
 public:
+	class SortKey
+	{
+		// Member-wise copying is OK.
+	public:
+		SortKey() : m_group(0), m_value(0.0) {}
+
+		SortKey(int group, double value) : m_group(group), m_value(value) {}
+
+		bool operator<(SortKey const& other) const {
+			if (m_group != other.m_group) {
+				return m_group < other.m_group;
+			}
+			return m_value < other.m_value;
+		}
+
+		bool operator==(SortKey const& other) const {
+			return m_group == other.m_group && m_value == other.m_value;
+		}
+
+		bool operator!=(SortKey const& other) const { return !(*this == other); }
+	private:
+		/** Pages are ordered by group first.  Typically used to move unknowns to the back. */
+		int m_group;
+
+		/** Orders pages within a group. */
+		double m_value;
+	};
+
+	/**
+	 * \brief Computes sort keys for a number of pages at once.
+	 *
+	 * \param pages The pages to compute keys for.
+	 * \param incomplete For each page, indicates whether it's represented
+	 *        by IncompleteThumbnail.  Must be of the same size as \p pages.
+	 * \param keys Receives a key for each page, in the same order.
+	 */
+	virtual void sortKeys(
+		std::vector<PageId> const& pages, std::vector<bool> const& incomplete,
+		std::vector<SortKey>& keys) const = 0;
+
+	/**
+	 * \brief Whether pages with equal keys are to be ordered by PageId.
+	 *
+	 * Otherwise, their existing relative order is preserved.
+	 */
+	virtual bool orderTiesByPageId() const { return false; }
+
+	/**
+	 * \brief A convenience wrapper around sortKeys() for a single page.
+	 */
+	SortKey sortKey(PageId const& page, bool incomplete) const;
+
 	/**
-	 * Returns true if \p lhs_page precedes \p rhs_page.
-	 * \p lhs_incomplete and \p rhs_incomplete indicate whether
-	 * a page is represented by IncompleteThumbnail.
+	 * Returns true if \p lhs_page with \p lhs_key precedes
+	 * \p rhs_page with \p rhs_key.
 	 */
-	virtual bool precedes(
-		PageId const& lhs_page, bool lhs_incomplete,
-		PageId const& rhs_page, bool rhs_incomplete) const = 0;
+	bool precedes(
+		PageId const& lhs_page, SortKey const& lhs_key,
+		PageId const& rhs_page, SortKey const& rhs_key) const;
 };
 
 #endif
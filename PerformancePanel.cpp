@@ -0,0 +1,218 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "PerformancePanel.h"
+#include "PerformancePanel.h.moc"
+#include "PerformanceStats.h"
+#include <QCoreApplication>
+#include <QTableWidgetItem>
+#include <QHeaderView>
+#include <QStringList>
+#include <QString>
+#include <QChar>
+#include <QShowEvent>
+#include <QHideEvent>
+#include <algorithm>
+
+PerformancePanel::PerformancePanel(QWidget* parent)
+:	QWidget(parent)
+{
+	ui.setupUi(this);
+
+	ui.stageTable->setRowCount(PerformanceStats::NUM_STAGES);
+	ui.stageTable->setColumnCount(NUM_COLUMNS);
+
+	QStringList row_labels;
+	for (int stage = 0; stage < PerformanceStats::NUM_STAGES; ++stage) {
+		row_labels.push_back(stageName(stage));
+		for (int col = 0; col < NUM_COLUMNS; ++col) {
+			QTableWidgetItem* item = new QTableWidgetItem;
+			if (col != HISTOGRAM_COL) {
+				item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+			}
+			ui.stageTable->setItem(stage, col, item);
+		}
+	}
+	ui.stageTable->setVerticalHeaderLabels(row_labels);
+
+	QStringList column_labels;
+	column_labels << tr("Pages") << tr("Median") << tr("90%") << tr("Max") << tr("Distribution");
+	ui.stageTable->setHorizontalHeaderLabels(column_labels);
+	ui.stageTable->horizontalHeaderItem(PAGES_COL)->setToolTip(
+		tr("The number of recent pages the statistics are based on.")
+	);
+	ui.stageTable->horizontalHeaderItem(P90_COL)->setToolTip(
+		tr("90% of recent pages took no longer than that.")
+	);
+
+	m_refreshTimer.setInterval(1000);
+	connect(&m_refreshTimer, SIGNAL(timeout()), SLOT(refresh()));
+	connect(ui.resetBtn, SIGNAL(clicked()), SLOT(resetStats()));
+}
+
+void
+PerformancePanel::showEvent(QShowEvent* event)
+{
+	QWidget::showEvent(event);
+	refresh();
+	m_refreshTimer.start();
+}
+
+void
+PerformancePanel::hideEvent(QHideEvent* event)
+{
+	QWidget::hideEvent(event);
+	m_refreshTimer.stop();
+}
+
+void
+PerformancePanel::resetStats()
+{
+	PerformanceStats::instance().reset();
+	refresh();
+}
+
+void
+PerformancePanel::refresh()
+{
+	PerformanceStats::Snapshot const snapshot(PerformanceStats::instance().snapshot());
+
+	for (int stage = 0; stage < PerformanceStats::NUM_STAGES; ++stage) {
+		PerformanceStats::StageSummary const& summary = snapshot.stages[stage];
+		bool const have_samples = summary.numSamples > 0;
+
+		ui.stageTable->item(stage, PAGES_COL)->setText(
+			have_samples ? QString::number(summary.numSamples) : QString()
+		);
+		ui.stageTable->item(stage, MEDIAN_COL)->setText(
+			have_samples ? formatMsec(summary.medianMsec) : QString()
+		);
+		ui.stageTable->item(stage, P90_COL)->setText(
+			have_samples ? formatMsec(summary.percentile90Msec) : QString()
+		);
+		ui.stageTable->item(stage, MAX_COL)->setText(
+			have_samples ? formatMsec(summary.maxMsec) : QString()
+		);
+
+		QTableWidgetItem* histogram = ui.stageTable->item(stage, HISTOGRAM_COL);
+		histogram->setText(have_samples ? histogramBars(summary.histogram) : QString());
+		histogram->setToolTip(have_samples ? histogramToolTip(summary.histogram) : QString());
+	}
+
+	if (snapshot.pagesPerMinute > 0.0) {
+		ui.pagesPerMinute->setText(QString::number(snapshot.pagesPerMinute, 'f', 1));
+	} else {
+		ui.pagesPerMinute->setText(tr("n/a"));
+	}
+
+	ui.taskQueue->setText(QString::number(snapshot.taskQueueDepth));
+	ui.thumbnailQueue->setText(QString::number(snapshot.thumbnailQueueDepth));
+
+	int const num_requests = snapshot.thumbnailHits + snapshot.thumbnailMisses;
+	if (num_requests > 0) {
+		ui.thumbnailHitRate->setText(
+			tr("%1% of %2").arg(snapshot.thumbnailHits * 100 / num_requests).arg(num_requests)
+		);
+	} else {
+		ui.thumbnailHitRate->setText(tr("n/a"));
+	}
+
+	if (snapshot.peakMemoryUsage >= 0) {
+		ui.peakMemory->setText(formatBytes(snapshot.peakMemoryUsage));
+	} else {
+		ui.peakMemory->setText(tr("n/a"));
+	}
+}
+
+QString
+PerformancePanel::stageName(int const stage)
+{
+	// We reuse the translations of filter names.
+	switch (stage) {
+		case PerformanceStats::LOAD_STAGE:
+			return tr("Load");
+		case PerformanceStats::FIX_ORIENTATION_STAGE:
+			return QCoreApplication::translate("fix_orientation::Filter", "Fix Orientation");
+		case PerformanceStats::PAGE_SPLIT_STAGE:
+			return QCoreApplication::translate("page_split::Filter", "Split Pages");
+		case PerformanceStats::DESKEW_STAGE:
+			return QCoreApplication::translate("deskew::Filter", "Deskew");
+		case PerformanceStats::SELECT_CONTENT_STAGE:
+			return QCoreApplication::translate("select_content::Filter", "Select Content");
+		case PerformanceStats::PAGE_LAYOUT_STAGE:
+			return QCoreApplication::translate("page_layout::Filter", "Margins");
+		case PerformanceStats::OUTPUT_STAGE:
+			return QCoreApplication::translate("output::Filter", "Output");
+	}
+	return QString();
+}
+
+QString
+PerformancePanel::formatMsec(int const msec)
+{
+	if (msec < 10000) {
+		return tr("%1 ms").arg(msec);
+	} else {
+		return tr("%1 s").arg(msec / 1000.0, 0, 'f', 1);
+	}
+}
+
+QString
+PerformancePanel::formatBytes(qint64 const bytes)
+{
+	return tr("%1 MB").arg((bytes + (1 << 19)) >> 20);
+}
+
+QString
+PerformancePanel::histogramBars(int const* bins)
+{
+	int const max_count = *std::max_element(bins, bins + PerformanceStats::NUM_HISTOGRAM_BINS);
+
+	// U+2581 .. U+2588 are block elements of increasing height.
+	QString bars;
+	for (int i = 0; i < PerformanceStats::NUM_HISTOGRAM_BINS; ++i) {
+		if (bins[i] == 0) {
+			bars.push_back(QChar(' '));
+		} else {
+			int const level = (bins[i] * 7 + max_count - 1) / max_count;
+			bars.push_back(QChar(0x2581 + level));
+		}
+	}
+	return bars;
+}
+
+QString
+PerformancePanel::histogramToolTip(int const* bins)
+{
+	QString text;
+	int lower = 0;
+	for (int i = 0; i < PerformanceStats::NUM_HISTOGRAM_BINS; ++i) {
+		int const upper = PerformanceStats::histogramBinLimit(i);
+		if (!text.isEmpty()) {
+			text += QChar('\n');
+		}
+		if (upper < 0) {
+			text += tr("%1 ms and more: %2").arg(lower).arg(bins[i]);
+		} else {
+			text += tr("%1 - %2 ms: %3").arg(lower).arg(upper).arg(bins[i]);
+		}
+		lower = upper;
+	}
+	return text;
+}
@@ -0,0 +1,66 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PERFORMANCE_PANEL_H_
+#define PERFORMANCE_PANEL_H_
+
+#include "ui_PerformancePanel.h"
+#include <QWidget>
+#include <QTimer>
+#include <QtGlobal>
+
+class QString;
+class QShowEvent;
+class QHideEvent;
+
+/**
+ * \brief Displays PerformanceStats, refreshing them once a second
+ *        while visible.
+ */
+class PerformancePanel : public QWidget
+{
+	Q_OBJECT
+public:
+	PerformancePanel(QWidget* parent = 0);
+protected:
+	virtual void showEvent(QShowEvent* event);
+
+	virtual void hideEvent(QHideEvent* event);
+private slots:
+	void refresh();
+
+	void resetStats();
+private:
+	enum Column { PAGES_COL, MEDIAN_COL, P90_COL, MAX_COL, HISTOGRAM_COL, NUM_COLUMNS };
+
+	static QString stageName(int stage);
+
+	static QString formatMsec(int msec);
+
+	static QString formatBytes(qint64 bytes);
+
+	static QString histogramBars(int const* bins);
+
+	static QString histogramToolTip(int const* bins);
+
+	Ui::PerformancePanel ui;
+	QTimer m_refreshTimer;
+};
+
+#endif
@@ -0,0 +1,285 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "PerformanceStats.h"
+#include <QMutexLocker>
+#include <QThreadStorage>
+#include <algorithm>
+#include <exception>
+#include <string.h>
+#ifdef _WIN32
+// Makes GetProcessMemoryInfo() resolve to K32GetProcessMemoryInfo()
+// from kernel32, so that we don't have to link to psapi.
+#ifndef PSAPI_VERSION
+#define PSAPI_VERSION 2
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+
+/**
+ * QThreadStorage deletes what it holds when a thread exits,
+ * so we can't put a pointer to a stack object there directly.
+ */
+struct CurrentTimer
+{
+	PerformanceStats::StageTimer* pTimer;
+
+	CurrentTimer() : pTimer(0) {}
+};
+
+QThreadStorage<CurrentTimer*> current_timer;
+
+CurrentTimer& currentTimer()
+{
+	if (!current_timer.hasLocalData()) {
+		current_timer.setLocalData(new CurrentTimer);
+	}
+	return *current_timer.localData();
+}
+
+} // anonymous namespace
+
+
+/*========================== PerformanceStats ===========================*/
+
+PerformanceStats::PerformanceStats()
+:	m_numCompletions(0),
+	m_nextCompletion(0)
+{
+	memset(m_stages, 0, sizeof(m_stages));
+	m_clock.start();
+}
+
+PerformanceStats&
+PerformanceStats::instance()
+{
+	// Depending on the compiler, this may not be thread-safe,
+	// so we make sure it's called from the main thread early on.
+	static PerformanceStats object;
+	return object;
+}
+
+void
+PerformanceStats::recordStageTime(Stage const stage, int const msec)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	StageHistory& history = m_stages[stage];
+	history.samples[history.nextSample] = msec;
+	history.nextSample = (history.nextSample + 1) % HISTORY_SIZE;
+	if (history.numSamples < HISTORY_SIZE) {
+		++history.numSamples;
+	}
+}
+
+void
+PerformanceStats::recordPageCompleted()
+{
+	QMutexLocker const locker(&m_mutex);
+
+	m_completionTimes[m_nextCompletion] = m_clock.elapsed();
+	m_nextCompletion = (m_nextCompletion + 1) % COMPLETION_HISTORY_SIZE;
+	if (m_numCompletions < COMPLETION_HISTORY_SIZE) {
+		++m_numCompletions;
+	}
+}
+
+void
+PerformanceStats::setTaskQueueDepth(int const depth)
+{
+	m_taskQueueDepth.fetchAndStoreRelaxed(depth);
+}
+
+void
+PerformanceStats::setThumbnailQueueDepth(int const depth)
+{
+	m_thumbnailQueueDepth.fetchAndStoreRelaxed(depth);
+}
+
+void
+PerformanceStats::recordThumbnailRequest(bool const cache_hit)
+{
+	if (cache_hit) {
+		m_thumbnailHits.fetchAndAddRelaxed(1);
+	} else {
+		m_thumbnailMisses.fetchAndAddRelaxed(1);
+	}
+}
+
+PerformanceStats::Snapshot
+PerformanceStats::snapshot() const
+{
+	Snapshot snapshot;
+	StageHistory stages[NUM_STAGES];
+	int completion_times[COMPLETION_HISTORY_SIZE];
+	int num_completions = 0;
+	int now = 0;
+
+	{
+		QMutexLocker const locker(&m_mutex);
+		memcpy(stages, m_stages, sizeof(stages));
+		now = m_clock.elapsed();
+
+		// Oldest to newest.
+		int idx = (m_nextCompletion - m_numCompletions + COMPLETION_HISTORY_SIZE)
+			% COMPLETION_HISTORY_SIZE;
+		for (int i = 0; i < m_numCompletions; ++i) {
+			completion_times[num_completions++] = m_completionTimes[idx];
+			idx = (idx + 1) % COMPLETION_HISTORY_SIZE;
+		}
+	}
+
+	for (int s = 0; s < NUM_STAGES; ++s) {
+		StageHistory& history = stages[s];
+		StageSummary& summary = snapshot.stages[s];
+		memset(&summary, 0, sizeof(summary));
+
+		int const num_samples = history.numSamples;
+		summary.numSamples = num_samples;
+		if (num_samples == 0) {
+			continue;
+		}
+
+		int* const begin = history.samples;
+		int* const end = history.samples + num_samples;
+		for (int* p = begin; p != end; ++p) {
+			int bin = 0;
+			while (bin < NUM_HISTOGRAM_BINS - 1 && *p >= histogramBinLimit(bin)) {
+				++bin;
+			}
+			++summary.histogram[bin];
+		}
+
+		int* const median = begin + num_samples / 2;
+		std::nth_element(begin, median, end);
+		summary.medianMsec = *median;
+
+		int* const p90 = begin + (num_samples * 9) / 10;
+		std::nth_element(begin, p90, end);
+		summary.percentile90Msec = *p90;
+
+		summary.maxMsec = *std::max_element(begin, end);
+	}
+
+	// Pages completed within the last minute.  QTime::elapsed() wraps
+	// around after 24 hours, which makes older entries look like they
+	// are from the future.  We ignore those too.
+	int first = num_completions;
+	while (first > 0) {
+		int const age = now - completion_times[first - 1];
+		if (age < 0 || age > 60 * 1000) {
+			break;
+		}
+		--first;
+	}
+	snapshot.pagesPerMinute = 0.0;
+	int const num_recent = num_completions - first;
+	if (num_recent >= 2) {
+		int const span = completion_times[num_completions - 1] - completion_times[first];
+		if (span > 0) {
+			snapshot.pagesPerMinute = (num_recent - 1) * 60000.0 / span;
+		}
+	}
+
+	snapshot.taskQueueDepth = m_taskQueueDepth.fetchAndAddRelaxed(0);
+	snapshot.thumbnailQueueDepth = m_thumbnailQueueDepth.fetchAndAddRelaxed(0);
+	snapshot.thumbnailHits = m_thumbnailHits.fetchAndAddRelaxed(0);
+	snapshot.thumbnailMisses = m_thumbnailMisses.fetchAndAddRelaxed(0);
+	snapshot.peakMemoryUsage = peakMemoryUsage();
+
+	return snapshot;
+}
+
+void
+PerformanceStats::reset()
+{
+	QMutexLocker const locker(&m_mutex);
+
+	memset(m_stages, 0, sizeof(m_stages));
+	m_numCompletions = 0;
+	m_nextCompletion = 0;
+	m_clock.restart();
+	m_thumbnailHits.fetchAndStoreRelaxed(0);
+	m_thumbnailMisses.fetchAndStoreRelaxed(0);
+}
+
+int
+PerformanceStats::histogramBinLimit(int const bin)
+{
+	static int const limits[NUM_HISTOGRAM_BINS] = {
+		50, 100, 250, 500, 1000, 2500, 5000, -1
+	};
+	return limits[bin];
+}
+
+qint64
+PerformanceStats::peakMemoryUsage()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return -1;
+	}
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return -1;
+	}
+#if defined(__APPLE__)
+	return usage.ru_maxrss; // Bytes on Mac OS X.
+#else
+	return qint64(usage.ru_maxrss) * 1024; // Kilobytes elsewhere.
+#endif
+#endif
+}
+
+
+/*===================== PerformanceStats::StageTimer ====================*/
+
+PerformanceStats::StageTimer::StageTimer(Stage const stage)
+:	m_pParent(currentTimer().pTimer),
+	m_nestedMsec(0),
+	m_stage(stage)
+{
+	currentTimer().pTimer = this;
+	m_startTime.start();
+}
+
+PerformanceStats::StageTimer::~StageTimer()
+{
+	int const elapsed = m_startTime.elapsed();
+	currentTimer().pTimer = m_pParent;
+	if (m_pParent) {
+		m_pParent->m_nestedMsec += elapsed;
+	}
+
+	if (!std::uncaught_exception()) {
+		PerformanceStats::instance().recordStageTime(
+			m_stage, std::max(0, elapsed - m_nestedMsec)
+		);
+	}
+}
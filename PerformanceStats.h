@@ -0,0 +1,167 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PERFORMANCE_STATS_H_
+#define PERFORMANCE_STATS_H_
+
+#include "NonCopyable.h"
+#include <QMutex>
+#include <QAtomicInt>
+#include <QTime>
+#include <QtGlobal>
+
+/**
+ * \brief Process-wide counters describing how fast pages go through
+ *        the processing pipeline.
+ *
+ * Filters record the time they spend on each page, task queues and
+ * the thumbnail cache report how backlogged they are.  Recording is
+ * cheap: a short critical section per stage per page, or an atomic
+ * store for the rest.  Everything else happens in snapshot(), which
+ * is meant to be called about once a second by whoever displays it.
+ *
+ * \note All methods of this class are thread-safe.
+ */
+class PerformanceStats
+{
+	DECLARE_NON_COPYABLE(PerformanceStats)
+public:
+	enum Stage {
+		LOAD_STAGE,
+		FIX_ORIENTATION_STAGE,
+		PAGE_SPLIT_STAGE,
+		DESKEW_STAGE,
+		SELECT_CONTENT_STAGE,
+		PAGE_LAYOUT_STAGE,
+		OUTPUT_STAGE,
+		NUM_STAGES
+	};
+
+	enum {
+		/** The number of recent samples kept for each stage. */
+		HISTORY_SIZE = 128,
+
+		NUM_HISTOGRAM_BINS = 8
+	};
+
+	struct StageSummary
+	{
+		int numSamples; /**< Samples within the history window. */
+		int medianMsec;
+		int percentile90Msec;
+		int maxMsec;
+		int histogram[NUM_HISTOGRAM_BINS];
+	};
+
+	struct Snapshot
+	{
+		StageSummary stages[NUM_STAGES];
+
+		/** Zero until at least two pages were completed within a minute. */
+		double pagesPerMinute;
+
+		int taskQueueDepth;
+		int thumbnailQueueDepth;
+		int thumbnailHits;
+		int thumbnailMisses;
+
+		/** In bytes, or negative if not known on this platform. */
+		qint64 peakMemoryUsage;
+	};
+
+	/**
+	 * \brief Measures the time spent in a pipeline stage.
+	 *
+	 * Filter tasks call the next stage's task from their process()
+	 * methods, so a timer only records the time not already recorded
+	 * by timers nested within it on the same thread.  Nothing is
+	 * recorded when a timer is destroyed by an exception, which
+	 * normally means the task was cancelled.
+	 */
+	class StageTimer
+	{
+		DECLARE_NON_COPYABLE(StageTimer)
+	public:
+		explicit StageTimer(Stage stage);
+
+		~StageTimer();
+	private:
+		StageTimer* m_pParent;
+		QTime m_startTime;
+		int m_nestedMsec;
+		Stage m_stage;
+	};
+
+	static PerformanceStats& instance();
+
+	void recordStageTime(Stage stage, int msec);
+
+	void recordPageCompleted();
+
+	void setTaskQueueDepth(int depth);
+
+	void setThumbnailQueueDepth(int depth);
+
+	void recordThumbnailRequest(bool cache_hit);
+
+	Snapshot snapshot() const;
+
+	/**
+	 * \brief Forgets everything recorded so far, except queue depths.
+	 */
+	void reset();
+
+	/**
+	 * \brief The upper bound of a histogram bin, in milliseconds.
+	 *
+	 * The last bin doesn't have one, so -1 is returned for it.
+	 */
+	static int histogramBinLimit(int bin);
+
+	/**
+	 * \brief Returns the peak resident memory of this process in bytes,
+	 *        or -1 if it can't be determined on this platform.
+	 */
+	static qint64 peakMemoryUsage();
+private:
+	struct StageHistory
+	{
+		int samples[HISTORY_SIZE];
+		int numSamples;
+		int nextSample;
+	};
+
+	/** Completion times of this many pages are used to calculate the rate. */
+	enum { COMPLETION_HISTORY_SIZE = 64 };
+
+	PerformanceStats();
+
+	mutable QMutex m_mutex;
+	StageHistory m_stages[NUM_STAGES];
+	QTime m_clock;
+	int m_completionTimes[COMPLETION_HISTORY_SIZE];
+	int m_numCompletions;
+	int m_nextCompletion;
+	QAtomicInt m_taskQueueDepth;
+	QAtomicInt m_thumbnailQueueDepth;
+	QAtomicInt m_thumbnailHits;
+	QAtomicInt m_thumbnailMisses;
+};
+
+#endif
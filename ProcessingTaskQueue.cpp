@@ -107,6 +107,18 @@ ProcessingTaskQueue::allProcessed() const
 	return m_queue.empty();
 }
 
+int
+ProcessingTaskQueue::numPendingTasks() const
+{
+	int num_pending = 0;
+	BOOST_FOREACH(Entry const& ent, m_queue) {
+		if (!ent.takenForProcessing) {
+			++num_pending;
+		}
+	}
+	return num_pending;
+}
+
 void
 ProcessingTaskQueue::cancelAndRemove(std::set<PageId> const& pages)
 {
@@ -61,6 +61,11 @@ public:
 
 	bool allProcessed() const;
 
+	/**
+	 * \brief Returns the number of tasks not yet taken for processing.
+	 */
+	int numPendingTasks() const;
+
 	void cancelAndRemove(std::set<PageId> const& pages);
 
 	void cancelAndClear();
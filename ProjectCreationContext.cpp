@@ -31,7 +31,8 @@
 
 ProjectCreationContext::ProjectCreationContext(QWidget* parent)
 :	m_layoutDirection(Qt::LeftToRight),
-	m_pParent(parent)
+	m_pParent(parent),
+	m_analyzePages(false)
 {
 	showProjectFilesDialog();
 }
@@ -68,6 +69,7 @@ ProjectCreationContext::projectFilesSubmitted()
 	if (m_ptrProjectFilesDialog->isRtlLayout()) {
 		m_layoutDirection = Qt::RightToLeft;
 	}
+	m_analyzePages = m_ptrProjectFilesDialog->isBackgroundAnalysisRequested();
 	
 	if (!m_ptrProjectFilesDialog->isDpiFixingForced() && allDpisOK(m_files)) {
 		emit done(this);
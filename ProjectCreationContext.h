@@ -45,6 +45,12 @@ public:
 	QString const& outDir() const { return m_outDir; }
 	
 	Qt::LayoutDirection layoutDirection() const { return m_layoutDirection; }
+	
+	/**
+	 * Whether automatic detection is to be run for all pages
+	 * in the background once the project is created.
+	 */
+	bool analyzePages() const { return m_analyzePages; }
 signals:
 	void done(ProjectCreationContext* context);
 private slots:
@@ -66,6 +72,7 @@ private:
 	std::vector<ImageFileInfo> m_files;
 	Qt::LayoutDirection m_layoutDirection;
 	QWidget* m_pParent;
+	bool m_analyzePages;
 };
 
 #endif
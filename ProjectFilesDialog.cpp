@@ -238,6 +238,11 @@ ProjectFilesDialog::ProjectFilesDialog(QWidget* parent)
 	connect(addToProjectBtn, SIGNAL(clicked()), this, SLOT(addToProject()));
 	connect(removeFromProjectBtn, SIGNAL(clicked()), this, SLOT(removeFromProject()));
 	connect(buttonBox, SIGNAL(accepted()), this, SLOT(onOK()));
+	
+	QSettings settings;
+	analyzePagesCB->setChecked(
+		settings.value("settings/analyze_new_projects", false).toBool()
+	);
 }
 
 ProjectFilesDialog::~ProjectFilesDialog()
@@ -298,6 +303,12 @@ ProjectFilesDialog::isDpiFixingForced() const
 	return forceFixDpi->isChecked();
 }
 
+bool
+ProjectFilesDialog::isBackgroundAnalysisRequested() const
+{
+	return analyzePagesCB->isChecked();
+}
+
 QString
 ProjectFilesDialog::sanitizePath(QString const& path)
 {
@@ -599,6 +610,7 @@ ProjectFilesDialog::startLoadingMetadata()
 	inProjectSelectAllBtn->setEnabled(false);
 	rtlLayoutCB->setEnabled(false);
 	forceFixDpi->setEnabled(false);
+	analyzePagesCB->setEnabled(false);
 	buttonBox->button(QDialogButtonBox::Ok)->setEnabled(false);
 	offProjectList->clearSelection();
 	inProjectList->clearSelection();
@@ -642,6 +654,7 @@ ProjectFilesDialog::finishLoadingMetadata()
 	inProjectSelectAllBtn->setEnabled(true);
 	rtlLayoutCB->setEnabled(true);
 	forceFixDpi->setEnabled(true);
+	analyzePagesCB->setEnabled(true);
 	buttonBox->button(QDialogButtonBox::Ok)->setEnabled(true);
 	
 	if (m_metadataLoadFailed) {
@@ -656,6 +669,9 @@ ProjectFilesDialog::finishLoadingMetadata()
 		return;
 	}
 	
+	QSettings settings;
+	settings.setValue("settings/analyze_new_projects", analyzePagesCB->isChecked());
+	
 	accept();
 }
 
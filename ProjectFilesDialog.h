@@ -44,6 +44,8 @@ public:
 	bool isRtlLayout() const;
 	
 	bool isDpiFixingForced() const;
+	
+	bool isBackgroundAnalysisRequested() const;
 private slots:
 	static QString sanitizePath(QString const& path);
 	
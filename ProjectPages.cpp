@@ -168,6 +168,38 @@ ProjectPages::toPageSequence(PageView const view) const
 	return pages;
 }
 
+std::vector<PageInfo>
+ProjectPages::pagesOfImage(ImageId const& image_id) const
+{
+	std::vector<PageInfo> pages;
+	
+	QMutexLocker locker(&m_mutex);
+	
+	BOOST_FOREACH(ImageDesc const& image, m_images) {
+		if (image.id != image_id) {
+			continue;
+		}
+		
+		assert(image.numLogicalPages >= 1 && image.numLogicalPages <= 2);
+		for (int j = 0; j < image.numLogicalPages; ++j) {
+			PageId const id(
+				image.id, image.logicalPageToSubPage(j, m_subPagesInOrder)
+			);
+			pages.push_back(
+				PageInfo(
+					id, image.metadata,
+					image.numLogicalPages,
+					image.leftHalfRemoved,
+					image.rightHalfRemoved
+				)
+			);
+		}
+		break;
+	}
+	
+	return pages;
+}
+
 void
 ProjectPages::listRelinkablePaths(VirtualFunction1<void, RelinkablePath const&>& sink) const
 {
@@ -65,6 +65,15 @@ public:
 	Qt::LayoutDirection layoutDirection() const;
 	
 	PageSequence toPageSequence(PageView view) const;
+	
+	/**
+	 * \brief Returns the pages of a single image, as they appear in PAGE_VIEW.
+	 *
+	 * Unlike toPageSequence(), this doesn't build descriptors for
+	 * the whole project.  An empty vector is returned if the image
+	 * is not part of the project.
+	 */
+	std::vector<PageInfo> pagesOfImage(ImageId const& image_id) const;
 
 	void listRelinkablePaths(VirtualFunction1<void, RelinkablePath const&>& sink) const;
 
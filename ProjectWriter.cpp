@@ -45,6 +45,28 @@ ProjectWriter::ProjectWriter(
 	m_outFileNameGen(out_file_name_gen),
 	m_selectedPage(selected_page),
 	m_layoutDirection(page_sequence->layoutDirection())
+{
+	assignNumericIds();
+}
+
+ProjectWriter::ProjectWriter(
+	PageSequence const& pages, Qt::LayoutDirection const layout_direction,
+	SelectedPage const& selected_page,
+	OutputFileNameGenerator const& out_file_name_gen)
+:	m_pageSequence(pages),
+	m_outFileNameGen(out_file_name_gen),
+	m_selectedPage(selected_page),
+	m_layoutDirection(layout_direction)
+{
+	assignNumericIds();
+}
+
+ProjectWriter::~ProjectWriter()
+{
+}
+
+void
+ProjectWriter::assignNumericIds()
 {
 	int next_id = 1;
 	size_t const num_pages = m_pageSequence.numPages();
@@ -76,12 +98,23 @@ ProjectWriter::ProjectWriter(
 	}
 }
 
-ProjectWriter::~ProjectWriter()
+bool
+ProjectWriter::write(QString const& file_path, std::vector<FilterPtr> const& filters) const
 {
+	QDomDocument const doc(toDocument(filters));
+	
+	QFile file(file_path);
+	if (file.open(QIODevice::WriteOnly)) {
+		QTextStream strm(&file);
+		doc.save(strm, 2);
+		return true;
+	}
+	
+	return false;
 }
 
-bool
-ProjectWriter::write(QString const& file_path, std::vector<FilterPtr> const& filters) const
+QDomDocument
+ProjectWriter::toDocument(std::vector<FilterPtr> const& filters) const
 {
 	QDomDocument doc;
 	QDomElement root_el(doc.createElement("project"));
@@ -111,14 +144,7 @@ ProjectWriter::write(QString const& file_path, std::vector<FilterPtr> const& fil
 		filters_el.appendChild((*it)->saveSettings(*this, doc));
 	}
 	
-	QFile file(file_path);
-	if (file.open(QIODevice::WriteOnly)) {
-		QTextStream strm(&file);
-		doc.save(strm, 2);
-		return true;
-	}
-	
-	return false;
+	return doc;
 }
 
 QDomElement
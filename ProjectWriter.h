@@ -54,10 +54,23 @@ public:
 		SelectedPage const& selected_page,
 		OutputFileNameGenerator const& out_file_name_gen);
 	
+	/**
+	 * \brief Writes a subset of pages of a project.
+	 *
+	 * Filters only write the settings of pages and images
+	 * that are part of \p pages.
+	 */
+	ProjectWriter(
+		PageSequence const& pages, Qt::LayoutDirection layout_direction,
+		SelectedPage const& selected_page,
+		OutputFileNameGenerator const& out_file_name_gen);
+	
 	~ProjectWriter();
 	
 	bool write(QString const& file_path, std::vector<FilterPtr> const& filters) const;
 	
+	QDomDocument toDocument(std::vector<FilterPtr> const& filters) const;
+	
 	/**
 	 * \p out will be called like this: out(ImageId, numeric_image_id)
 	 */
@@ -152,6 +165,8 @@ private:
 		>
 	> Pages;
 	
+	void assignNumericIds();
+	
 	QDomElement processDirectories(QDomDocument& doc) const;
 	
 	QDomElement processFiles(QDomDocument& doc) const;
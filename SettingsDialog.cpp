@@ -20,8 +20,13 @@
 #include "SettingsDialog.h.moc"
 #include "OpenGLSupport.h"
 #include "config.h"
+#include "imageproc/SpillStorage.h"
+#include "ThreadPool.h"
 #include <QSettings>
 #include <QVariant>
+#include <QFileDialog>
+
+using namespace imageproc;
 
 SettingsDialog::SettingsDialog(QWidget* parent)
 :	QDialog(parent)
@@ -46,6 +51,21 @@ SettingsDialog::SettingsDialog(QWidget* parent)
 	}
 #endif
 
+	ui.maxThreads->setValue(settings.value("settings/max_threads", 0).toInt());
+
+	ui.spillStorage->setChecked(settings.value("settings/spill_enabled", false).toBool());
+	ui.spillDir->setText(settings.value("settings/spill_dir").toString());
+	ui.spillThreshold->setValue(settings.value("settings/spill_threshold_mb", 256).toInt());
+	ui.memoryBudget->setValue(settings.value("settings/memory_budget_mb", 0).toInt());
+
+	SpillStorage::Statistics const stats(SpillStorage::instance().statistics());
+	ui.spillStatistics->setText(
+		tr("Images in temporary files: %1 (%2 MB), %3 MB at most.").arg(
+			stats.numSpilledBlocks
+		).arg(stats.spilledBytes >> 20).arg(stats.peakSpilledBytes >> 20)
+	);
+
+	connect(ui.spillDirBrowse, SIGNAL(clicked()), SLOT(browseForSpillDir()));
 	connect(ui.buttonBox, SIGNAL(accepted()), SLOT(commitChanges()));
 }
 
@@ -60,4 +80,48 @@ SettingsDialog::commitChanges()
 #ifdef ENABLE_OPENGL
 	settings.setValue("settings/use_3d_acceleration", ui.use3DAcceleration->isChecked());
 #endif
+	settings.setValue("settings/max_threads", ui.maxThreads->value());
+	settings.setValue("settings/spill_enabled", ui.spillStorage->isChecked());
+	settings.setValue("settings/spill_dir", ui.spillDir->text());
+	settings.setValue("settings/spill_threshold_mb", ui.spillThreshold->value());
+	settings.setValue("settings/memory_budget_mb", ui.memoryBudget->value());
+
+	applySpillStorageSettings();
+	applyThreadPoolSettings();
+}
+
+void
+SettingsDialog::browseForSpillDir()
+{
+	QString const dir(
+		QFileDialog::getExistingDirectory(
+			this, tr("Directory for temporary files"), ui.spillDir->text()
+		)
+	);
+	if (!dir.isEmpty()) {
+		ui.spillDir->setText(dir);
+	}
+}
+
+void
+SettingsDialog::applySpillStorageSettings()
+{
+	QSettings settings;
+	SpillStorage& storage = SpillStorage::instance();
+
+	storage.setDirectory(settings.value("settings/spill_dir").toString());
+	storage.setSizeThreshold(
+		qint64(settings.value("settings/spill_threshold_mb", 256).toInt()) << 20
+	);
+	storage.setMemoryBudget(
+		qint64(settings.value("settings/memory_budget_mb", 0).toInt()) << 20
+	);
+	storage.setEnabled(settings.value("settings/spill_enabled", false).toBool());
+}
+
+void
+SettingsDialog::applyThreadPoolSettings()
+{
+	QSettings settings;
+	ThreadPool::instance().setMaxThreads(settings.value("settings/max_threads", 0).toInt());
 }
@@ -29,8 +29,20 @@ public:
 	SettingsDialog(QWidget* parent = 0);
 	
 	virtual ~SettingsDialog();
+
+	/**
+	 * \brief Configures imageproc::SpillStorage from the stored settings.
+	 */
+	static void applySpillStorageSettings();
+
+	/**
+	 * \brief Configures ThreadPool from the stored settings.
+	 */
+	static void applyThreadPoolSettings();
 private slots:
 	void commitChanges();
+
+	void browseForSpillDir();
 private:
 	Ui::SettingsDialog ui;
 };
@@ -22,6 +22,7 @@
 #include "AtomicFileOverwriter.h"
 #include "RelinkablePath.h"
 #include "OutOfMemoryHandler.h"
+#include "PerformanceStats.h"
 #include "imageproc/Scale.h"
 #include "imageproc/GrayImage.h"
 #include <QCoreApplication>
@@ -48,6 +49,7 @@
 #endif
 #include <algorithm>
 #include <vector>
+#include <map>
 #include <new>
 
 using namespace ::boost;
@@ -118,6 +120,8 @@ public:
 	~Impl();
 
 	void setThumbDir(QString const& thumb_dir);
+
+	void setWritingEnabled(bool enabled);
 	
 	Status request(
 		ImageId const& image_id, QPixmap& pixmap, bool load_now = false,
@@ -148,6 +152,24 @@ private:
 	typedef Container::index<ItemsByKeyTag>::type ItemsByKey;
 	typedef Container::index<LoadQueueTag>::type LoadQueue;
 	typedef Container::index<RemoveQueueTag>::type RemoveQueue;
+
+	class PendingWrite
+	{
+	public:
+		QImage thumbnail;
+
+		/**
+		 * If false, the thumbnail is only written if it doesn't exist yet.
+		 */
+		bool overwrite;
+
+		PendingWrite() : overwrite(false) {}
+
+		PendingWrite(QImage const& thumb, bool overwr)
+		: thumbnail(thumb), overwrite(overwr) {}
+	};
+
+	typedef std::map<ImageId, PendingWrite> PendingWrites;
 	
 	class BackgroundLoader : public QObject
 	{
@@ -160,6 +182,15 @@ private:
 	};
 	
 	void backgroundProcessing();
+
+	void enqueueWrite(
+		ImageId const& image_id, QImage const& image, bool overwrite);
+
+	bool takePendingWrite(ImageId& image_id, PendingWrite& write);
+
+	void writeThumbnail(ImageId const& image_id, PendingWrite const& write);
+
+	void wakeBackgroundThreadLocked();
 	
 	static QImage loadSaveThumbnail(
 		ImageId const& image_id, QString const& thumb_dir,
@@ -215,6 +246,12 @@ private:
 	 * An iterator of m_removeQueue that marks the end of LOADED items.
 	 */
 	RemoveQueue::iterator m_endOfLoadedItems;
+
+	/**
+	 * Thumbnails waiting to be written by the background thread.
+	 * A newer write for the same image replaces the older one.
+	 */
+	PendingWrites m_pendingWrites;
 	
 	QString m_thumbDir;
 	QSize m_maxThumbSize;
@@ -236,6 +273,7 @@ private:
 	
 	bool m_threadStarted;
 	bool m_shuttingDown;
+	bool m_writingEnabled;
 };
 
 
@@ -285,6 +323,12 @@ ThumbnailPixmapCache::setThumbDir(QString const& thumb_dir)
 	m_ptrImpl->setThumbDir(RelinkablePath::normalize(thumb_dir));
 }
 
+void
+ThumbnailPixmapCache::setWritingEnabled(bool const enabled)
+{
+	m_ptrImpl->setWritingEnabled(enabled);
+}
+
 ThumbnailPixmapCache::Status
 ThumbnailPixmapCache::loadFromCache(ImageId const& image_id, QPixmap& pixmap)
 {
@@ -339,7 +383,8 @@ ThumbnailPixmapCache::Impl::Impl(
 	m_numLoadedItems(0),
 	m_totalLoadAttempts(0),
 	m_threadStarted(false),
-	m_shuttingDown(false)
+	m_shuttingDown(false),
+	m_writingEnabled(true)
 {
 	// Note that QDir::mkdir() will fail if the parent directory,
 	// that is $OUT/cache doesn't exist. We want that behaviour,
@@ -352,18 +397,25 @@ ThumbnailPixmapCache::Impl::Impl(
 
 ThumbnailPixmapCache::Impl::~Impl()
 {
+	bool thread_started = false;
+
 	{
 		QMutexLocker const locker(&m_mutex);
-		
-		if (!m_threadStarted) {
-			return;
-		}
-		
+		thread_started = m_threadStarted;
 		m_shuttingDown = true;
 	}
 	
-	quit();
-	wait();
+	if (thread_started) {
+		quit();
+		wait();
+	}
+
+	// Don't lose thumbnails that are still waiting to be written.
+	// Dropping a recreateThumbnail() request would leave an outdated
+	// thumbnail on disk.
+	BOOST_FOREACH(PendingWrites::value_type const& kv, m_pendingWrites) {
+		writeThumbnail(kv.first, kv.second);
+	}
 }
 
 void
@@ -384,6 +436,16 @@ ThumbnailPixmapCache::Impl::setThumbDir(QString const& thumb_dir)
 			item.precedingLoadAttempts + m_expirationThreshold + 1
 		);
 	}
+
+	// Pending writes were meant for the old directory.
+	m_pendingWrites.clear();
+}
+
+void
+ThumbnailPixmapCache::Impl::setWritingEnabled(bool const enabled)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_writingEnabled = enabled;
 }
 
 ThumbnailPixmapCache::Status
@@ -410,12 +472,26 @@ ThumbnailPixmapCache::Impl::request(
 			);
 			m_removeQueue.relocate(m_endOfLoadedItems, rq_it);
 			
+			PerformanceStats::instance().recordThumbnailRequest(true);
 			return LOADED;
 		} else if (k_it->status == Item::LOAD_FAILED) {
 			pixmap = k_it->pixmap;
 			return LOAD_FAILED;
 		}
 	}
+
+	PendingWrites::iterator const pw_it(m_pendingWrites.find(image_id));
+	if (pw_it != m_pendingWrites.end()) {
+		// The thumbnail hasn't been written yet, but we already have it.
+		pixmap = QPixmap::fromImage(pw_it->second.thumbnail);
+		cachePixmapLocked(image_id, pixmap);
+		PerformanceStats::instance().recordThumbnailRequest(true);
+		return LOADED;
+	}
+	
+	if (load_now || completion_handler) {
+		PerformanceStats::instance().recordThumbnailRequest(false);
+	}
 	
 	if (load_now) {
 		QString const thumb_dir(m_thumbDir);
@@ -475,17 +551,9 @@ ThumbnailPixmapCache::Impl::request(
 	lq_it->completionHandlers.push_back(*completion_handler);
 	
 	if (m_numQueuedItems++ == 0) {
-		if (m_threadStarted) {
-			// Wake the background thread up.
-			QCoreApplication::postEvent(
-				&m_backgroundLoader, new QEvent(QEvent::User)
-			);
-		} else {
-			// Start the background thread.
-			start();
-			m_threadStarted = true;
-		}
+		wakeBackgroundThreadLocked();
 	}
+	PerformanceStats::instance().setThumbnailQueueDepth(m_numQueuedItems);
 	
 	return QUEUED;
 }
@@ -503,8 +571,13 @@ ThumbnailPixmapCache::Impl::ensureThumbnailExists(
 	}
 	
 	QMutexLocker locker(&m_mutex);
+	if (!m_writingEnabled) {
+		return;
+	}
+	if (m_pendingWrites.find(image_id) != m_pendingWrites.end()) {
+		return;
+	}
 	QString const thumb_dir(m_thumbDir);
-	QSize const max_thumb_size(m_maxThumbSize);
 	locker.unlock();
 	
 	QString const thumb_file_path(getThumbFilePath(image_id, thumb_dir));
@@ -512,13 +585,7 @@ ThumbnailPixmapCache::Impl::ensureThumbnailExists(
 		return;
 	}
 	
-	QImage const thumbnail(makeThumbnail(image, max_thumb_size));
-	
-	AtomicFileOverwriter overwriter;
-	QIODevice* iodev = overwriter.startWriting(thumb_file_path);
-	if (iodev && thumbnail.save(iodev, "PNG")) {
-		overwriter.commit();
-	}
+	enqueueWrite(image_id, image, false);
 }
 
 void
@@ -532,51 +599,149 @@ ThumbnailPixmapCache::Impl::recreateThumbnail(
 	if (image.isNull()) {
 		return;
 	}
-	
+
 	QMutexLocker locker(&m_mutex);
+	bool const writing_enabled = m_writingEnabled;
 	QString const thumb_dir(m_thumbDir);
+	locker.unlock();
+
+	if (writing_enabled) {
+		enqueueWrite(image_id, image, true);
+		return;
+	}
+
+	// Not writing a new thumbnail is fine, keeping the old one isn't.
+	QFile::remove(getThumbFilePath(image_id, thumb_dir));
+
+	locker.relock();
+
+	ItemsByKey::iterator const k_it(m_itemsByKey.find(image_id));
+	if (k_it != m_itemsByKey.end()) {
+		switch (k_it->status) {
+			case Item::LOADED:
+			case Item::LOAD_FAILED:
+				removeItemLocked(m_items.project<RemoveQueueTag>(k_it));
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+void
+ThumbnailPixmapCache::Impl::enqueueWrite(
+	ImageId const& image_id, QImage const& image, bool const overwrite)
+{
+	QMutexLocker locker(&m_mutex);
 	QSize const max_thumb_size(m_maxThumbSize);
 	locker.unlock();
-	
-	QString const thumb_file_path(getThumbFilePath(image_id, thumb_dir));
+
+	// The full-size image is not kept around.  Only the downscaled
+	// version waits for the background thread.
 	QImage const thumbnail(makeThumbnail(image, max_thumb_size));
-	bool thumb_written = false;
-	
-	// Note that we may be called from multiple threads at the same time.
+
+	locker.relock();
+
+	if (m_shuttingDown) {
+		return;
+	}
+
+	bool const was_idle = m_pendingWrites.empty();
+
+	PendingWrites::iterator const pw_it(m_pendingWrites.find(image_id));
+	if (pw_it == m_pendingWrites.end()) {
+		m_pendingWrites.insert(
+			PendingWrites::value_type(
+				image_id, PendingWrite(thumbnail, overwrite)
+			)
+		);
+	} else if (overwrite || !pw_it->second.overwrite) {
+		// Coalesce with the older write, which is now obsolete.
+		pw_it->second = PendingWrite(
+			thumbnail, overwrite || pw_it->second.overwrite
+		);
+	}
+
+	if (overwrite) {
+		// Make sure the outdated pixmap is not served from cache.
+		// Requests will be served from the pending write instead.
+		ItemsByKey::iterator const k_it(m_itemsByKey.find(image_id));
+		if (k_it != m_itemsByKey.end()) {
+			switch (k_it->status) {
+				case Item::LOADED:
+				case Item::LOAD_FAILED:
+					removeItemLocked(m_items.project<RemoveQueueTag>(k_it));
+					break;
+				case Item::QUEUED:
+					break;
+				case Item::IN_PROGRESS:
+					// We have a small race condition in this case.
+					// The background thread may be loading the
+					// old version of the thumbnail right now.
+					// Well, let's just pretend the thumbnail was
+					// loaded before the new version was produced.
+					break;
+			}
+		}
+	}
+
+	if (was_idle) {
+		wakeBackgroundThreadLocked();
+	}
+}
+
+bool
+ThumbnailPixmapCache::Impl::takePendingWrite(
+	ImageId& image_id, PendingWrite& write)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	if (m_shuttingDown || m_pendingWrites.empty()) {
+		return false;
+	}
+
+	PendingWrites::iterator const pw_it(m_pendingWrites.begin());
+	image_id = pw_it->first;
+	write = pw_it->second;
+	m_pendingWrites.erase(pw_it);
+
+	return true;
+}
+
+void
+ThumbnailPixmapCache::Impl::writeThumbnail(
+	ImageId const& image_id, PendingWrite const& write)
+{
+	QMutexLocker locker(&m_mutex);
+	QString const thumb_dir(m_thumbDir);
+	locker.unlock();
+
+	QString const thumb_file_path(getThumbFilePath(image_id, thumb_dir));
+	if (!write.overwrite && QFile::exists(thumb_file_path)) {
+		return;
+	}
+
 	AtomicFileOverwriter overwriter;
 	QIODevice* iodev = overwriter.startWriting(thumb_file_path);
-	if (iodev && thumbnail.save(iodev, "PNG")) {
-		thumb_written = overwriter.commit();
+	if (iodev && write.thumbnail.save(iodev, "PNG")) {
+		overwriter.commit();
 	} else {
 		overwriter.abort();
 	}
-	
-	if (!thumb_written) {
-		return;
-	}
-	
-	QMutexLocker const locker2(&m_mutex);
-	
-	ItemsByKey::iterator const k_it(m_itemsByKey.find(image_id));
-	if (k_it == m_itemsByKey.end()) {
-		return;
-	}
-	
-	switch (k_it->status) {
-		case Item::LOADED:
-		case Item::LOAD_FAILED:
-			removeItemLocked(m_items.project<RemoveQueueTag>(k_it));
-			break;
-		case Item::QUEUED:
-			break;
-		case Item::IN_PROGRESS:
-			// We have a small race condition in this case.
-			// We don't know if the other thread has already loaded
-			// the thumbnail or not.  In case it did, again we
-			// don't know if it loaded the old or new version.
-			// Well, let's just pretend the thumnail was loaded
-			// (or failed to load) before we wrote the new version.
-			break;
+}
+
+void
+ThumbnailPixmapCache::Impl::wakeBackgroundThreadLocked()
+{
+	if (m_threadStarted) {
+		// Wake the background thread up.
+		QCoreApplication::postEvent(
+			&m_backgroundLoader, new QEvent(QEvent::User)
+		);
+	} else {
+		// Start the background thread.
+		start();
+		m_threadStarted = true;
 	}
 }
 
@@ -601,6 +766,15 @@ ThumbnailPixmapCache::Impl::backgroundProcessing()
 	
 	for (;;) {
 		try {
+			// Pending writes go first, so that queued loads
+			// pick up the freshly written thumbnails.
+			ImageId write_image_id;
+			PendingWrite write;
+			if (takePendingWrite(write_image_id, write)) {
+				writeThumbnail(write_image_id, write);
+				continue;
+			}
+
 			// We are going to initialize these while holding the mutex.
 			LoadQueue::iterator lq_it;
 			ImageId image_id;
@@ -679,7 +853,8 @@ ThumbnailPixmapCache::Impl::loadSaveThumbnail(
 		return image;
 	}
 	
-	image = ImageLoader::load(image_id);
+	// There is no point in decoding more pixels than the thumbnail needs.
+	image = ImageLoader::loadReduced(image_id, max_thumb_size);
 	if (image.isNull()) {
 		return QImage();
 	}
@@ -751,6 +926,7 @@ ThumbnailPixmapCache::Impl::queuedToInProgress(LoadQueue::iterator const& lq_it)
 	
 	assert(m_numQueuedItems > 0);
 	--m_numQueuedItems;
+	PerformanceStats::instance().setThumbnailQueueDepth(m_numQueuedItems);
 	
 	// Move it item to the end of load queue.
 	// The point is to keep QUEUED items before any others.
@@ -863,6 +1039,7 @@ ThumbnailPixmapCache::Impl::removeItemLocked(
 		case Item::QUEUED:
 			assert(m_numQueuedItems > 0);
 			--m_numQueuedItems;
+			PerformanceStats::instance().setThumbnailQueueDepth(m_numQueuedItems);
 			break;
 		case Item::LOADED:
 			assert(m_numLoadedItems > 0);
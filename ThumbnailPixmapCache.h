@@ -72,6 +72,17 @@ public:
 	
 	void setThumbDir(QString const& thumb_dir);
 
+	/**
+	 * \brief Enables or disables writing thumbnails to disk.
+	 *
+	 * With writing disabled, ensureThumbnailExists() does nothing and
+	 * recreateThumbnail() just removes the outdated thumbnail, leaving
+	 * it to be re-generated on demand.  That's what the command line
+	 * version wants, as nobody looks at its thumbnails.
+	 * Writing is enabled by default.
+	 */
+	void setWritingEnabled(bool enabled);
+
 	/**
 	 * \brief Take the pixmap from cache, if it's there.
 	 *
@@ -132,6 +143,9 @@ public:
 	 * \param image_id The identifier of the full size image and its thumbnail.
 	 * \param image The full-size image.
 	 *
+	 * Only the downscaling happens in the calling thread.  Encoding and
+	 * writing the thumbnail is left to a background thread.
+	 *
 	 * \note This function may be called from any thread, even concurrently.
 	 */
 	void ensureThumbnailExists(ImageId const& image_id, QImage const& image);
@@ -142,6 +156,10 @@ public:
 	 * \param image_id The identifier of the full size image and its thumbnail.
 	 * \param image The full-size image or a thumbnail.
 	 *
+	 * Like with ensureThumbnailExists(), the thumbnail is written
+	 * in background.  Until then, requests for it are served from
+	 * the pending write.
+	 *
 	 * \note This function may be called from any thread, even concurrently.
 	 */
 	void recreateThumbnail(ImageId const& image_id, QImage const& image);
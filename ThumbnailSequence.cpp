@@ -69,6 +69,7 @@
 #include <Qt>
 #include <QDebug>
 #include <algorithm>
+#include <vector>
 #include <stddef.h>
 #include <assert.h>
 
@@ -94,6 +95,9 @@ public:
 	PageInfo pageInfo;
 	mutable CompositeItem* composite;
 	mutable bool incompleteThumbnail;
+	
+	/** Only meaningful if a PageOrderProvider is set. */
+	mutable PageOrderProvider::SortKey sortKey;
 private:
 	mutable bool m_isSelected;
 	mutable bool m_isSelectionLeader;
@@ -221,7 +225,7 @@ private:
 	 * \param begin Beginning of the interval to consider.
 	 * \param end End of the interval to consider.
 	 * \param page_id The item to find insertion position for.
-	 * \param page_incomplete Whether the page is represented by IncompleteThumbnail.
+	 * \param page_key The sort key of the item, as returned by m_ptrOrderProvider.
 	 * \param hint The place to start the search.  Must be within [begin, end].
 	 * \param dist_from_hint If provided, the distance from \p hint
 	 *        to the calculated insertion position will be written there.
@@ -230,7 +234,7 @@ private:
 	 */
 	ItemsInOrder::iterator itemInsertPosition(
 		ItemsInOrder::iterator begin, ItemsInOrder::iterator end,
-		PageId const& page_id, bool page_incomplete,
+		PageId const& page_id, PageOrderProvider::SortKey const& page_key,
 		ItemsInOrder::iterator hint, int* dist_from_hint = 0);
 	
 	std::auto_ptr<QGraphicsItem> getThumbnail(PageInfo const& page_info);
@@ -629,6 +633,14 @@ ThumbnailSequence::Impl::invalidateThumbnailImpl(ItemsById::iterator const id_it
 	id_it->incompleteThumbnail = new_composite->incompleteThumbnail();
 	delete old_composite;
 	
+	// Only this page's key is recomputed.  Other pages keep their keys,
+	// which makes re-sorting after a single page change incremental.
+	if (m_ptrOrderProvider.get()) {
+		id_it->sortKey = m_ptrOrderProvider->sortKey(
+			id_it->pageInfo.id(), id_it->incompleteThumbnail
+		);
+	}
+	
 	ItemsInOrder::iterator after_old(m_items.project<ItemsInOrderTag>(id_it));
 	// Notice after_old++ below.
 
@@ -640,7 +652,7 @@ ThumbnailSequence::Impl::invalidateThumbnailImpl(ItemsById::iterator const id_it
 	ItemsInOrder::iterator const after_new(
 		itemInsertPosition(
 			++m_itemsInOrder.begin(), m_itemsInOrder.end(),
-			id_it->pageInfo.id(), id_it->incompleteThumbnail,
+			id_it->pageInfo.id(), id_it->sortKey,
 			after_old, &dist
 		)
 	);
@@ -724,11 +736,29 @@ ThumbnailSequence::Impl::invalidateAllThumbnails()
 
 	// Sort pages in m_itemsInOrder using m_ptrOrderProvider.
 	if (m_ptrOrderProvider.get()) {
+		// Extract the sort keys of all pages in one go, so that the
+		// order provider only has to query its settings once.
+		std::vector<PageId> pages;
+		std::vector<bool> incomplete;
+		std::vector<PageOrderProvider::SortKey> keys;
+		pages.reserve(m_itemsInOrder.size());
+		incomplete.reserve(m_itemsInOrder.size());
+		BOOST_FOREACH(Item const& item, m_itemsInOrder) {
+			pages.push_back(item.pageId());
+			incomplete.push_back(item.incompleteThumbnail);
+		}
+		m_ptrOrderProvider->sortKeys(pages, incomplete, keys);
+
+		size_t i = 0;
+		BOOST_FOREACH(Item const& item, m_itemsInOrder) {
+			item.sortKey = keys[i++];
+		}
+
 		m_itemsInOrder.sort(
 			boost::lambda::bind(
 				&PageOrderProvider::precedes, m_ptrOrderProvider.get(),
-				boost::lambda::bind(&Item::pageId, boost::lambda::_1), bind(&Item::incompleteThumbnail, boost::lambda::_1),
-				boost::lambda::bind(&Item::pageId, boost::lambda::_2), bind(&Item::incompleteThumbnail, boost::lambda::_2)
+				boost::lambda::bind(&Item::pageId, boost::lambda::_1), bind(&Item::sortKey, boost::lambda::_1),
+				boost::lambda::bind(&Item::pageId, boost::lambda::_2), bind(&Item::sortKey, boost::lambda::_2)
 			)
 		);
 	}
@@ -902,10 +932,14 @@ ThumbnailSequence::Impl::insert(
 		}
 	}
 
+	PageOrderProvider::SortKey key;
+	if (m_ptrOrderProvider.get()) {
+		key = m_ptrOrderProvider->sortKey(page_info.id(), /*incomplete=*/true);
+	}
+
 	// If m_ptrOrderProvider is not set, ord_it won't change.
 	ord_it = itemInsertPosition(
-		m_itemsInOrder.begin(), m_itemsInOrder.end(), page_info.id(),
-		/*page_incomplete=*/true, ord_it
+		m_itemsInOrder.begin(), m_itemsInOrder.end(), page_info.id(), key, ord_it
 	);
 	
 	double offset = 0.0;
@@ -927,7 +961,8 @@ ThumbnailSequence::Impl::insert(
 	
 	QPointF const pos_delta(0.0, composite->boundingRect().height() + SPACING);
 	
-	Item const item(page_info, composite.get());
+	Item item(page_info, composite.get());
+	item.sortKey = key;
 	std::pair<ItemsInOrder::iterator, bool> const ins(
 		m_itemsInOrder.insert(ord_it, item)
 	);
@@ -1279,7 +1314,7 @@ ThumbnailSequence::Impl::clearSelection()
 ThumbnailSequence::Impl::ItemsInOrder::iterator
 ThumbnailSequence::Impl::itemInsertPosition(
 	ItemsInOrder::iterator const begin, ItemsInOrder::iterator const end,
-	PageId const& page_id, bool const page_incomplete,
+	PageId const& page_id, PageOrderProvider::SortKey const& page_key,
 	ItemsInOrder::iterator const hint, int* dist_from_hint)
 {
 	// Note that to preserve stable ordering, this function *must* return hint,
@@ -1301,7 +1336,7 @@ ThumbnailSequence::Impl::itemInsertPosition(
 		ItemsInOrder::iterator prev(ins_pos);
 		--prev;
 		bool const precedes = m_ptrOrderProvider->precedes(
-			page_id, page_incomplete, prev->pageId(), prev->incompleteThumbnail
+			page_id, page_key, prev->pageId(), prev->sortKey
 		);
 		if (precedes) {
 			ins_pos = prev;
@@ -1315,8 +1350,8 @@ ThumbnailSequence::Impl::itemInsertPosition(
 	// the page we are inserting, advance ins_pos.
 	while (ins_pos != end) {
 		bool const precedes = m_ptrOrderProvider->precedes(
-			ins_pos->pageId(), ins_pos->incompleteThumbnail,
-			page_id, page_incomplete
+			ins_pos->pageId(), ins_pos->sortKey,
+			page_id, page_key
 		);
 		if (precedes) {
 			++ins_pos;
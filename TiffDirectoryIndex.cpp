@@ -0,0 +1,119 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TiffDirectoryIndex.h"
+#include <QFileInfo>
+#include <QMutexLocker>
+
+TiffDirectoryIndex::TiffDirectoryIndex()
+:	m_useCounter(0)
+{
+}
+
+TiffDirectoryIndex&
+TiffDirectoryIndex::instance()
+{
+	// Depending on the compiler, this may not be thread-safe,
+	// so we make sure it's called from the main thread early on.
+	static TiffDirectoryIndex object;
+	return object;
+}
+
+bool
+TiffDirectoryIndex::lookup(QString const& file_path, int page_num, quint64& offset)
+{
+	if (page_num < 0) {
+		return false;
+	}
+
+	// Stat the file before taking the lock.
+	QFileInfo const file_info(file_path);
+	qint64 const file_size = file_info.size();
+	QDateTime const last_modified(file_info.lastModified());
+
+	QMutexLocker const locker(&m_mutex);
+
+	Map::iterator const it(m_entries.find(file_path));
+	if (it == m_entries.end()) {
+		return false;
+	}
+
+	Entry& entry = it->second;
+	if (entry.fileSize != file_size || entry.lastModified != last_modified) {
+		// The file has changed since it was indexed.
+		m_entries.erase(it);
+		return false;
+	}
+
+	if (page_num >= (int)entry.offsets.size()) {
+		return false;
+	}
+
+	entry.lastUsed = ++m_useCounter;
+	offset = entry.offsets[page_num];
+	return true;
+}
+
+void
+TiffDirectoryIndex::store(QString const& file_path, std::vector<quint64> const& offsets)
+{
+	QFileInfo const file_info(file_path);
+	if (!file_info.exists()) {
+		return;
+	}
+
+	Entry entry;
+	entry.offsets = offsets;
+	entry.fileSize = file_info.size();
+	entry.lastModified = file_info.lastModified();
+
+	QMutexLocker const locker(&m_mutex);
+
+	entry.lastUsed = ++m_useCounter;
+
+	Map::iterator const it(m_entries.lower_bound(file_path));
+	if (it != m_entries.end() && it->first == file_path) {
+		it->second.offsets.swap(entry.offsets);
+		it->second.fileSize = entry.fileSize;
+		it->second.lastModified = entry.lastModified;
+		it->second.lastUsed = entry.lastUsed;
+		return;
+	}
+
+	if (m_entries.size() >= MAX_ENTRIES) {
+		evictLeastRecentlyUsed();
+	}
+	m_entries.insert(Map::value_type(file_path, entry));
+}
+
+void
+TiffDirectoryIndex::evictLeastRecentlyUsed()
+{
+	Map::iterator victim(m_entries.begin());
+	Map::iterator it(m_entries.begin());
+	Map::iterator const end(m_entries.end());
+	for (; it != end; ++it) {
+		if (it->second.lastUsed < victim->second.lastUsed) {
+			victim = it;
+		}
+	}
+
+	if (victim != end) {
+		m_entries.erase(victim);
+	}
+}
@@ -0,0 +1,91 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TIFF_DIRECTORY_INDEX_H_
+#define TIFF_DIRECTORY_INDEX_H_
+
+#include "NonCopyable.h"
+#include <QString>
+#include <QDateTime>
+#include <QMutex>
+#include <QtGlobal>
+#include <vector>
+#include <map>
+
+/**
+ * \brief A process-wide cache of IFD (image file directory) offsets
+ *        of multi-page TIFF files.
+ *
+ * Positioning libtiff at page N with TIFFSetDirectory() walks the IFD
+ * chain from the beginning, which makes loading every page of a large
+ * multi-page file quadratic in the number of IFD reads.  Knowing the
+ * offset of each IFD lets us jump straight to it with TIFFSetSubDirectory().
+ *
+ * Entries are keyed by file path and validated against the file's size
+ * and modification time, so a file that was changed on disk is re-indexed.
+ *
+ * \note All methods of this class are thread-safe.
+ */
+class TiffDirectoryIndex
+{
+	DECLARE_NON_COPYABLE(TiffDirectoryIndex)
+public:
+	static TiffDirectoryIndex& instance();
+
+	/**
+	 * \brief Looks up the IFD offset of a page.
+	 *
+	 * \param file_path The path of a TIFF file.
+	 * \param page_num A zero-based page number within that file.
+	 * \param offset Receives the IFD offset on success.
+	 * \return true if the file was indexed, hasn't changed since then and
+	 *         has the requested page.  false otherwise.
+	 */
+	bool lookup(QString const& file_path, int page_num, quint64& offset);
+
+	/**
+	 * \brief Stores IFD offsets of all pages of a file, replacing
+	 *        any existing entry for it.
+	 */
+	void store(QString const& file_path, std::vector<quint64> const& offsets);
+private:
+	struct Entry
+	{
+		std::vector<quint64> offsets;
+		QDateTime lastModified;
+		qint64 fileSize;
+		quint64 lastUsed;
+
+		Entry() : fileSize(-1), lastUsed(0) {}
+	};
+
+	typedef std::map<QString, Entry> Map;
+
+	/** The maximum number of files we keep the index for. */
+	enum { MAX_ENTRIES = 256 };
+
+	TiffDirectoryIndex();
+
+	void evictLeastRecentlyUsed();
+
+	QMutex m_mutex;
+	Map m_entries;
+	quint64 m_useCounter;
+};
+
+#endif
@@ -17,21 +17,30 @@
 */
 
 #include "TiffReader.h"
+#include "TiffDirectoryIndex.h"
 #include "ImageMetadata.h"
 #include "NonCopyable.h"
 #include "Dpi.h"
 #include "Dpm.h"
+#include "MrcLayers.h"
+#include "imageproc/BinaryImage.h"
+#include "ThreadPool.h"
+#include "ParallelFor.h"
 #include <QtGlobal>
 #include <QSysInfo>
 #include <QIODevice>
+#include <QFile>
 #include <QImage>
 #include <QColor>
 #include <QSize>
+#include <QAtomicInt>
 #include <QDebug>
 #include <algorithm>
+#include <vector>
 #include <tiff.h>
 #include <tiffio.h>
 #include <new>
+#include <string.h>
 #include <assert.h>
 
 class TiffReader::TiffHeader
@@ -104,12 +113,113 @@ struct TiffReader::TiffInfo
 	uint16 samples_per_pixel;
 	uint16 sample_format;
 	uint16 photometric;
+	uint16 planar_config;
+	uint16 orientation;
+	uint16 alpha; // EXTRASAMPLE_UNSPECIFIED if there is no alpha channel.
 	bool host_big_endian;
 	bool file_big_endian;
 	
 	TiffInfo(TiffHandle const& tif, TiffHeader const& header);
 	
 	bool mapsToBinaryOrIndexed8() const;
+	
+	/**
+	 * Returns true for contiguous 8 or 16 bit per sample RGB(A)
+	 * and grayscale (with alpha) images, which we decode ourselves
+	 * rather than going through TIFFReadRGBAImageOriented().
+	 */
+	bool mapsToNativeColor() const;
+};
+
+
+/**
+ * Describes how a page is split into independently decodable
+ * chunks, which are either strips or tiles.
+ */
+struct TiffReader::ChunkLayout
+{
+	bool tiled;
+	uint32 chunk_width; // Tile width, or image width for strips.
+	uint32 chunk_height; // Tile height, or rows per strip.
+	uint32 chunks_across;
+	uint32 num_chunks;
+	tsize_t chunk_bytes; // The size of a decoded chunk.
+	tsize_t row_bytes; // The size of a row within a decoded chunk.
+	
+	ChunkLayout(TiffHandle const& tif, TiffInfo const& info);
+	
+	bool isValid() const;
+	
+	bool isCompatibleWith(ChunkLayout const& other) const;
+};
+
+
+/**
+ * Hands out chunks to decode to whichever thread asks for one.
+ */
+class TiffReader::ChunkDecodingJob
+{
+	DECLARE_NON_COPYABLE(ChunkDecodingJob)
+public:
+	ChunkDecodingJob(TiffInfo const& info, ChunkLayout const& layout, QImage& image);
+	
+	TiffInfo const& info() const { return m_rInfo; }
+	
+	ChunkLayout const& layout() const { return m_rLayout; }
+	
+	/**
+	 * Decodes chunks until there are none left or one of them fails.
+	 * May be called concurrently, with different TIFF handles.
+	 */
+	void run(TiffHandle const& tif);
+	
+	bool hasUnclaimedChunks() const {
+		return !failed() && uint32(int(m_nextChunk)) < m_rLayout.num_chunks;
+	}
+	
+	/**
+	 * Returns true for the first caller only, who may then use
+	 * the TIFF handle of the thread that started the job.
+	 */
+	bool claimOriginalHandle() { return m_originalHandleClaimed.testAndSetOrdered(0, 1); }
+	
+	void markFailed() { m_failed.fetchAndStoreOrdered(1); }
+	
+	bool failed() const { return m_failed != 0; }
+private:
+	TiffInfo const& m_rInfo;
+	ChunkLayout const& m_rLayout;
+	uchar* m_pImageBits;
+	int m_imageBpl;
+	QAtomicInt m_nextChunk;
+	QAtomicInt m_originalHandleClaimed;
+	QAtomicInt m_failed;
+};
+
+
+/**
+ * A parallelFor() body, with every item being a participant in
+ * a ChunkDecodingJob.  The first participant to start uses the original
+ * TIFF handle, while the others open the file again.
+ */
+class TiffReader::ChunkDecodingParticipant
+{
+public:
+	ChunkDecodingParticipant(ChunkDecodingJob& job, TiffHandle const& original_tif,
+		QString const& file_path, int page_num)
+	:	m_pJob(&job),
+		m_pOriginalTif(&original_tif),
+		m_filePath(file_path),
+		m_pageNum(page_num) {}
+	
+	void operator()(int begin, int end) const;
+private:
+	void runWithOwnHandle() const;
+	
+	ChunkDecodingJob* m_pJob;
+	TiffHandle const* m_pOriginalTif;
+	QString m_filePath;
+	int m_pageNum;
 };
 
 
@@ -120,6 +230,9 @@ TiffReader::TiffInfo::TiffInfo(TiffHandle const& tif, TiffHeader const& header)
 	samples_per_pixel(1),
 	sample_format(SAMPLEFORMAT_UINT),
 	photometric(PHOTOMETRIC_MINISBLACK),
+	planar_config(PLANARCONFIG_CONTIG),
+	orientation(ORIENTATION_TOPLEFT),
+	alpha(EXTRASAMPLE_UNSPECIFIED),
 	host_big_endian(QSysInfo::ByteOrder == QSysInfo::BigEndian),
 	file_big_endian(header.signature() == TiffHeader::TIFF_BIG_ENDIAN)
 {
@@ -139,6 +252,16 @@ TiffReader::TiffInfo::TiffInfo(TiffHandle const& tif, TiffHeader const& header)
 	TIFFGetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
 	TIFFGetField(tif.handle(), TIFFTAG_SAMPLEFORMAT, &sample_format);
 	TIFFGetField(tif.handle(), TIFFTAG_PHOTOMETRIC, &photometric);
+	TIFFGetField(tif.handle(), TIFFTAG_PLANARCONFIG, &planar_config);
+	TIFFGetField(tif.handle(), TIFFTAG_ORIENTATION, &orientation);
+	
+	uint16 num_extra_samples = 0;
+	uint16* extra_samples = 0;
+	if (TIFFGetField(tif.handle(), TIFFTAG_EXTRASAMPLES, &num_extra_samples, &extra_samples)) {
+		if (num_extra_samples == 1 && extra_samples) {
+			alpha = extra_samples[0];
+		}
+	}
 }
 
 bool
@@ -158,6 +281,79 @@ TiffReader::TiffInfo::mapsToBinaryOrIndexed8() const
 	return false;
 }
 
+bool
+TiffReader::TiffInfo::mapsToNativeColor() const
+{
+	if (planar_config != PLANARCONFIG_CONTIG || orientation != ORIENTATION_TOPLEFT) {
+		return false;
+	}
+	if (sample_format != SAMPLEFORMAT_UINT) {
+		return false;
+	}
+	if (bits_per_sample != 8 && bits_per_sample != 16) {
+		return false;
+	}
+	
+	int const num_alpha_samples = alpha == EXTRASAMPLE_UNSPECIFIED ? 0 : 1;
+	switch (photometric) {
+		case PHOTOMETRIC_RGB:
+			return samples_per_pixel == 3 + num_alpha_samples;
+		case PHOTOMETRIC_MINISBLACK:
+			return samples_per_pixel == 1 + num_alpha_samples;
+	}
+	
+	return false;
+}
+
+
+TiffReader::ChunkLayout::ChunkLayout(TiffHandle const& tif, TiffInfo const& info)
+:	tiled(TIFFIsTiled(tif.handle()) != 0),
+	chunk_width(0),
+	chunk_height(0),
+	chunks_across(0),
+	num_chunks(0),
+	chunk_bytes(0),
+	row_bytes(0)
+{
+	if (tiled) {
+		TIFFGetField(tif.handle(), TIFFTAG_TILEWIDTH, &chunk_width);
+		TIFFGetField(tif.handle(), TIFFTAG_TILELENGTH, &chunk_height);
+		if (chunk_width != 0) {
+			chunks_across = (info.width + chunk_width - 1) / chunk_width;
+		}
+		num_chunks = TIFFNumberOfTiles(tif.handle());
+		chunk_bytes = TIFFTileSize(tif.handle());
+		row_bytes = TIFFTileRowSize(tif.handle());
+	} else {
+		chunk_width = info.width;
+		chunk_height = info.height;
+		TIFFGetFieldDefaulted(tif.handle(), TIFFTAG_ROWSPERSTRIP, &chunk_height);
+		if (chunk_height > (uint32)info.height) {
+			// ROWSPERSTRIP defaults to 2^32 - 1.
+			chunk_height = info.height;
+		}
+		chunks_across = 1;
+		num_chunks = TIFFNumberOfStrips(tif.handle());
+		chunk_bytes = TIFFStripSize(tif.handle());
+		row_bytes = TIFFScanlineSize(tif.handle());
+	}
+}
+
+bool
+TiffReader::ChunkLayout::isValid() const
+{
+	return chunk_width > 0 && chunk_height > 0 && num_chunks > 0
+		&& chunk_bytes > 0 && row_bytes > 0;
+}
+
+bool
+TiffReader::ChunkLayout::isCompatibleWith(ChunkLayout const& other) const
+{
+	return tiled == other.tiled && chunk_width == other.chunk_width
+		&& chunk_height == other.chunk_height && num_chunks == other.num_chunks
+		&& chunk_bytes == other.chunk_bytes && row_bytes == other.row_bytes;
+}
+
 
 static tsize_t deviceRead(thandle_t context, tdata_t data, tsize_t size)
 {
@@ -258,13 +454,161 @@ TiffReader::readMetadata(
 		return ImageMetadataLoader::GENERIC_ERROR;
 	}
 	
+	// While we are at it, index IFD offsets for fast random access to pages.
+	// The layers of an MRC file make up a single page.
+	bool const mrc = isMrcTextLayer(tif);
+	std::vector<quint64> dir_offsets;
 	do {
-		out(currentPageMetadata(tif));
+		dir_offsets.push_back(TIFFCurrentDirOffset(tif.handle()));
+		if (!mrc || dir_offsets.size() == 1) {
+			out(currentPageMetadata(tif));
+		}
 	} while (TIFFReadDirectory(tif.handle()));
 	
+	QString const file_path(filePathOf(device));
+	if (!file_path.isEmpty()) {
+		TiffDirectoryIndex::instance().store(file_path, dir_offsets);
+	}
+	
 	return ImageMetadataLoader::LOADED;
 }
 
+static inline uint32 sampleToByte(uint8 const sample)
+{
+	return sample;
+}
+
+static inline uint32 sampleToByte(uint16 const sample)
+{
+	return (sample * 255u + 32767u) / 65535u;
+}
+
+template<typename Sample, int ColorSamples, bool Alpha>
+static void convertNativeLine(Sample const* src, uint32* dst, int const count)
+{
+	int const samples_per_pixel = ColorSamples + (Alpha ? 1 : 0);
+	for (int i = 0; i < count; ++i, src += samples_per_pixel) {
+		uint32 const r = sampleToByte(src[0]);
+		uint32 const g = ColorSamples == 3 ? sampleToByte(src[1]) : r;
+		uint32 const b = ColorSamples == 3 ? sampleToByte(src[2]) : r;
+		uint32 const a = Alpha ? sampleToByte(src[ColorSamples]) : 0xFF;
+		dst[i] = (a << 24) | (r << 16) | (g << 8) | b;
+	}
+}
+
+template<typename Sample>
+static void convertNativeLine(
+	uint8 const* src, uint32* dst, int const count, bool const gray, bool const alpha)
+{
+	Sample const* typed_src = reinterpret_cast<Sample const*>(src);
+	if (gray) {
+		if (alpha) {
+			convertNativeLine<Sample, 1, true>(typed_src, dst, count);
+		} else {
+			convertNativeLine<Sample, 1, false>(typed_src, dst, count);
+		}
+	} else {
+		if (alpha) {
+			convertNativeLine<Sample, 3, true>(typed_src, dst, count);
+		} else {
+			convertNativeLine<Sample, 3, false>(typed_src, dst, count);
+		}
+	}
+}
+
+/**
+ * Images smaller than this are not worth involving other threads for.
+ */
+static int const MIN_PIXELS_FOR_PARALLEL_DECODING = 1 << 20;
+
+
+TiffReader::ChunkDecodingJob::ChunkDecodingJob(
+	TiffInfo const& info, ChunkLayout const& layout, QImage& image)
+:	m_rInfo(info),
+	m_rLayout(layout),
+	m_pImageBits(image.bits()),
+	m_imageBpl(image.bytesPerLine()),
+	m_nextChunk(0),
+	m_originalHandleClaimed(0),
+	m_failed(0)
+{
+}
+
+void
+TiffReader::ChunkDecodingJob::run(TiffHandle const& tif)
+{
+	TiffBuffer<uint8> buf(m_rLayout.chunk_bytes);
+	
+	while (!failed()) {
+		uint32 const chunk = m_nextChunk.fetchAndAddRelaxed(1);
+		if (chunk >= m_rLayout.num_chunks) {
+			break;
+		}
+		
+		if (!decodeChunk(tif, m_rInfo, m_rLayout, chunk, buf.data(), m_pImageBits, m_imageBpl)) {
+			markFailed();
+		}
+	}
+}
+
+
+void
+TiffReader::ChunkDecodingParticipant::operator()(int begin, int const end) const
+{
+	try {
+		for (; begin < end; ++begin) {
+			if (!m_pJob->hasUnclaimedChunks()) {
+				// Don't bother opening the file.
+				break;
+			}
+			if (m_pJob->claimOriginalHandle()) {
+				m_pJob->run(*m_pOriginalTif);
+			} else {
+				runWithOwnHandle();
+			}
+		}
+	} catch (std::bad_alloc const&) {
+		// Stop the other participants, then let parallelFor() re-throw.
+		m_pJob->markFailed();
+		throw;
+	}
+}
+
+void
+TiffReader::ChunkDecodingParticipant::runWithOwnHandle() const
+{
+	QFile file(m_filePath);
+	if (!file.open(QIODevice::ReadOnly)) {
+		// Not fatal, as the remaining participants will decode our share.
+		return;
+	}
+	
+	TiffHandle tif(
+		TIFFClientOpen(
+			"file", "rBm", &file, &deviceRead, &deviceWrite,
+			&deviceSeek, &deviceClose, &deviceSize,
+			&deviceMap, &deviceUnmap
+		)
+	);
+	if (!tif.handle() || !setPage(tif, m_filePath, m_pageNum)) {
+		return;
+	}
+	
+	// Make sure we are looking at the same thing as the original handle.
+	uint32 width = 0, height = 0;
+	TIFFGetField(tif.handle(), TIFFTAG_IMAGEWIDTH, &width);
+	TIFFGetField(tif.handle(), TIFFTAG_IMAGELENGTH, &height);
+	if ((int)width != m_pJob->info().width || (int)height != m_pJob->info().height) {
+		return;
+	}
+	if (!ChunkLayout(tif, m_pJob->info()).isCompatibleWith(m_pJob->layout())) {
+		return;
+	}
+	
+	m_pJob->run(tif);
+}
+
+
 static void convertAbgrToArgb(uint32 const* src, uint32* dst, int count)
 {
 	for (int i = 0; i < count; ++i) {
@@ -304,10 +648,24 @@ TiffReader::readImage(QIODevice& device, int const page_num)
 		return QImage();
 	}
 	
-	if (!TIFFSetDirectory(tif.handle(), page_num)) {
+	QString const file_path(filePathOf(device));
+	if (!setPage(tif, file_path, page_num)) {
 		return QImage();
 	}
 	
+	if (page_num == 0 && isMrcTextLayer(tif)) {
+		QImage const text(readCurrentPage(tif, header, file_path, 0));
+		return readMrcLayers(tif, header, file_path, text);
+	}
+	
+	return readCurrentPage(tif, header, file_path, page_num);
+}
+
+QImage
+TiffReader::readCurrentPage(
+	TiffHandle const& tif, TiffHeader const& header,
+	QString const& file_path, int const page_num)
+{
 	TiffInfo const info(tif, header);
 	
 	ImageMetadata const metadata(currentPageMetadata(tif));
@@ -318,43 +676,13 @@ TiffReader::readImage(QIODevice& device, int const page_num)
 		// Common case optimization.
 		image = extractBinaryOrIndexed8Image(tif, info);
 	} else {
-		// General case.
-		image = QImage(
-			info.width, info.height,
-			info.samples_per_pixel == 3
-			? QImage::Format_RGB32 : QImage::Format_ARGB32
-		);
-		if (image.isNull()) {
-			throw std::bad_alloc();
-		}
-
-		// For ABGR -> ARGB conversion.
-		TiffBuffer<uint32> tmp_buffer;
-		uint32 const* src_line = 0;
-
-		if (image.bytesPerLine() == 4 * info.width) {
-			// We can avoid creating a temporary buffer in this case.
-			if (!TIFFReadRGBAImageOriented(tif.handle(), info.width, info.height,
-			                               (uint32*)image.bits(), ORIENTATION_TOPLEFT, 0)) {
-				return QImage();
-			}
-			src_line = (uint32 const*)image.bits();
-		} else {
-			TiffBuffer<uint32>(info.width * info.height).swap(tmp_buffer);
-			if (!TIFFReadRGBAImageOriented(tif.handle(), info.width, info.height,
-				                           tmp_buffer.data(), ORIENTATION_TOPLEFT, 0)) {
-				return QImage();
-			}
-			src_line = tmp_buffer.data();
+		if (info.mapsToNativeColor()) {
+			// Another common case: colour scans.
+			image = extractNativeColorImage(tif, info, file_path, page_num);
 		}
-		
-		uint32* dst_line = (uint32*)image.bits();
-		assert(image.bytesPerLine() % 4 == 0);
-		int const dst_stride = image.bytesPerLine() / 4;
-		for (int y = 0; y < info.height; ++y) {
-			convertAbgrToArgb(src_line, dst_line, info.width);
-			src_line += info.width;
-			dst_line += dst_stride;
+		if (image.isNull()) {
+			// General case.
+			image = extractRgbaImage(tif, info);
 		}
 	}
 	
@@ -367,6 +695,42 @@ TiffReader::readImage(QIODevice& device, int const page_num)
 	return image;
 }
 
+QImage
+TiffReader::readMrcLayers(
+	TiffHandle const& tif, TiffHeader const& header,
+	QString const& file_path, QImage const& text)
+{
+	if (text.isNull() || !TIFFReadDirectory(tif.handle())) {
+		return QImage();
+	}
+	QImage const mask(readCurrentPage(tif, header, file_path, 1));
+	
+	if (mask.isNull() || !TIFFReadDirectory(tif.handle())) {
+		return QImage();
+	}
+	QImage const background(readCurrentPage(tif, header, file_path, 2));
+	
+	if (background.isNull() || mask.size() != text.size()) {
+		return QImage();
+	}
+	
+	MrcLayers const layers(
+		imageproc::BinaryImage(text), imageproc::BinaryImage(mask),
+		background, Dpm(text)
+	);
+	return layers.compose();
+}
+
+bool
+TiffReader::isMrcTextLayer(TiffHandle const& tif)
+{
+	char const* page_name = 0;
+	if (!TIFFGetField(tif.handle(), TIFFTAG_PAGENAME, &page_name) || !page_name) {
+		return false;
+	}
+	return strcmp(page_name, "mrc-text") == 0;
+}
+
 TiffReader::TiffHeader
 TiffReader::readHeader(QIODevice& device)
 {
@@ -389,6 +753,51 @@ TiffReader::readHeader(QIODevice& device)
 	}
 }
 
+QString
+TiffReader::filePathOf(QIODevice const& device)
+{
+	if (QFile const* file = qobject_cast<QFile const*>(&device)) {
+		return file->fileName();
+	}
+	return QString();
+}
+
+bool
+TiffReader::setPage(TiffHandle const& tif, QString const& file_path, int const page_num)
+{
+	if (page_num == 0) {
+		// TIFFClientOpen() has already read the first directory.
+		return true;
+	}
+	
+	if (file_path.isEmpty()) {
+		// Can't index what we can't identify.
+		return TIFFSetDirectory(tif.handle(), page_num);
+	}
+	
+	TiffDirectoryIndex& index = TiffDirectoryIndex::instance();
+	
+	quint64 offset = 0;
+	if (index.lookup(file_path, page_num, offset)) {
+		return TIFFSetSubDirectory(tif.handle(), (toff_t)offset);
+	}
+	
+	// Walk the IFD chain once, indexing every directory on the way,
+	// so that subsequent requests for any page don't have to.
+	std::vector<quint64> dir_offsets;
+	do {
+		dir_offsets.push_back(TIFFCurrentDirOffset(tif.handle()));
+	} while (TIFFReadDirectory(tif.handle()));
+	
+	index.store(file_path, dir_offsets);
+	
+	if (page_num >= (int)dir_offsets.size()) {
+		return false;
+	}
+	
+	return TIFFSetSubDirectory(tif.handle(), (toff_t)dir_offsets[page_num]);
+}
+
 bool
 TiffReader::checkHeader(TiffHeader const& header)
 {
@@ -493,6 +902,141 @@ TiffReader::extractBinaryOrIndexed8Image(
 	return image;
 }
 
+QImage
+TiffReader::extractNativeColorImage(
+	TiffHandle const& tif, TiffInfo const& info,
+	QString const& file_path, int const page_num)
+{
+	ChunkLayout const layout(tif, info);
+	if (!layout.isValid()) {
+		return QImage();
+	}
+	
+	QImage::Format format = QImage::Format_RGB32;
+	if (info.alpha == EXTRASAMPLE_ASSOCALPHA) {
+		format = QImage::Format_ARGB32_Premultiplied;
+	} else if (info.alpha == EXTRASAMPLE_UNASSALPHA) {
+		format = QImage::Format_ARGB32;
+	}
+	
+	QImage image(info.width, info.height, format);
+	if (image.isNull()) {
+		throw std::bad_alloc();
+	}
+	
+	ChunkDecodingJob job(info, layout, image);
+	
+	// Strips and tiles are independent, so we let ThreadPool threads
+	// help decoding them, each through a TIFF handle of its own.
+	// That's only possible if we know which file to open.
+	int num_participants = 1;
+	if (!file_path.isEmpty() && qint64(info.width) * info.height >= MIN_PIXELS_FOR_PARALLEL_DECODING) {
+		num_participants = std::min<int>(
+			ThreadPool::instance().maxThreads(), layout.num_chunks
+		);
+	}
+	
+	if (num_participants > 1) {
+		parallelFor(
+			num_participants, 1,
+			ChunkDecodingParticipant(job, tif, file_path, page_num)
+		);
+	} else {
+		job.run(tif);
+	}
+	
+	if (job.failed()) {
+		return QImage();
+	}
+	
+	return image;
+}
+
+bool
+TiffReader::decodeChunk(
+	TiffHandle const& tif, TiffInfo const& info, ChunkLayout const& layout,
+	uint32 const chunk, uint8* buf, uchar* image_bits, int const image_bpl)
+{
+	uint32 const x0 = (chunk % layout.chunks_across) * layout.chunk_width;
+	uint32 const y0 = (chunk / layout.chunks_across) * layout.chunk_height;
+	if (x0 >= (uint32)info.width || y0 >= (uint32)info.height) {
+		return true;
+	}
+	
+	tsize_t res = -1;
+	if (layout.tiled) {
+		res = TIFFReadEncodedTile(tif.handle(), chunk, buf, layout.chunk_bytes);
+	} else {
+		res = TIFFReadEncodedStrip(tif.handle(), chunk, buf, layout.chunk_bytes);
+	}
+	if (res < 0) {
+		return false;
+	}
+	
+	int const cols = std::min<uint32>(layout.chunk_width, info.width - x0);
+	int const rows = std::min<uint32>(layout.chunk_height, info.height - y0);
+	bool const gray = info.photometric == PHOTOMETRIC_MINISBLACK;
+	bool const alpha = info.alpha != EXTRASAMPLE_UNSPECIFIED;
+	
+	uint8 const* src_line = buf;
+	uchar* dst_line = image_bits + y0 * image_bpl + x0 * 4;
+	for (int y = 0; y < rows; ++y) {
+		if (info.bits_per_sample == 8) {
+			convertNativeLine<uint8>(src_line, (uint32*)dst_line, cols, gray, alpha);
+		} else {
+			convertNativeLine<uint16>(src_line, (uint32*)dst_line, cols, gray, alpha);
+		}
+		src_line += layout.row_bytes;
+		dst_line += image_bpl;
+	}
+	
+	return true;
+}
+
+QImage
+TiffReader::extractRgbaImage(TiffHandle const& tif, TiffInfo const& info)
+{
+	QImage image(
+		info.width, info.height,
+		info.samples_per_pixel == 3
+		? QImage::Format_RGB32 : QImage::Format_ARGB32
+	);
+	if (image.isNull()) {
+		throw std::bad_alloc();
+	}
+
+	// For ABGR -> ARGB conversion.
+	TiffBuffer<uint32> tmp_buffer;
+	uint32 const* src_line = 0;
+
+	if (image.bytesPerLine() == 4 * info.width) {
+		// We can avoid creating a temporary buffer in this case.
+		if (!TIFFReadRGBAImageOriented(tif.handle(), info.width, info.height,
+		                               (uint32*)image.bits(), ORIENTATION_TOPLEFT, 0)) {
+			return QImage();
+		}
+		src_line = (uint32 const*)image.bits();
+	} else {
+		TiffBuffer<uint32>(info.width * info.height).swap(tmp_buffer);
+		if (!TIFFReadRGBAImageOriented(tif.handle(), info.width, info.height,
+			                           tmp_buffer.data(), ORIENTATION_TOPLEFT, 0)) {
+			return QImage();
+		}
+		src_line = tmp_buffer.data();
+	}
+	
+	uint32* dst_line = (uint32*)image.bits();
+	assert(image.bytesPerLine() % 4 == 0);
+	int const dst_stride = image.bytesPerLine() / 4;
+	for (int y = 0; y < info.height; ++y) {
+		convertAbgrToArgb(src_line, dst_line, info.width);
+		src_line += info.width;
+		dst_line += dst_stride;
+	}
+	
+	return image;
+}
+
 void
 TiffReader::readLines(TiffHandle const& tif, QImage& image)
 {
@@ -24,6 +24,7 @@
 
 class QIODevice;
 class QImage;
+class QString;
 class ImageMetadata;
 class Dpi;
 
@@ -50,19 +51,61 @@ private:
 	class TiffHeader;
 	class TiffHandle;
 	struct TiffInfo;
+	struct ChunkLayout;
+	class ChunkDecodingJob;
+	class ChunkDecodingParticipant;
 	template<typename T> class TiffBuffer;
 	
 	static TiffHeader readHeader(QIODevice& device);
 	
 	static bool checkHeader(TiffHeader const& header);
 	
+	/**
+	 * Returns the file path if the device is a QFile, or a null string otherwise.
+	 */
+	static QString filePathOf(QIODevice const& device);
+	
+	/**
+	 * Makes \p page_num the current directory, using and maintaining
+	 * TiffDirectoryIndex when the file path is known.
+	 */
+	static bool setPage(TiffHandle const& tif, QString const& file_path, int page_num);
+	
 	static ImageMetadata currentPageMetadata(TiffHandle const& tif);
 	
+	/**
+	 * Returns true if the current directory is the text layer
+	 * of a file written by TiffWriter::writeMrcImage().
+	 */
+	static bool isMrcTextLayer(TiffHandle const& tif);
+	
+	static QImage readCurrentPage(
+		TiffHandle const& tif, TiffHeader const& header,
+		QString const& file_path, int page_num);
+	
+	/**
+	 * Reads the mask and background layers following the text layer,
+	 * and composes all three into a single image.
+	 */
+	static QImage readMrcLayers(
+		TiffHandle const& tif, TiffHeader const& header,
+		QString const& file_path, QImage const& text);
+	
 	static Dpi getDpi(float xres, float yres, unsigned res_unit);
 	
 	static QImage extractBinaryOrIndexed8Image(
 		TiffHandle const& tif, TiffInfo const& info);
 	
+	static QImage extractNativeColorImage(
+		TiffHandle const& tif, TiffInfo const& info,
+		QString const& file_path, int page_num);
+	
+	static bool decodeChunk(
+		TiffHandle const& tif, TiffInfo const& info, ChunkLayout const& layout,
+		unsigned chunk, unsigned char* buf, unsigned char* image_bits, int image_bpl);
+	
+	static QImage extractRgbaImage(TiffHandle const& tif, TiffInfo const& info);
+	
 	static void readLines(TiffHandle const& tif, QImage& image);
 	
 	static void readAndUnpackLines(
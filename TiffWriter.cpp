@@ -18,6 +18,8 @@
 
 #include "TiffWriter.h"
 #include "Dpm.h"
+#include "MrcLayers.h"
+#include "imageproc/BinaryImage.h"
 #include "imageproc/Constants.h"
 #include <QtGlobal>
 #include <QFile>
@@ -28,6 +30,7 @@
 #include <QSize>
 #include <QDebug>
 #include <vector>
+#include <algorithm>
 #include <tiff.h>
 #include <tiffio.h>
 #include <string.h>
@@ -142,6 +145,17 @@ static void deviceUnmap(thandle_t, tdata_t, toff_t)
 	// Not implemented.
 }
 
+static TIFF* openForWriting(QIODevice& device)
+{
+	return TIFFClientOpen(
+		// Libtiff seems to be buggy with L or H flags,
+		// so we use B.
+		"file", "wBm", &device, &deviceRead, &deviceWrite,
+		&deviceSeek, &deviceClose, &deviceSize,
+		&deviceMap, &deviceUnmap
+	);
+}
+
 bool
 TiffWriter::writeImage(QString const& file_path, QImage const& image)
 {
@@ -176,15 +190,7 @@ TiffWriter::writeImage(QIODevice& device, QImage const& image)
 		return false;
 	}
 	
-	TiffHandle tif(
-		TIFFClientOpen(
-			// Libtiff seems to be buggy with L or H flags,
-			// so we use B.
-			"file", "wBm", &device, &deviceRead, &deviceWrite,
-			&deviceSeek, &deviceClose, &deviceSize,
-			&deviceMap, &deviceUnmap
-		)
-	);
+	TiffHandle tif(openForWriting(device));
 	if (!tif.handle()) {
 		return false;
 	}
@@ -214,6 +220,59 @@ TiffWriter::writeImage(QIODevice& device, QImage const& image)
 	}
 }
 
+bool
+TiffWriter::writeMrcImage(QString const& file_path, MrcLayers const& layers)
+{
+	if (layers.isNull()) {
+		return false;
+	}
+	
+	QFile file(file_path);
+	if (!file.open(QFile::WriteOnly)) {
+		return false;
+	}
+	
+	if (!writeMrcImage(file, layers)) {
+		file.remove();
+		return false;
+	}
+	
+	return true;
+}
+
+bool
+TiffWriter::writeMrcImage(QIODevice& device, MrcLayers const& layers)
+{
+	if (layers.isNull()) {
+		return false;
+	}
+	if (!device.isWritable()) {
+		return false;
+	}
+	if (device.isSequential()) {
+		// libtiff needs to be able to seek.
+		return false;
+	}
+	
+	TiffHandle tif(openForWriting(device));
+	if (!tif.handle()) {
+		return false;
+	}
+	
+	if (!writeMrcBinaryLayer(tif, layers.text(), layers.dpm(), "mrc-text")
+			|| !TIFFWriteDirectory(tif.handle())) {
+		return false;
+	}
+	
+	if (!writeMrcBinaryLayer(tif, layers.mask(), layers.dpm(), "mrc-mask")
+			|| !TIFFWriteDirectory(tif.handle())) {
+		return false;
+	}
+	
+	// The last directory is written by TIFFClose().
+	return writeMrcBackgroundLayer(tif, layers.background());
+}
+
 /**
  * Set the physical resolution, if it's defined.
  */
@@ -463,3 +522,121 @@ TiffWriter::writeBinaryLinesReversed(
 	
 	return true;
 }
+
+bool
+TiffWriter::writeMrcBinaryLayer(
+	TiffHandle const& tif, imageproc::BinaryImage const& image,
+	Dpm const& dpm, char const* const page_name)
+{
+	int const width = image.width();
+	int const height = image.height();
+	
+	TIFFSetField(tif.handle(), TIFFTAG_IMAGEWIDTH, uint32(width));
+	TIFFSetField(tif.handle(), TIFFTAG_IMAGELENGTH, uint32(height));
+	TIFFSetField(tif.handle(), TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
+	TIFFSetField(tif.handle(), TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, uint16(1));
+	TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, uint16(1));
+	TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISWHITE);
+	TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, COMPRESSION_CCITTFAX4);
+	TIFFSetField(tif.handle(), TIFFTAG_ROWSPERSTRIP, uint32(height));
+	TIFFSetField(tif.handle(), TIFFTAG_PAGENAME, page_name);
+	setDpm(tif, dpm);
+	
+	// BinaryImage keeps pixels in native words, with the leftmost pixel
+	// in the most significant bit, while libtiff wants them in bytes.
+	int const bpl = (width + 7) / 8;
+	int const wpl = image.wordsPerLine();
+	std::vector<uint8_t> tmp_line(wpl * 4, 0);
+	uint32_t const* src_line = image.data();
+	
+	for (int y = 0; y < height; ++y, src_line += wpl) {
+		for (int i = 0; i < wpl; ++i) {
+			uint32_t const word = src_line[i];
+			tmp_line[i * 4] = static_cast<uint8_t>(word >> 24);
+			tmp_line[i * 4 + 1] = static_cast<uint8_t>(word >> 16);
+			tmp_line[i * 4 + 2] = static_cast<uint8_t>(word >> 8);
+			tmp_line[i * 4 + 3] = static_cast<uint8_t>(word);
+		}
+		std::fill(tmp_line.begin() + bpl, tmp_line.end(), 0);
+		if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1) {
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+bool
+TiffWriter::writeMrcBackgroundLayer(TiffHandle const& tif, QImage const& image)
+{
+	bool const gray = image.format() == QImage::Format_Indexed8;
+	assert(gray || image.format() == QImage::Format_RGB32);
+	
+	int const width = image.width();
+	int const height = image.height();
+	
+	TIFFSetField(tif.handle(), TIFFTAG_SUBFILETYPE, uint32(FILETYPE_REDUCEDIMAGE));
+	TIFFSetField(tif.handle(), TIFFTAG_IMAGEWIDTH, uint32(width));
+	TIFFSetField(tif.handle(), TIFFTAG_IMAGELENGTH, uint32(height));
+	TIFFSetField(tif.handle(), TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
+	TIFFSetField(tif.handle(), TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, uint16(gray ? 1 : 3));
+	TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, uint16(8));
+	TIFFSetField(tif.handle(), TIFFTAG_PAGENAME, "mrc-background");
+	setDpm(tif, Dpm(image));
+	
+	if (TIFFIsCODECConfigured(COMPRESSION_JPEG)) {
+		TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, COMPRESSION_JPEG);
+		TIFFSetField(tif.handle(), TIFFTAG_JPEGQUALITY, 75);
+		if (gray) {
+			TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+		} else {
+			// Store YCbCr with subsampled chroma, but let libjpeg
+			// do the conversion from the RGB samples we feed it.
+			// JPEGCOLORMODE is a codec pseudo-tag, so it has to
+			// follow setting the compression.
+			TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_YCBCR);
+			TIFFSetField(tif.handle(), TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB);
+		}
+		// JPEG wants strips made of whole MCUs, which are 16 rows
+		// tall with 2x2 chroma subsampling.
+		uint32 const rows = (TIFFDefaultStripSize(tif.handle(), 0) + 15) & ~uint32(15);
+		TIFFSetField(tif.handle(), TIFFTAG_ROWSPERSTRIP, rows);
+	} else {
+		TIFFSetField(
+			tif.handle(), TIFFTAG_PHOTOMETRIC,
+			gray ? PHOTOMETRIC_MINISBLACK : PHOTOMETRIC_RGB
+		);
+		if (TIFFIsCODECConfigured(COMPRESSION_ADOBE_DEFLATE)) {
+			TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+			TIFFSetField(tif.handle(), TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+		} else {
+			TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+		}
+	}
+	
+	if (gray) {
+		return write8bitLines(tif, image);
+	}
+	
+	std::vector<uint8_t> tmp_line(width * 3);
+	
+	for (int y = 0; y < height; ++y) {
+		uint32_t const* p_src = (uint32_t const*)image.scanLine(y);
+		uint8_t* p_dst = &tmp_line[0];
+		for (int x = 0; x < width; ++x) {
+			uint32_t const ARGB = *p_src;
+			p_dst[0] = static_cast<uint8_t>(ARGB >> 16);
+			p_dst[1] = static_cast<uint8_t>(ARGB >> 8);
+			p_dst[2] = static_cast<uint8_t>(ARGB);
+			++p_src;
+			p_dst += 3;
+		}
+		if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1) {
+			return false;
+		}
+	}
+	
+	return true;
+}
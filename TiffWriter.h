@@ -26,6 +26,12 @@ class QIODevice;
 class QString;
 class QImage;
 class Dpm;
+class MrcLayers;
+
+namespace imageproc
+{
+	class BinaryImage;
+}
 
 class TiffWriter
 {
@@ -48,6 +54,20 @@ public:
 	 * \return True on success, false on failure.
 	 */
 	static bool writeImage(QIODevice& device, QImage const& image);
+	
+	/**
+	 * \brief Writes Mixed Raster Content layers as a 3-page TIFF.
+	 *
+	 * The first page is the text layer and the second one is the mask,
+	 * both at full resolution and G4-compressed.  The third page is the
+	 * background, JPEG-compressed if libtiff supports that, and marked
+	 * as a reduced resolution image.  Pages are named "mrc-text",
+	 * "mrc-mask" and "mrc-background", which is how TiffReader recognizes
+	 * such files and puts the layers back together.
+	 */
+	static bool writeMrcImage(QString const& file_path, MrcLayers const& layers);
+	
+	static bool writeMrcImage(QIODevice& device, MrcLayers const& layers);
 private:
 	class TiffHandle;
 	
@@ -71,6 +91,13 @@ private:
 	static bool writeBinaryLinesReversed(
 		TiffHandle const& tif, QImage const& image);
 	
+	static bool writeMrcBinaryLayer(
+		TiffHandle const& tif, imageproc::BinaryImage const& image,
+		Dpm const& dpm, char const* page_name);
+	
+	static bool writeMrcBackgroundLayer(
+		TiffHandle const& tif, QImage const& image);
+	
 	static uint8_t const m_reverseBitsLUT[256];
 };
 
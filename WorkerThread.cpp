@@ -66,11 +66,15 @@ class WorkerThread::Impl : public QThread
 public:
 	enum { NormalExit = 0, ExitForRestart };
 
-	Impl(WorkerThread& owner);
+	Impl(WorkerThread& owner, ThreadPriority const* fixed_priority);
 	
 	~Impl();
 	
 	void performTask(BackgroundTaskPtr const& task);
+	
+	ThreadPriority const* fixedPriority() const {
+		return m_hasFixedPriority ? &m_fixedPriority : 0;
+	}
 protected:
 	virtual void run();
 	
@@ -82,6 +86,8 @@ private:
 
 	WorkerThread& m_rOwner;
 	Dispatcher m_dispatcher;
+	ThreadPriority m_fixedPriority;
+	bool m_hasFixedPriority;
 	bool m_threadStarted;
 };
 
@@ -115,7 +121,13 @@ private:
 
 WorkerThread::WorkerThread(QObject* parent)
 :	QObject(parent),
-	m_ptrImpl(new Impl(*this))
+	m_ptrImpl(new Impl(*this, 0))
+{
+}
+
+WorkerThread::WorkerThread(ThreadPriority const fixed_priority, QObject* parent)
+:	QObject(parent),
+	m_ptrImpl(new Impl(*this, &fixed_priority))
 {
 }
 
@@ -162,7 +174,9 @@ WorkerThread::Dispatcher::updateThreadPriority(BackgroundTask const& task)
 			"settings/batch_processing_priority", ThreadPriority::Normal
 		)
 	);
-	if (task.type() == task.INTERACTIVE) {
+	if (ThreadPriority const* fixed_prio = m_rOwner.fixedPriority()) {
+		prio = *fixed_prio;
+	} else if (task.type() == task.INTERACTIVE) {
 		prio.setValue(ThreadPriority::Normal);
 	}
 	
@@ -252,9 +266,11 @@ WorkerThread::Dispatcher::processTask(BackgroundTaskPtr const& task)
 
 /*========================== WorkerThread::Impl ============================*/
 
-WorkerThread::Impl::Impl(WorkerThread& owner)
+WorkerThread::Impl::Impl(WorkerThread& owner, ThreadPriority const* fixed_priority)
 :	m_rOwner(owner),
 	m_dispatcher(*this),
+	m_fixedPriority(fixed_priority ? *fixed_priority : ThreadPriority::Normal),
+	m_hasFixedPriority(fixed_priority != 0),
 	m_threadStarted(false)
 {
 	m_dispatcher.moveToThread(this);
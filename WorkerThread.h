@@ -22,6 +22,7 @@
 #include "NonCopyable.h"
 #include "BackgroundTask.h"
 #include "FilterResult.h"
+#include "ThreadPriority.h"
 #include <QObject>
 #include <memory>
 
@@ -32,6 +33,14 @@ class WorkerThread : public QObject
 public:	
 	WorkerThread(QObject* parent = 0);
 	
+	/**
+	 * \brief Creates a worker running all tasks at the given priority.
+	 *
+	 * By default, batch tasks run at the priority chosen by the user
+	 * and interactive ones at normal priority.
+	 */
+	WorkerThread(ThreadPriority fixed_priority, QObject* parent = 0);
+	
 	~WorkerThread();
 	
 	/**
@@ -141,7 +141,19 @@ QPointF
 CylindricalSurfaceDewarper::mapToDewarpedSpace(QPointF const& img_pt) const
 {
 	State state;
+	return mapToDewarpedSpace(img_pt, state);
+}
+
+QPointF
+CylindricalSurfaceDewarper::mapToWarpedSpace(QPointF const& crv_pt) const
+{
+	State state;
+	return mapToWarpedSpace(crv_pt, state);
+}
 
+QPointF
+CylindricalSurfaceDewarper::mapToDewarpedSpace(QPointF const& img_pt, State& state) const
+{
 	double const pln_x = m_img2pln(img_pt)[0];
 	double const crv_x = m_arcLengthMapper.xToArcLen(pln_x, state.m_arcLengthHint);
 
@@ -179,13 +191,39 @@ CylindricalSurfaceDewarper::mapToDewarpedSpace(QPointF const& img_pt) const
 }
 
 QPointF
-CylindricalSurfaceDewarper::mapToWarpedSpace(QPointF const& crv_pt) const
+CylindricalSurfaceDewarper::mapToWarpedSpace(QPointF const& crv_pt, State& state) const
 {
-	State state;
 	Generatrix const gtx(mapGeneratrix(crv_pt.x(), state));
 	return gtx.imgLine.pointAt(gtx.pln2img(crv_pt.y()));
 }
 
+void
+CylindricalSurfaceDewarper::mapPointsToDewarpedSpace(
+	QPointF const* img_pts, QPointF* crv_pts, int const num_pts) const
+{
+	State state;
+	for (int i = 0; i < num_pts; ++i) {
+		crv_pts[i] = mapToDewarpedSpace(img_pts[i], state);
+	}
+}
+
+void
+CylindricalSurfaceDewarper::mapPointsToWarpedSpace(
+	QPointF const* crv_pts, QPointF* img_pts, int const num_pts) const
+{
+	State state;
+	int i = 0;
+	while (i < num_pts) {
+		// Consecutive points on the same generatrix share its mapping.
+		double const crv_x = crv_pts[i].x();
+		Generatrix const gtx(mapGeneratrix(crv_x, state));
+		do {
+			img_pts[i] = gtx.imgLine.pointAt(gtx.pln2img(crv_pts[i].y()));
+			++i;
+		} while (i < num_pts && crv_pts[i].x() == crv_x);
+	}
+}
+
 HomographicTransform<2, double>
 CylindricalSurfaceDewarper::calcPlnToImgHomography(
 	std::vector<QPointF> const& img_directrix1,
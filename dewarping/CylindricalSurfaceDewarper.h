@@ -88,6 +88,44 @@ public:
 	 * systems we owork with.
 	 */
 	QPointF mapToWarpedSpace(QPointF const& crv_pt) const;
+
+	/**
+	 * \brief Same as mapToDewarpedSpace(QPointF const&), but reuses
+	 *        the search hints in \p state.
+	 *
+	 * Passing the same state while mapping nearby points saves
+	 * most of the searching.
+	 */
+	QPointF mapToDewarpedSpace(QPointF const& img_pt, State& state) const;
+
+	/**
+	 * \brief Same as mapToWarpedSpace(QPointF const&), but reuses
+	 *        the search hints in \p state.
+	 */
+	QPointF mapToWarpedSpace(QPointF const& crv_pt, State& state) const;
+
+	/**
+	 * \brief Maps an array of points to dewarped normalized coordinates.
+	 *
+	 * The result is the same as calling mapToDewarpedSpace() for every
+	 * point, but the search hints stay warm from one point to the next,
+	 * which pays off when consecutive points are close to each other,
+	 * as is the case with polygon vertices.
+	 * \p img_pts and \p crv_pts may point to the same array.
+	 */
+	void mapPointsToDewarpedSpace(
+		QPointF const* img_pts, QPointF* crv_pts, int num_pts) const;
+
+	/**
+	 * \brief Maps an array of points to warped image coordinates.
+	 *
+	 * Like mapPointsToDewarpedSpace(), plus consecutive points having
+	 * the same X coordinate share a single generatrix, so a grid
+	 * is best passed one column after another.
+	 * \p crv_pts and \p img_pts may point to the same array.
+	 */
+	void mapPointsToWarpedSpace(
+		QPointF const* crv_pts, QPointF* img_pts, int num_pts) const;
 private:
 	class CoupledPolylinesIterator;
 	
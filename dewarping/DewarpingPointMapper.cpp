@@ -73,4 +73,40 @@ DewarpingPointMapper::mapToWarpedSpace(QPointF const& dewarped_pt) const
 	return m_dewarper.mapToWarpedSpace(QPointF(crv_x, crv_y));
 }
 
+QPolygonF
+DewarpingPointMapper::mapPolygonToDewarpedSpace(QPolygonF const& warped_poly) const
+{
+	QPolygonF dewarped_poly(warped_poly.size());
+	m_dewarper.mapPointsToDewarpedSpace(
+		warped_poly.constData(), dewarped_poly.data(), warped_poly.size()
+	);
+
+	for (QPointF* pt = dewarped_poly.begin(); pt != dewarped_poly.end(); ++pt) {
+		pt->setX(pt->x() * m_modelXScaleFromNormalized + m_modelDomainLeft);
+		pt->setY(pt->y() * m_modelYScaleFromNormalized + m_modelDomainTop);
+	}
+
+	return dewarped_poly;
+}
+
+QPolygonF
+DewarpingPointMapper::mapPolygonToWarpedSpace(QPolygonF const& dewarped_poly) const
+{
+	QPolygonF warped_poly(dewarped_poly.size());
+	for (int i = 0; i < dewarped_poly.size(); ++i) {
+		QPointF const& pt = dewarped_poly[i];
+		warped_poly[i] = QPointF(
+			(pt.x() - m_modelDomainLeft) * m_modelXScaleToNormalized,
+			(pt.y() - m_modelDomainTop) * m_modelYScaleToNormalized
+		);
+	}
+
+	// Map in place.
+	m_dewarper.mapPointsToWarpedSpace(
+		warped_poly.constData(), warped_poly.data(), warped_poly.size()
+	);
+
+	return warped_poly;
+}
+
 } // namespace dewarping
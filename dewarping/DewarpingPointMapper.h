@@ -20,6 +20,7 @@
 #define DEWARPING_DEWARPING_POINT_MAPPER_H_
 
 #include "CylindricalSurfaceDewarper.h"
+#include <QPolygonF>
 
 class QRect;
 class QTransform;
@@ -50,6 +51,18 @@ public:
 	 * from normalized dewarped coordinates.
 	 */
 	QPointF mapToWarpedSpace(QPointF const& dewarped_pt) const;
+
+	/**
+	 * Maps every vertex of a polygon with mapToDewarpedSpace(),
+	 * using the much faster batch mapping of CylindricalSurfaceDewarper.
+	 */
+	QPolygonF mapPolygonToDewarpedSpace(QPolygonF const& warped_poly) const;
+
+	/**
+	 * Maps every vertex of a polygon with mapToWarpedSpace(),
+	 * using the much faster batch mapping of CylindricalSurfaceDewarper.
+	 */
+	QPolygonF mapPolygonToWarpedSpace(QPolygonF const& dewarped_poly) const;
 private:
 	CylindricalSurfaceDewarper m_dewarper;
 	double m_modelDomainLeft;
@@ -0,0 +1,268 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DEWARPING_DIRECTIONAL_PATH_SEARCH_H_
+#define DEWARPING_DIRECTIONAL_PATH_SEARCH_H_
+
+#include "Grid.h"
+#include "VecNT.h"
+#include "PriorityQueue.h"
+#include <stdint.h>
+#include <algorithm>
+#include <stddef.h>
+#include <math.h>
+#include <assert.h>
+
+namespace dewarping
+{
+
+/**
+ * \brief Minimax paths over a grid, where every step has to make
+ *        progress in a given direction.
+ *
+ * The cost of a path is the highest step cost of the nodes it leaves.
+ * Every node ends up with the cost of the cheapest path leading
+ * to it from any of the source nodes, and a link to the previous node
+ * on that path.
+ *
+ * Neighbours are indexed like this:
+ * \code
+ * 0 1 2
+ * 3   4
+ * 5 6 7
+ * \endcode
+ * Only those neighbours whose direction makes a positive dot product
+ * with the propagation direction may be stepped on.  That makes the
+ * graph acyclic, which is what makes propagateWavefront() possible.
+ *
+ * \tparam Node Has to provide the following:
+ * \code
+ * float pathCost; // 0 for sources, max() for other interior nodes, negative for padding.
+ * float stepCost() const; // The cost of leaving this node, in [0, 1].
+ * void setPrevNeighbourIdx(uint32_t idx);
+ * \endcode
+ * propagateWithPriorityQueue() additionally requires:
+ * \code
+ * static uint32_t const INVALID_HEAP_IDX;
+ * uint32_t heapIdx() const; // INVALID_HEAP_IDX initially.
+ * void setHeapIdx(uint32_t idx);
+ * \endcode
+ * The grid must have a padding of at least 1.
+ */
+template<typename Node>
+class DirectionalPathSearch
+{
+public:
+	/**
+	 * \brief Dijkstra-style propagation using a binary heap.
+	 *
+	 * This is the original implementation, which now serves as
+	 * a reference for propagateWavefront().
+	 */
+	static void propagateWithPriorityQueue(Grid<Node>& grid, Vec2f const& direction);
+
+	/**
+	 * \brief Dynamic programming sweep in topological order.
+	 *
+	 * Nodes are visited line by line across the dominant axis of
+	 * \p direction, in the order of propagation.  Every node pulls
+	 * the best path from its (at most 4) predecessors, all of which
+	 * have already been finalized.  There is no priority queue
+	 * involved, and every node is visited exactly once.
+	 *
+	 * Path costs are identical to those of propagateWithPriorityQueue().
+	 * The paths themselves may differ where there are several paths
+	 * of the same cost.
+	 */
+	static void propagateWavefront(Grid<Node>& grid, Vec2f const& direction);
+
+	/**
+	 * \brief Builds the list of neighbours a step may be made to.
+	 *
+	 * \param[out] next_nbh_offsets Grid offsets of the allowed neighbours.
+	 * \param[out] prev_nbh_indexes For every allowed neighbour, the index
+	 *             of the current node from that neighbour's point of view.
+	 * \return The number of allowed neighbours, which is either 3 or 4.
+	 */
+	static int initNeighbours(
+		int* next_nbh_offsets, int* prev_nbh_indexes, int stride, Vec2f const& direction);
+private:
+	class PrioQueue : public PriorityQueue<uint32_t, PrioQueue>
+	{
+	public:
+		PrioQueue(Grid<Node>& grid) : m_pData(grid.data()) {}
+
+		bool higherThan(uint32_t lhs, uint32_t rhs) const {
+			return m_pData[lhs].pathCost < m_pData[rhs].pathCost;
+		}
+
+		void setIndex(uint32_t grid_idx, size_t heap_idx) {
+			m_pData[grid_idx].setHeapIdx(static_cast<uint32_t>(heap_idx));
+		}
+
+		void reposition(Node* node) {
+			PriorityQueue<uint32_t, PrioQueue>::reposition(node->heapIdx());
+		}
+	private:
+		Node* const m_pData;
+	};
+};
+
+
+template<typename Node>
+void
+DirectionalPathSearch<Node>::propagateWithPriorityQueue(
+	Grid<Node>& grid, Vec2f const& direction)
+{
+	int const width = grid.width();
+	int const height = grid.height();
+	int const stride = grid.stride();
+	Node* const data = grid.data();
+
+	PrioQueue queue(grid);
+
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			int const offset = y * stride + x;
+			if (data[offset].pathCost == 0) {
+				queue.push(offset);
+			}
+		}
+	}
+
+	int next_nbh_offsets[8];
+	int prev_nbh_indexes[8];
+	int const num_neighbours = initNeighbours(next_nbh_offsets, prev_nbh_indexes, stride, direction);
+
+	while (!queue.empty()) {
+		int const grid_idx = queue.front();
+		Node* node = data + grid_idx;
+		assert(node->pathCost >= 0);
+		queue.pop();
+		node->setHeapIdx(Node::INVALID_HEAP_IDX);
+
+		float const new_cost = std::max<float>(node->pathCost, node->stepCost());
+
+		for (int i = 0; i < num_neighbours; ++i) {
+			int const nbh_grid_idx = grid_idx + next_nbh_offsets[i];
+			Node* nbh_node = data + nbh_grid_idx;
+			
+			if (new_cost < nbh_node->pathCost) {
+				nbh_node->pathCost = new_cost;
+				nbh_node->setPrevNeighbourIdx(prev_nbh_indexes[i]);
+				if (nbh_node->heapIdx() == Node::INVALID_HEAP_IDX) {
+					queue.push(nbh_grid_idx);
+				} else {
+					queue.reposition(nbh_node);
+				}
+			}
+		}
+	}
+}
+
+template<typename Node>
+void
+DirectionalPathSearch<Node>::propagateWavefront(
+	Grid<Node>& grid, Vec2f const& direction)
+{
+	int const width = grid.width();
+	int const height = grid.height();
+	int const stride = grid.stride();
+	Node* const data = grid.data();
+
+	int next_nbh_offsets[8];
+	int prev_nbh_indexes[8];
+	int const num_neighbours = initNeighbours(next_nbh_offsets, prev_nbh_indexes, stride, direction);
+
+	// A step always moves along the dominant axis in the direction of
+	// propagation, or stays on the same line and moves along the other
+	// axis, again in the direction of propagation.  Therefore, visiting
+	// lines in the order of propagation, and nodes within a line in
+	// the order of propagation, visits predecessors before successors.
+	bool const horizontal = fabs(direction[0]) >= fabs(direction[1]);
+	int const num_lines = horizontal ? width : height;
+	int const line_len = horizontal ? height : width;
+	int const line_step = horizontal ? 1 : stride;
+	int const node_step = horizontal ? stride : 1;
+	bool const reverse_lines = (horizontal ? direction[0] : direction[1]) < 0;
+	bool const reverse_nodes = (horizontal ? direction[1] : direction[0]) < 0;
+
+	for (int i = 0; i < num_lines; ++i) {
+		int const line = reverse_lines ? num_lines - 1 - i : i;
+		Node* const line_start = data + line * line_step;
+
+		for (int j = 0; j < line_len; ++j) {
+			int const pos = reverse_nodes ? line_len - 1 - j : j;
+			Node* const node = line_start + pos * node_step;
+
+			for (int n = 0; n < num_neighbours; ++n) {
+				Node const* const prev_node = node - next_nbh_offsets[n];
+				if (prev_node->pathCost < 0) {
+					// Padding.
+					continue;
+				}
+
+				float const new_cost = std::max<float>(prev_node->pathCost, prev_node->stepCost());
+				if (new_cost < node->pathCost) {
+					node->pathCost = new_cost;
+					node->setPrevNeighbourIdx(prev_nbh_indexes[n]);
+				}
+			}
+		}
+	}
+}
+
+template<typename Node>
+int
+DirectionalPathSearch<Node>::initNeighbours(
+	int* next_nbh_offsets, int* prev_nbh_indexes, int stride, Vec2f const& direction)
+{
+	int const candidate_offsets[] = {
+		-stride - 1, -stride, -stride + 1,
+		         -1,                    1,
+		 stride - 1,  stride,  stride + 1
+	};
+
+	float const candidate_vectors[8][2] = {
+		{ -1.0f, -1.0f }, { 0.0f, -1.0f }, { 1.0f, -1.0f },
+		{ -1.0f,  0.0f },                  { 1.0f,  0.0f },
+		{ -1.0f,  1.0f }, { 0.0f,  1.0f }, { 1.0f,  1.0f }
+	};
+
+	static int const opposite_nbh_map[] = {
+		7, 6, 5,
+		4,    3,
+		2, 1, 0
+	};
+
+	int out_idx = 0;
+	for (int i = 0; i < 8; ++i) {
+		Vec2f const vec(candidate_vectors[i][0], candidate_vectors[i][1]);
+		if (vec.dot(direction) > 0) {
+			next_nbh_offsets[out_idx] = candidate_offsets[i];
+			prev_nbh_indexes[out_idx] = opposite_nbh_map[i];
+			++out_idx;
+		}
+	}
+	return out_idx;
+}
+
+} // namespace dewarping
+
+#endif
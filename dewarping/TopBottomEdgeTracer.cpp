@@ -21,10 +21,11 @@
 #include "TaskStatus.h"
 #include "DebugImages.h"
 #include "NumericTraits.h"
-#include "PriorityQueue.h"
+#include "DirectionalPathSearch.h"
 #include "ToLineProjector.h"
 #include "LineBoundedByRect.h"
 #include "GridLineTraverser.h"
+#include "TaskGroup.h"
 #include "MatrixCalc.h"
 #include "imageproc/GrayImage.h"
 #include "imageproc/Scale.h"
@@ -89,6 +90,11 @@ public:
 
 	float absDirDeriv() const { return fabs(dirDeriv); }
 
+	float stepCost() const {
+		assert(fabs(dirDeriv) <= 1.0);
+		return 1.0f - fabs(dirDeriv);
+	}
+
 	void setupForPadding() {
 		dirDeriv = 0;
 		pathCost = -1;
@@ -138,33 +144,55 @@ public:
 };
 
 
-class TopBottomEdgeTracer::PrioQueue :
-	public PriorityQueue<uint32_t, PrioQueue>
+struct TopBottomEdgeTracer::Step
 {
-public:
-	PrioQueue(Grid<GridNode>& grid) : m_pData(grid.data()) {}
+	Vec2f pt;
+	uint32_t prevStepIdx;
+	float pathCost;
+};
 
-	bool higherThan(uint32_t lhs, uint32_t rhs) const {
-		return m_pData[lhs].pathCost < m_pData[rhs].pathCost;
-	}
 
-	void setIndex(uint32_t grid_idx, size_t heap_idx) {
-		m_pData[grid_idx].setHeapIdx(static_cast<uint32_t>(heap_idx));
-	}
+/**
+ * Turns one of the best paths into a snake and refines it.  Different
+ * snakes may be refined concurrently, as the grid is only read from.
+ */
+class TopBottomEdgeTracer::SnakeRefiner
+{
+public:
+	SnakeRefiner(
+		Grid<GridNode> const& grid, QRectF const& page_rect,
+		Vec2f const& bounds_dir, std::vector<QPoint> const& endpoints,
+		std::vector<std::vector<QPointF> >& snakes,
+		std::vector<std::vector<QPointF> >* down_the_hill_snakes, size_t idx)
+	:	m_rGrid(grid),
+		m_pageRect(page_rect),
+		m_boundsDir(bounds_dir),
+		m_rEndpoints(endpoints),
+		m_rSnakes(snakes),
+		m_pDownTheHillSnakes(down_the_hill_snakes),
+		m_idx(idx) {}
+
+	void operator()() const {
+		std::vector<QPointF>& snake = m_rSnakes[m_idx];
+		snake = pathToSnake(m_rGrid, m_rEndpoints[m_idx]);
+
+		Vec2f const down_dir(downTheHillDirection(m_pageRect, snake, m_boundsDir));
+		downTheHillSnake(snake, m_rGrid, down_dir);
+		if (m_pDownTheHillSnakes) {
+			(*m_pDownTheHillSnakes)[m_idx] = snake;
+		}
 
-	void reposition(GridNode* node) {
-		PriorityQueue<uint32_t, PrioQueue>::reposition(node->heapIdx());
+		Vec2f const up_dir(-downTheHillDirection(m_pageRect, snake, m_boundsDir));
+		upTheHillSnake(snake, m_rGrid, up_dir);
 	}
 private:
-	GridNode* const m_pData;
-};
-
-
-struct TopBottomEdgeTracer::Step
-{
-	Vec2f pt;
-	uint32_t prevStepIdx;
-	float pathCost;
+	Grid<GridNode> const& m_rGrid;
+	QRectF m_pageRect;
+	Vec2f m_boundsDir;
+	std::vector<QPoint> const& m_rEndpoints;
+	std::vector<std::vector<QPointF> >& m_rSnakes;
+	std::vector<std::vector<QPointF> >* m_pDownTheHillSnakes;
+	size_t m_idx;
 };
 
 
@@ -245,12 +273,10 @@ TopBottomEdgeTracer::trace(
 
 	status.throwIfCancelled();
 
-	PrioQueue queue(grid);
-	
 	// Shortest paths from bounds.first towards bounds.second.
-	prepareForShortestPathsFrom(queue, grid, bounds.first);
+	prepareForShortestPathsFrom(grid, bounds.first);
 	Vec2f const dir_1st_to_2nd(directionFromPointToLine(bounds.first.pointAt(0.5), bounds.second));
-	propagateShortestPaths(dir_1st_to_2nd, queue, grid);
+	DirectionalPathSearch<GridNode>::propagateWavefront(grid, dir_1st_to_2nd);
 	std::vector<QPoint> const endpoints1(locateBestPathEndpoints(grid, bounds.second));
 	if (dbg) {
 		dbg->add(visualizePaths(downscaled, grid, bounds, endpoints1), "best_paths_ltr");
@@ -258,26 +284,32 @@ TopBottomEdgeTracer::trace(
 
 	gaussBlurGradient(grid);
 
-	std::vector<std::vector<QPointF> > snakes;
-	snakes.reserve(endpoints1.size());
-	
-	BOOST_FOREACH(QPoint endpoint, endpoints1) {
-		snakes.push_back(pathToSnake(grid, endpoint));
-		Vec2f const dir(downTheHillDirection(downscaled.rect(), snakes.back(), avg_bounds_dir));
-		downTheHillSnake(snakes.back(), grid, dir);
-	}
+	std::vector<std::vector<QPointF> > snakes(endpoints1.size());
+	std::vector<std::vector<QPointF> > down_the_hill_snakes;
 	if (dbg) {
-		QImage const background(visualizeBlurredGradient(grid));
-		dbg->add(visualizeSnakes(background, snakes, bounds), "down_the_hill_snakes");
+		down_the_hill_snakes.resize(endpoints1.size());
 	}
 
-	BOOST_FOREACH(std::vector<QPointF>& snake, snakes) {
-		Vec2f const dir(-downTheHillDirection(downscaled.rect(), snake, avg_bounds_dir));
-		upTheHillSnake(snake, grid, dir);
+	// The top and bottom snakes are refined independently of each other.
+	TaskGroup refinements;
+	for (size_t i = 0; i < endpoints1.size(); ++i) {
+		refinements.run(
+			SnakeRefiner(
+				grid, downscaled.rect(), avg_bounds_dir, endpoints1,
+				snakes, dbg ? &down_the_hill_snakes : 0, i
+			)
+		);
 	}
+	refinements.wait();
+
+	status.throwIfCancelled();
+
 	if (dbg) {
-		QImage const background(visualizeGradient(grid));
-		dbg->add(visualizeSnakes(background, snakes, bounds), "up_the_hill_snakes");
+		QImage const blurred_background(visualizeBlurredGradient(grid));
+		dbg->add(visualizeSnakes(blurred_background, down_the_hill_snakes, bounds), "down_the_hill_snakes");
+
+		QImage const gradient_background(visualizeGradient(grid));
+		dbg->add(visualizeSnakes(gradient_background, snakes, bounds), "up_the_hill_snakes");
 	}
 
 	// Convert snakes back to the original coordinate system.
@@ -479,7 +511,7 @@ TopBottomEdgeTracer::directionFromPointToLine(QPointF const& pt, QLineF const& l
 
 void
 TopBottomEdgeTracer::prepareForShortestPathsFrom(
-	PrioQueue& queue, Grid<GridNode>& grid, QLineF const& from)
+	Grid<GridNode>& grid, QLineF const& from)
 {
 	GridNode padding_node;
 	padding_node.setupForPadding();
@@ -510,78 +542,7 @@ TopBottomEdgeTracer::prepareForShortestPathsFrom(
 
 		int const offset = pt.y() * stride + pt.x();
 		data[offset].pathCost = 0;
-		queue.push(offset);
-	}
-}
-
-void
-TopBottomEdgeTracer::propagateShortestPaths(
-	Vec2f const& direction, PrioQueue& queue, Grid<GridNode>& grid)
-{
-	GridNode* const data = grid.data();
-	
-	int next_nbh_offsets[8];
-	int prev_nbh_indexes[8];
-	int const num_neighbours = initNeighbours(next_nbh_offsets, prev_nbh_indexes, grid.stride(), direction);
-
-	while (!queue.empty()) {
-		int const grid_idx = queue.front();
-		GridNode* node = data + grid_idx;
-		assert(node->pathCost >= 0);
-		queue.pop();
-		node->setHeapIdx(GridNode::INVALID_HEAP_IDX);
-
-		for (int i = 0; i < num_neighbours; ++i) {
-			int const nbh_grid_idx = grid_idx + next_nbh_offsets[i];
-			GridNode* nbh_node = data + nbh_grid_idx;
-			
-			assert(fabs(node->dirDeriv) <= 1.0);
-			float const new_cost = std::max<float>(node->pathCost, 1.0f - fabs(node->dirDeriv));
-			if (new_cost < nbh_node->pathCost) {
-				nbh_node->pathCost = new_cost;
-				nbh_node->setPrevNeighbourIdx(prev_nbh_indexes[i]);
-				if (nbh_node->heapIdx() == GridNode::INVALID_HEAP_IDX) {
-					queue.push(nbh_grid_idx);
-				} else {
-					queue.reposition(nbh_node);
-				}
-			}
-		}
-	}
-}
-
-int
-TopBottomEdgeTracer::initNeighbours(
-	int* next_nbh_offsets, int* prev_nbh_indexes, int stride, Vec2f const& direction)
-{
-	int const candidate_offsets[] = {
-		-stride - 1, -stride, -stride + 1,
-		         -1,                    1,
-		 stride - 1,  stride,  stride + 1
-	};
-
-	float const candidate_vectors[8][2] = {
-		{ -1.0f, -1.0f }, { 0.0f, -1.0f }, { 1.0f, -1.0f },
-		{ -1.0f,  0.0f },                  { 1.0f,  0.0f },
-		{ -1.0f,  1.0f }, { 0.0f,  1.0f }, { 1.0f,  1.0f }
-	};
-
-	static int const opposite_nbh_map[] = {
-		7, 6, 5,
-		4,    3,
-		2, 1, 0
-	};
-
-	int out_idx = 0;
-	for (int i = 0; i < 8; ++i) {
-		Vec2f const vec(candidate_vectors[i][0], candidate_vectors[i][1]);
-		if (vec.dot(direction) > 0) {
-			next_nbh_offsets[out_idx] = candidate_offsets[i];
-			prev_nbh_indexes[out_idx] = opposite_nbh_map[i];
-			++out_idx;
-		}
 	}
-	return out_idx;
 }
 
 namespace
@@ -51,8 +51,8 @@ public:
 		DistortionModelBuilder& output, TaskStatus const& status, DebugImages* dbg = 0);
 private:
 	struct GridNode;
-	class PrioQueue;
 	struct Step;
+	class SnakeRefiner;
 
 	static bool intersectWithRect(std::pair<QLineF, QLineF>& bounds, QRectF const& rect);
 
@@ -69,11 +69,7 @@ private:
 
 	static Vec2f directionFromPointToLine(QPointF const& pt, QLineF const& line);
 
-	static void prepareForShortestPathsFrom(PrioQueue& queue, Grid<GridNode>& grid, QLineF const& from); 
-
-	static void propagateShortestPaths(Vec2f const& direction, PrioQueue& queue, Grid<GridNode>& grid);
-
-	static int initNeighbours(int* next_nbh_offsets, int* prev_nbh_indexes, int stride, Vec2f const& direction);
+	static void prepareForShortestPathsFrom(Grid<GridNode>& grid, QLineF const& from);
 
 	static std::vector<QPoint> locateBestPathEndpoints(Grid<GridNode> const& grid, QLineF const& line);
 
@@ -36,6 +36,8 @@
 #include <QCoreApplication>
 #include <QDomDocument>
 #include <QDomElement>
+#include <vector>
+#include <utility>
 #include "CommandLine.h"
 
 namespace deskew
@@ -101,6 +103,8 @@ Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
 	
 	QDomElement const filter_el(filters_el.namedItem("deskew").toElement());
 	
+	std::vector<std::pair<PageId, Params> > page_params;
+
 	QString const page_tag_name("page");
 	QDomNode node(filter_el.firstChild());
 	for (; !node.isNull(); node = node.nextSibling()) {
@@ -128,9 +132,10 @@ Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
 			continue;
 		}
 		
-		Params const params(params_el);
-		m_ptrSettings->setPageParams(page_id, params);
+		page_params.push_back(std::make_pair(page_id, Params(params_el)));
 	}
+
+	m_ptrSettings->setPageParams(page_params);
 }
 
 void
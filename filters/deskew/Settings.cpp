@@ -17,7 +17,6 @@
 */
 
 #include "Settings.h"
-#include "Utils.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
 #include <QMutexLocker>
@@ -40,7 +39,8 @@ void
 Settings::clear()
 {
 	QMutexLocker locker(&m_mutex);
-	m_perPageParams.clear();
+	PerPageParams empty;
+	m_perPageParams.publish(empty);
 }
 
 void
@@ -49,38 +49,56 @@ Settings::performRelinking(AbstractRelinker const& relinker)
 	QMutexLocker locker(&m_mutex);
 	PerPageParams new_params;
 
-	BOOST_FOREACH(PerPageParams::value_type const& kv, m_perPageParams) {
+	SnapshotPublisher<PerPageParams>::Snapshot const old_version(m_perPageParams.snapshot());
+	BOOST_FOREACH(PerPageParams::value_type const& kv, *old_version) {
 		RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
 		PageId new_page_id(kv.first);
 		new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-		new_params.insert(PerPageParams::value_type(new_page_id, kv.second));
+		new_params.set(new_page_id, kv.second);
 	}
 
-	m_perPageParams.swap(new_params);
+	m_perPageParams.publish(new_params);
 }
 
 void
 Settings::setPageParams(PageId const& page_id, Params const& params)
 {
 	QMutexLocker locker(&m_mutex);
-	Utils::mapSetValue(m_perPageParams, page_id, params);
+	PerPageParams new_params(*m_perPageParams.snapshot());
+	new_params.set(page_id, params);
+	m_perPageParams.publish(new_params);
+}
+
+void
+Settings::setPageParams(std::vector<std::pair<PageId, Params> > const& page_params)
+{
+	typedef std::pair<PageId, Params> PageAndParams;
+
+	QMutexLocker locker(&m_mutex);
+	PerPageParams new_params(*m_perPageParams.snapshot());
+	BOOST_FOREACH(PageAndParams const& pp, page_params) {
+		new_params.set(pp.first, pp.second);
+	}
+	m_perPageParams.publish(new_params);
 }
 
 void
 Settings::clearPageParams(PageId const& page_id)
 {
 	QMutexLocker locker(&m_mutex);
-	m_perPageParams.erase(page_id);
+	PerPageParams new_params(*m_perPageParams.snapshot());
+	new_params.erase(page_id);
+	m_perPageParams.publish(new_params);
 }
 
 std::auto_ptr<Params>
 Settings::getPageParams(PageId const& page_id) const
 {
-	QMutexLocker locker(&m_mutex);
+	SnapshotPublisher<PerPageParams>::Snapshot const params(m_perPageParams.snapshot());
 	
-	PerPageParams::const_iterator it(m_perPageParams.find(page_id));
-	if (it != m_perPageParams.end()) {
-		return std::auto_ptr<Params>(new Params(it->second));
+	Params const* const page_params = params->find(page_id);
+	if (page_params) {
+		return std::auto_ptr<Params>(new Params(*page_params));
 	} else {
 		return std::auto_ptr<Params>();
 	}
@@ -90,9 +108,11 @@ void
 Settings::setDegress(std::set<PageId> const& pages, Params const& params)
 {
 	QMutexLocker const locker(&m_mutex);
+	PerPageParams new_params(*m_perPageParams.snapshot());
 	BOOST_FOREACH(PageId const& page, pages) {
-		Utils::mapSetValue(m_perPageParams, page, params);
+		new_params.set(page, params);
 	}
+	m_perPageParams.publish(new_params);
 }
 
 } // namespace deskew
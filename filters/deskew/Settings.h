@@ -23,9 +23,12 @@
 #include "NonCopyable.h"
 #include "PageId.h"
 #include "Params.h"
+#include "SnapshotPublisher.h"
+#include "ChunkedMap.h"
 #include <QMutex>
 #include <memory>
-#include <map>
+#include <vector>
+#include <utility>
 #include <set>
 
 class AbstractRelinker;
@@ -46,6 +49,13 @@ public:
 	void performRelinking(AbstractRelinker const& relinker);
 	
 	void setPageParams(PageId const& page_id, Params const& params);
+
+	/**
+	 * \brief Sets parameters for many pages at once.
+	 *
+	 * Much faster than setting them one by one.
+	 */
+	void setPageParams(std::vector<std::pair<PageId, Params> > const& page_params);
 	
 	void clearPageParams(PageId const& page_id);
 	
@@ -53,10 +63,11 @@ public:
 	
 	void setDegress(std::set<PageId> const& pages, Params const& params);
 private:
-	typedef std::map<PageId, Params> PerPageParams;
+	typedef ChunkedMap<PageId, Params> PerPageParams;
 	
-	mutable QMutex m_mutex;
-	PerPageParams m_perPageParams;
+	/** Serializes writers.  Readers don't lock. */
+	QMutex m_mutex;
+	SnapshotPublisher<PerPageParams> m_perPageParams;
 };
 
 } // namespace deskew
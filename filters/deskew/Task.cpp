@@ -23,6 +23,7 @@
 #include "Params.h"
 #include "Dependencies.h"
 #include "TaskStatus.h"
+#include "PerformanceStats.h"
 #include "DebugImages.h"
 #include "filters/select_content/Task.h"
 #include "FilterUiInterface.h"
@@ -108,6 +109,7 @@ FilterResultPtr
 Task::process(TaskStatus const& status, FilterData const& data)
 {
 	status.throwIfCancelled();
+	PerformanceStats::StageTimer const stage_timer(PerformanceStats::DESKEW_STAGE);
 
 	Dependencies const deps(data.xform().preCropArea(), data.xform().preRotation());
 	
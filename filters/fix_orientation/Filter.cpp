@@ -39,6 +39,8 @@
 #include <QDomDocument>
 #include <QDomElement>
 #include <QDomNode>
+#include <vector>
+#include <utility>
 #include <iostream>
 #include "CommandLine.h"
 
@@ -116,6 +118,8 @@ Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
 	
 	QDomElement filter_el(filters_el.namedItem("fix-orientation").toElement());
 	
+	std::vector<std::pair<ImageId, OrthogonalRotation> > rotations;
+
 	QString const image_tag_name("image");
 	QDomNode node(filter_el.firstChild());
 	for (; !node.isNull(); node = node.nextSibling()) {
@@ -144,8 +148,10 @@ Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
 			)
 		);
 		
-		m_ptrSettings->applyRotation(image_id, rotation);
+		rotations.push_back(std::make_pair(image_id, rotation));
 	}
+
+	m_ptrSettings->applyRotations(rotations);
 }
 
 IntrusivePtr<Task>
@@ -17,7 +17,6 @@
 */
 
 #include "Settings.h"
-#include "Utils.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
 #ifndef Q_MOC_RUN
@@ -39,7 +38,8 @@ void
 Settings::clear()
 {
 	QMutexLocker locker(&m_mutex);
-	m_perImageRotation.clear();
+	PerImageRotation empty;
+	m_perImageRotation.publish(empty);
 }
 
 void
@@ -48,14 +48,15 @@ Settings::performRelinking(AbstractRelinker const& relinker)
 	QMutexLocker locker(&m_mutex);
 	PerImageRotation new_rotations;
 
-	BOOST_FOREACH(PerImageRotation::value_type const& kv, m_perImageRotation) {
+	SnapshotPublisher<PerImageRotation>::Snapshot const old_version(m_perImageRotation.snapshot());
+	BOOST_FOREACH(PerImageRotation::value_type const& kv, *old_version) {
 		RelinkablePath const old_path(kv.first.filePath(), RelinkablePath::File);
 		ImageId new_image_id(kv.first);
 		new_image_id.setFilePath(relinker.substitutionPathFor(old_path));
-		new_rotations.insert(PerImageRotation::value_type(new_image_id, kv.second));
+		new_rotations.set(new_image_id, kv.second);
 	}
 
-	m_perImageRotation.swap(new_rotations);
+	m_perImageRotation.publish(new_rotations);
 }
 
 void
@@ -63,7 +64,9 @@ Settings::applyRotation(
 	ImageId const& image_id, OrthogonalRotation const rotation)
 {
 	QMutexLocker locker(&m_mutex);
-	setImageRotationLocked(image_id, rotation);
+	PerImageRotation new_rotations(*m_perImageRotation.snapshot());
+	new_rotations.set(image_id, rotation);
+	m_perImageRotation.publish(new_rotations);
 }
 
 void
@@ -71,30 +74,44 @@ Settings::applyRotation(
 	std::set<PageId> const& pages, OrthogonalRotation const rotation)
 {
 	QMutexLocker locker(&m_mutex);
+	PerImageRotation new_rotations(*m_perImageRotation.snapshot());
 	
 	BOOST_FOREACH(PageId const& page, pages) {
-		setImageRotationLocked(page.imageId(), rotation);
+		new_rotations.set(page.imageId(), rotation);
 	}
+
+	m_perImageRotation.publish(new_rotations);
+}
+
+void
+Settings::applyRotations(
+	std::vector<std::pair<ImageId, OrthogonalRotation> > const& rotations)
+{
+	typedef std::pair<ImageId, OrthogonalRotation> ImageAndRotation;
+
+	QMutexLocker locker(&m_mutex);
+	PerImageRotation new_rotations(*m_perImageRotation.snapshot());
+
+	BOOST_FOREACH(ImageAndRotation const& ir, rotations) {
+		new_rotations.set(ir.first, ir.second);
+	}
+
+	m_perImageRotation.publish(new_rotations);
 }
 
 OrthogonalRotation
 Settings::getRotationFor(ImageId const& image_id) const
 {
-	QMutexLocker locker(&m_mutex);
+	SnapshotPublisher<PerImageRotation>::Snapshot const rotations(
+		m_perImageRotation.snapshot()
+	);
 	
-	PerImageRotation::const_iterator it(m_perImageRotation.find(image_id));
-	if (it != m_perImageRotation.end()) {
-		return it->second;
+	OrthogonalRotation const* const rotation = rotations->find(image_id);
+	if (rotation) {
+		return *rotation;
 	} else {
 		return OrthogonalRotation();
 	}
 }
 
-void
-Settings::setImageRotationLocked(
-	ImageId const& image_id, OrthogonalRotation const& rotation)
-{
-	Utils::mapSetValue(m_perImageRotation, image_id, rotation);
-}
-
 } // namespace fix_orientation
@@ -24,8 +24,11 @@
 #include "OrthogonalRotation.h"
 #include "ImageId.h"
 #include "PageId.h"
+#include "SnapshotPublisher.h"
+#include "ChunkedMap.h"
 #include <QMutex>
-#include <map>
+#include <vector>
+#include <utility>
 #include <set>
 
 class AbstractRelinker;
@@ -48,16 +51,21 @@ public:
 	void applyRotation(ImageId const& image_id, OrthogonalRotation rotation);
 	
 	void applyRotation(std::set<PageId> const& pages, OrthogonalRotation rotation);
+
+	/**
+	 * \brief Applies rotations to many images at once.
+	 *
+	 * Much faster than applying them one by one.
+	 */
+	void applyRotations(std::vector<std::pair<ImageId, OrthogonalRotation> > const& rotations);
 	
 	OrthogonalRotation getRotationFor(ImageId const& image_id) const;
 private:
-	typedef std::map<ImageId, OrthogonalRotation> PerImageRotation;
-	
-	void setImageRotationLocked(
-		ImageId const& image_id, OrthogonalRotation const& rotation);
+	typedef ChunkedMap<ImageId, OrthogonalRotation> PerImageRotation;
 	
-	mutable QMutex m_mutex;
-	PerImageRotation m_perImageRotation;
+	/** Serializes writers.  Readers don't lock. */
+	QMutex m_mutex;
+	SnapshotPublisher<PerImageRotation> m_perImageRotation;
 };
 
 } // namespace fix_orientation
@@ -24,6 +24,7 @@
 #include "ImageTransformation.h"
 #include "filters/page_split/Task.h"
 #include "TaskStatus.h"
+#include "PerformanceStats.h"
 #include "ImageView.h"
 #include "FilterUiInterface.h"
 #include <QImage>
@@ -79,6 +80,7 @@ Task::process(TaskStatus const& status, FilterData const& data)
 	// This function is executed from the worker thread.
 	
 	status.throwIfCancelled();
+	PerformanceStats::StageTimer const stage_timer(PerformanceStats::FIX_ORIENTATION_STAGE);
 	
 	ImageTransformation xform(data.xform());
 	xform.setPreRotation(m_ptrSettings->getRotationFor(m_imageId));
@@ -90,7 +90,9 @@ CacheDrivenTask::process(
 				params.depthPerception(), params.despeckleLevel()
 			);
 
-			if (!stored_output_params->outputImageParams().matches(new_output_image_params)) {
+			OutputImageParams const& stored_image_params = stored_output_params->outputImageParams();
+			if (!stored_image_params.matches(new_output_image_params) ||
+					!stored_image_params.fileLayoutMatches(new_output_image_params)) {
 				need_reprocess = true;
 				break;
 			}
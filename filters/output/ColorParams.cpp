@@ -27,7 +27,8 @@ namespace output
 ColorParams::ColorParams(QDomElement const& el)
 :	m_colorMode(parseColorMode(el.attribute("colorMode"))),
 	m_colorGrayscaleOptions(el.namedItem("color-or-grayscale").toElement()),
-	m_bwOptions(el.namedItem("bw").toElement())
+	m_bwOptions(el.namedItem("bw").toElement()),
+	m_layeredOutput(el.attribute("layered") == "1")
 {
 }
 
@@ -36,11 +37,26 @@ ColorParams::toXml(QDomDocument& doc, QString const& name) const
 {
 	QDomElement el(doc.createElement(name));
 	el.setAttribute("colorMode", formatColorMode(m_colorMode));
+	if (m_layeredOutput) {
+		el.setAttribute("layered", "1");
+	}
 	el.appendChild(m_colorGrayscaleOptions.toXml(doc, "color-or-grayscale"));
 	el.appendChild(m_bwOptions.toXml(doc, "bw"));
 	return el;
 }
 
+ColorParams::FileUpdate
+ColorParams::fileUpdateFor(ColorParams const& stored, ColorParams const& wanted)
+{
+	if (stored.colorMode() != MIXED || stored.layeredOutput() == wanted.layeredOutput()) {
+		return KEEP_FILE;
+	} else if (stored.layeredOutput()) {
+		return REGENERATE_FILE;
+	} else {
+		return REWRITE_FILE;
+	}
+}
+
 ColorParams::ColorMode
 ColorParams::parseColorMode(QString const& str)
 {
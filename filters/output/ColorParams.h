@@ -32,8 +32,13 @@ class ColorParams
 {
 public:
 	enum ColorMode { BLACK_AND_WHITE, COLOR_GRAYSCALE, MIXED };
+
+	/**
+	 * \see fileUpdateFor()
+	 */
+	enum FileUpdate { KEEP_FILE, REWRITE_FILE, REGENERATE_FILE };
 	
-	ColorParams(): m_colorMode(BLACK_AND_WHITE) {}
+	ColorParams(): m_colorMode(BLACK_AND_WHITE), m_layeredOutput(false) {}
 	
 	ColorParams(QDomElement const& el);
 	
@@ -58,6 +63,28 @@ public:
 	void setBlackWhiteOptions(BlackWhiteOptions const& opt) {
 		m_bwOptions = opt;
 	}
+	
+	/**
+	 * \brief Whether MIXED output is written as separate text, mask
+	 *        and background layers rather than a single image.
+	 *
+	 * \see TiffWriter::writeMrcImage()
+	 */
+	bool layeredOutput() const { return m_layeredOutput; }
+	
+	void setLayeredOutput(bool layered) { m_layeredOutput = layered; }
+
+	/**
+	 * \brief Tells what to do with an output file written with \p stored
+	 *        params, for it to be as if written with \p wanted ones.
+	 *
+	 * The params are assumed to produce the same output image, differing
+	 * at most in how it's stored.  A plain file can be rewritten as layers,
+	 * as it has all the pixels.  The background layer of a layered file is
+	 * lossy and reduced, so turning layered output off needs the image
+	 * to be generated again.
+	 */
+	static FileUpdate fileUpdateFor(ColorParams const& stored, ColorParams const& wanted);
 private:
 	static ColorMode parseColorMode(QString const& str);
 	
@@ -66,6 +93,7 @@ private:
 	ColorMode m_colorMode;
 	ColorGrayscaleOptions m_colorGrayscaleOptions;
 	BlackWhiteOptions m_bwOptions;
+	bool m_layeredOutput;
 };
 
 } // namespace output
@@ -223,23 +223,29 @@ DewarpingView::onPaint(QPainter& painter, InteractionState const& interaction)
 
 	if (valid_model) {
 		try {
-			std::vector<QVector<QPointF> > curves(num_hor_grid_lines);
-
 			dewarping::CylindricalSurfaceDewarper dewarper(
 				m_distortionModel.topCurve().polyline(),
 				m_distortionModel.bottomCurve().polyline(), m_depthPerception.value()
 			);
-			dewarping::CylindricalSurfaceDewarper::State state;
 
+			// Grid nodes, one vertical grid line after another, so that
+			// the nodes of a vertical line share a single generatrix.
+			QVector<QPointF> grid(num_vert_grid_lines * num_hor_grid_lines);
 			for (int j = 0; j < num_vert_grid_lines; ++j) {
 				double const x = j / (num_vert_grid_lines - 1.0);
-				dewarping::CylindricalSurfaceDewarper::Generatrix const gtx(dewarper.mapGeneratrix(x, state));
-				QPointF const gtx_p0(gtx.imgLine.pointAt(gtx.pln2img(0)));
-				QPointF const gtx_p1(gtx.imgLine.pointAt(gtx.pln2img(1)));
-				painter.drawLine(gtx_p0, gtx_p1);
 				for (int i = 0; i < num_hor_grid_lines; ++i) {
 					double const y = i / (num_hor_grid_lines - 1.0);
-					curves[i].push_back(gtx.imgLine.pointAt(gtx.pln2img(y)));
+					grid[j * num_hor_grid_lines + i] = QPointF(x, y);
+				}
+			}
+			dewarper.mapPointsToWarpedSpace(grid.constData(), grid.data(), grid.size());
+
+			std::vector<QVector<QPointF> > curves(num_hor_grid_lines);
+			for (int j = 0; j < num_vert_grid_lines; ++j) {
+				QPointF const* const gtx_nodes = grid.constData() + j * num_hor_grid_lines;
+				painter.drawLine(gtx_nodes[0], gtx_nodes[num_hor_grid_lines - 1]);
+				for (int i = 0; i < num_hor_grid_lines; ++i) {
+					curves[i].push_back(gtx_nodes[i]);
 				}
 			}
 
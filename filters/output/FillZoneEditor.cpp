@@ -65,8 +65,8 @@ private:
 
 FillZoneEditor::FillZoneEditor(
 	QImage const& image, ImagePixmapUnion const& downscaled_version,
-	boost::function<QPointF(QPointF const&)> const& orig_to_image,
-	boost::function<QPointF(QPointF const&)> const& image_to_orig,
+	boost::function<QPolygonF(QPolygonF const&)> const& orig_to_image,
+	boost::function<QPolygonF(QPolygonF const&)> const& image_to_orig,
 	PageId const& page_id, IntrusivePtr<Settings> const& settings)
 :	ImageViewBase(
 		image, downscaled_version,
@@ -37,6 +37,7 @@
 #endif
 #include <QPoint>
 #include <QPointF>
+#include <QPolygonF>
 #include <QColor>
 
 class InteractionState;
@@ -54,8 +55,8 @@ class FillZoneEditor : public ImageViewBase, private InteractionHandler
 public:
 	FillZoneEditor(
 		QImage const& image, ImagePixmapUnion const& downscaled_version,
-		boost::function<QPointF(QPointF const&)> const& orig_to_image,
-		boost::function<QPointF(QPointF const&)> const& image_to_orig,
+		boost::function<QPolygonF(QPolygonF const&)> const& orig_to_image,
+		boost::function<QPolygonF(QPolygonF const&)> const& image_to_orig,
 		PageId const& page_id, IntrusivePtr<Settings> const& settings);
 	
 	virtual ~FillZoneEditor();
@@ -96,8 +97,8 @@ private:
 	DragHandler m_dragHandler;
 	ZoomHandler m_zoomHandler;	
 
-	boost::function<QPointF(QPointF const&)> m_origToImage;
-	boost::function<QPointF(QPointF const&)> m_imageToOrig;
+	boost::function<QPolygonF(QPolygonF const&)> m_origToImage;
+	boost::function<QPolygonF(QPolygonF const&)> m_imageToOrig;
 	PageId m_pageId;
 	IntrusivePtr<Settings> m_ptrSettings;
 };
@@ -22,6 +22,9 @@
 #include "Task.h"
 #include "PageId.h"
 #include "Settings.h"
+#include "RenderCache.h"
+#include "OutputFileScan.h"
+#include "WriteBehindQueue.h"
 #include "Params.h"
 #include "OutputParams.h"
 #include "ProjectReader.h"
@@ -42,9 +45,34 @@
 namespace output
 {
 
+namespace
+{
+
+/**
+ * Makes a page whose output files failed to be written
+ * get processed again.
+ */
+class WriteFailureHandler
+{
+public:
+	WriteFailureHandler(IntrusivePtr<Settings> const& settings)
+	:	m_ptrSettings(settings) {}
+
+	void operator()(PageId const& page_id) const {
+		m_ptrSettings->removeOutputParams(page_id);
+	}
+private:
+	IntrusivePtr<Settings> m_ptrSettings;
+};
+
+} // anonymous namespace
+
 Filter::Filter(
 	PageSelectionAccessor const& page_selection_accessor)
-:	m_ptrSettings(new Settings)
+:	m_ptrSettings(new Settings),
+	m_ptrRenderCache(new RenderCache),
+	m_ptrOutputFileScan(new OutputFileScan),
+	m_ptrWriteQueue(new WriteBehindQueue(WriteFailureHandler(m_ptrSettings)))
 {
 	if (CommandLine::get().isGui()) {
 		m_ptrOptionsWidget.reset(
@@ -55,6 +83,28 @@ Filter::Filter(
 
 Filter::~Filter()
 {
+	// Background writes call outputThumbnailRecreated() on us.
+	m_ptrWriteQueue->waitForAll();
+}
+
+void
+Filter::waitForPendingWrites()
+{
+	m_ptrWriteQueue->waitForAll();
+}
+
+void
+Filter::waitForPendingWrites(PageId const& page_id)
+{
+	m_ptrWriteQueue->waitForPage(page_id);
+}
+
+void
+Filter::outputThumbnailRecreated(PageId const& page_id)
+{
+	if (m_ptrOptionsWidget.get()) {
+		m_ptrOptionsWidget->outputThumbnailRecreated(page_id);
+	}
 }
 
 QString
@@ -72,7 +122,10 @@ Filter::getView() const
 void
 Filter::performRelinking(AbstractRelinker const& relinker)
 {
+	m_ptrWriteQueue->waitForAll();
 	m_ptrSettings->performRelinking(relinker);
+	m_ptrRenderCache->clear();
+	m_ptrOutputFileScan->clear();
 }
 
 void
@@ -86,7 +139,6 @@ QDomElement
 Filter::saveSettings(
 	ProjectWriter const& writer, QDomDocument& doc) const
 {
-	
 	using namespace boost::lambda;
 	
 	QDomElement filter_el(doc.createElement("output"));
@@ -105,6 +157,9 @@ Filter::writePageSettings(
 	QDomDocument& doc, QDomElement& filter_el,
 	PageId const& page_id, int numeric_id) const
 {
+	// Output params of a page are only committed once its files are written.
+	m_ptrWriteQueue->waitForPage(page_id);
+	
 	Params const params(m_ptrSettings->getParams(page_id));
 	
 	QDomElement page_el(doc.createElement("page"));
@@ -125,7 +180,12 @@ Filter::writePageSettings(
 void
 Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
 {
+	// Pending writes would otherwise commit their output params
+	// into the settings we are about to load.
+	m_ptrWriteQueue->waitForAll();
 	m_ptrSettings->clear();
+	m_ptrRenderCache->clear();
+	m_ptrOutputFileScan->clear();
 	
 	QDomElement const filter_el(
 		filters_el.namedItem("output").toElement()
@@ -187,10 +247,15 @@ Filter::createTask(
 	ImageViewTab lastTab(TAB_OUTPUT);
 	if (m_ptrOptionsWidget.get() != 0)
 		lastTab = m_ptrOptionsWidget->lastTab();
+	if (!batch) {
+		// Output files may be changed behind our back between batches,
+		// so a scan is only trusted within a single batch run.
+		m_ptrOutputFileScan->clear();
+	}
 	return IntrusivePtr<Task>(
 		new Task(
-			IntrusivePtr<Filter>(this), m_ptrSettings,
-			thumbnail_cache, page_id, out_file_name_gen,
+			IntrusivePtr<Filter>(this), m_ptrSettings, m_ptrRenderCache,
+			m_ptrOutputFileScan, m_ptrWriteQueue, thumbnail_cache, page_id, out_file_name_gen,
 			lastTab, batch, debug
 		)
 	);
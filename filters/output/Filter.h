@@ -41,6 +41,9 @@ class OptionsWidget;
 class Task;
 class CacheDrivenTask;
 class Settings;
+class RenderCache;
+class OutputFileScan;
+class WriteBehindQueue;
 
 class Filter : public AbstractFilter
 {
@@ -72,6 +75,25 @@ public:
 	
 	IntrusivePtr<CacheDrivenTask> createCacheDrivenTask(
 		OutputFileNameGenerator const& out_file_name_gen);
+
+	/**
+	 * \brief Waits for output files being written in the background
+	 *        to be written, and their output params committed.
+	 */
+	void waitForPendingWrites();
+	
+	/**
+	 * \brief Same as above, but only for a particular page.
+	 */
+	void waitForPendingWrites(PageId const& page_id);
+
+	/**
+	 * \brief Makes the GUI reload the output thumbnail of a page.
+	 *
+	 * Called by background writes after recreating the thumbnail.
+	 * May be called from any thread.
+	 */
+	void outputThumbnailRecreated(PageId const& page_id);
 	
 	OptionsWidget* optionsWidget() { return m_ptrOptionsWidget.get(); };
 	Settings* getSettings() { return m_ptrSettings.get(); };
@@ -81,6 +103,9 @@ private:
 		PageId const& page_id, int numeric_id) const;
 	
 	IntrusivePtr<Settings> m_ptrSettings;
+	IntrusivePtr<RenderCache> m_ptrRenderCache;
+	IntrusivePtr<OutputFileScan> m_ptrOutputFileScan;
+	IntrusivePtr<WriteBehindQueue> m_ptrWriteQueue;
 	SafeDeletingQObjectPtr<OptionsWidget> m_ptrOptionsWidget;
 	PictureZonePropFactory m_pictureZonePropFactory;
 	FillZonePropFactory m_fillZonePropFactory;
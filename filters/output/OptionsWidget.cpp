@@ -44,6 +44,7 @@
 #include <QSize>
 #include <Qt>
 #include <QDebug>
+#include <QMetaType>
 
 namespace output
 {
@@ -59,6 +60,9 @@ OptionsWidget::OptionsWidget(
 {
 	setupUi(this);
 
+	// For invalidateThumbnail() emitted by outputThumbnailRecreated().
+	qRegisterMetaType<PageId>("PageId");
+
 	depthPerceptionSlider->setMinimum(qRound(DepthPerception::minValue() * 10));
 	depthPerceptionSlider->setMaximum(qRound(DepthPerception::maxValue() * 10));
 	
@@ -90,6 +94,10 @@ OptionsWidget::OptionsWidget(
 		whiteMarginsCB, SIGNAL(clicked(bool)),
 		this, SLOT(whiteMarginsToggled(bool))
 	);
+	connect(
+		layeredOutputCB, SIGNAL(clicked(bool)),
+		this, SLOT(layeredOutputToggled(bool))
+	);
 	connect(
 		equalizeIlluminationCB, SIGNAL(clicked(bool)),
 		this, SLOT(equalizeIlluminationToggled(bool))
@@ -232,6 +240,14 @@ OptionsWidget::whiteMarginsToggled(bool const checked)
 	emit reloadRequested();
 }
 
+void
+OptionsWidget::layeredOutputToggled(bool const checked)
+{
+	m_colorParams.setLayeredOutput(checked);
+	m_ptrSettings->setColorParams(m_pageId, m_colorParams);
+	emit reloadRequested();
+}
+
 void
 OptionsWidget::equalizeIlluminationToggled(bool const checked)
 {
@@ -623,6 +639,12 @@ OptionsWidget::updateColorsDisplay()
 		equalizeIlluminationCB->setEnabled(opt.whiteMargins());
 	}
 	
+	bool const mixed_options_visible = color_mode == ColorParams::MIXED;
+	mixedOptions->setVisible(mixed_options_visible);
+	if (mixed_options_visible) {
+		layeredOutputCB->setChecked(m_colorParams.layeredOutput());
+	}
+	
 	modePanel->setVisible(m_lastTab != TAB_DEWARPING);
 	bwOptions->setVisible(bw_options_visible);
 	despecklePanel->setVisible(bw_options_visible && m_lastTab != TAB_DEWARPING);
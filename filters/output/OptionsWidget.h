@@ -60,6 +60,15 @@ public:
 	ImageViewTab lastTab() const { return m_lastTab; }
 
 	DepthPerception const& depthPerception() const { return m_depthPerception; }
+
+	/**
+	 * \brief Emits invalidateThumbnail() for a page whose output
+	 *        thumbnail was recreated.
+	 *
+	 * May be called from any thread.  Connections to objects living
+	 * in the GUI thread are queued then.
+	 */
+	void outputThumbnailRecreated(PageId const& page_id) { emit invalidateThumbnail(page_id); }
 signals:
 	void despeckleLevelChanged(DespeckleLevel level, bool* handled);
 
@@ -81,6 +90,8 @@ private slots:
 	
 	void whiteMarginsToggled(bool checked);
 	
+	void layeredOutputToggled(bool checked);
+	
 	void equalizeIlluminationToggled(bool checked);
 	
 	void setLighterThreshold();
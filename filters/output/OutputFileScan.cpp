@@ -0,0 +1,99 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "OutputFileScan.h"
+#include <QFileInfo>
+#include <QDir>
+#include <QMutexLocker>
+#ifndef Q_MOC_RUN
+#include <boost/foreach.hpp>
+#endif
+
+namespace output
+{
+
+OutputFileScan::OutputFileScan()
+{
+}
+
+OutputFileScan::~OutputFileScan()
+{
+}
+
+OutputFileParams
+OutputFileScan::fileParams(QString const& file_path)
+{
+	// Note that constructing a QFileInfo doesn't touch the file system.
+	QFileInfo const file_info(file_path);
+
+	QMutexLocker const locker(&m_mutex);
+
+	DirContents const& contents = dirContentsLocked(file_info.absolutePath());
+	DirContents::const_iterator const it(contents.find(file_info.fileName()));
+	if (it == contents.end()) {
+		return OutputFileParams();
+	} else {
+		return it->second;
+	}
+}
+
+void
+OutputFileScan::update(QString const& file_path, OutputFileParams const& params)
+{
+	QFileInfo const file_info(file_path);
+
+	QMutexLocker const locker(&m_mutex);
+
+	DirContents& contents = dirContentsLocked(file_info.absolutePath());
+	if (params.isValid()) {
+		contents[file_info.fileName()] = params;
+	} else {
+		contents.erase(file_info.fileName());
+	}
+}
+
+void
+OutputFileScan::clear()
+{
+	QMutexLocker const locker(&m_mutex);
+	m_dirs.clear();
+}
+
+OutputFileScan::DirContents&
+OutputFileScan::dirContentsLocked(QString const& dir_path)
+{
+	Dirs::iterator it(m_dirs.lower_bound(dir_path));
+	if (it != m_dirs.end() && it->first == dir_path) {
+		return it->second;
+	}
+
+	it = m_dirs.insert(it, Dirs::value_type(dir_path, DirContents()));
+	DirContents& contents = it->second;
+
+	// A missing directory simply produces an empty list.
+	QFileInfoList const entries(
+		QDir(dir_path).entryInfoList(QDir::Files|QDir::Hidden|QDir::NoDotAndDotDot)
+	);
+	BOOST_FOREACH(QFileInfo const& entry, entries) {
+		contents.insert(DirContents::value_type(entry.fileName(), OutputFileParams(entry)));
+	}
+
+	return contents;
+}
+
+} // namespace output
@@ -0,0 +1,82 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OUTPUT_OUTPUT_FILE_SCAN_H_
+#define OUTPUT_OUTPUT_FILE_SCAN_H_
+
+#include "RefCountable.h"
+#include "NonCopyable.h"
+#include "OutputFileParams.h"
+#include <QMutex>
+#include <QString>
+#include <map>
+
+namespace output
+{
+
+/**
+ * \brief OutputFileParams of files in output directories, collected
+ *        with a single listing of each directory.
+ *
+ * In batch processing, this is used to decide whether output files are
+ * up to date, without querying the file system for each of them separately.
+ * A directory is listed the first time a file in it is asked about.
+ * Files written after that have to be reported through update().
+ *
+ * \note All methods of this class are thread-safe.
+ */
+class OutputFileScan : public RefCountable
+{
+	DECLARE_NON_COPYABLE(OutputFileScan)
+public:
+	OutputFileScan();
+
+	virtual ~OutputFileScan();
+
+	/**
+	 * \brief Returns the parameters of a file.
+	 *
+	 * If the file doesn't exist, the returned parameters will be invalid.
+	 */
+	OutputFileParams fileParams(QString const& file_path);
+
+	/**
+	 * \brief Records the parameters of a file that was just written.
+	 */
+	void update(QString const& file_path, OutputFileParams const& params);
+
+	/**
+	 * \brief Forgets everything, so that directories will be listed again.
+	 */
+	void clear();
+private:
+	/** Maps file names to their parameters. */
+	typedef std::map<QString, OutputFileParams> DirContents;
+
+	/** Maps absolute directory paths to their contents. */
+	typedef std::map<QString, DirContents> Dirs;
+
+	DirContents& dirContentsLocked(QString const& dir_path);
+
+	QMutex m_mutex;
+	Dirs m_dirs;
+};
+
+} // namespace output
+
+#endif
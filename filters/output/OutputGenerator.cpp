@@ -17,6 +17,8 @@
 */
 
 #include "OutputGenerator.h"
+#include "OutputLayers.h"
+#include "PictureZoneComparator.h"
 #include "ImageTransformation.h"
 #include "FilterData.h"
 #include "TaskStatus.h"
@@ -32,6 +34,7 @@
 #include "ZoneSet.h"
 #include "PictureLayerProperty.h"
 #include "FillColorProperty.h"
+#include "MrcLayers.h"
 #include "dewarping/CylindricalSurfaceDewarper.h"
 #include "dewarping/TextLineTracer.h"
 #include "dewarping/TopBottomEdgeTracer.h"
@@ -60,6 +63,7 @@
 #include "imageproc/PolygonRasterizer.h"
 #include "imageproc/ConnectivityMap.h"
 #include "imageproc/InfluenceMap.h"
+#include "imageproc/ParallelLines.h"
 #include "config.h"
 #ifndef Q_MOC_RUN
 #include <boost/foreach.hpp>
@@ -88,6 +92,11 @@
 #include <string.h>
 #include <stdint.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OUTPUT_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 using namespace imageproc;
 using namespace dewarping;
 
@@ -157,18 +166,100 @@ uint8_t reserveBlackAndWhite(uint8_t color)
 	}
 }
 
+/**
+ * Applies reserveBlackAndWhite() to \p count consecutive pixels.
+ */
+template<typename PixelType>
+void reserveBlackAndWhiteRun(PixelType* pixels, int count);
+
+template<>
+void reserveBlackAndWhiteRun(uint32_t* pixels, int const count)
+{
+	int i = 0;
+	
+#ifdef OUTPUT_USE_SSE2
+	__m128i const rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+	__m128i const reserved_black = _mm_set1_epi32(0xFF010101);
+	__m128i const reserved_white = _mm_set1_epi32(0xFFFEFEFE);
+	__m128i const zero = _mm_setzero_si128();
+	
+	for (; i + 4 <= count; i += 4) {
+		__m128i* const p = reinterpret_cast<__m128i*>(pixels + i);
+		__m128i const px = _mm_loadu_si128(p);
+		__m128i const rgb = _mm_and_si128(px, rgb_mask);
+		__m128i const black = _mm_cmpeq_epi32(rgb, zero);
+		__m128i const white = _mm_cmpeq_epi32(rgb, rgb_mask);
+		__m128i const reserved = _mm_or_si128(black, white);
+		
+		__m128i res = _mm_andnot_si128(reserved, px);
+		res = _mm_or_si128(res, _mm_and_si128(black, reserved_black));
+		res = _mm_or_si128(res, _mm_and_si128(white, reserved_white));
+		_mm_storeu_si128(p, res);
+	}
+#endif
+	
+	for (; i < count; ++i) {
+		pixels[i] = reserveBlackAndWhite<uint32_t>(pixels[i]);
+	}
+}
+
+template<>
+void reserveBlackAndWhiteRun(uint8_t* pixels, int const count)
+{
+	int i = 0;
+	
+#ifdef OUTPUT_USE_SSE2
+	__m128i const zero = _mm_setzero_si128();
+	__m128i const all_ones = _mm_set1_epi8(-1);
+	
+	for (; i + 16 <= count; i += 16) {
+		__m128i* const p = reinterpret_cast<__m128i*>(pixels + i);
+		__m128i const px = _mm_loadu_si128(p);
+		
+		// Comparison results are 0 or -1, so subtracting the first one
+		// turns 0x00 into 0x01, while adding the second one turns
+		// 0xFF into 0xFE.
+		__m128i const black = _mm_cmpeq_epi8(px, zero);
+		__m128i const white = _mm_cmpeq_epi8(px, all_ones);
+		_mm_storeu_si128(p, _mm_add_epi8(_mm_sub_epi8(px, black), white));
+	}
+#endif
+	
+	for (; i < count; ++i) {
+		pixels[i] = reserveBlackAndWhite<uint8_t>(pixels[i]);
+	}
+}
+
+template<typename PixelType>
+class ReserveBlackAndWhiteLines
+{
+public:
+	ReserveBlackAndWhiteLines(PixelType* data, int stride, int width)
+	: m_pData(data), m_stride(stride), m_width(width) {}
+	
+	void operator()(int const first_line, int const end_line) const
+	{
+		PixelType* line = m_pData + first_line * m_stride;
+		for (int y = first_line; y < end_line; ++y, line += m_stride) {
+			reserveBlackAndWhiteRun(line, m_width);
+		}
+	}
+private:
+	PixelType* m_pData;
+	int m_stride;
+	int m_width;
+};
+
 template<typename PixelType>
 void reserveBlackAndWhite(QSize size, int stride, PixelType* data)
 {
 	int const width = size.width();
 	int const height = size.height();
 
-	PixelType* line = data;
-	for (int y = 0; y < height; ++y, line += stride) {
-		for (int x = 0; x < width; ++x) {
-			line[x] = reserveBlackAndWhite<PixelType>(line[x]);
-		}
-	}
+	processLinesInParallel(
+		height, 64, double(width) * height,
+		ReserveBlackAndWhiteLines<PixelType>(data, stride, width)
+	);
 }
 
 void reserveBlackAndWhite(QImage& img)
@@ -186,54 +277,127 @@ void reserveBlackAndWhite(QImage& img)
 	}
 }
 
+/**
+ * Sets \p count pixels to pure black or pure white, according to
+ * \p content_bits, starting from its most significant bit.
+ */
+template<typename MixedPixel>
+void fillBlackAndWhiteRun(MixedPixel* pixels, uint32_t content_bits, int const count)
+{
+	// Same as what we would get by truncating opaque black or white.
+	MixedPixel const black = static_cast<MixedPixel>(uint32_t(0xff000000));
+	MixedPixel const white = static_cast<MixedPixel>(uint32_t(0xffffffff));
+	
+	uint32_t const used_bits = count == 32 ? ~uint32_t(0) : ~(~uint32_t(0) >> count);
+	content_bits &= used_bits;
+	
+	if (content_bits == 0) {
+		std::fill(pixels, pixels + count, white);
+	} else if (content_bits == used_bits) {
+		std::fill(pixels, pixels + count, black);
+	} else {
+		for (int i = 0; i < count; ++i, content_bits <<= 1) {
+			pixels[i] = (content_bits & 0x80000000) ? black : white;
+		}
+	}
+}
+
+template<typename MixedPixel>
+class CombineMixedLines
+{
+public:
+	CombineMixedLines(QImage& mixed, BinaryImage const& bw_content, BinaryImage const& bw_mask)
+	:	m_pMixed(reinterpret_cast<MixedPixel*>(mixed.bits())),
+		m_pContent(bw_content.data()),
+		m_pMask(bw_mask.data()),
+		m_mixedStride(mixed.bytesPerLine() / sizeof(MixedPixel)),
+		m_contentStride(bw_content.wordsPerLine()),
+		m_maskStride(bw_mask.wordsPerLine()),
+		m_width(mixed.width()) {}
+	
+	void operator()(int const first_line, int const end_line) const
+	{
+		MixedPixel* mixed_line = m_pMixed + first_line * m_mixedStride;
+		uint32_t const* content_line = m_pContent + first_line * m_contentStride;
+		uint32_t const* mask_line = m_pMask + first_line * m_maskStride;
+		
+		for (int y = first_line; y < end_line; ++y) {
+			for (int x = 0; x < m_width; x += 32) {
+				combineWord(
+					mixed_line + x, content_line[x >> 5], mask_line[x >> 5],
+					std::min(32, m_width - x)
+				);
+			}
+			mixed_line += m_mixedStride;
+			content_line += m_contentStride;
+			mask_line += m_maskStride;
+		}
+	}
+private:
+	/**
+	 * Processes up to 32 pixels corresponding to a single mask word.
+	 * Words that are entirely B/W or entirely picture are handled as runs.
+	 */
+	static void combineWord(
+		MixedPixel* pixels, uint32_t content_bits, uint32_t mask_bits, int const count)
+	{
+		uint32_t const used_bits = count == 32 ? ~uint32_t(0) : ~(~uint32_t(0) >> count);
+		mask_bits &= used_bits;
+		
+		if (mask_bits == 0) {
+			reserveBlackAndWhiteRun(pixels, count);
+		} else if (mask_bits == used_bits) {
+			fillBlackAndWhiteRun(pixels, content_bits, count);
+		} else {
+			for (int i = 0; i < count; ++i) {
+				uint32_t const bit = uint32_t(0x80000000) >> i;
+				if (mask_bits & bit) {
+					fillBlackAndWhiteRun(pixels + i, content_bits << i, 1);
+				} else {
+					pixels[i] = reserveBlackAndWhite<MixedPixel>(pixels[i]);
+				}
+			}
+		}
+	}
+	
+	MixedPixel* m_pMixed;
+	uint32_t const* m_pContent;
+	uint32_t const* m_pMask;
+	int m_mixedStride;
+	int m_contentStride;
+	int m_maskStride;
+	int m_width;
+};
+
 /**
  * Fills areas of \p mixed with pixels from \p bw_content in
  * areas where \p bw_mask is black.  Supported \p mixed image formats
  * are Indexed8 grayscale, RGB32 and ARGB32.
  * The \p MixedPixel type is uint8_t for Indexed8 grayscale and uint32_t
  * for RGB32 and ARGB32.
+ *
+ * Pixels not covered by \p bw_mask go through reserveBlackAndWhite().
  */
 template<typename MixedPixel>
 void combineMixed(
 	QImage& mixed, BinaryImage const& bw_content,
 	BinaryImage const& bw_mask)
 {
-	MixedPixel* mixed_line = reinterpret_cast<MixedPixel*>(mixed.bits());
-	int const mixed_stride = mixed.bytesPerLine() / sizeof(MixedPixel);
-	uint32_t const* bw_content_line = bw_content.data();
-	int const bw_content_stride = bw_content.wordsPerLine();
-	uint32_t const* bw_mask_line = bw_mask.data();
-	int const bw_mask_stride = bw_mask.wordsPerLine();
 	int const width = mixed.width();
 	int const height = mixed.height();
-	uint32_t const msb = uint32_t(1) << 31;
-	
-	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width; ++x) {
-			if (bw_mask_line[x >> 5] & (msb >> (x & 31))) {
-				// B/W content.
-
-				uint32_t tmp = bw_content_line[x >> 5];
-				tmp >>= (31 - (x & 31));
-				tmp &= uint32_t(1);
-				// Now it's 0 for white and 1 for black.
-				
-				--tmp; // 0 becomes 0xffffffff and 1 becomes 0.
-				
-				tmp |= 0xff000000; // Force opacity.
-				
-				mixed_line[x] = static_cast<MixedPixel>(tmp);
-			} else {
-				// Non-B/W content.
-				mixed_line[x] = reserveBlackAndWhite<MixedPixel>(mixed_line[x]);
-			}
-		}
-		mixed_line += mixed_stride;
-		bw_content_line += bw_content_stride;
-		bw_mask_line += bw_mask_stride;
-	}
+	
+	processLinesInParallel(
+		height, 64, double(width) * height,
+		CombineMixedLines<MixedPixel>(mixed, bw_content, bw_mask)
+	);
 }
 
+/**
+ * How far a change in the input of morphologicalSmoothInPlace() may propagate.
+ * It does 24 hit-miss passes, each with a pattern no larger than 9 pixels.
+ */
+int const MORPHOLOGICAL_SMOOTHING_REACH = 24 * 8;
+
 } // anonymous namespace
 
 
@@ -264,16 +428,35 @@ OutputGenerator::process(
 	DepthPerception const& depth_perception,
 	imageproc::BinaryImage* auto_picture_mask,
 	imageproc::BinaryImage* speckles_image,
-	DebugImages* const dbg) const
+	DebugImages* const dbg, OutputLayers* const layers,
+	MrcLayers* const mrc_layers) const
 {
+	if (layers) {
+		*layers = OutputLayers();
+	}
+	if (mrc_layers) {
+		*mrc_layers = MrcLayers();
+	}
+
 	QImage image(
 		processImpl(
 			status, input, picture_zones, fill_zones,
 			dewarping_mode, distortion_model, depth_perception,
-			auto_picture_mask, speckles_image, dbg
+			auto_picture_mask, speckles_image, dbg, layers, mrc_layers
 		)
 	);
 	assert(!image.isNull());
+
+	if (layers && !layers->isNull()) {
+		layers->m_thresholdAdjustment = m_colorParams.blackWhiteOptions().thresholdAdjustment();
+		layers->m_despeckleLevel = m_despeckleLevel;
+		if (auto_picture_mask) {
+			layers->m_autoPictureMask = *auto_picture_mask;
+		}
+		if (speckles_image) {
+			layers->m_speckles = *speckles_image;
+		}
+	}
 	
 	// Set the correct DPI.
 	Dpm const output_dpm(m_dpi);
@@ -283,6 +466,339 @@ OutputGenerator::process(
 	return image;
 }
 
+QImage
+OutputGenerator::reprocess(
+	TaskStatus const& status,
+	ZoneSet const& picture_zones, ZoneSet const& fill_zones,
+	OutputLayers& layers, DistortionModel& distortion_model,
+	imageproc::BinaryImage* auto_picture_mask,
+	imageproc::BinaryImage* speckles_image,
+	MrcLayers* const mrc_layers) const
+{
+	if (layers.isNull()) {
+		return QImage();
+	}
+
+	RenderParams const render_params(m_colorParams);
+	int const threshold_adjustment = m_colorParams.blackWhiteOptions().thresholdAdjustment();
+
+	bool const zones_changed = layers.dependsOnPictureZones()
+		&& !PictureZoneComparator::equal(layers.m_pictureZones, picture_zones);
+	bool const threshold_changed = render_params.needBinarization()
+		&& layers.m_thresholdAdjustment != threshold_adjustment;
+	bool const despeckling_changed = render_params.needBinarization()
+		&& layers.m_despeckleLevel != m_despeckleLevel;
+
+	// Whether the despeckling was redone, producing a new speckles image.
+	bool despeckled = false;
+
+	if (zones_changed || threshold_changed || despeckling_changed) {
+		if (!layers.hasBinarizationLayers()) {
+			return QImage();
+		}
+		if (layers.hasPictureLayers()) {
+			despeckled = recomposeMixed(status, picture_zones, layers, speckles_image);
+		} else {
+			despeckled = rebinarize(status, threshold_changed, layers, speckles_image);
+		}
+		layers.m_thresholdAdjustment = threshold_adjustment;
+		layers.m_despeckleLevel = m_despeckleLevel;
+	}
+
+	status.throwIfCancelled();
+
+	QImage image(layers.m_unfilledOutput);
+	if (image.format() == QImage::Format_Mono) {
+		BinaryImage bw_image(image);
+		applyFillZonesInPlace(bw_image, fill_zones, layers.m_origToOutput);
+		image = bw_image.toQImage();
+	} else {
+		applyFillZonesInPlace(image, fill_zones, layers.m_origToOutput);
+		if (layers.m_reserveBlackAndWhiteAfterFill) {
+			reserveBlackAndWhite(image);
+		}
+	}
+
+	if (layers.m_distortionModel.isValid()) {
+		distortion_model = layers.m_distortionModel;
+	}
+	if (auto_picture_mask) {
+		*auto_picture_mask = layers.m_autoPictureMask;
+	}
+	if (speckles_image) {
+		if (despeckled) {
+			layers.m_speckles = *speckles_image;
+		} else {
+			*speckles_image = layers.m_speckles;
+		}
+	}
+	if (mrc_layers) {
+		if (layers.m_mixedBwMask.isNull()) {
+			*mrc_layers = MrcLayers();
+		} else {
+			*mrc_layers = buildMrcLayers(
+				image, layers.m_mixedBwContent, layers.m_mixedBwMask,
+				fill_zones, layers.m_origToOutput
+			);
+		}
+	}
+
+	// Set the correct DPI.
+	Dpm const output_dpm(m_dpi);
+	image.setDotsPerMeterX(output_dpm.horizontal());
+	image.setDotsPerMeterY(output_dpm.vertical());
+
+	return image;
+}
+
+/**
+ * Brings the layers of Mixed output without dewarping up to date with
+ * new picture zones, binarization threshold and despeckling level,
+ * starting from the first step affected by the change.
+ *
+ * If neither the resulting threshold changed nor any despeckling is involved,
+ * only the neighbourhood of the picture zones that changed is re-composed.
+ * Otherwise, the threshold and despeckling being non-local, everything
+ * starting from binarization or from despeckling is redone for the whole image.
+ *
+ * \return true if despeckling was redone, in which case \p speckles_image,
+ *         if provided, receives the new speckles.
+ */
+bool
+OutputGenerator::recomposeMixed(
+	TaskStatus const& status, ZoneSet const& picture_zones,
+	OutputLayers& layers, BinaryImage* speckles_image) const
+{
+	QRect const small_margins_rect(layers.m_smallMarginsRect);
+
+	QRect const dirty_rect(
+		pictureZonesDirtyRect(layers.m_pictureZones, picture_zones, small_margins_rect)
+	);
+	layers.m_pictureZones = picture_zones;
+
+	BinaryImage bw_mask(layers.m_autoBwMask);
+	modifyBinarizationMask(bw_mask, small_margins_rect, picture_zones);
+
+	status.throwIfCancelled();
+
+	// Crop area in layers' coordinates.
+	QPolygonF crop_area(m_xform.resultingPreCropArea());
+	crop_area.translate(-small_margins_rect.topLeft());
+
+	BinaryImage const binarization_mask(
+		buildBinarizationMask(layers.m_smoothed.size(), crop_area, &bw_mask)
+	);
+	BinaryThreshold const threshold(
+		calcBinarizationThreshold(layers.m_smoothed, binarization_mask)
+	);
+
+	status.throwIfCancelled();
+
+	bool const same_threshold = (threshold == layers.m_threshold);
+	bool const same_despeckling = (m_despeckleLevel == layers.m_despeckleLevel);
+
+	if (same_threshold && same_despeckling && dirty_rect.isEmpty()) {
+		// Say, the zones were merely reordered.
+		return false;
+	}
+
+	if (same_threshold && same_despeckling && m_despeckleLevel == DESPECKLE_OFF) {
+		recomposeRect(status, layers, bw_mask, binarization_mask, threshold, dirty_rect);
+		return false;
+	}
+
+	BinaryImage bw_content;
+	if (same_threshold && dirty_rect.isEmpty()) {
+		// Only the despeckling level has changed.
+		bw_content = layers.m_preDespeckle;
+	} else {
+		bw_content = binarizeMixed(
+			status, layers.m_smoothed, bw_mask, binarization_mask, threshold, 0
+		);
+		layers.m_preDespeckle = bw_content;
+		layers.m_threshold = threshold;
+	}
+
+	QImage mixed(layers.m_pictureLayer);
+	despeckleAndCombineMixed(
+		status, mixed, bw_content, bw_mask,
+		small_margins_rect, speckles_image, 0
+	);
+	layers.m_unfilledOutput = composeOutput(mixed, small_margins_rect);
+	storeMixedBwLayers(layers, bw_content, bw_mask, small_margins_rect);
+
+	return true;
+}
+
+/**
+ * Brings the layers of B/W output without dewarping up to date with
+ * new binarization threshold and despeckling level.
+ *
+ * \return true if despeckling was redone, in which case \p speckles_image,
+ *         if provided, receives the new speckles.
+ */
+bool
+OutputGenerator::rebinarize(
+	TaskStatus const& status, bool const threshold_changed,
+	OutputLayers& layers, BinaryImage* speckles_image) const
+{
+	BinaryImage dst(layers.m_preDespeckle);
+	if (threshold_changed) {
+		QPolygonF crop_area(m_xform.resultingPreCropArea());
+		crop_area.translate(-layers.m_smallMarginsRect.topLeft());
+
+		// A different adjustment doesn't necessarily make for
+		// a different threshold, as it gets clamped.
+		BinaryThreshold const threshold(
+			calcBinarizationThreshold(layers.m_smoothed, crop_area)
+		);
+		if (threshold != layers.m_threshold) {
+			dst = binarizeWithoutDewarping(
+				status, layers.m_smoothed, crop_area,
+				layers.m_smallMarginsRect, threshold, 0
+			);
+			layers.m_preDespeckle = dst;
+			layers.m_threshold = threshold;
+		} else if (layers.m_despeckleLevel == m_despeckleLevel) {
+			// Nothing to redo.
+			return false;
+		}
+	}
+
+	status.throwIfCancelled();
+
+	maybeDespeckleInPlace(
+		dst, m_outRect, m_outRect, m_despeckleLevel,
+		speckles_image, m_dpi, status, 0
+	);
+	layers.m_unfilledOutput = dst.toQImage();
+
+	return true;
+}
+
+/**
+ * Redoes binarization and combining of layers in the area that may be affected
+ * by changes of the binarization mask within \p dirty_rect.  This produces
+ * exactly the same result as doing it for the whole image would, provided
+ * the binarization threshold didn't change and no despeckling is involved.
+ */
+void
+OutputGenerator::recomposeRect(
+	TaskStatus const& status, OutputLayers& layers,
+	BinaryImage const& bw_mask, BinaryImage const& binarization_mask,
+	BinaryThreshold const threshold, QRect const& dirty_rect) const
+{
+	int const reach = MORPHOLOGICAL_SMOOTHING_REACH;
+	QRect const full_rect(layers.m_smoothed.rect());
+
+	// The area where the output may change.
+	QRect const affected_rect(
+		dirty_rect.adjusted(-reach, -reach, reach, reach).intersected(full_rect)
+	);
+
+	// The area we need to binarize to get affected_rect right.
+	QRect const work_rect(
+		affected_rect.adjusted(-reach, -reach, reach, reach).intersected(full_rect)
+	);
+
+	BinaryImage bw_content(layers.m_smoothed, work_rect, threshold);
+	rasterOp<RopAnd<RopSrc, RopDst> >(
+		bw_content, bw_content.rect(), binarization_mask, work_rect.topLeft()
+	);
+
+	status.throwIfCancelled();
+
+	morphologicalSmoothInPlace(bw_content, status);
+
+	status.throwIfCancelled();
+
+	BinaryImage affected_content(affected_rect.size());
+	rasterOp<RopSrc>(
+		affected_content, affected_content.rect(), bw_content,
+		affected_rect.topLeft() - work_rect.topLeft()
+	);
+	bw_content.release(); // Save memory.
+
+	BinaryImage affected_mask(affected_rect.size());
+	rasterOp<RopSrc>(
+		affected_mask, affected_mask.rect(), bw_mask, affected_rect.topLeft()
+	);
+	rasterOp<RopAnd<RopSrc, RopDst> >(affected_content, affected_mask);
+
+	// With no despeckling, this is also the despeckled content.
+	rasterOp<RopSrc>(
+		layers.m_preDespeckle, affected_rect, affected_content, QPoint(0, 0)
+	);
+
+	QImage mixed(layers.m_pictureLayer.copy(affected_rect));
+	if (mixed.isNull()) {
+		throw std::bad_alloc();
+	}
+	if (mixed.format() == QImage::Format_Indexed8) {
+		combineMixed<uint8_t>(mixed, affected_content, affected_mask);
+	} else {
+		assert(mixed.format() == QImage::Format_RGB32
+			|| mixed.format() == QImage::Format_ARGB32);
+		combineMixed<uint32_t>(mixed, affected_content, affected_mask);
+	}
+
+	// Only the content area gets copied to the output.
+	QPoint const mixed_origin(layers.m_smallMarginsRect.topLeft() + affected_rect.topLeft());
+	QRect const dst_rect(
+		QRect(mixed_origin, affected_rect.size()).intersected(m_contentRect)
+	);
+	if (!dst_rect.isEmpty()) {
+		QImage output(layers.m_unfilledOutput);
+		drawOver(output, dst_rect, mixed, dst_rect.translated(-mixed_origin));
+		layers.m_unfilledOutput = output;
+
+		QPoint const src_pos(dst_rect.topLeft() - mixed_origin);
+		rasterOp<RopSrc>(layers.m_mixedBwContent, dst_rect, affected_content, src_pos);
+		rasterOp<RopSrc>(layers.m_mixedBwMask, dst_rect, affected_mask, src_pos);
+	}
+}
+
+/**
+ * Returns the bounding rectangle of zones present in only one of the zone sets,
+ * in the coordinates of a binarization mask corresponding to \p mask_rect.
+ */
+QRect
+OutputGenerator::pictureZonesDirtyRect(
+	ZoneSet const& old_zones, ZoneSet const& new_zones, QRect const& mask_rect) const
+{
+	QTransform xform(m_xform.transform());
+	xform *= QTransform().translate(-mask_rect.x(), -mask_rect.y());
+
+	QRectF dirty_rect;
+
+	ZoneSet const* const sets[2] = { &old_zones, &new_zones };
+	for (int i = 0; i < 2; ++i) {
+		ZoneSet const& zones = *sets[i];
+		ZoneSet const& other_zones = *sets[1 - i];
+		BOOST_FOREACH(Zone const& zone, zones) {
+			bool found = false;
+			BOOST_FOREACH(Zone const& other_zone, other_zones) {
+				if (PictureZoneComparator::equal(zone, other_zone)) {
+					found = true;
+					break;
+				}
+			}
+			if (!found) {
+				dirty_rect |= xform.map(zone.spline().toPolygon()).boundingRect();
+			}
+		}
+	}
+
+	if (dirty_rect.isNull()) {
+		return QRect();
+	}
+
+	// A pixel of margin to be on the safe side with rasterization.
+	return dirty_rect.toAlignedRect().adjusted(-1, -1, 1, 1).intersected(
+		QRect(QPoint(0, 0), mask_rect.size())
+	);
+}
+
 QSize
 OutputGenerator::outputImageSize() const
 {
@@ -453,7 +969,8 @@ OutputGenerator::processImpl(
 	DepthPerception const& depth_perception,
 	imageproc::BinaryImage* auto_picture_mask,
 	imageproc::BinaryImage* speckles_image,
-	DebugImages* const dbg) const
+	DebugImages* const dbg, OutputLayers* const layers,
+	MrcLayers* const mrc_layers) const
 {
 	RenderParams const render_params(m_colorParams);
 
@@ -462,16 +979,16 @@ OutputGenerator::processImpl(
 		return processWithDewarping(
 			status, input, picture_zones, fill_zones,
 			dewarping_mode, distortion_model, depth_perception,
-			auto_picture_mask, speckles_image, dbg
+			auto_picture_mask, speckles_image, dbg, layers, mrc_layers
 		);
 	} else if (!render_params.whiteMargins()) {
 		return processAsIs(
-			input, status, fill_zones, depth_perception, dbg
+			input, status, fill_zones, depth_perception, dbg, layers
 		);
 	} else {
 		return processWithoutDewarping(
 			status, input, picture_zones, fill_zones,
-			auto_picture_mask, speckles_image, dbg
+			auto_picture_mask, speckles_image, dbg, layers, mrc_layers
 		);
 	}
 }
@@ -481,7 +998,7 @@ OutputGenerator::processAsIs(
 	FilterData const& input, TaskStatus const& status,
 	ZoneSet const& fill_zones,
 	DepthPerception const& depth_perception,
-	DebugImages* const dbg) const
+	DebugImages* const dbg, OutputLayers* const layers) const
 {
 	uint8_t const dominant_gray = reserveBlackAndWhite<uint8_t>(
 		calcDominantBackgroundGrayLevel(input.grayImage())
@@ -521,6 +1038,12 @@ OutputGenerator::processAsIs(
 		);
 	}
 
+	if (layers) {
+		layers->m_unfilledOutput = out;
+		layers->m_origToOutput = origToOutputMapper();
+		layers->m_reserveBlackAndWhiteAfterFill = true;
+	}
+
 	applyFillZonesInPlace(out, fill_zones);
 	reserveBlackAndWhite(out);
 
@@ -533,7 +1056,8 @@ OutputGenerator::processWithoutDewarping(
 	ZoneSet const& picture_zones, ZoneSet const& fill_zones,
 	imageproc::BinaryImage* auto_picture_mask,
 	imageproc::BinaryImage* speckles_image,
-	DebugImages* dbg) const
+	DebugImages* dbg, OutputLayers* const layers,
+	MrcLayers* const mrc_layers) const
 {
 	RenderParams const render_params(m_colorParams);
 	
@@ -611,30 +1135,24 @@ OutputGenerator::processWithoutDewarping(
 	status.throwIfCancelled();
 	
 	if (render_params.binaryOutput() || m_outRect.isEmpty()) {
-		BinaryImage dst(m_outRect.size().expandedTo(QSize(1, 1)), WHITE);
+		BinaryThreshold const threshold(
+			calcBinarizationThreshold(maybe_smoothed, normalize_illumination_crop_area)
+		);
+		BinaryImage dst(
+			binarizeWithoutDewarping(
+				status, maybe_smoothed, normalize_illumination_crop_area,
+				normalize_illumination_rect, threshold, dbg
+			)
+		);
 		
 		if (!m_contentRect.isEmpty()) {
-			BinaryImage bw_content(
-				binarize(maybe_smoothed, normalize_illumination_crop_area)
-			);
-			if (dbg) {
-				dbg->add(bw_content, "binarized_and_cropped");
+			if (layers && render_params.binaryOutput()) {
+				layers->m_smoothed = maybe_smoothed;
+				layers->m_smallMarginsRect = normalize_illumination_rect;
+				layers->m_preDespeckle = dst;
+				layers->m_threshold = threshold;
 			}
 			
-			status.throwIfCancelled();
-			
-			morphologicalSmoothInPlace(bw_content, status);
-			if (dbg) {
-				dbg->add(bw_content, "edges_smoothed");
-			}
-
-			status.throwIfCancelled();
-			
-			QRect const src_rect(m_contentRect.translated(-normalize_illumination_rect.topLeft()));
-			QRect const dst_rect(m_contentRect);
-			rasterOp<RopSrc>(dst, dst_rect, bw_content, src_rect.topLeft());
-			bw_content.release(); // Save memory.
-			
 			// It's important to keep despeckling the very last operation
 			// affecting the binary part of the output. That's because
 			// we will be reconstructing the input to this despeckling
@@ -645,6 +1163,11 @@ OutputGenerator::processWithoutDewarping(
 			);
 		}
 		
+		if (layers) {
+			layers->m_unfilledOutput = dst.toQImage();
+			layers->m_origToOutput = origToOutputMapper();
+		}
+		
 		applyFillZonesInPlace(dst, fill_zones);
 		return dst.toQImage();
 	}
@@ -652,6 +1175,11 @@ OutputGenerator::processWithoutDewarping(
 	QSize const target_size(m_outRect.size().expandedTo(QSize(1, 1)));
 
 	BinaryImage bw_mask;
+
+	// Mixed output's B/W layers in output image coordinates, for MRC output.
+	BinaryImage mixed_bw_content;
+	BinaryImage mixed_bw_mask;
+
 	if (render_params.mixedOutput()) {
 		// This block should go before the block with
 		// adjustBrightnessGrayscale(), which may convert
@@ -681,6 +1209,10 @@ OutputGenerator::processWithoutDewarping(
 
 		status.throwIfCancelled();
 
+		if (layers) {
+			layers->m_autoBwMask = bw_mask;
+		}
+
 		modifyBinarizationMask(bw_mask, small_margins_rect, picture_zones);
 		if (dbg) {
 			dbg->add(bw_mask, "bw_mask with zones");
@@ -711,60 +1243,193 @@ OutputGenerator::processWithoutDewarping(
 		// It's "Color / Grayscale" mode, as we handle B/W above.
 		reserveBlackAndWhite(maybe_normalized);
 	} else {
+		BinaryImage const binarization_mask(
+			buildBinarizationMask(
+				maybe_smoothed.size(), normalize_illumination_crop_area, &bw_mask
+			)
+		);
+		BinaryThreshold const threshold(
+			calcBinarizationThreshold(maybe_smoothed, binarization_mask)
+		);
+
 		BinaryImage bw_content(
-			binarize(maybe_smoothed, normalize_illumination_crop_area, &bw_mask)
+			binarizeMixed(
+				status, maybe_smoothed, bw_mask,
+				binarization_mask, threshold, dbg
+			)
 		);
+
+		if (layers) {
+			// despeckleAndCombineMixed() modifies both maybe_normalized
+			// and bw_content, which will make them detach from the copies
+			// we keep.
+			layers->m_pictureLayer = maybe_normalized;
+			layers->m_smoothed = maybe_smoothed;
+			layers->m_preDespeckle = bw_content;
+			layers->m_smallMarginsRect = small_margins_rect;
+			layers->m_pictureZones = picture_zones;
+			layers->m_threshold = threshold;
+			layers->m_dependsOnPictureZones = true;
+		}
 		maybe_smoothed = QImage(); // Save memory.
-		if (dbg) {
-			dbg->add(bw_content, "binarized_and_cropped");
+
+		despeckleAndCombineMixed(
+			status, maybe_normalized, bw_content, bw_mask,
+			small_margins_rect, speckles_image, dbg
+		);
+
+		if (layers) {
+			storeMixedBwLayers(*layers, bw_content, bw_mask, small_margins_rect);
 		}
-		
-		status.throwIfCancelled();
-		
-		morphologicalSmoothInPlace(bw_content, status);
-		if (dbg) {
-			dbg->add(bw_content, "edges_smoothed");
+		if (mrc_layers) {
+			mixed_bw_content = composeBwOutput(bw_content, small_margins_rect, WHITE);
+			mixed_bw_mask = composeBwOutput(bw_mask, small_margins_rect, BLACK);
 		}
+	}
+	
+	status.throwIfCancelled();
+	
+	assert(!target_size.isEmpty());
+	QImage dst(composeOutput(maybe_normalized, small_margins_rect));
 
-		status.throwIfCancelled();
-		
-		// We don't want speckles in non-B/W areas, as they would
-		// then get visualized on the Despeckling tab.
-		rasterOp<RopAnd<RopSrc, RopDst> >(bw_content, bw_mask);
-
-		status.throwIfCancelled();
+	if (layers) {
+		layers->m_unfilledOutput = dst;
+		layers->m_origToOutput = origToOutputMapper();
+	}
+	
+	applyFillZonesInPlace(dst, fill_zones);
 
-		// It's important to keep despeckling the very last operation
-		// affecting the binary part of the output. That's because
-		// we will be reconstructing the input to this despeckling
-		// operation from the final output file.
-		maybeDespeckleInPlace(
-			bw_content, small_margins_rect, m_contentRect,
-			m_despeckleLevel, speckles_image, m_dpi, status, dbg
+	if (mrc_layers && !mixed_bw_mask.isNull()) {
+		*mrc_layers = buildMrcLayers(
+			dst, mixed_bw_content, mixed_bw_mask, fill_zones, origToOutputMapper()
 		);
-		
-		status.throwIfCancelled();
-		
-		if (maybe_normalized.format() == QImage::Format_Indexed8) {
-			combineMixed<uint8_t>(
-				maybe_normalized, bw_content, bw_mask
-			);
-		} else {
-			assert(maybe_normalized.format() == QImage::Format_RGB32
-				|| maybe_normalized.format() == QImage::Format_ARGB32);
-			
-			combineMixed<uint32_t>(
-				maybe_normalized, bw_content, bw_mask
-			);
-		}
+	}
+
+	return dst;
+}
+
+/**
+ * Produces the B/W output without dewarping, up to despeckling.
+ *
+ * \param smoothed The image to binarize, corresponding to \p smoothed_rect.
+ * \param crop_area Crop area in \p smoothed coordinates.
+ * \param threshold The threshold derived from \p smoothed and \p crop_area.
+ */
+BinaryImage
+OutputGenerator::binarizeWithoutDewarping(
+	TaskStatus const& status, QImage const& smoothed,
+	QPolygonF const& crop_area, QRect const& smoothed_rect,
+	BinaryThreshold const threshold, DebugImages* const dbg) const
+{
+	BinaryImage dst(m_outRect.size().expandedTo(QSize(1, 1)), WHITE);
+	if (m_contentRect.isEmpty()) {
+		return dst;
+	}
+
+	BinaryImage bw_content(binarize(smoothed, crop_area, threshold));
+	if (dbg) {
+		dbg->add(bw_content, "binarized_and_cropped");
 	}
 	
 	status.throwIfCancelled();
 	
-	assert(!target_size.isEmpty());
-	QImage dst(target_size, maybe_normalized.format());
+	morphologicalSmoothInPlace(bw_content, status);
+	if (dbg) {
+		dbg->add(bw_content, "edges_smoothed");
+	}
+
+	status.throwIfCancelled();
+	
+	QRect const src_rect(m_contentRect.translated(-smoothed_rect.topLeft()));
+	QRect const dst_rect(m_contentRect);
+	rasterOp<RopSrc>(dst, dst_rect, bw_content, src_rect.topLeft());
+
+	return dst;
+}
+
+/**
+ * Binarizes \p smoothed for Mixed output, up to despeckling.
+ *
+ * \param binarization_mask The binarization mask combined with the crop area,
+ *        as returned by buildBinarizationMask().
+ * \param threshold The threshold derived from \p binarization_mask.
+ */
+BinaryImage
+OutputGenerator::binarizeMixed(
+	TaskStatus const& status, QImage const& smoothed,
+	BinaryImage const& bw_mask, BinaryImage const& binarization_mask,
+	BinaryThreshold const threshold, DebugImages* const dbg) const
+{
+	BinaryImage bw_content(smoothed, threshold);
+	
+	// Fill masked out areas with white.
+	rasterOp<RopAnd<RopSrc, RopDst> >(bw_content, binarization_mask);
+	if (dbg) {
+		dbg->add(bw_content, "binarized_and_cropped");
+	}
+	
+	status.throwIfCancelled();
+	
+	morphologicalSmoothInPlace(bw_content, status);
+	if (dbg) {
+		dbg->add(bw_content, "edges_smoothed");
+	}
 
-	if (maybe_normalized.format() == QImage::Format_Indexed8) {
+	status.throwIfCancelled();
+	
+	// We don't want speckles in non-B/W areas, as they would
+	// then get visualized on the Despeckling tab.
+	rasterOp<RopAnd<RopSrc, RopDst> >(bw_content, bw_mask);
+
+	return bw_content;
+}
+
+/**
+ * Despeckles \p bw_content and combines it with \p mixed according
+ * to \p bw_mask.  All images correspond to \p small_margins_rect.
+ */
+void
+OutputGenerator::despeckleAndCombineMixed(
+	TaskStatus const& status, QImage& mixed, BinaryImage& bw_content,
+	BinaryImage const& bw_mask, QRect const& small_margins_rect,
+	BinaryImage* speckles_image, DebugImages* const dbg) const
+{
+	status.throwIfCancelled();
+
+	// It's important to keep despeckling the very last operation
+	// affecting the binary part of the output. That's because
+	// we will be reconstructing the input to this despeckling
+	// operation from the final output file.
+	maybeDespeckleInPlace(
+		bw_content, small_margins_rect, m_contentRect,
+		m_despeckleLevel, speckles_image, m_dpi, status, dbg
+	);
+	
+	status.throwIfCancelled();
+	
+	if (mixed.format() == QImage::Format_Indexed8) {
+		combineMixed<uint8_t>(mixed, bw_content, bw_mask);
+	} else {
+		assert(mixed.format() == QImage::Format_RGB32
+			|| mixed.format() == QImage::Format_ARGB32);
+		
+		combineMixed<uint32_t>(mixed, bw_content, bw_mask);
+	}
+}
+
+/**
+ * Places the content area of \p content, which corresponds to
+ * \p small_margins_rect, onto a white output image.
+ */
+QImage
+OutputGenerator::composeOutput(
+	QImage const& content, QRect const& small_margins_rect) const
+{
+	RenderParams const render_params(m_colorParams);
+	QSize const target_size(m_outRect.size().expandedTo(QSize(1, 1)));
+	QImage dst(target_size, content.format());
+
+	if (content.format() == QImage::Format_Indexed8) {
 		dst.setColorTable(createGrayscalePalette());
 		// White.  0xff is reserved if in "Color / Grayscale" mode.
 		uint8_t const color = render_params.mixedOutput() ? 0xff : 0xfe;
@@ -783,13 +1448,83 @@ OutputGenerator::processWithoutDewarping(
 	if (!m_contentRect.isEmpty()) {
 		QRect const src_rect(m_contentRect.translated(-small_margins_rect.topLeft()));
 		QRect const dst_rect(m_contentRect);
-		drawOver(dst, dst_rect, maybe_normalized, src_rect);
+		drawOver(dst, dst_rect, content, src_rect);
 	}
-	
-	applyFillZonesInPlace(dst, fill_zones);
+
 	return dst;
 }
 
+/**
+ * Places the content area of \p content, which corresponds to
+ * \p small_margins_rect, onto an output-sized B/W image.
+ */
+BinaryImage
+OutputGenerator::composeBwOutput(
+	BinaryImage const& content, QRect const& small_margins_rect,
+	BWColor const margins_color) const
+{
+	QSize const target_size(m_outRect.size().expandedTo(QSize(1, 1)));
+	BinaryImage dst(target_size, margins_color);
+
+	if (!m_contentRect.isEmpty()) {
+		QRect const src_rect(m_contentRect.translated(-small_margins_rect.topLeft()));
+		rasterOp<RopSrc>(dst, m_contentRect, content, src_rect.topLeft());
+	}
+
+	return dst;
+}
+
+/**
+ * Stores the B/W content and mask of Mixed output without dewarping,
+ * which correspond to \p small_margins_rect, in output image coordinates.
+ * Margins belong to the B/W content and are white there, as
+ * composeOutput() makes them.
+ */
+void
+OutputGenerator::storeMixedBwLayers(OutputLayers& layers,
+	BinaryImage const& bw_content, BinaryImage const& bw_mask,
+	QRect const& small_margins_rect) const
+{
+	layers.m_mixedBwContent = composeBwOutput(bw_content, small_margins_rect, WHITE);
+	layers.m_mixedBwMask = composeBwOutput(bw_mask, small_margins_rect, BLACK);
+}
+
+/**
+ * Builds MRC layers of the final Mixed output.
+ *
+ * \param output The output image, with fill zones applied.
+ * \param bw_content The B/W content in output image coordinates,
+ *        without fill zones.
+ * \param bw_mask The mask of \p bw_content.
+ *
+ * Fill zones of pure black or white become B/W content.  Others go
+ * to the background, the way they would be split from \p output.
+ */
+MrcLayers
+OutputGenerator::buildMrcLayers(
+	QImage const& output, BinaryImage const& bw_content,
+	BinaryImage const& bw_mask, ZoneSet const& fill_zones,
+	boost::function<QPolygonF(QPolygonF const&)> const& orig_to_output) const
+{
+	BinaryImage text(bw_content);
+	BinaryImage mask(bw_mask);
+	bool const gray = output.format() == QImage::Format_Indexed8;
+
+	BOOST_FOREACH(Zone const& zone, fill_zones) {
+		QColor const color(zone.properties().locateOrDefault<FillColorProperty>()->color());
+		QRgb const rgb = color.rgb() & 0x00ffffff;
+		int const level = gray ? qGray(color.rgb()) : -1;
+		bool const black = gray ? level == 0x00 : rgb == 0x00000000;
+		bool const white = gray ? level == 0xff : rgb == 0x00ffffff;
+
+		QPolygonF const poly(orig_to_output(zone.spline().toPolygon()));
+		PolygonRasterizer::fill(mask, (black || white) ? BLACK : WHITE, poly, Qt::WindingFill);
+		PolygonRasterizer::fill(text, black ? BLACK : WHITE, poly, Qt::WindingFill);
+	}
+
+	return MrcLayers::fromMixed(output, text, mask, Dpm(m_dpi));
+}
+
 QImage
 OutputGenerator::processWithDewarping(
 	TaskStatus const& status, FilterData const& input,
@@ -799,7 +1534,8 @@ OutputGenerator::processWithDewarping(
 	DepthPerception const& depth_perception,
 	imageproc::BinaryImage* auto_picture_mask,
 	imageproc::BinaryImage* speckles_image,
-	DebugImages* dbg) const
+	DebugImages* dbg, OutputLayers* const layers,
+	MrcLayers* const mrc_layers) const
 {
 	QSize const target_size(m_outRect.size().expandedTo(QSize(1, 1)));
 	if (m_outRect.isEmpty()) {
@@ -1060,8 +1796,8 @@ OutputGenerator::processWithDewarping(
 			m_xform.transform(), m_contentRect
 		)
 	);
-	boost::function<QPointF(QPointF const&)> const orig_to_output(
-		boost::bind(&DewarpingPointMapper::mapToDewarpedSpace, mapper, _1)
+	boost::function<QPolygonF(QPolygonF const&)> const orig_to_output(
+		boost::bind(&DewarpingPointMapper::mapPolygonToDewarpedSpace, mapper, _1)
 	);
 
 	if (render_params.binaryOutput()) {	
@@ -1089,11 +1825,21 @@ OutputGenerator::processWithDewarping(
 			speckles_image, m_dpi, status, dbg
 		);
 
+		if (layers) {
+			layers->m_unfilledOutput = dewarped_bw_content.toQImage();
+			layers->m_origToOutput = orig_to_output;
+			layers->m_distortionModel = distortion_model;
+		}
+
 		applyFillZonesInPlace(dewarped_bw_content, fill_zones, orig_to_output);
 
 		return dewarped_bw_content.toQImage();
 	}
 
+	// Mixed output's B/W layers, for MRC output and reprocess().
+	BinaryImage mixed_bw_content;
+	BinaryImage mixed_bw_mask;
+
 	if (!render_params.mixedOutput()) {
 		// It's "Color / Grayscale" mode, as we handle B/W above.
 		reserveBlackAndWhite(dewarped);
@@ -1168,10 +1914,29 @@ OutputGenerator::processWithDewarping(
 				dewarped, dewarped_bw_content, dewarped_bw_mask
 			);
 		}
+
+		mixed_bw_content = dewarped_bw_content;
+		mixed_bw_mask = dewarped_bw_mask;
+	}
+
+	if (layers) {
+		layers->m_unfilledOutput = dewarped;
+		layers->m_origToOutput = orig_to_output;
+		layers->m_distortionModel = distortion_model;
+		layers->m_pictureZones = picture_zones;
+		layers->m_dependsOnPictureZones = render_params.mixedOutput();
+		layers->m_mixedBwContent = mixed_bw_content;
+		layers->m_mixedBwMask = mixed_bw_mask;
 	}
 
 	applyFillZonesInPlace(dewarped, fill_zones, orig_to_output);
 
+	if (mrc_layers && !mixed_bw_mask.isNull()) {
+		*mrc_layers = buildMrcLayers(
+			dewarped, mixed_bw_content, mixed_bw_mask, fill_zones, orig_to_output
+		);
+	}
+
 	return dewarped;
 }
 
@@ -1440,6 +2205,25 @@ OutputGenerator::adjustThreshold(BinaryThreshold threshold) const
 	return BinaryThreshold(qBound(30, adjusted, 225));
 }
 
+/**
+ * Builds a mask of pixels to binarize, from the crop area
+ * and an optional binarization mask.
+ */
+BinaryImage
+OutputGenerator::buildBinarizationMask(
+	QSize const& size, QPolygonF const& crop_area, BinaryImage const* mask) const
+{
+	BinaryImage modified_mask(size, BLACK);
+	PolygonRasterizer::fillExcept(modified_mask, WHITE, crop_area, Qt::WindingFill);
+	modified_mask = erodeBrick(modified_mask, QSize(3, 3), WHITE);
+	
+	if (mask) {
+		rasterOp<RopAnd<RopSrc, RopDst> >(modified_mask, *mask);
+	}
+
+	return modified_mask;
+}
+
 BinaryThreshold
 OutputGenerator::calcBinarizationThreshold(
 	QImage const& image, BinaryImage const& mask) const
@@ -1458,52 +2242,33 @@ OutputGenerator::calcBinarizationThreshold(
 	if (path.contains(image.rect())) {
 		return adjustThreshold(BinaryThreshold::otsuThreshold(image));
 	} else {
-		BinaryImage modified_mask(image.size(), BLACK);
-		PolygonRasterizer::fillExcept(modified_mask, WHITE, crop_area, Qt::WindingFill);
-		modified_mask = erodeBrick(modified_mask, QSize(3, 3), WHITE);
-		
-		if (mask) {
-			rasterOp<RopAnd<RopSrc, RopDst> >(modified_mask, *mask);
-		}
-		
-		return calcBinarizationThreshold(image, modified_mask);
+		return calcBinarizationThreshold(
+			image, buildBinarizationMask(image.size(), crop_area, mask)
+		);
 	}
 }
 
-BinaryImage
-OutputGenerator::binarize(QImage const& image, BinaryImage const& mask) const
-{
-	GrayscaleHistogram hist(image, mask);
-	BinaryThreshold const bw_thresh(BinaryThreshold::otsuThreshold(hist));
-	BinaryImage binarized(image, adjustThreshold(bw_thresh));
-	
-	// Fill masked out areas with white.
-	rasterOp<RopAnd<RopSrc, RopDst> >(binarized, mask);
-	
-	return binarized;
-}
-
+/**
+ * Binarizes \p image with \p threshold, as returned by
+ * calcBinarizationThreshold(), leaving what's outside
+ * \p crop_area white.
+ */
 BinaryImage
 OutputGenerator::binarize(QImage const& image,
-	QPolygonF const& crop_area, BinaryImage const* mask) const
+	QPolygonF const& crop_area, BinaryThreshold const threshold) const
 {
+	BinaryImage binarized(image, threshold);
+
 	QPainterPath path;
 	path.addPolygon(crop_area);
 	
-	if (path.contains(image.rect()) && !mask) {
-		BinaryThreshold const bw_thresh(BinaryThreshold::otsuThreshold(image));
-		return BinaryImage(image, adjustThreshold(bw_thresh));
-	} else {
-		BinaryImage modified_mask(image.size(), BLACK);
-		PolygonRasterizer::fillExcept(modified_mask, WHITE, crop_area, Qt::WindingFill);
-		modified_mask = erodeBrick(modified_mask, QSize(3, 3), WHITE);
-		
-		if (mask) {
-			rasterOp<RopAnd<RopSrc, RopDst> >(modified_mask, *mask);
-		}
-		
-		return binarize(image, modified_mask);
+	if (!path.contains(image.rect())) {
+		rasterOp<RopAnd<RopSrc, RopDst> >(
+			binarized, buildBinarizationMask(image.size(), crop_area)
+		);
 	}
+	
+	return binarized;
 }
 
 /**
@@ -1781,7 +2546,7 @@ OutputGenerator::calcDominantBackgroundGrayLevel(QImage const& img)
 void
 OutputGenerator::applyFillZonesInPlace(
 	QImage& img, ZoneSet const& zones,
-	boost::function<QPointF(QPointF const&)> const& orig_to_output) const
+	boost::function<QPolygonF(QPolygonF const&)> const& orig_to_output) const
 {
 	if (zones.empty()) {
 		return;
@@ -1796,7 +2561,7 @@ OutputGenerator::applyFillZonesInPlace(
 
 		BOOST_FOREACH(Zone const& zone, zones) {
 			QColor const color(zone.properties().locateOrDefault<FillColorProperty>()->color());
-			QPolygonF const poly(zone.spline().transformed(orig_to_output).toPolygon());
+			QPolygonF const poly(orig_to_output(zone.spline().toPolygon()));
 			painter.setBrush(color);
 			painter.drawPolygon(poly, Qt::WindingFill);
 		}
@@ -1816,16 +2581,13 @@ OutputGenerator::applyFillZonesInPlace(
 void
 OutputGenerator::applyFillZonesInPlace(QImage& img, ZoneSet const& zones) const
 {
-	typedef QPointF (QTransform::*MapPointFunc)(QPointF const&) const;
-	applyFillZonesInPlace(
-		img, zones, boost::bind((MapPointFunc)&QTransform::map, m_xform.transform(), _1)
-	);
+	applyFillZonesInPlace(img, zones, origToOutputMapper());
 }
 
 void
 OutputGenerator::applyFillZonesInPlace(
 	imageproc::BinaryImage& img, ZoneSet const& zones,
-	boost::function<QPointF(QPointF const&)> const& orig_to_output) const
+	boost::function<QPolygonF(QPolygonF const&)> const& orig_to_output) const
 {
 	if (zones.empty()) {
 		return;
@@ -1834,7 +2596,7 @@ OutputGenerator::applyFillZonesInPlace(
 	BOOST_FOREACH(Zone const& zone, zones) {
 		QColor const color(zone.properties().locateOrDefault<FillColorProperty>()->color());
 		BWColor const bw_color = qGray(color.rgb()) < 128 ? BLACK : WHITE;
-		QPolygonF const poly(zone.spline().transformed(orig_to_output).toPolygon());
+		QPolygonF const poly(orig_to_output(zone.spline().toPolygon()));
 		PolygonRasterizer::fill(img, bw_color, poly, Qt::WindingFill);
 	}
 }
@@ -1847,10 +2609,14 @@ void
 OutputGenerator::applyFillZonesInPlace(
 	imageproc::BinaryImage& img, ZoneSet const& zones) const
 {
-	typedef QPointF (QTransform::*MapPointFunc)(QPointF const&) const;
-	applyFillZonesInPlace(
-		img, zones, boost::bind((MapPointFunc)&QTransform::map, m_xform.transform(), _1)
-	);
+	applyFillZonesInPlace(img, zones, origToOutputMapper());
+}
+
+boost::function<QPolygonF(QPolygonF const&)>
+OutputGenerator::origToOutputMapper() const
+{
+	typedef QPolygonF (QTransform::*MapPolygonFunc)(QPolygonF const&) const;
+	return boost::bind((MapPolygonFunc)&QTransform::map, m_xform.transform(), _1);
 }
 
 } // namespace output
@@ -20,6 +20,7 @@
 #define OUTPUT_OUTPUTGENERATOR_H_
 
 #include "imageproc/Connectivity.h"
+#include "imageproc/BWColor.h"
 #include "Dpi.h"
 #include "ColorParams.h"
 #include "DepthPerception.h"
@@ -44,6 +45,7 @@ class TaskStatus;
 class DebugImages;
 class FilterData;
 class ZoneSet;
+class MrcLayers;
 class QSize;
 class QImage;
 
@@ -63,6 +65,8 @@ namespace dewarping
 namespace output
 {
 
+class OutputLayers;
+
 class OutputGenerator
 {
 public:
@@ -95,6 +99,13 @@ public:
 	 *        to be performed again with different settings, without going
 	 *        through the whole output generation process again.
 	 * \param dbg An optional sink for debugging images.
+	 * \param layers If provided, the intermediate images that allow
+	 *        reprocess() to do its job will be written there.
+	 * \param mrc_layers If provided and the output is Mixed, the output
+	 *        split into MRC layers will be written there.  The B/W layers
+	 *        come straight from the B/W content and its mask, rather than
+	 *        from the combined image.  For other kinds of output, or if
+	 *        the content area is empty, a null MrcLayers is written.
 	 */
 	QImage process(
 		TaskStatus const& status, FilterData const& input,
@@ -104,7 +115,34 @@ public:
 		DepthPerception const& depth_perception,
 		imageproc::BinaryImage* auto_picture_mask = 0,
 		imageproc::BinaryImage* speckles_image = 0,
-		DebugImages* dbg = 0) const;
+		DebugImages* dbg = 0, OutputLayers* layers = 0,
+		MrcLayers* mrc_layers = 0) const;
+
+	/**
+	 * \brief Re-produce the output image from layers saved by process().
+	 *
+	 * Fill zones are simply re-applied to the cached unfilled output.
+	 * Changes to picture zones, the binarization threshold and
+	 * the despeckling level are only handled for B/W and Mixed output
+	 * without dewarping, by restarting from the first step they affect.
+	 * Picture zone changes are re-composed only in the area affected
+	 * by the zones that changed, when that gives an identical result.
+	 *
+	 * \param layers Layers written by process() called with parameters
+	 *        identical to those of this object, except possibly for the
+	 *        binarization threshold and the despeckling level.  They will be
+	 *        updated to correspond to the current parameters and picture zones.
+	 * \return The output image, or a null image, if the layers can't be
+	 *         used to handle the change, in which case process() has to
+	 *         be called instead.  Other parameters are the same as in process().
+	 */
+	QImage reprocess(
+		TaskStatus const& status,
+		ZoneSet const& picture_zones, ZoneSet const& fill_zones,
+		OutputLayers& layers, dewarping::DistortionModel& distortion_model,
+		imageproc::BinaryImage* auto_picture_mask = 0,
+		imageproc::BinaryImage* speckles_image = 0,
+		MrcLayers* mrc_layers = 0) const;
 	
 	QSize outputImageSize() const;
 	
@@ -121,20 +159,22 @@ private:
 		DepthPerception const& depth_perception,
 		imageproc::BinaryImage* auto_picture_mask = 0,
 		imageproc::BinaryImage* speckles_image = 0,
-		DebugImages* dbg = 0) const;
+		DebugImages* dbg = 0, OutputLayers* layers = 0,
+		MrcLayers* mrc_layers = 0) const;
 
 	QImage processAsIs(
 		FilterData const& input, TaskStatus const& status,
 		ZoneSet const& fill_zones,
 		DepthPerception const& depth_perception,
-		DebugImages* dbg = 0) const;
+		DebugImages* dbg = 0, OutputLayers* layers = 0) const;
 
 	QImage processWithoutDewarping(
 		TaskStatus const& status, FilterData const& input,
 		ZoneSet const& picture_zones, ZoneSet const& fill_zones,
 		imageproc::BinaryImage* auto_picture_mask = 0,
 		imageproc::BinaryImage* speckles_image = 0,
-		DebugImages* dbg = 0) const;
+		DebugImages* dbg = 0, OutputLayers* layers = 0,
+		MrcLayers* mrc_layers = 0) const;
 
 	QImage processWithDewarping(
 		TaskStatus const& status, FilterData const& input,
@@ -144,7 +184,59 @@ private:
 		DepthPerception const& depth_perception,
 		imageproc::BinaryImage* auto_picture_mask = 0,
 		imageproc::BinaryImage* speckles_image = 0,
-		DebugImages* dbg = 0) const;
+		DebugImages* dbg = 0, OutputLayers* layers = 0,
+		MrcLayers* mrc_layers = 0) const;
+
+	bool recomposeMixed(
+		TaskStatus const& status, ZoneSet const& picture_zones,
+		OutputLayers& layers, imageproc::BinaryImage* speckles_image) const;
+
+	bool rebinarize(
+		TaskStatus const& status, bool threshold_changed,
+		OutputLayers& layers, imageproc::BinaryImage* speckles_image) const;
+
+	void recomposeRect(
+		TaskStatus const& status, OutputLayers& layers,
+		imageproc::BinaryImage const& bw_mask,
+		imageproc::BinaryImage const& binarization_mask,
+		imageproc::BinaryThreshold threshold, QRect const& dirty_rect) const;
+
+	QRect pictureZonesDirtyRect(
+		ZoneSet const& old_zones, ZoneSet const& new_zones,
+		QRect const& mask_rect) const;
+
+	imageproc::BinaryImage binarizeWithoutDewarping(
+		TaskStatus const& status, QImage const& smoothed,
+		QPolygonF const& crop_area, QRect const& smoothed_rect,
+		imageproc::BinaryThreshold threshold, DebugImages* dbg) const;
+
+	imageproc::BinaryImage binarizeMixed(
+		TaskStatus const& status, QImage const& smoothed,
+		imageproc::BinaryImage const& bw_mask,
+		imageproc::BinaryImage const& binarization_mask,
+		imageproc::BinaryThreshold threshold, DebugImages* dbg) const;
+
+	void despeckleAndCombineMixed(
+		TaskStatus const& status, QImage& mixed,
+		imageproc::BinaryImage& bw_content,
+		imageproc::BinaryImage const& bw_mask, QRect const& small_margins_rect,
+		imageproc::BinaryImage* speckles_image, DebugImages* dbg) const;
+
+	QImage composeOutput(
+		QImage const& content, QRect const& small_margins_rect) const;
+
+	imageproc::BinaryImage composeBwOutput(
+		imageproc::BinaryImage const& content, QRect const& small_margins_rect,
+		imageproc::BWColor margins_color) const;
+
+	void storeMixedBwLayers(OutputLayers& layers,
+		imageproc::BinaryImage const& bw_content, imageproc::BinaryImage const& bw_mask,
+		QRect const& small_margins_rect) const;
+
+	MrcLayers buildMrcLayers(
+		QImage const& output, imageproc::BinaryImage const& bw_content,
+		imageproc::BinaryImage const& bw_mask, ZoneSet const& fill_zones,
+		boost::function<QPolygonF(QPolygonF const&)> const& orig_to_output) const;
 	
 	void setupTrivialDistortionModel(dewarping::DistortionModel& distortion_model) const;
 
@@ -188,6 +280,10 @@ private:
 	imageproc::BinaryThreshold adjustThreshold(
 		imageproc::BinaryThreshold threshold) const;
 	
+	imageproc::BinaryImage buildBinarizationMask(
+		QSize const& size, QPolygonF const& crop_area,
+		imageproc::BinaryImage const* mask = 0) const;
+
 	imageproc::BinaryThreshold calcBinarizationThreshold(
 		QImage const& image, imageproc::BinaryImage const& mask) const;
 
@@ -195,12 +291,9 @@ private:
 		QImage const& image, QPolygonF const& crop_area,
 		imageproc::BinaryImage const* mask = 0) const;
 
-	imageproc::BinaryImage binarize(
-		QImage const& image, imageproc::BinaryImage const& mask) const;
-	
 	imageproc::BinaryImage binarize(
 		QImage const& image, QPolygonF const& crop_area,
-		imageproc::BinaryImage const* mask = 0) const;
+		imageproc::BinaryThreshold threshold) const;
 	
 	void maybeDespeckleInPlace(
 		imageproc::BinaryImage& image, QRect const& image_rect,
@@ -232,14 +325,16 @@ private:
 		QImage const* morph_background = 0) const;
 
 	void applyFillZonesInPlace(QImage& img, ZoneSet const& zones,
-		boost::function<QPointF(QPointF const&)> const& orig_to_output) const;
+		boost::function<QPolygonF(QPolygonF const&)> const& orig_to_output) const;
 
 	void applyFillZonesInPlace(QImage& img, ZoneSet const& zones) const;
 
 	void applyFillZonesInPlace(imageproc::BinaryImage& img, ZoneSet const& zones,
-		boost::function<QPointF(QPointF const&)> const& orig_to_output) const;
+		boost::function<QPolygonF(QPolygonF const&)> const& orig_to_output) const;
 
 	void applyFillZonesInPlace(imageproc::BinaryImage& img, ZoneSet const& zones) const;
+
+	boost::function<QPolygonF(QPolygonF const&)> origToOutputMapper() const;
 	
 	Dpi m_dpi;
 	ColorParams m_colorParams;
@@ -121,6 +121,22 @@ OutputImageParams::matches(OutputImageParams const& other) const
 	return true;
 }
 
+bool
+OutputImageParams::matchesIgnoringBinarization(OutputImageParams const& other) const
+{
+	OutputImageParams adjusted(other);
+	adjusted.m_colorParams.setBlackWhiteOptions(m_colorParams.blackWhiteOptions());
+	adjusted.m_despeckleLevel = m_despeckleLevel;
+	return matches(adjusted);
+}
+
+bool
+OutputImageParams::fileLayoutMatches(OutputImageParams const& other) const
+{
+	return ColorParams::fileUpdateFor(m_colorParams, other.m_colorParams)
+		== ColorParams::KEEP_FILE;
+}
+
 bool
 OutputImageParams::colorParamsMatch(
 	ColorParams const& cp1, DespeckleLevel const dl1,
@@ -60,6 +60,8 @@ public:
 	DepthPerception const& depthPerception() const { return m_depthPerception; }
 
 	DespeckleLevel despeckleLevel() const { return m_despeckleLevel; }
+
+	ColorParams const& colorParams() const { return m_colorParams; }
 	
 	QDomElement toXml(QDomDocument& doc, QString const& name) const;
 	
@@ -68,6 +70,22 @@ public:
 	 *        to avoid re-generating the output image.
 	 */
 	bool matches(OutputImageParams const& other) const;
+
+	/**
+	 * \brief Same as matches(), except the binarization threshold
+	 *        and the despeckling level are not taken into account.
+	 */
+	bool matchesIgnoringBinarization(OutputImageParams const& other) const;
+
+	/**
+	 * \brief Returns true if the output file would be stored the same way.
+	 *
+	 * Things like layered output don't affect the output image, so they
+	 * are not taken into account by matches().
+	 *
+	 * \see ColorParams::fileUpdateFor()
+	 */
+	bool fileLayoutMatches(OutputImageParams const& other) const;
 private:
 	class PartialXform
 	{
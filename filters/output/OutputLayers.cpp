@@ -0,0 +1,49 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "OutputLayers.h"
+
+namespace output
+{
+
+namespace
+{
+
+size_t bytesOf(QImage const& image)
+{
+	return size_t(image.bytesPerLine()) * image.height();
+}
+
+size_t bytesOf(imageproc::BinaryImage const& image)
+{
+	return size_t(image.wordsPerLine()) * image.height() * 4;
+}
+
+} // anonymous namespace
+
+size_t
+OutputLayers::memoryUsage() const
+{
+	return bytesOf(m_unfilledOutput) + bytesOf(m_autoPictureMask)
+		+ bytesOf(m_speckles) + bytesOf(m_pictureLayer)
+		+ bytesOf(m_smoothed) + bytesOf(m_autoBwMask)
+		+ bytesOf(m_preDespeckle) + bytesOf(m_mixedBwContent)
+		+ bytesOf(m_mixedBwMask);
+}
+
+} // namespace output
@@ -0,0 +1,152 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OUTPUT_OUTPUT_LAYERS_H_
+#define OUTPUT_OUTPUT_LAYERS_H_
+
+#include "ZoneSet.h"
+#include "DespeckleLevel.h"
+#include "dewarping/DistortionModel.h"
+#include "imageproc/BinaryImage.h"
+#ifndef Q_MOC_RUN
+#include <boost/function.hpp>
+#endif
+#include <QImage>
+#include <QRect>
+#include <QPolygonF>
+#include <stddef.h>
+
+namespace output
+{
+
+class OutputGenerator;
+
+/**
+ * \brief Intermediate images of the output generation process.
+ *
+ * OutputGenerator::process() may save these, so that OutputGenerator::reprocess()
+ * would be able to re-generate the output after picture or fill zones were edited,
+ * or after the binarization threshold or the despeckling level were changed,
+ * without going through the whole output generation process again.
+ *
+ * All images are implicitly shared, so copying this object is cheap.
+ */
+class OutputLayers
+{
+	friend class OutputGenerator;
+public:
+	OutputLayers()
+	:	m_threshold(0), m_thresholdAdjustment(0),
+		m_despeckleLevel(DESPECKLE_OFF), m_dependsOnPictureZones(false),
+		m_reserveBlackAndWhiteAfterFill(false) {}
+
+	bool isNull() const { return m_unfilledOutput.isNull(); }
+
+	/**
+	 * \brief Returns true if picture zones were taken into account
+	 *        when producing these layers.
+	 */
+	bool dependsOnPictureZones() const { return m_dependsOnPictureZones; }
+
+	/**
+	 * \brief Returns true if the layers necessary to re-compose the output
+	 *        after a picture zone change are present.
+	 */
+	bool hasPictureLayers() const { return !m_pictureLayer.isNull(); }
+
+	/**
+	 * \brief Returns true if the layers necessary to redo binarization
+	 *        are present.
+	 */
+	bool hasBinarizationLayers() const { return !m_smoothed.isNull(); }
+
+	dewarping::DistortionModel const& distortionModel() const { return m_distortionModel; }
+
+	/**
+	 * \brief Returns the approximate number of bytes occupied by the images.
+	 */
+	size_t memoryUsage() const;
+private:
+	/** The output image before fill zones were applied. */
+	QImage m_unfilledOutput;
+
+	/** Maps original image coordinates to output image ones, for fill zones. */
+	boost::function<QPolygonF(QPolygonF const&)> m_origToOutput;
+
+	/** \see OutputGenerator::process() */
+	imageproc::BinaryImage m_autoPictureMask;
+
+	/** \see OutputGenerator::process() */
+	imageproc::BinaryImage m_speckles;
+
+	/** The distortion model the output was produced with, if dewarping took place. */
+	dewarping::DistortionModel m_distortionModel;
+
+	/** Picture zones the output was produced with. */
+	ZoneSet m_pictureZones;
+
+	/**
+	 * The B/W content and its mask of Mixed output, in output image
+	 * coordinates and before fill zones were applied.  These are present
+	 * with and without dewarping, and allow OutputGenerator::reprocess()
+	 * to produce MRC layers without splitting the combined image.
+	 */
+	imageproc::BinaryImage m_mixedBwContent;
+	imageproc::BinaryImage m_mixedBwMask;
+
+	/**
+	 * The following are only present for B/W and Mixed output without dewarping.
+	 * Except for m_preDespeckle in B/W mode, which corresponds to the whole
+	 * output image, they correspond to m_smallMarginsRect in output image
+	 * coordinates.  m_pictureLayer and m_autoBwMask are only present in Mixed mode.
+	 */
+
+	/** The color or grayscale content before being combined with the B/W one. */
+	QImage m_pictureLayer;
+
+	/** The image being binarized. */
+	QImage m_smoothed;
+
+	/** The binarization mask before picture zones were applied to it. */
+	imageproc::BinaryImage m_autoBwMask;
+
+	/** The B/W content right before despeckling. */
+	imageproc::BinaryImage m_preDespeckle;
+
+	QRect m_smallMarginsRect;
+
+	/**
+	 * Binarization threshold.  For Mixed output, it's derived
+	 * from the mask with zones applied.
+	 */
+	int m_threshold;
+
+	/** \see BlackWhiteOptions::thresholdAdjustment() */
+	int m_thresholdAdjustment;
+
+	DespeckleLevel m_despeckleLevel;
+
+	bool m_dependsOnPictureZones;
+
+	/** processAsIs() reserves black and white after applying fill zones. */
+	bool m_reserveBlackAndWhiteAfterFill;
+};
+
+} // namespace output
+
+#endif
@@ -0,0 +1,121 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RenderCache.h"
+#include <QMutexLocker>
+
+namespace output
+{
+
+RenderCache::RenderCache()
+:	m_memoryUsage(0),
+	m_useCounter(0)
+{
+}
+
+RenderCache::~RenderCache()
+{
+}
+
+bool
+RenderCache::find(
+	PageId const& page_id, OutputImageParams const& params, OutputLayers& layers)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	Map::iterator const it(m_entries.find(page_id));
+	if (it == m_entries.end()) {
+		return false;
+	}
+
+	if (!it->second.params.matchesIgnoringBinarization(params)) {
+		return false;
+	}
+
+	it->second.lastUsed = ++m_useCounter;
+	layers = it->second.layers;
+	return true;
+}
+
+void
+RenderCache::store(
+	PageId const& page_id, OutputImageParams const& params, OutputLayers const& layers)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	Map::iterator const it(m_entries.find(page_id));
+	if (it != m_entries.end()) {
+		m_memoryUsage -= it->second.memoryUsage;
+		m_entries.erase(it);
+	}
+
+	if (layers.isNull()) {
+		return;
+	}
+
+	Entry const entry(params, layers, ++m_useCounter);
+	size_t const max_memory = size_t(MAX_MEMORY_MB) << 20;
+	while (!m_entries.empty() && (m_entries.size() >= MAX_ENTRIES
+			|| m_memoryUsage + entry.memoryUsage > max_memory)) {
+		evictLeastRecentlyUsed();
+	}
+
+	m_entries.insert(Map::value_type(page_id, entry));
+	m_memoryUsage += entry.memoryUsage;
+}
+
+void
+RenderCache::remove(PageId const& page_id)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	Map::iterator const it(m_entries.find(page_id));
+	if (it != m_entries.end()) {
+		m_memoryUsage -= it->second.memoryUsage;
+		m_entries.erase(it);
+	}
+}
+
+void
+RenderCache::clear()
+{
+	QMutexLocker const locker(&m_mutex);
+
+	m_entries.clear();
+	m_memoryUsage = 0;
+}
+
+void
+RenderCache::evictLeastRecentlyUsed()
+{
+	Map::iterator victim(m_entries.begin());
+	Map::iterator it(m_entries.begin());
+	Map::iterator const end(m_entries.end());
+	for (; it != end; ++it) {
+		if (it->second.lastUsed < victim->second.lastUsed) {
+			victim = it;
+		}
+	}
+
+	if (victim != end) {
+		m_memoryUsage -= victim->second.memoryUsage;
+		m_entries.erase(victim);
+	}
+}
+
+} // namespace output
@@ -0,0 +1,99 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OUTPUT_RENDER_CACHE_H_
+#define OUTPUT_RENDER_CACHE_H_
+
+#include "RefCountable.h"
+#include "NonCopyable.h"
+#include "PageId.h"
+#include "OutputImageParams.h"
+#include "OutputLayers.h"
+#include <QMutex>
+#include <QtGlobal>
+#include <map>
+#include <stddef.h>
+
+namespace output
+{
+
+/**
+ * \brief Keeps OutputLayers of the most recently processed pages in memory.
+ *
+ * The cache is bounded both by the number of pages and by the total
+ * amount of memory, except that the most recently stored entry is always
+ * kept, no matter how large it is.
+ *
+ * \note All methods of this class are thread-safe.
+ */
+class RenderCache : public RefCountable
+{
+	DECLARE_NON_COPYABLE(RenderCache)
+public:
+	RenderCache();
+
+	virtual ~RenderCache();
+
+	/**
+	 * \brief Retrieves the layers of a page.
+	 *
+	 * \param page_id The page to retrieve the layers for.
+	 * \param params The parameters the output is about to be produced with.
+	 * \param layers Receives the layers on success.
+	 * \return true if the layers were found and were produced with
+	 *         parameters matching \p params, except possibly for the
+	 *         binarization threshold and the despeckling level.
+	 */
+	bool find(PageId const& page_id, OutputImageParams const& params, OutputLayers& layers);
+
+	void store(PageId const& page_id, OutputImageParams const& params, OutputLayers const& layers);
+
+	void remove(PageId const& page_id);
+
+	void clear();
+private:
+	struct Entry
+	{
+		OutputImageParams params;
+		OutputLayers layers;
+		size_t memoryUsage;
+		quint64 lastUsed;
+
+		Entry(OutputImageParams const& p, OutputLayers const& l, quint64 last_used)
+		: params(p), layers(l), memoryUsage(l.memoryUsage()), lastUsed(last_used) {}
+	};
+
+	typedef std::map<PageId, Entry> Map;
+
+	/** The maximum number of pages we keep the layers for. */
+	enum { MAX_ENTRIES = 4 };
+
+	/** The maximum total size of cached images, in megabytes. */
+	enum { MAX_MEMORY_MB = 512 };
+
+	void evictLeastRecentlyUsed();
+
+	QMutex m_mutex;
+	Map m_entries;
+	size_t m_memoryUsage;
+	quint64 m_useCounter;
+};
+
+} // namespace output
+
+#endif
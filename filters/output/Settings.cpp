@@ -22,7 +22,6 @@
 #include "FillColorProperty.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
-#include "../../Utils.h"
 #ifndef Q_MOC_RUN
 #include <boost/foreach.hpp>
 #endif
@@ -50,10 +49,15 @@ Settings::clear()
 	
 	initialPictureZoneProps().swap(m_defaultPictureZoneProps);
 	initialFillZoneProps().swap(m_defaultFillZoneProps);
-	m_perPageParams.clear();
-	m_perPageOutputParams.clear();
-	m_perPagePictureZones.clear();
-	m_perPageFillZones.clear();
+
+	PerPageParams empty_params;
+	m_perPageParams.publish(empty_params);
+	PerPageOutputParams empty_output_params;
+	m_perPageOutputParams.publish(empty_output_params);
+	PerPageZones empty_picture_zones;
+	m_perPagePictureZones.publish(empty_picture_zones);
+	PerPageZones empty_fill_zones;
+	m_perPageFillZones.publish(empty_fill_zones);
 }
 
 void
@@ -66,158 +70,154 @@ Settings::performRelinking(AbstractRelinker const& relinker)
 	PerPageZones new_picture_zones;
 	PerPageZones new_fill_zones;
 
-	BOOST_FOREACH(PerPageParams::value_type const& kv, m_perPageParams) {
+	SnapshotPublisher<PerPageParams>::Snapshot const old_params(m_perPageParams.snapshot());
+	BOOST_FOREACH(PerPageParams::value_type const& kv, *old_params) {
 		RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
 		PageId new_page_id(kv.first);
 		new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-		new_params.insert(PerPageParams::value_type(new_page_id, kv.second));
+		new_params.set(new_page_id, kv.second);
 	}
 
-	BOOST_FOREACH(PerPageOutputParams::value_type const& kv, m_perPageOutputParams) {
+	SnapshotPublisher<PerPageOutputParams>::Snapshot const old_output_params(
+		m_perPageOutputParams.snapshot()
+	);
+	BOOST_FOREACH(PerPageOutputParams::value_type const& kv, *old_output_params) {
 		RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
 		PageId new_page_id(kv.first);
 		new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-		new_output_params.insert(PerPageOutputParams::value_type(new_page_id, kv.second));
+		new_output_params.set(new_page_id, kv.second);
 	}
 
-	BOOST_FOREACH(PerPageZones::value_type const& kv, m_perPagePictureZones) {
+	SnapshotPublisher<PerPageZones>::Snapshot const old_picture_zones(
+		m_perPagePictureZones.snapshot()
+	);
+	BOOST_FOREACH(PerPageZones::value_type const& kv, *old_picture_zones) {
 		RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
 		PageId new_page_id(kv.first);
 		new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-		new_picture_zones.insert(PerPageZones::value_type(new_page_id, kv.second));
+		new_picture_zones.set(new_page_id, kv.second);
 	}
 
-	BOOST_FOREACH(PerPageZones::value_type const& kv, m_perPageFillZones) {
+	SnapshotPublisher<PerPageZones>::Snapshot const old_fill_zones(
+		m_perPageFillZones.snapshot()
+	);
+	BOOST_FOREACH(PerPageZones::value_type const& kv, *old_fill_zones) {
 		RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
 		PageId new_page_id(kv.first);
 		new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-		new_fill_zones.insert(PerPageZones::value_type(new_page_id, kv.second));
+		new_fill_zones.set(new_page_id, kv.second);
 	}
 
-	m_perPageParams.swap(new_params);
-	m_perPageOutputParams.swap(new_output_params);
-	m_perPagePictureZones.swap(new_picture_zones);
-	m_perPageFillZones.swap(new_fill_zones);
+	m_perPageParams.publish(new_params);
+	m_perPageOutputParams.publish(new_output_params);
+	m_perPagePictureZones.publish(new_picture_zones);
+	m_perPageFillZones.publish(new_fill_zones);
 }
 
 Params
 Settings::getParams(PageId const& page_id) const
 {
-	QMutexLocker const locker(&m_mutex);
-	
-	PerPageParams::const_iterator const it(m_perPageParams.find(page_id));
-	if (it != m_perPageParams.end()) {
-		return it->second;
-	} else {
-		return Params();
-	}
+	SnapshotPublisher<PerPageParams>::Snapshot const params(m_perPageParams.snapshot());
+	return existingOrDefault(*params, page_id);
 }
 
 void
 Settings::setParams(PageId const& page_id, Params const& params)
 {
 	QMutexLocker const locker(&m_mutex);
-	Utils::mapSetValue(m_perPageParams, page_id, params);
+	PerPageParams new_params(*m_perPageParams.snapshot());
+	new_params.set(page_id, params);
+	m_perPageParams.publish(new_params);
 }
 
 void
 Settings::setColorParams(PageId const& page_id, ColorParams const& prms)
 {
 	QMutexLocker const locker(&m_mutex);
+	PerPageParams new_params(*m_perPageParams.snapshot());
 
-	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
-		Params params;
-		params.setColorParams(prms);
-		m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-	} else {
-		it->second.setColorParams(prms);
-	}
+	Params params(existingOrDefault(new_params, page_id));
+	params.setColorParams(prms);
+
+	new_params.set(page_id, params);
+	m_perPageParams.publish(new_params);
 }
 
 void
 Settings::setDpi(PageId const& page_id, Dpi const& dpi)
 {
 	QMutexLocker const locker(&m_mutex);
+	PerPageParams new_params(*m_perPageParams.snapshot());
 
-	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
-		Params params;
-		params.setOutputDpi(dpi);
-		m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-	} else {
-		it->second.setOutputDpi(dpi);
-	}
+	Params params(existingOrDefault(new_params, page_id));
+	params.setOutputDpi(dpi);
+
+	new_params.set(page_id, params);
+	m_perPageParams.publish(new_params);
 }
 
 void
 Settings::setDewarpingMode(PageId const& page_id, DewarpingMode const& mode)
 {
 	QMutexLocker const locker(&m_mutex);
+	PerPageParams new_params(*m_perPageParams.snapshot());
 
-	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
-		Params params;
-		params.setDewarpingMode(mode);
-		m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-	} else {
-		it->second.setDewarpingMode(mode);
-	}
+	Params params(existingOrDefault(new_params, page_id));
+	params.setDewarpingMode(mode);
+
+	new_params.set(page_id, params);
+	m_perPageParams.publish(new_params);
 }
 
 void
 Settings::setDistortionModel(PageId const& page_id, dewarping::DistortionModel const& model)
 {
 	QMutexLocker const locker(&m_mutex);
+	PerPageParams new_params(*m_perPageParams.snapshot());
 
-	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
-		Params params;
-		params.setDistortionModel(model);
-		m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-	} else {
-		it->second.setDistortionModel(model);
-	}
+	Params params(existingOrDefault(new_params, page_id));
+	params.setDistortionModel(model);
+
+	new_params.set(page_id, params);
+	m_perPageParams.publish(new_params);
 }
 
 void
 Settings::setDepthPerception(PageId const& page_id, DepthPerception const& depth_perception)
 {
 	QMutexLocker const locker(&m_mutex);
+	PerPageParams new_params(*m_perPageParams.snapshot());
 
-	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
-		Params params;
-		params.setDepthPerception(depth_perception);
-		m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-	} else {
-		it->second.setDepthPerception(depth_perception);
-	}
+	Params params(existingOrDefault(new_params, page_id));
+	params.setDepthPerception(depth_perception);
+
+	new_params.set(page_id, params);
+	m_perPageParams.publish(new_params);
 }
 
 void
 Settings::setDespeckleLevel(PageId const& page_id, DespeckleLevel level)
 {
 	QMutexLocker const locker(&m_mutex);
+	PerPageParams new_params(*m_perPageParams.snapshot());
 
-	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
-	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
-		Params params;
-		params.setDespeckleLevel(level);
-		m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
-	} else {
-		it->second.setDespeckleLevel(level);
-	}
+	Params params(existingOrDefault(new_params, page_id));
+	params.setDespeckleLevel(level);
+
+	new_params.set(page_id, params);
+	m_perPageParams.publish(new_params);
 }
 
 std::auto_ptr<OutputParams>
 Settings::getOutputParams(PageId const& page_id) const
 {
-	QMutexLocker const locker(&m_mutex);
+	SnapshotPublisher<PerPageOutputParams>::Snapshot const params(
+		m_perPageOutputParams.snapshot()
+	);
 	
-	PerPageOutputParams::const_iterator const it(m_perPageOutputParams.find(page_id));
-	if (it != m_perPageOutputParams.end()) {
-		return std::auto_ptr<OutputParams>(new OutputParams(it->second));
+	OutputParams const* const page_params = params->find(page_id);
+	if (page_params) {
+		return std::auto_ptr<OutputParams>(new OutputParams(*page_params));
 	} else {
 		return std::auto_ptr<OutputParams>();
 	}
@@ -227,24 +227,28 @@ void
 Settings::removeOutputParams(PageId const& page_id)
 {
 	QMutexLocker const locker(&m_mutex);
-	m_perPageOutputParams.erase(page_id);
+	PerPageOutputParams new_params(*m_perPageOutputParams.snapshot());
+	new_params.erase(page_id);
+	m_perPageOutputParams.publish(new_params);
 }
 
 void
 Settings::setOutputParams(PageId const& page_id, OutputParams const& params)
 {
 	QMutexLocker const locker(&m_mutex);
-	Utils::mapSetValue(m_perPageOutputParams, page_id, params);
+	PerPageOutputParams new_params(*m_perPageOutputParams.snapshot());
+	new_params.set(page_id, params);
+	m_perPageOutputParams.publish(new_params);
 }
 
 ZoneSet
 Settings::pictureZonesForPage(PageId const& page_id) const
 {
-	QMutexLocker const locker(&m_mutex);
+	SnapshotPublisher<PerPageZones>::Snapshot const zones(m_perPagePictureZones.snapshot());
 
-	PerPageZones::const_iterator const it(m_perPagePictureZones.find(page_id));
-	if (it != m_perPagePictureZones.end()) {
-		return it->second;
+	ZoneSet const* const page_zones = zones->find(page_id);
+	if (page_zones) {
+		return *page_zones;
 	} else {
 		return ZoneSet();
 	}
@@ -253,11 +257,11 @@ Settings::pictureZonesForPage(PageId const& page_id) const
 ZoneSet
 Settings::fillZonesForPage(PageId const& page_id) const
 {
-	QMutexLocker const locker(&m_mutex);
+	SnapshotPublisher<PerPageZones>::Snapshot const zones(m_perPageFillZones.snapshot());
 
-	PerPageZones::const_iterator const it(m_perPageFillZones.find(page_id));
-	if (it != m_perPageFillZones.end()) {
-		return it->second;
+	ZoneSet const* const page_zones = zones->find(page_id);
+	if (page_zones) {
+		return *page_zones;
 	} else {
 		return ZoneSet();
 	}
@@ -267,14 +271,18 @@ void
 Settings::setPictureZones(PageId const& page_id, ZoneSet const& zones)
 {
 	QMutexLocker const locker(&m_mutex);
-	Utils::mapSetValue(m_perPagePictureZones, page_id, zones);
+	PerPageZones new_zones(*m_perPagePictureZones.snapshot());
+	new_zones.set(page_id, zones);
+	m_perPagePictureZones.publish(new_zones);
 }
 
 void
 Settings::setFillZones(PageId const& page_id, ZoneSet const& zones)
 {
 	QMutexLocker const locker(&m_mutex);
-	Utils::mapSetValue(m_perPageFillZones, page_id, zones);
+	PerPageZones new_zones(*m_perPageFillZones.snapshot());
+	new_zones.set(page_id, zones);
+	m_perPageFillZones.publish(new_zones);
 }
 
 PropertySet
@@ -305,6 +313,17 @@ Settings::setDefaultFillZoneProperties(PropertySet const& props)
 	m_defaultFillZoneProps = props;
 }
 
+Params
+Settings::existingOrDefault(PerPageParams const& params, PageId const& page_id)
+{
+	Params const* const page_params = params.find(page_id);
+	if (page_params) {
+		return *page_params;
+	} else {
+		return Params();
+	}
+}
+
 PropertySet
 Settings::initialPictureZoneProps()
 {
@@ -25,13 +25,15 @@
 #include "Dpi.h"
 #include "ColorParams.h"
 #include "OutputParams.h"
+#include "Params.h"
 #include "DewarpingMode.h"
 #include "dewarping/DistortionModel.h"
 #include "DespeckleLevel.h"
 #include "ZoneSet.h"
 #include "PropertySet.h"
+#include "SnapshotPublisher.h"
+#include "ChunkedMap.h"
 #include <QMutex>
-#include <map>
 #include <memory>
 
 class AbstractRelinker;
@@ -39,8 +41,6 @@ class AbstractRelinker;
 namespace output
 {
 
-class Params;
-
 class Settings : public RefCountable
 {
 	DECLARE_NON_COPYABLE(Settings)
@@ -95,19 +95,25 @@ public:
 
 	void setDefaultFillZoneProperties(PropertySet const& props);
 private:
-	typedef std::map<PageId, Params> PerPageParams;
-	typedef std::map<PageId, OutputParams> PerPageOutputParams;
-	typedef std::map<PageId, ZoneSet> PerPageZones;
+	typedef ChunkedMap<PageId, Params> PerPageParams;
+	typedef ChunkedMap<PageId, OutputParams> PerPageOutputParams;
+	typedef ChunkedMap<PageId, ZoneSet> PerPageZones;
 	
+	static Params existingOrDefault(PerPageParams const& params, PageId const& page_id);
+
 	static PropertySet initialPictureZoneProps();
 
 	static PropertySet initialFillZoneProps();
 
+	/**
+	 * Serializes writers and protects default zone properties.
+	 * Per-page readers don't lock.
+	 */
 	mutable QMutex m_mutex;
-	PerPageParams m_perPageParams;
-	PerPageOutputParams m_perPageOutputParams;
-	PerPageZones m_perPagePictureZones;
-	PerPageZones m_perPageFillZones;
+	SnapshotPublisher<PerPageParams> m_perPageParams;
+	SnapshotPublisher<PerPageOutputParams> m_perPageOutputParams;
+	SnapshotPublisher<PerPageZones> m_perPagePictureZones;
+	SnapshotPublisher<PerPageZones> m_perPageFillZones;
 	PropertySet m_defaultPictureZoneProps;
 	PropertySet m_defaultFillZoneProps;
 };
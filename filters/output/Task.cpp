@@ -28,6 +28,7 @@
 #include "RenderParams.h"
 #include "FilterUiInterface.h"
 #include "TaskStatus.h"
+#include "PerformanceStats.h"
 #include "FilterData.h"
 #include "ImageView.h"
 #include "ImageViewTab.h"
@@ -53,7 +54,13 @@
 #include "ThumbnailPixmapCache.h"
 #include "DebugImages.h"
 #include "OutputGenerator.h"
+#include "OutputLayers.h"
+#include "RenderCache.h"
+#include "OutputFileScan.h"
+#include "WriteBehindQueue.h"
+#include "ZoneSet.h"
 #include "TiffWriter.h"
+#include "MrcLayers.h"
 #include "ImageLoader.h"
 #include "ErrorWidget.h"
 #include "imageproc/BinaryImage.h"
@@ -96,7 +103,7 @@ public:
 		BinaryImage const& picture_mask,
 		DespeckleState const& despeckle_state,
 		DespeckleVisualization const& despeckle_visualization,
-		bool batch, bool debug);
+		bool invalidate_thumbnail, bool batch, bool debug);
 	
 	virtual void updateUI(FilterUiInterface* ui);
 	
@@ -117,18 +124,108 @@ private:
 	DespeckleState m_despeckleState;
 	DespeckleVisualization m_despeckleVisualization;
 	DespeckleLevel m_despeckleLevel;
+	bool m_invalidateThumbnail;
 	bool m_batchProcessing;
 	bool m_debug;
 };
 
 
+/**
+ * Writes the output files of a page, then commits its OutputParams
+ * and updates the thumbnail, provided all the files were written
+ * successfully.  Executed by WriteBehindQueue.
+ */
+class Task::WriteJob
+{
+	// Member-wise copying is OK.
+public:
+	/**
+	 * \param thumbnail_cache If set, the thumbnail of the output file
+	 *        will be recreated once the file is written, and \p filter
+	 *        will let the GUI know.  Filter waits for pending writes
+	 *        before going away, so a plain pointer is fine.
+	 */
+	WriteJob(IntrusivePtr<Settings> const& settings,
+		IntrusivePtr<OutputFileScan> const& output_file_scan,
+		IntrusivePtr<ThumbnailPixmapCache> const& thumbnail_cache,
+		Filter* filter, PageId const& page_id, OutputFileNameGenerator const& out_file_name_gen,
+		OutputImageParams const& output_image_params,
+		ZoneSet const& picture_zones, ZoneSet const& fill_zones,
+		QImage const& out_img, MrcLayers const& mrc_layers,
+		BinaryImage const& automask_img, bool write_automask,
+		BinaryImage const& speckles_img, bool write_speckles_file);
+
+	/**
+	 * \brief Makes the job only rewrite the output file, keeping
+	 *        the existing automask and speckles files.
+	 */
+	void keepAuxiliaryFiles(OutputFileParams const& automask_file_params,
+		OutputFileParams const& speckles_file_params);
+
+	void operator()() const;
+private:
+	bool writeOutputFile(QString const& file_path) const;
+
+	void deleteMutuallyExclusiveOutputFiles() const;
+
+	/**
+	 * Deletes a file, keeping the output file scan, if any, up to date.
+	 */
+	void removeOutputFile(QString const& file_path) const;
+
+	IntrusivePtr<Settings> m_ptrSettings;
+	IntrusivePtr<OutputFileScan> m_ptrOutputFileScan; /**< Only set in batch mode. */
+	IntrusivePtr<ThumbnailPixmapCache> m_ptrThumbnailCache;
+	Filter* m_pFilter;
+	PageId m_pageId;
+	OutputFileNameGenerator m_outFileNameGen;
+	OutputImageParams m_outputImageParams;
+	ZoneSet m_pictureZones;
+	ZoneSet m_fillZones;
+	QImage m_outImage;
+	MrcLayers m_mrcLayers; /**< May be null even if layered output is requested. */
+	BinaryImage m_automaskImage;
+	BinaryImage m_specklesImage;
+	OutputFileParams m_keptAutomaskFileParams;
+	OutputFileParams m_keptSpecklesFileParams;
+	bool m_writeAutomask;
+	bool m_writeSpecklesFile;
+};
+
+
+/**
+ * In batch mode, only the thumbnail has to be updated, so unlike UiUpdater,
+ * this one doesn't require the output image.
+ */
+class Task::BatchUiUpdater : public FilterResult
+{
+public:
+	BatchUiUpdater(IntrusivePtr<Filter> const& filter,
+		PageId const& page_id, bool invalidate_thumbnail);
+
+	virtual void updateUI(FilterUiInterface* ui);
+
+	virtual IntrusivePtr<AbstractFilter> filter() { return m_ptrFilter; }
+private:
+	IntrusivePtr<Filter> m_ptrFilter;
+	PageId m_pageId;
+	bool m_invalidateThumbnail;
+};
+
+
 Task::Task(IntrusivePtr<Filter> const& filter,
 	IntrusivePtr<Settings> const& settings,
+	IntrusivePtr<RenderCache> const& render_cache,
+	IntrusivePtr<OutputFileScan> const& output_file_scan,
+	IntrusivePtr<WriteBehindQueue> const& write_queue,
 	IntrusivePtr<ThumbnailPixmapCache> const& thumbnail_cache,
 	PageId const& page_id, OutputFileNameGenerator const& out_file_name_gen,
 	ImageViewTab const last_tab, bool const batch, bool const debug)
 :	m_ptrFilter(filter),
 	m_ptrSettings(settings),
+	m_ptrRenderCache(render_cache),
+	m_ptrOutputFileScan(output_file_scan),
+	m_ptrWriteQueue(write_queue),
 	m_ptrThumbnailCache(thumbnail_cache),
 	m_pageId(page_id),
 	m_outFileNameGen(out_file_name_gen),
@@ -151,6 +248,7 @@ Task::process(
 	QPolygonF const& content_rect_phys)
 {
 	status.throwIfCancelled();
+	PerformanceStats::StageTimer const stage_timer(PerformanceStats::OUTPUT_STAGE);
 
 	Params params(m_ptrSettings->getParams(m_pageId));
 	RenderParams const render_params(params.colorParams());
@@ -164,13 +262,11 @@ Task::process(
 	QString const automask_file_path(
 		QDir(automask_dir).absoluteFilePath(out_file_info.fileName())
 	);
-	QFileInfo automask_file_info(automask_file_path);
 
 	QString const speckles_dir(Utils::specklesDir(m_outFileNameGen.outDir()));
 	QString const speckles_file_path(
 		QDir(speckles_dir).absoluteFilePath(out_file_info.fileName())
 	);
-	QFileInfo speckles_file_info(speckles_file_path);
 
 	bool const need_picture_editor = render_params.mixedOutput() && !m_batchProcessing;
 	bool const need_speckles_image = params.despeckleLevel() != DESPECKLE_OFF
@@ -191,12 +287,19 @@ Task::process(
 	ZoneSet const new_picture_zones(m_ptrSettings->pictureZonesForPage(m_pageId));
 	ZoneSet const new_fill_zones(m_ptrSettings->fillZonesForPage(m_pageId));
 	
+	// Output params of this page are only committed once its files are written.
+	m_ptrWriteQueue->waitForPage(m_pageId);
+
 	bool need_reprocess = false;
+
+	// Set if only the way the output file is stored has changed,
+	// and the existing file has everything needed to store it anew.
+	bool need_rewrite = false;
+	std::auto_ptr<OutputParams> stored_output_params;
+
 	do { // Just to be able to break from it.
 		
-		std::auto_ptr<OutputParams> stored_output_params(
-			m_ptrSettings->getOutputParams(m_pageId)
-		);
+		stored_output_params = m_ptrSettings->getOutputParams(m_pageId);
 		
 		if (!stored_output_params.get()) {
 			need_reprocess = true;
@@ -218,38 +321,54 @@ Task::process(
 			break;
 		}
 		
-		if (!out_file_info.exists()) {
+		OutputFileParams const out_file_params(currentFileParams(out_file_path));
+		if (!out_file_params.isValid()) {
 			need_reprocess = true;
 			break;
 		}
 		
-		if (!stored_output_params->outputFileParams().matches(OutputFileParams(out_file_info))) {
+		if (!stored_output_params->outputFileParams().matches(out_file_params)) {
 			need_reprocess = true;
 			break;
 		}
 
 		if (need_picture_editor) {
-			if (!automask_file_info.exists()) {
+			OutputFileParams const automask_file_params(currentFileParams(automask_file_path));
+			if (!automask_file_params.isValid()) {
 				need_reprocess = true;
 				break;
 			}
 
-			if (!stored_output_params->automaskFileParams().matches(OutputFileParams(automask_file_info))) {
+			if (!stored_output_params->automaskFileParams().matches(automask_file_params)) {
 				need_reprocess = true;
 				break;
 			}
 		}
 
 		if (need_speckles_image) {
-			if (!speckles_file_info.exists()) {
+			OutputFileParams const speckles_file_params(currentFileParams(speckles_file_path));
+			if (!speckles_file_params.isValid()) {
 				need_reprocess = true;
 				break;
 			}
-			if (!stored_output_params->specklesFileParams().matches(OutputFileParams(speckles_file_info))) {
+			if (!stored_output_params->specklesFileParams().matches(speckles_file_params)) {
 				need_reprocess = true;
 				break;
 			}
 		}
+
+		switch (ColorParams::fileUpdateFor(
+				stored_output_params->outputImageParams().colorParams(),
+				new_output_image_params.colorParams())) {
+			case ColorParams::KEEP_FILE:
+				break;
+			case ColorParams::REWRITE_FILE:
+				need_rewrite = true;
+				break;
+			case ColorParams::REGENERATE_FILE:
+				need_reprocess = true;
+				break;
+		}
 	
 	} while (false);
 	
@@ -257,6 +376,16 @@ Task::process(
 	BinaryImage automask_img;
 	BinaryImage speckles_img;
 	
+	if (!need_reprocess && !need_rewrite && m_batchProcessing) {
+		// The output is up to date and nobody is going to look at it,
+		// so don't bother loading it.
+		if (CommandLine::get().isGui()) {
+			return FilterResultPtr(new BatchUiUpdater(m_ptrFilter, m_pageId, true));
+		} else {
+			return FilterResultPtr(0);
+		}
+	}
+
 	if (!need_reprocess) {
 		QFile out_file(out_file_path);
 		if (out_file.open(QIODevice::ReadOnly)) {
@@ -264,7 +393,7 @@ Task::process(
 		}
 		need_reprocess = out_img.isNull();
 
-		if (need_picture_editor && !need_reprocess) {
+		if (need_picture_editor && !need_reprocess && !m_batchProcessing) {
 			QFile automask_file(automask_file_path);
 			if (automask_file.open(QIODevice::ReadOnly)) {
 				automask_img = BinaryImage(ImageLoader::load(automask_file, 0));
@@ -272,7 +401,7 @@ Task::process(
 			need_reprocess = automask_img.isNull() || automask_img.size() != out_img.size();
 		}
 
-		if (need_speckles_image && !need_reprocess) {
+		if (need_speckles_image && !need_reprocess && !m_batchProcessing) {
 			QFile speckles_file(speckles_file_path);
 			if (speckles_file.open(QIODevice::ReadOnly)) {
 				speckles_img = BinaryImage(ImageLoader::load(speckles_file, 0));
@@ -281,6 +410,29 @@ Task::process(
 		}
 	}
 
+	bool const layered_output = params.colorParams().colorMode() == ColorParams::MIXED
+		&& params.colorParams().layeredOutput();
+
+	if (need_rewrite && !need_reprocess) {
+		// The output image is loaded from the existing plain file,
+		// which WriteJob is going to split into MRC layers.
+		// The thumbnail doesn't change, but the file it's made from
+		// is only complete once the job is done.
+		WriteJob job(
+			m_ptrSettings,
+			m_batchProcessing ? m_ptrOutputFileScan : IntrusivePtr<OutputFileScan>(),
+			m_ptrThumbnailCache, m_ptrFilter.get(),
+			m_pageId, m_outFileNameGen, new_output_image_params,
+			new_picture_zones, new_fill_zones, out_img, MrcLayers(),
+			BinaryImage(), false, BinaryImage(), false
+		);
+		job.keepAuxiliaryFiles(
+			stored_output_params->automaskFileParams(),
+			stored_output_params->specklesFileParams()
+		);
+		m_ptrWriteQueue->submit(m_pageId, job);
+	}
+
 	if (need_reprocess) {
 		// Even in batch processing mode we should still write automask, because it
 		// will be needed when we view the results back in interactive mode.
@@ -291,6 +443,7 @@ Task::process(
 		bool const write_speckles_file = params.despeckleLevel() != DESPECKLE_OFF &&
 			params.colorParams().colorMode() != ColorParams::COLOR_GRAYSCALE; 
 
+		out_img = QImage();
 		automask_img = BinaryImage();
 		speckles_img = BinaryImage();
 
@@ -301,14 +454,36 @@ Task::process(
 		// OutputGenerator will write a new distortion model
 		// there, if dewarping mode is AUTO.
 
-		out_img = generator.process(
-			status, data, new_picture_zones, new_fill_zones,
-			params.dewarpingMode(), distortion_model,
-			params.depthPerception(),
-			write_automask ? &automask_img : 0,
-			write_speckles_file ? &speckles_img : 0,
-			m_ptrDbg.get()
-		);
+		// Intermediate layers are only worth keeping in interactive mode,
+		// where the user is likely to edit zones or tune the threshold
+		// and despeckling of the current page.
+		// Debugging images would be missing if we were to reuse them.
+		bool const use_render_cache = !m_batchProcessing && !m_ptrDbg.get();
+		OutputLayers layers;
+		MrcLayers mrc_layers;
+
+		if (use_render_cache &&
+				m_ptrRenderCache->find(m_pageId, new_output_image_params, layers)) {
+			out_img = generator.reprocess(
+				status, new_picture_zones, new_fill_zones,
+				layers, distortion_model,
+				write_automask ? &automask_img : 0,
+				write_speckles_file ? &speckles_img : 0,
+				layered_output ? &mrc_layers : 0
+			);
+		}
+
+		if (out_img.isNull()) {
+			out_img = generator.process(
+				status, data, new_picture_zones, new_fill_zones,
+				params.dewarpingMode(), distortion_model,
+				params.depthPerception(),
+				write_automask ? &automask_img : 0,
+				write_speckles_file ? &speckles_img : 0,
+				m_ptrDbg.get(), use_render_cache ? &layers : 0,
+				layered_output ? &mrc_layers : 0
+			);
+		}
 
 		if (params.dewarpingMode() == DewarpingMode::AUTO && distortion_model.isValid()) {
 			// A new distortion model was generated.
@@ -318,6 +493,10 @@ Task::process(
 			new_output_image_params.setDistortionModel(distortion_model);
 		}
 
+		if (use_render_cache) {
+			m_ptrRenderCache->store(m_pageId, new_output_image_params, layers);
+		}
+
 		if (write_speckles_file && speckles_img.isNull()) {
 			// Even if despeckling didn't actually take place, we still need
 			// to write an empty speckles file.  Making it a special case
@@ -325,54 +504,33 @@ Task::process(
 			BinaryImage(out_img.size(), WHITE).swap(speckles_img);
 		}
 
-		bool invalidate_params = false;
-		
-		if (!TiffWriter::writeImage(out_file_path, out_img)) {
-			invalidate_params = true;
-		} else {
-			deleteMutuallyExclusiveOutputFiles();
-		}
+		// The files are written in the background, while we move on
+		// to the next page.  Until then, the previous output params
+		// of this page stay in place.
+		m_ptrWriteQueue->submit(
+			m_pageId,
+			WriteJob(
+				m_ptrSettings,
+				m_batchProcessing ? m_ptrOutputFileScan : IntrusivePtr<OutputFileScan>(),
+				m_ptrThumbnailCache, m_ptrFilter.get(),
+				m_pageId, m_outFileNameGen, new_output_image_params,
+				new_picture_zones, new_fill_zones, out_img, mrc_layers,
+				automask_img, write_automask, speckles_img, write_speckles_file
+			)
+		);
+	}
 
-		if (write_automask) {
-			// Note that QDir::mkdir() will fail if the parent directory,
-			// that is $OUT/cache doesn't exist. We want that behaviour,
-			// as otherwise when loading a project from a different machine,
-			// a whole bunch of bogus directories would be created.
-			QDir().mkdir(automask_dir);
-			// Also note that QDir::mkdir() will fail if the directory already exists,
-			// so we ignore its return value here.
-
-			if (!TiffWriter::writeImage(automask_file_path, automask_img.toQImage())) {
-				invalidate_params = true;
-			}
-		}
-		if (write_speckles_file) {
-			if (!QDir().mkpath(speckles_dir)) {
-				invalidate_params = true;
-			} else if (!TiffWriter::writeImage(speckles_file_path, speckles_img.toQImage())) {
-				invalidate_params = true;
-			}
-		}
+	// Queued writes have the thumbnail invalidated once they are done.
+	bool const write_queued = need_reprocess || need_rewrite;
 
-		if (invalidate_params) {
-			m_ptrSettings->removeOutputParams(m_pageId);
-		} else {
-			// Note that we can't reuse *_file_info objects
-			// as we've just overwritten those files.
-			OutputParams const out_params(
-				new_output_image_params,
-				OutputFileParams(QFileInfo(out_file_path)),
-				write_automask ? OutputFileParams(QFileInfo(automask_file_path))
-				: OutputFileParams(),
-				write_speckles_file ? OutputFileParams(QFileInfo(speckles_file_path))
-				: OutputFileParams(),
-				new_picture_zones, new_fill_zones
+	if (m_batchProcessing) {
+		if (CommandLine::get().isGui()) {
+			return FilterResultPtr(
+				new BatchUiUpdater(m_ptrFilter, m_pageId, !write_queued)
 			);
-
-			m_ptrSettings->setOutputParams(m_pageId, out_params);
+		} else {
+			return FilterResultPtr(0);
 		}
-		
-		m_ptrThumbnailCache->recreateThumbnail(ImageId(out_file_path), out_img);
 	}
 
 	DespeckleState const despeckle_state(
@@ -394,7 +552,7 @@ Task::process(
 				new_xform, generator.outputContentRect(),
 				m_pageId, data.origImage(), out_img, automask_img,
 				despeckle_state, despeckle_visualization,
-				m_batchProcessing, m_debug
+				!write_queued, m_batchProcessing, m_debug
 			)
 		);
 	} else {
@@ -403,32 +561,17 @@ Task::process(
 }
 
 /**
- * Delete output files mutually exclusive to m_pageId.
+ * Returns the parameters of an output file as it is on disk.
+ * In batch mode, they come from the scan of the output directory,
+ * rather than from querying the file itself.
  */
-void
-Task::deleteMutuallyExclusiveOutputFiles()
+OutputFileParams
+Task::currentFileParams(QString const& file_path) const
 {
-	switch (m_pageId.subPage()) {
-		case PageId::SINGLE_PAGE:
-			QFile::remove(
-				m_outFileNameGen.filePathFor(
-					PageId(m_pageId.imageId(), PageId::LEFT_PAGE)
-				)
-			);
-			QFile::remove(
-				m_outFileNameGen.filePathFor(
-					PageId(m_pageId.imageId(), PageId::RIGHT_PAGE)
-				)
-			);
-			break;
-		case PageId::LEFT_PAGE:
-		case PageId::RIGHT_PAGE:
-			QFile::remove(
-				m_outFileNameGen.filePathFor(
-					PageId(m_pageId.imageId(), PageId::SINGLE_PAGE)
-				)
-			);
-			break;
+	if (m_batchProcessing) {
+		return m_ptrOutputFileScan->fileParams(file_path);
+	} else {
+		return OutputFileParams(QFileInfo(file_path));
 	}
 }
 
@@ -448,7 +591,7 @@ Task::UiUpdater::UiUpdater(
 	BinaryImage const& picture_mask,
 	DespeckleState const& despeckle_state,
 	DespeckleVisualization const& despeckle_visualization,
-	bool const batch, bool const debug)
+	bool const invalidate_thumbnail, bool const batch, bool const debug)
 :	m_ptrFilter(filter),
 	m_ptrSettings(settings),
 	m_ptrDbg(dbg_img),
@@ -463,6 +606,7 @@ Task::UiUpdater::UiUpdater(
 	m_pictureMask(picture_mask),
 	m_despeckleState(despeckle_state),
 	m_despeckleVisualization(despeckle_visualization),
+	m_invalidateThumbnail(invalidate_thumbnail),
 	m_batchProcessing(batch),
 	m_debug(debug)
 {
@@ -477,7 +621,9 @@ Task::UiUpdater::updateUI(FilterUiInterface* ui)
 	opt_widget->postUpdateUI();
 	ui->setOptionsWidget(opt_widget, ui->KEEP_OWNERSHIP);
 	
-	ui->invalidateThumbnail(m_pageId);
+	if (m_invalidateThumbnail) {
+		ui->invalidateThumbnail(m_pageId);
+	}
 	
 	if (m_batchProcessing) {
 		return;
@@ -532,8 +678,8 @@ Task::UiUpdater::updateUI(FilterUiInterface* ui)
 	// In OptionsWidget::dewarpingChanged() we make sure to reload
 	// if we are on the "Fill Zones" tab, and if not, it will be reloaded
 	// anyway when another tab is selected.
-	boost::function<QPointF(QPointF const&)> orig_to_output;
-	boost::function<QPointF(QPointF const&)> output_to_orig;
+	boost::function<QPolygonF(QPolygonF const&)> orig_to_output;
+	boost::function<QPolygonF(QPolygonF const&)> output_to_orig;
 	if (m_params.dewarpingMode() != DewarpingMode::OFF && m_params.distortionModel().isValid()) {
 		boost::shared_ptr<DewarpingPointMapper> mapper(
 			new DewarpingPointMapper(
@@ -541,12 +687,12 @@ Task::UiUpdater::updateUI(FilterUiInterface* ui)
 				m_xform.transform(), m_virtContentRect
 			)
 		);
-		orig_to_output = boost::bind(&DewarpingPointMapper::mapToDewarpedSpace, mapper, _1);
-		output_to_orig = boost::bind(&DewarpingPointMapper::mapToWarpedSpace, mapper, _1);
+		orig_to_output = boost::bind(&DewarpingPointMapper::mapPolygonToDewarpedSpace, mapper, _1);
+		output_to_orig = boost::bind(&DewarpingPointMapper::mapPolygonToWarpedSpace, mapper, _1);
 	} else {
-		typedef QPointF (QTransform::*MapPointFunc)(QPointF const&) const;
-		orig_to_output = boost::bind((MapPointFunc)&QTransform::map, m_xform.transform(), _1);
-		output_to_orig = boost::bind((MapPointFunc)&QTransform::map, m_xform.transformBack(), _1);
+		typedef QPolygonF (QTransform::*MapPolygonFunc)(QPolygonF const&) const;
+		orig_to_output = boost::bind((MapPolygonFunc)&QTransform::map, m_xform.transform(), _1);
+		output_to_orig = boost::bind((MapPolygonFunc)&QTransform::map, m_xform.transformBack(), _1);
 	}
 
 	std::auto_ptr<QWidget> fill_zone_editor(
@@ -595,4 +741,208 @@ Task::UiUpdater::updateUI(FilterUiInterface* ui)
 	ui->setImageWidget(tab_widget.release(), ui->TRANSFER_OWNERSHIP, m_ptrDbg.get());
 }
 
+
+/*============================= Task::WriteJob ===========================*/
+
+Task::WriteJob::WriteJob(
+	IntrusivePtr<Settings> const& settings,
+	IntrusivePtr<OutputFileScan> const& output_file_scan,
+	IntrusivePtr<ThumbnailPixmapCache> const& thumbnail_cache,
+	Filter* const filter, PageId const& page_id,
+	OutputFileNameGenerator const& out_file_name_gen,
+	OutputImageParams const& output_image_params,
+	ZoneSet const& picture_zones, ZoneSet const& fill_zones,
+	QImage const& out_img, MrcLayers const& mrc_layers,
+	BinaryImage const& automask_img, bool const write_automask,
+	BinaryImage const& speckles_img, bool const write_speckles_file)
+:	m_ptrSettings(settings),
+	m_ptrOutputFileScan(output_file_scan),
+	m_ptrThumbnailCache(thumbnail_cache),
+	m_pFilter(filter),
+	m_pageId(page_id),
+	m_outFileNameGen(out_file_name_gen),
+	m_outputImageParams(output_image_params),
+	m_pictureZones(picture_zones),
+	m_fillZones(fill_zones),
+	m_outImage(out_img),
+	m_mrcLayers(mrc_layers),
+	m_automaskImage(automask_img),
+	m_specklesImage(speckles_img),
+	m_writeAutomask(write_automask),
+	m_writeSpecklesFile(write_speckles_file)
+{
+}
+
+void
+Task::WriteJob::keepAuxiliaryFiles(
+	OutputFileParams const& automask_file_params,
+	OutputFileParams const& speckles_file_params)
+{
+	m_automaskImage = BinaryImage();
+	m_specklesImage = BinaryImage();
+	m_writeAutomask = false;
+	m_writeSpecklesFile = false;
+	m_keptAutomaskFileParams = automask_file_params;
+	m_keptSpecklesFileParams = speckles_file_params;
+}
+
+void
+Task::WriteJob::operator()() const
+{
+	QString const out_file_path(m_outFileNameGen.filePathFor(m_pageId));
+	QString const file_name(QFileInfo(out_file_path).fileName());
+	QString const automask_dir(Utils::automaskDir(m_outFileNameGen.outDir()));
+	QString const automask_file_path(QDir(automask_dir).absoluteFilePath(file_name));
+	QString const speckles_dir(Utils::specklesDir(m_outFileNameGen.outDir()));
+	QString const speckles_file_path(QDir(speckles_dir).absoluteFilePath(file_name));
+
+	bool invalidate_params = false;
+	
+	if (!writeOutputFile(out_file_path)) {
+		invalidate_params = true;
+	} else {
+		deleteMutuallyExclusiveOutputFiles();
+	}
+
+	if (m_writeAutomask) {
+		// Note that QDir::mkdir() will fail if the parent directory,
+		// that is $OUT/cache doesn't exist. We want that behaviour,
+		// as otherwise when loading a project from a different machine,
+		// a whole bunch of bogus directories would be created.
+		QDir().mkdir(automask_dir);
+		// Also note that QDir::mkdir() will fail if the directory already exists,
+		// so we ignore its return value here.
+
+		if (!TiffWriter::writeImage(automask_file_path, m_automaskImage.toQImage())) {
+			invalidate_params = true;
+		}
+	}
+	if (m_writeSpecklesFile) {
+		if (!QDir().mkpath(speckles_dir)) {
+			invalidate_params = true;
+		} else if (!TiffWriter::writeImage(speckles_file_path, m_specklesImage.toQImage())) {
+			invalidate_params = true;
+		}
+	}
+
+	if (invalidate_params) {
+		m_ptrSettings->removeOutputParams(m_pageId);
+		return;
+	}
+
+	// Note that we have to query the files again,
+	// as we've just overwritten them.
+	OutputParams const out_params(
+		m_outputImageParams,
+		OutputFileParams(QFileInfo(out_file_path)),
+		m_writeAutomask ? OutputFileParams(QFileInfo(automask_file_path))
+		: m_keptAutomaskFileParams,
+		m_writeSpecklesFile ? OutputFileParams(QFileInfo(speckles_file_path))
+		: m_keptSpecklesFileParams,
+		m_pictureZones, m_fillZones
+	);
+
+	m_ptrSettings->setOutputParams(m_pageId, out_params);
+
+	if (m_ptrOutputFileScan.get()) {
+		m_ptrOutputFileScan->update(out_file_path, out_params.outputFileParams());
+		if (m_writeAutomask) {
+			m_ptrOutputFileScan->update(automask_file_path, out_params.automaskFileParams());
+		}
+		if (m_writeSpecklesFile) {
+			m_ptrOutputFileScan->update(speckles_file_path, out_params.specklesFileParams());
+		}
+	}
+
+	if (m_ptrThumbnailCache.get()) {
+		m_ptrThumbnailCache->recreateThumbnail(ImageId(out_file_path), m_outImage);
+		m_pFilter->outputThumbnailRecreated(m_pageId);
+	}
+}
+
+bool
+Task::WriteJob::writeOutputFile(QString const& file_path) const
+{
+	ColorParams const& color_params = m_outputImageParams.colorParams();
+	if (color_params.colorMode() != ColorParams::MIXED || !color_params.layeredOutput()) {
+		return TiffWriter::writeImage(file_path, m_outImage);
+	}
+
+	if (!m_mrcLayers.isNull()) {
+		return TiffWriter::writeMrcImage(file_path, m_mrcLayers);
+	}
+
+	if (m_outImage.format() == QImage::Format_Mono) {
+		// Mixed output with nothing but B/W content.  It's as compact as it gets.
+		return TiffWriter::writeImage(file_path, m_outImage);
+	}
+
+	// Rewriting an existing plain file, so all we have is the combined image.
+	return TiffWriter::writeMrcImage(file_path, MrcLayers::split(m_outImage));
+}
+
+/**
+ * Delete output files mutually exclusive to m_pageId.
+ */
+void
+Task::WriteJob::deleteMutuallyExclusiveOutputFiles() const
+{
+	switch (m_pageId.subPage()) {
+		case PageId::SINGLE_PAGE:
+			removeOutputFile(
+				m_outFileNameGen.filePathFor(
+					PageId(m_pageId.imageId(), PageId::LEFT_PAGE)
+				)
+			);
+			removeOutputFile(
+				m_outFileNameGen.filePathFor(
+					PageId(m_pageId.imageId(), PageId::RIGHT_PAGE)
+				)
+			);
+			break;
+		case PageId::LEFT_PAGE:
+		case PageId::RIGHT_PAGE:
+			removeOutputFile(
+				m_outFileNameGen.filePathFor(
+					PageId(m_pageId.imageId(), PageId::SINGLE_PAGE)
+				)
+			);
+			break;
+	}
+}
+
+void
+Task::WriteJob::removeOutputFile(QString const& file_path) const
+{
+	if (QFile::remove(file_path) && m_ptrOutputFileScan.get()) {
+		m_ptrOutputFileScan->update(file_path, OutputFileParams());
+	}
+}
+
+
+/*============================ Task::BatchUiUpdater ==========================*/
+
+Task::BatchUiUpdater::BatchUiUpdater(
+	IntrusivePtr<Filter> const& filter,
+	PageId const& page_id, bool const invalidate_thumbnail)
+:	m_ptrFilter(filter),
+	m_pageId(page_id),
+	m_invalidateThumbnail(invalidate_thumbnail)
+{
+}
+
+void
+Task::BatchUiUpdater::updateUI(FilterUiInterface* ui)
+{
+	// This function is executed from the GUI thread.
+
+	OptionsWidget* const opt_widget = m_ptrFilter->optionsWidget();
+	opt_widget->postUpdateUI();
+	ui->setOptionsWidget(opt_widget, ui->KEEP_OWNERSHIP);
+
+	if (m_invalidateThumbnail) {
+		ui->invalidateThumbnail(m_pageId);
+	}
+}
+
 } // namespace output
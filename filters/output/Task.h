@@ -36,6 +36,7 @@ class ImageTransformation;
 class QPolygonF;
 class QSize;
 class QImage;
+class QString;
 class Dpi;
 
 namespace imageproc
@@ -48,6 +49,10 @@ namespace output
 
 class Filter;
 class Settings;
+class RenderCache;
+class OutputFileScan;
+class WriteBehindQueue;
+class OutputFileParams;
 
 class Task : public RefCountable
 {
@@ -55,6 +60,9 @@ class Task : public RefCountable
 public:
 	Task(IntrusivePtr<Filter> const& filter,
 		IntrusivePtr<Settings> const& settings,
+		IntrusivePtr<RenderCache> const& render_cache,
+		IntrusivePtr<OutputFileScan> const& output_file_scan,
+		IntrusivePtr<WriteBehindQueue> const& write_queue,
 		IntrusivePtr<ThumbnailPixmapCache> const& thumbnail_cache,
 		PageId const& page_id, OutputFileNameGenerator const& out_file_name_gen,
 		ImageViewTab last_tab, bool batch, bool debug);
@@ -66,11 +74,22 @@ public:
 		QPolygonF const& content_rect_phys);
 private:
 	class UiUpdater;
+	class BatchUiUpdater;
+	class WriteJob;
 	
-	void deleteMutuallyExclusiveOutputFiles();
+	/**
+	 * \brief Returns the current OutputFileParams of a file.
+	 *
+	 * In batch mode, they come from m_ptrOutputFileScan.
+	 * The returned parameters are invalid if the file doesn't exist.
+	 */
+	OutputFileParams currentFileParams(QString const& file_path) const;
 
 	IntrusivePtr<Filter> m_ptrFilter;
 	IntrusivePtr<Settings> m_ptrSettings;
+	IntrusivePtr<RenderCache> m_ptrRenderCache;
+	IntrusivePtr<OutputFileScan> m_ptrOutputFileScan;
+	IntrusivePtr<WriteBehindQueue> m_ptrWriteQueue;
 	IntrusivePtr<ThumbnailPixmapCache> m_ptrThumbnailCache;
 	std::auto_ptr<DebugImages> m_ptrDbg;
 	PageId m_pageId;
@@ -0,0 +1,136 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "WriteBehindQueue.h"
+#include <QThread>
+#include <QMutexLocker>
+#include <QDebug>
+#include <exception>
+
+namespace output
+{
+
+class WriteBehindQueue::WorkerThread : public QThread
+{
+public:
+	WorkerThread(WriteBehindQueue& owner) : m_rOwner(owner) {}
+protected:
+	virtual void run() { m_rOwner.processJobs(); }
+private:
+	WriteBehindQueue& m_rOwner;
+};
+
+
+WriteBehindQueue::WriteBehindQueue(FailureHandler const& failure_handler)
+:	m_failureHandler(failure_handler),
+	m_numPendingJobs(0),
+	m_shuttingDown(false),
+	m_ptrThread(new WorkerThread(*this))
+{
+	m_ptrThread->start();
+}
+
+WriteBehindQueue::~WriteBehindQueue()
+{
+	{
+		QMutexLocker const locker(&m_mutex);
+		m_shuttingDown = true;
+		m_jobQueued.wakeAll();
+	}
+
+	m_ptrThread->wait();
+}
+
+void
+WriteBehindQueue::submit(PageId const& page_id, Job const& job)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	while (m_queue.size() >= MAX_QUEUED_JOBS) {
+		m_jobTaken.wait(&m_mutex);
+	}
+
+	m_queue.push_back(QueuedJob(page_id, job));
+	++m_pendingJobsPerPage[page_id];
+	++m_numPendingJobs;
+	m_jobQueued.wakeOne();
+}
+
+void
+WriteBehindQueue::waitForPage(PageId const& page_id)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	while (m_pendingJobsPerPage.find(page_id) != m_pendingJobsPerPage.end()) {
+		m_jobFinished.wait(&m_mutex);
+	}
+}
+
+void
+WriteBehindQueue::waitForAll()
+{
+	QMutexLocker const locker(&m_mutex);
+
+	while (m_numPendingJobs != 0) {
+		m_jobFinished.wait(&m_mutex);
+	}
+}
+
+void
+WriteBehindQueue::processJobs()
+{
+	QMutexLocker locker(&m_mutex);
+
+	for (;;) {
+		while (m_queue.empty()) {
+			if (m_shuttingDown) {
+				return;
+			}
+			m_jobQueued.wait(&m_mutex);
+		}
+
+		QueuedJob const queued_job(m_queue.front());
+		m_queue.pop_front();
+		m_jobTaken.wakeAll();
+
+		locker.unlock();
+		try {
+			queued_job.job();
+		} catch (std::exception const& e) {
+			qWarning() << "Writing output for"
+				<< queued_job.pageId.imageId().filePath()
+				<< "failed:" << e.what();
+			// The job may have failed after replacing some of the files,
+			// so the output params it left in place can't be trusted.
+			// This gets the page processed again.
+			m_failureHandler(queued_job.pageId);
+		}
+		locker.relock();
+
+		std::map<PageId, int>::iterator const it(
+			m_pendingJobsPerPage.find(queued_job.pageId)
+		);
+		if (--it->second == 0) {
+			m_pendingJobsPerPage.erase(it);
+		}
+		--m_numPendingJobs;
+		m_jobFinished.wakeAll();
+	}
+}
+
+} // namespace output
@@ -0,0 +1,119 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OUTPUT_WRITE_BEHIND_QUEUE_H_
+#define OUTPUT_WRITE_BEHIND_QUEUE_H_
+
+#include "RefCountable.h"
+#include "NonCopyable.h"
+#include "PageId.h"
+#ifndef Q_MOC_RUN
+#include <boost/function.hpp>
+#endif
+#include <QMutex>
+#include <QWaitCondition>
+#include <deque>
+#include <map>
+#include <memory>
+
+namespace output
+{
+
+/**
+ * \brief Executes file writing jobs on a background thread.
+ *
+ * This lets the next page be processed while the output files
+ * of the previous one are still being written.  Jobs are executed in
+ * the order they were submitted.  The queue is bounded, as jobs hold
+ * full size images, so submitting a job blocks while the queue is full.
+ *
+ * \note All methods of this class are thread-safe.
+ */
+class WriteBehindQueue : public RefCountable
+{
+	DECLARE_NON_COPYABLE(WriteBehindQueue)
+public:
+	typedef boost::function<void()> Job;
+
+	/**
+	 * Called on the background thread for the page of a job
+	 * that threw an exception.
+	 */
+	typedef boost::function<void(PageId const&)> FailureHandler;
+
+	/**
+	 * \param failure_handler Makes sure the page of a failed job
+	 *        isn't considered up to date.  Failures are logged anyway.
+	 */
+	WriteBehindQueue(FailureHandler const& failure_handler);
+
+	/**
+	 * \brief Executes the remaining jobs, then stops the background thread.
+	 */
+	virtual ~WriteBehindQueue();
+
+	/**
+	 * \brief Schedules a job writing the output of a page.
+	 *
+	 * Blocks while the queue is full.
+	 */
+	void submit(PageId const& page_id, Job const& job);
+
+	/**
+	 * \brief Waits for all jobs for the given page to finish.
+	 */
+	void waitForPage(PageId const& page_id);
+
+	/**
+	 * \brief Waits for all submitted jobs to finish.
+	 */
+	void waitForAll();
+private:
+	class WorkerThread;
+
+	struct QueuedJob
+	{
+		PageId pageId;
+		Job job;
+
+		QueuedJob(PageId const& page_id, Job const& j) : pageId(page_id), job(j) {}
+	};
+
+	/** The maximum number of jobs submitted but not yet started. */
+	enum { MAX_QUEUED_JOBS = 2 };
+
+	void processJobs();
+
+	QMutex m_mutex;
+	QWaitCondition m_jobQueued;
+	QWaitCondition m_jobTaken;
+	QWaitCondition m_jobFinished;
+	std::deque<QueuedJob> m_queue;
+
+	/** The number of jobs submitted and not yet finished, per page. */
+	std::map<PageId, int> m_pendingJobsPerPage;
+
+	FailureHandler m_failureHandler;
+	int m_numPendingJobs;
+	bool m_shuttingDown;
+	std::auto_ptr<WorkerThread> m_ptrThread;
+};
+
+} // namespace output
+
+#endif
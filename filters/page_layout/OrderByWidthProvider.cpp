@@ -17,10 +17,10 @@
 */
 
 #include "OrderByWidthProvider.h"
-#include "Params.h"
-#include "Margins.h"
+#include "PageId.h"
 #include <QSizeF>
-#include <memory>
+#include <vector>
+#include <stddef.h>
 
 namespace page_layout
 {
@@ -30,40 +30,25 @@ OrderByWidthProvider::OrderByWidthProvider(IntrusivePtr<Settings> const& setting
 {
 }
 
-bool
-OrderByWidthProvider::precedes(
-	PageId const& lhs_page, bool const lhs_incomplete,
-	PageId const& rhs_page, bool const rhs_incomplete) const
+void
+OrderByWidthProvider::sortKeys(
+	std::vector<PageId> const& pages, std::vector<bool> const& incomplete,
+	std::vector<SortKey>& keys) const
 {
-	std::auto_ptr<Params> const lhs_params(m_ptrSettings->getPageParams(lhs_page));
-	std::auto_ptr<Params> const rhs_params(m_ptrSettings->getPageParams(rhs_page));
-	
-	QSizeF lhs_size;
-	if (lhs_params.get()) {
-		Margins const margins(lhs_params->hardMarginsMM());
-		lhs_size = lhs_params->contentSizeMM();
-		lhs_size += QSizeF(
-			margins.left() + margins.right(), margins.top() + margins.bottom()
-		);
+	std::vector<QSizeF> sizes;
+	m_ptrSettings->getHardSizesMM(pages, sizes);
+
+	keys.clear();
+	keys.reserve(pages.size());
+
+	for (size_t i = 0; i < pages.size(); ++i) {
+		if (incomplete[i] || !sizes[i].isValid()) {
+			// Invalid (unknown) sizes go to the back.
+			keys.push_back(SortKey(1, 0.0));
+		} else {
+			keys.push_back(SortKey(0, sizes[i].width()));
+		}
 	}
-	QSizeF rhs_size;
-	if (rhs_params.get()) {
-		Margins const margins(rhs_params->hardMarginsMM());
-		rhs_size = rhs_params->contentSizeMM();
-		rhs_size += QSizeF(
-			margins.left() + margins.right(), margins.top() + margins.bottom()
-		);
-	}
-	
-	bool const lhs_valid = !lhs_incomplete && lhs_size.isValid();
-	bool const rhs_valid = !rhs_incomplete && rhs_size.isValid();
-
-	if (lhs_valid != rhs_valid) {
-		// Invalid (unknown) sizes go to the back.
-		return lhs_valid;
-	}
-
-	return lhs_size.width() < rhs_size.width();
 }
 
 } // namespace page_layout
@@ -31,9 +31,9 @@ class OrderByWidthProvider : public PageOrderProvider
 public:
 	OrderByWidthProvider(IntrusivePtr<Settings> const& settings);
 
-	virtual bool precedes(
-		PageId const& lhs_page, bool lhs_incomplete,
-		PageId const& rhs_page, bool rhs_incomplete) const;
+	virtual void sortKeys(
+		std::vector<PageId> const& pages, std::vector<bool> const& incomplete,
+		std::vector<SortKey>& keys) const;
 private:
 	IntrusivePtr<Settings> m_ptrSettings;
 };
@@ -24,6 +24,8 @@
 #include "Alignment.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
+#include "SnapshotPublisher.h"
+#include "ChunkedMap.h"
 #include <QSizeF>
 #include <QMutex>
 #include <QMutexLocker>
@@ -129,6 +131,9 @@ public:
 	
 	std::auto_ptr<Params> getPageParams(PageId const& page_id) const;
 	
+	void getHardSizesMM(
+		std::vector<PageId> const& page_ids, std::vector<QSizeF>& sizes) const;
+	
 	void setPageParams(PageId const& page_id, Params const& params);
 	
 	Params updateContentSizeAndGetParams(
@@ -198,9 +203,42 @@ private:
 	typedef Container::index<SequencedTag>::type UnorderedItems;
 	typedef Container::index<DescWidthTag>::type DescWidthOrder;
 	typedef Container::index<DescHeightTag>::type DescHeightOrder;
-	
+
+	/**
+	 * \brief What readers that don't lock get to see.
+	 *
+	 * The items of m_items by page, plus the aggregate size
+	 * computed from all of them.
+	 */
+	class Published
+	{
+	public:
+		ChunkedMap<PageId, Item> items;
+		QSizeF aggregateHardSizeMM;
+	};
+
+	/**
+	 * \brief Publishes a changed or a newly inserted item.
+	 *
+	 * To be called with m_mutex locked.
+	 */
+	void publishItem(Item const& item);
+
+	/**
+	 * \brief Publishes m_items from scratch.
+	 *
+	 * To be called with m_mutex locked.
+	 */
+	void publishAll();
+	
+	/**
+	 * Serializes writers and protects m_items, whose indices are still
+	 * needed by getAggregateHardSizeMM() for a hypothetical page.
+	 * Other readers use m_published and don't lock.
+	 */
 	mutable QMutex m_mutex;
 	Container m_items;
+	SnapshotPublisher<Published> m_published;
 	UnorderedItems& m_unorderedItems;
 	DescWidthOrder& m_descWidthOrder;
 	DescHeightOrder& m_descHeightOrder;
@@ -252,6 +290,13 @@ Settings::getPageParams(PageId const& page_id) const
 	return m_ptrImpl->getPageParams(page_id);
 }
 
+void
+Settings::getHardSizesMM(
+	std::vector<PageId> const& page_ids, std::vector<QSizeF>& sizes) const
+{
+	m_ptrImpl->getHardSizesMM(page_ids, sizes);
+}
+
 void
 Settings::setPageParams(PageId const& page_id, Params const& params)
 {
@@ -369,6 +414,7 @@ Settings::Impl::Impl()
 	m_defaultHardMarginsMM(page_layout::Settings::defaultHardMarginsMM()),
 	m_defaultAlignment(Alignment::TOP, Alignment::HCENTER)
 {
+	publishAll();
 }
 
 Settings::Impl::~Impl()
@@ -380,6 +426,7 @@ Settings::Impl::clear()
 {
 	QMutexLocker const locker(&m_mutex);
 	m_items.clear();
+	publishAll();
 }
 
 void
@@ -396,6 +443,7 @@ Settings::Impl::performRelinking(AbstractRelinker const& relinker)
 	}
 
 	m_items.swap(new_items);
+	publishAll();
 }
 
 void
@@ -420,13 +468,15 @@ Settings::Impl::removePagesMissingFrom(PageSequence const& pages)
 			m_unorderedItems.erase(it++);
 		}
 	}
+
+	publishAll();
 }
 
 bool
 Settings::Impl::checkEverythingDefined(
 	PageSequence const& pages, PageId const* ignore) const
 {
-	QMutexLocker const locker(&m_mutex);
+	SnapshotPublisher<Published>::Snapshot const published(m_published.snapshot());
 	
 	size_t const num_pages = pages.numPages();
 	for (size_t i = 0; i < num_pages; ++i) {
@@ -434,8 +484,8 @@ Settings::Impl::checkEverythingDefined(
 		if (ignore && *ignore == page_info.id()) {
 			continue;
 		}
-		Container::iterator const it(m_items.find(page_info.id()));
-		if (it == m_items.end() || !it->contentSizeMM.isValid()) {
+		Item const* const item = published->items.find(page_info.id());
+		if (!item || !item->contentSizeMM.isValid()) {
 			return false;
 		}
 	}
@@ -446,18 +496,37 @@ Settings::Impl::checkEverythingDefined(
 std::auto_ptr<Params>
 Settings::Impl::getPageParams(PageId const& page_id) const
 {
-	QMutexLocker const locker(&m_mutex);
+	SnapshotPublisher<Published>::Snapshot const published(m_published.snapshot());
 	
-	Container::iterator const it(m_items.find(page_id));
-	if (it == m_items.end()) {
+	Item const* const item = published->items.find(page_id);
+	if (!item) {
 		return std::auto_ptr<Params>();
 	}
 	
 	return std::auto_ptr<Params>(
-		new Params(it->hardMarginsMM, it->contentSizeMM, it->alignment)
+		new Params(item->hardMarginsMM, item->contentSizeMM, item->alignment)
 	);
 }
 
+void
+Settings::Impl::getHardSizesMM(
+	std::vector<PageId> const& page_ids, std::vector<QSizeF>& sizes) const
+{
+	sizes.clear();
+	sizes.reserve(page_ids.size());
+
+	SnapshotPublisher<Published>::Snapshot const published(m_published.snapshot());
+	
+	BOOST_FOREACH(PageId const& page_id, page_ids) {
+		Item const* const item = published->items.find(page_id);
+		if (!item) {
+			sizes.push_back(QSizeF());
+		} else {
+			sizes.push_back(QSizeF(item->hardWidthMM(), item->hardHeightMM()));
+		}
+	}
+}
+
 void
 Settings::Impl::setPageParams(PageId const& page_id, Params const& params)
 {
@@ -474,6 +543,8 @@ Settings::Impl::setPageParams(PageId const& page_id, Params const& params)
 	} else {
 		m_items.replace(it, new_item);
 	}
+
+	publishItem(new_item);
 }
 
 Params
@@ -498,6 +569,8 @@ Settings::Impl::updateContentSizeAndGetParams(
 	} else {
 		m_items.modify(it, ModifyContentSize(content_size_mm));
 	}
+
+	publishItem(*item_it);
 	
 	if (agg_hard_size_after) {
 		*agg_hard_size_after = getAggregateHardSizeMMLocked();
@@ -512,13 +585,13 @@ Settings::Impl::updateContentSizeAndGetParams(
 Margins
 Settings::Impl::getHardMarginsMM(PageId const& page_id) const
 {
-	QMutexLocker const locker(&m_mutex);
+	SnapshotPublisher<Published>::Snapshot const published(m_published.snapshot());
 	
-	Container::iterator const it(m_items.find(page_id));
-	if (it == m_items.end()) {
+	Item const* const item = published->items.find(page_id);
+	if (!item) {
 		return m_defaultHardMarginsMM;
 	} else {
-		return it->hardMarginsMM;
+		return item->hardMarginsMM;
 	}
 }
 
@@ -529,26 +602,29 @@ Settings::Impl::setHardMarginsMM(
 	QMutexLocker const locker(&m_mutex);
 	
 	Container::iterator const it(m_items.lower_bound(page_id));
+	Container::iterator item_it(it);
 	if (it == m_items.end() || page_id < it->pageId) {
 		Item const item(
 			page_id, margins_mm, m_invalidSize, m_defaultAlignment
 		);
-		m_items.insert(it, item);
+		item_it = m_items.insert(it, item);
 	} else {
 		m_items.modify(it, ModifyMargins(margins_mm));
 	}
+
+	publishItem(*item_it);
 }
 
 Alignment
 Settings::Impl::getPageAlignment(PageId const& page_id) const
 {
-	QMutexLocker const locker(&m_mutex);
+	SnapshotPublisher<Published>::Snapshot const published(m_published.snapshot());
 	
-	Container::iterator const it(m_items.find(page_id));
-	if (it == m_items.end()) {
+	Item const* const item = published->items.find(page_id);
+	if (!item) {
 		return m_defaultAlignment;
 	} else {
-		return it->alignment;
+		return item->alignment;
 	}
 }
 
@@ -561,15 +637,18 @@ Settings::Impl::setPageAlignment(
 	QSizeF const agg_size_before(getAggregateHardSizeMMLocked());
 
 	Container::iterator const it(m_items.lower_bound(page_id));
+	Container::iterator item_it(it);
 	if (it == m_items.end() || page_id < it->pageId) {
 		Item const item(
 			page_id, m_defaultHardMarginsMM, m_invalidSize, alignment
 		);
-		m_items.insert(it, item);
+		item_it = m_items.insert(it, item);
 	} else {
 		m_items.modify(it, ModifyAlignment(alignment));
 	}
 
+	publishItem(*item_it);
+
 	QSizeF const agg_size_after(getAggregateHardSizeMMLocked());
 	if (agg_size_before == agg_size_after) {
 		return AGGREGATE_SIZE_UNCHANGED;
@@ -587,15 +666,18 @@ Settings::Impl::setContentSizeMM(
 	QSizeF const agg_size_before(getAggregateHardSizeMMLocked());
 	
 	Container::iterator const it(m_items.lower_bound(page_id));
+	Container::iterator item_it(it);
 	if (it == m_items.end() || page_id < it->pageId) {
 		Item const item(
 			page_id, m_defaultHardMarginsMM,
 			content_size_mm, m_defaultAlignment
 		);
-		m_items.insert(it, item);
+		item_it = m_items.insert(it, item);
 	} else {
 		m_items.modify(it, ModifyContentSize(content_size_mm));
 	}
+
+	publishItem(*item_it);
 	
 	QSizeF const agg_size_after(getAggregateHardSizeMMLocked());
 	if (agg_size_before == agg_size_after) {
@@ -613,14 +695,14 @@ Settings::Impl::invalidateContentSize(PageId const& page_id)
 	Container::iterator const it(m_items.find(page_id));
 	if (it != m_items.end()) {
 		m_items.modify(it, ModifyContentSize(m_invalidSize));
+		publishItem(*it);
 	}
 }
 
 QSizeF
 Settings::Impl::getAggregateHardSizeMM() const
 {
-	QMutexLocker const locker(&m_mutex);
-	return getAggregateHardSizeMMLocked();
+	return m_published.snapshot()->aggregateHardSizeMM;
 }
 
 QSizeF
@@ -693,4 +775,24 @@ Settings::Impl::getAggregateHardSizeMM(
 	return QSizeF(width, height);
 }
 
+void
+Settings::Impl::publishItem(Item const& item)
+{
+	Published new_version(*m_published.snapshot());
+	new_version.items.set(item.pageId, item);
+	new_version.aggregateHardSizeMM = getAggregateHardSizeMMLocked();
+	m_published.publish(new_version);
+}
+
+void
+Settings::Impl::publishAll()
+{
+	Published new_version;
+	BOOST_FOREACH(Item const& item, m_unorderedItems) {
+		new_version.items.set(item.pageId, item);
+	}
+	new_version.aggregateHardSizeMM = getAggregateHardSizeMMLocked();
+	m_published.publish(new_version);
+}
+
 } // namespace page_layout
@@ -23,6 +23,7 @@
 #include "RefCountable.h"
 #include "Margins.h"
 #include <memory>
+#include <vector>
 
 class PageId;
 class Margins;
@@ -78,6 +79,18 @@ public:
 	 */
 	std::auto_ptr<Params> getPageParams(PageId const& page_id) const;
 	
+	/**
+	 * \brief Get hard page sizes (content plus hard margins) of many pages at once.
+	 *
+	 * Unlike calling getPageParams() for each page, this sees all of them
+	 * as of the same moment.
+	 * For pages unknown to us, a null QSizeF is produced.
+	 * \param page_ids The pages to get sizes for.
+	 * \param sizes Receives the sizes, in the same order as \p page_ids.
+	 */
+	void getHardSizesMM(
+		std::vector<PageId> const& page_ids, std::vector<QSizeF>& sizes) const;
+	
 	/**
 	 * \brief Set all page parameters at once.
 	 */
@@ -25,6 +25,7 @@
 #include "Utils.h"
 #include "FilterUiInterface.h"
 #include "TaskStatus.h"
+#include "PerformanceStats.h"
 #include "FilterData.h"
 #include "ImageView.h"
 #include "ImageTransformation.h"
@@ -91,6 +92,7 @@ Task::process(
 	QRectF const& content_rect)
 {
 	status.throwIfCancelled();
+	PerformanceStats::StageTimer const stage_timer(PerformanceStats::PAGE_LAYOUT_STAGE);
 	
 	QSizeF const content_size_mm(
 		Utils::calcRectSizeMM(data.xform(), content_rect)
@@ -20,9 +20,13 @@
 #include "OrderBySplitTypeProvider.h"
 #include "Params.h"
 #include "PageLayout.h"
-#include <QSizeF>
-#include <memory>
-#include <assert.h>
+#include "PageId.h"
+#include "ImageId.h"
+#ifndef Q_MOC_RUN
+#include <boost/foreach.hpp>
+#endif
+#include <vector>
+#include <stddef.h>
 
 namespace page_split
 {
@@ -32,49 +36,43 @@ OrderBySplitTypeProvider::OrderBySplitTypeProvider(IntrusivePtr<Settings> const&
 {
 }
 
-bool
-OrderBySplitTypeProvider::precedes(
-	PageId const& lhs_page, bool const lhs_incomplete,
-	PageId const& rhs_page, bool const rhs_incomplete) const
+void
+OrderBySplitTypeProvider::sortKeys(
+	std::vector<PageId> const& pages, std::vector<bool> const& incomplete,
+	std::vector<SortKey>& keys) const
 {
-	if (lhs_incomplete != rhs_incomplete) {
-		// Pages with question mark go to the bottom.
-		return rhs_incomplete;
-	} else if (lhs_incomplete) {
-		assert(rhs_incomplete);
-		// Two pages with question marks are ordered naturally.
-		return lhs_page < rhs_page;
+	std::vector<ImageId> image_ids;
+	image_ids.reserve(pages.size());
+	BOOST_FOREACH(PageId const& page, pages) {
+		image_ids.push_back(page.imageId());
 	}
 
-	assert(lhs_incomplete == false);
-	assert(rhs_incomplete == false);
+	std::vector<Settings::Record> records;
+	m_ptrSettings->getPageRecords(image_ids, records);
 
-	Settings::Record const lhs_record(m_ptrSettings->getPageRecord(lhs_page.imageId()));
-	Settings::Record const rhs_record(m_ptrSettings->getPageRecord(rhs_page.imageId()));
+	keys.clear();
+	keys.reserve(pages.size());
 
-	Params const* lhs_params = lhs_record.params();
-	Params const* rhs_params = rhs_record.params();
+	for (size_t i = 0; i < pages.size(); ++i) {
+		if (incomplete[i]) {
+			// Pages with question mark go to the bottom,
+			// and are ordered naturally among themselves.
+			keys.push_back(SortKey(1, 0.0));
+			continue;
+		}
 
-	int lhs_layout_type = lhs_record.combinedLayoutType();
-	if (lhs_params) {
-		lhs_layout_type = lhs_params->pageLayout().toLayoutType();
-	}
-	if (lhs_layout_type == AUTO_LAYOUT_TYPE) {
-		lhs_layout_type = 100; // To force it below pages with known layout.
-	}
+		Settings::Record const& record = records[i];
 
-	int rhs_layout_type = rhs_record.combinedLayoutType();
-	if (rhs_params) {
-		rhs_layout_type = rhs_params->pageLayout().toLayoutType();
-	}
-	if (rhs_layout_type == AUTO_LAYOUT_TYPE) {
-		rhs_layout_type = 100; // To force it below pages with known layout.
-	}
+		int layout_type = record.combinedLayoutType();
+		if (Params const* params = record.params()) {
+			layout_type = params->pageLayout().toLayoutType();
+		}
+		if (layout_type == AUTO_LAYOUT_TYPE) {
+			layout_type = 100; // To force it below pages with known layout.
+		}
 
-	if (lhs_layout_type == rhs_layout_type) {
-		return lhs_page < rhs_page;
-	} else {
-		return lhs_layout_type < rhs_layout_type;
+		// Pages of the same layout type are ordered naturally.
+		keys.push_back(SortKey(0, layout_type));
 	}
 }
 
@@ -32,9 +32,11 @@ class OrderBySplitTypeProvider : public PageOrderProvider
 public:
 	OrderBySplitTypeProvider(IntrusivePtr<Settings> const& settings);
 
-	virtual bool precedes(
-		PageId const& lhs_page, bool lhs_incomplete,
-		PageId const& rhs_page, bool rhs_incomplete) const;
+	virtual void sortKeys(
+		std::vector<PageId> const& pages, std::vector<bool> const& incomplete,
+		std::vector<SortKey>& keys) const;
+
+	virtual bool orderTiesByPageId() const { return true; }
 private:
 	IntrusivePtr<Settings> m_ptrSettings;
 };
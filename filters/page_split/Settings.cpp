@@ -108,6 +108,20 @@ Settings::getPageRecord(ImageId const& image_id) const
 	return getPageRecordLocked(image_id);
 }
 
+void
+Settings::getPageRecords(
+	std::vector<ImageId> const& image_ids, std::vector<Record>& records) const
+{
+	records.clear();
+	records.reserve(image_ids.size());
+
+	QMutexLocker locker(&m_mutex);
+
+	BOOST_FOREACH(ImageId const& image_id, image_ids) {
+		records.push_back(getPageRecordLocked(image_id));
+	}
+}
+
 Settings::Record
 Settings::getPageRecordLocked(ImageId const& image_id) const
 {
@@ -30,6 +30,7 @@
 #include <memory>
 #include <map>
 #include <set>
+#include <vector>
 
 class AbstractRelinker;
 
@@ -161,6 +162,16 @@ public:
 	 */
 	Record getPageRecord(ImageId const& image_id) const;
 	
+	/**
+	 * \brief Same as getPageRecord(), but for many pages at once,
+	 *        under a single lock.
+	 *
+	 * \param image_ids The images to get records for.
+	 * \param records Receives the records, in the same order as \p image_ids.
+	 */
+	void getPageRecords(
+		std::vector<ImageId> const& image_ids, std::vector<Record>& records) const;
+	
 	/**
 	 * \brief Performs the requested update on the page.
 	 *
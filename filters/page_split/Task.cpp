@@ -18,6 +18,7 @@
 
 #include "Task.h"
 #include "TaskStatus.h"
+#include "PerformanceStats.h"
 #include "Filter.h"
 #include "OptionsWidget.h"
 #include "Settings.h"
@@ -42,7 +43,9 @@
 #include <QImage>
 #include <QObject>
 #include <QDebug>
+#include <boost/foreach.hpp>
 #include <memory>
+#include <vector>
 #include <assert.h>
 
 namespace page_split
@@ -117,6 +120,7 @@ FilterResultPtr
 Task::process(TaskStatus const& status, FilterData const& data)
 {
 	status.throwIfCancelled();
+	PerformanceStats::StageTimer const stage_timer(PerformanceStats::PAGE_SPLIT_STAGE);
 	
 	Settings::Record record(m_ptrSettings->getPageRecord(m_pageInfo.imageId()));
 	
@@ -193,7 +197,7 @@ Task::process(TaskStatus const& status, FilterData const& data)
 	
 	m_ptrPages->setLayoutTypeFor(m_pageInfo.imageId(), toPageLayoutType(layout));
 	
-	if (m_ptrNextTask) {
+	if (m_ptrNextTask && !(m_batchProcessing && pageWasReplaced())) {
 		ImageTransformation new_xform(data.xform());
 		new_xform.setPreCropArea(layout.pageOutline(m_pageInfo.id().subPage()));
 		return m_ptrNextTask->process(status, FilterData(data, new_xform));
@@ -207,6 +211,24 @@ Task::process(TaskStatus const& status, FilterData const& data)
 	}
 }
 
+/**
+ * Returns true if splitting the image changed its pages, so that
+ * our page is no longer part of the project.  Running the following
+ * stages on it would be wasted work, as the pages that replaced it
+ * are going to be processed on their own.
+ */
+bool
+Task::pageWasReplaced() const
+{
+	std::vector<PageInfo> const pages(m_ptrPages->pagesOfImage(m_pageInfo.imageId()));
+	BOOST_FOREACH(PageInfo const& page, pages) {
+		if (page.id() == m_pageInfo.id()) {
+			return false;
+		}
+	}
+	return true;
+}
+
 
 /*============================ Task::UiUpdater =========================*/
 
@@ -62,6 +62,8 @@ public:
 private:
 	class UiUpdater;
 
+	bool pageWasReplaced() const;
+
 	IntrusivePtr<Filter> m_ptrFilter;
 	IntrusivePtr<Settings> m_ptrSettings;
 	IntrusivePtr<ProjectPages> m_ptrPages;
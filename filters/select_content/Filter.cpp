@@ -36,6 +36,8 @@
 #include <QObject>
 #include <QDomDocument>
 #include <QDomElement>
+#include <vector>
+#include <utility>
 #include <assert.h>
 #include "CommandLine.h"
 
@@ -154,6 +156,8 @@ Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
 		filters_el.namedItem("select-content").toElement()
 	);
 	
+	std::vector<std::pair<PageId, Params> > page_params;
+
 	QString const page_tag_name("page");
 	QDomNode node(filter_el.firstChild());
 	for (; !node.isNull(); node = node.nextSibling()) {
@@ -181,9 +185,10 @@ Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
 			continue;
 		}
 		
-		Params const params(params_el);
-		m_ptrSettings->setPageParams(page_id, params);
+		page_params.push_back(std::make_pair(page_id, Params(params_el)));
 	}
+
+	m_ptrSettings->setPageParams(page_params);
 }
 
 IntrusivePtr<Task>
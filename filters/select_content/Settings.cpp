@@ -17,7 +17,6 @@
 */
 
 #include "Settings.h"
-#include "Utils.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
 #include <QMutexLocker>
@@ -40,7 +39,8 @@ void
 Settings::clear()
 {
 	QMutexLocker locker(&m_mutex);
-	m_pageParams.clear();
+	PageParams empty;
+	m_pageParams.publish(empty);
 }
 
 void
@@ -49,41 +49,78 @@ Settings::performRelinking(AbstractRelinker const& relinker)
 	QMutexLocker locker(&m_mutex);
 	PageParams new_params;
 
-	BOOST_FOREACH(PageParams::value_type const& kv, m_pageParams) {
+	SnapshotPublisher<PageParams>::Snapshot const old_version(m_pageParams.snapshot());
+	BOOST_FOREACH(PageParams::value_type const& kv, *old_version) {
 		RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
 		PageId new_page_id(kv.first);
 		new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
-		new_params.insert(PageParams::value_type(new_page_id, kv.second));
+		new_params.set(new_page_id, kv.second);
 	}
 
-	m_pageParams.swap(new_params);
+	m_pageParams.publish(new_params);
 }
 
 void
 Settings::setPageParams(PageId const& page_id, Params const& params)
 {
 	QMutexLocker locker(&m_mutex);
-	Utils::mapSetValue(m_pageParams, page_id, params);
+	PageParams new_params(*m_pageParams.snapshot());
+	new_params.set(page_id, params);
+	m_pageParams.publish(new_params);
+}
+
+void
+Settings::setPageParams(std::vector<std::pair<PageId, Params> > const& page_params)
+{
+	typedef std::pair<PageId, Params> PageAndParams;
+
+	QMutexLocker locker(&m_mutex);
+	PageParams new_params(*m_pageParams.snapshot());
+	BOOST_FOREACH(PageAndParams const& pp, page_params) {
+		new_params.set(pp.first, pp.second);
+	}
+	m_pageParams.publish(new_params);
 }
 
 void
 Settings::clearPageParams(PageId const& page_id)
 {
 	QMutexLocker locker(&m_mutex);
-	m_pageParams.erase(page_id);
+	PageParams new_params(*m_pageParams.snapshot());
+	new_params.erase(page_id);
+	m_pageParams.publish(new_params);
 }
 
 std::auto_ptr<Params>
 Settings::getPageParams(PageId const& page_id) const
 {
-	QMutexLocker locker(&m_mutex);
+	SnapshotPublisher<PageParams>::Snapshot const params(m_pageParams.snapshot());
 	
-	PageParams::const_iterator const it(m_pageParams.find(page_id));
-	if (it != m_pageParams.end()) {
-		return std::auto_ptr<Params>(new Params(it->second));
+	Params const* const page_params = params->find(page_id);
+	if (page_params) {
+		return std::auto_ptr<Params>(new Params(*page_params));
 	} else {
 		return std::auto_ptr<Params>();
 	}
 }
 
+void
+Settings::getContentSizesMM(
+	std::vector<PageId> const& page_ids, std::vector<QSizeF>& sizes) const
+{
+	sizes.clear();
+	sizes.reserve(page_ids.size());
+
+	SnapshotPublisher<PageParams>::Snapshot const params(m_pageParams.snapshot());
+	
+	BOOST_FOREACH(PageId const& page_id, page_ids) {
+		Params const* const page_params = params->find(page_id);
+		if (page_params) {
+			sizes.push_back(page_params->contentSizeMM());
+		} else {
+			sizes.push_back(QSizeF());
+		}
+	}
+}
+
 } // namespace select_content
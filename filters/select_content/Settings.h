@@ -23,9 +23,13 @@
 #include "NonCopyable.h"
 #include "PageId.h"
 #include "Params.h"
+#include "SnapshotPublisher.h"
+#include "ChunkedMap.h"
 #include <QMutex>
+#include <QSizeF>
 #include <memory>
-#include <map>
+#include <vector>
+#include <utility>
 
 class AbstractRelinker;
 
@@ -45,15 +49,31 @@ public:
 	void performRelinking(AbstractRelinker const& relinker);
 
 	void setPageParams(PageId const& page_id, Params const& params);
+
+	/**
+	 * \brief Sets parameters for many pages at once.
+	 *
+	 * Much faster than setting them one by one.
+	 */
+	void setPageParams(std::vector<std::pair<PageId, Params> > const& page_params);
 	
 	void clearPageParams(PageId const& page_id);
 	
 	std::auto_ptr<Params> getPageParams(PageId const& page_id) const;
+	
+	/**
+	 * \brief Get content sizes of many pages at once, from a single snapshot.
+	 *
+	 * For pages unknown to us, a null QSizeF is produced.
+	 */
+	void getContentSizesMM(
+		std::vector<PageId> const& page_ids, std::vector<QSizeF>& sizes) const;
 private:
-	typedef std::map<PageId, Params> PageParams;
+	typedef ChunkedMap<PageId, Params> PageParams;
 	
-	mutable QMutex m_mutex;
-	PageParams m_pageParams;
+	/** Serializes writers.  Readers don't lock. */
+	QMutex m_mutex;
+	SnapshotPublisher<PageParams> m_pageParams;
 };
 
 } // namespace select_content
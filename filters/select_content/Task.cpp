@@ -26,6 +26,7 @@
 #include "Params.h"
 #include "Settings.h"
 #include "TaskStatus.h"
+#include "PerformanceStats.h"
 #include "ContentBoxFinder.h"
 #include "FilterUiInterface.h"
 #include "ImageView.h"
@@ -88,6 +89,7 @@ FilterResultPtr
 Task::process(TaskStatus const& status, FilterData const& data)
 {
 	status.throwIfCancelled();
+	PerformanceStats::StageTimer const stage_timer(PerformanceStats::SELECT_CONTENT_STAGE);
 	
 	Dependencies const deps(data.xform().resultingPreCropArea());
 
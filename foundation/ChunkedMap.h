@@ -0,0 +1,294 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2007-2008  Joseph Artsimovich <joseph_a@mail.ru>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CHUNKEDMAP_H_
+#define CHUNKEDMAP_H_
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "IntrusivePtr.h"
+#include <QAtomicInt>
+#include <map>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <stddef.h>
+
+/**
+ * \brief A map that is cheap to copy and then modify.
+ *
+ * Entries are distributed among a fixed number of chunks by qHash()
+ * of their keys.  Copies share chunks, and a shared chunk gets copied
+ * when one of the maps sharing it modifies it.  Modifying
+ * a single entry of a fresh copy therefore costs a fraction of the map
+ * size rather than the whole map, which is what makes it suitable
+ * as a value held by SnapshotPublisher.
+ *
+ * The iteration order is by chunks, and by keys within a chunk.
+ */
+template<typename K, typename V>
+class ChunkedMap
+{
+private:
+	enum { NUM_CHUNKS = 128 };
+
+	typedef std::map<K, V> Entries;
+
+	class Chunk
+	{
+	public:
+		Chunk() : m_refCounter(0) {}
+
+		void ref() const { m_refCounter.fetchAndAddRelaxed(1); }
+
+		void unref() const {
+			if (m_refCounter.fetchAndAddRelease(-1) == 1) {
+				delete this;
+			}
+		}
+
+		/**
+		 * A chunk only referenced by the map asking may be modified in place.
+		 * No one else can start sharing it concurrently, as that would take
+		 * a reference to it.
+		 */
+		bool isShared() const { return m_refCounter != 1; }
+
+		Entries entries;
+	private:
+		mutable QAtomicInt m_refCounter;
+	};
+public:
+	typedef K key_type;
+	typedef V mapped_type;
+	typedef typename Entries::value_type value_type;
+
+	class const_iterator
+	{
+		friend class ChunkedMap;
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef typename Entries::value_type value_type;
+		typedef typename Entries::difference_type difference_type;
+		typedef value_type const* pointer;
+		typedef value_type const& reference;
+
+		const_iterator() : m_pMap(0), m_chunk(NUM_CHUNKS) {}
+
+		reference operator*() const { return *m_it; }
+
+		pointer operator->() const { return &*m_it; }
+
+		const_iterator& operator++();
+
+		const_iterator operator++(int) {
+			const_iterator const prev(*this);
+			++*this;
+			return prev;
+		}
+
+		bool operator==(const_iterator const& other) const {
+			return m_chunk == other.m_chunk && (m_chunk == NUM_CHUNKS || m_it == other.m_it);
+		}
+
+		bool operator!=(const_iterator const& other) const { return !(*this == other); }
+	private:
+		const_iterator(ChunkedMap const* map, int chunk);
+
+		/** Moves to the first entry of the first non-empty chunk at or after m_chunk. */
+		void skipEmptyChunks();
+
+		ChunkedMap const* m_pMap;
+		int m_chunk;
+		typename Entries::const_iterator m_it;
+	};
+
+	typedef const_iterator iterator;
+
+	ChunkedMap();
+
+	// Member-wise copying is OK.  It shares the chunks.
+
+	void swap(ChunkedMap& other);
+
+	bool empty() const { return m_size == 0; }
+
+	size_t size() const { return m_size; }
+
+	/**
+	 * \brief Returns the value for \p key, or null if there isn't one.
+	 */
+	V const* find(K const& key) const;
+
+	/**
+	 * \brief Inserts or replaces the value for \p key.
+	 */
+	void set(K const& key, V const& value);
+
+	void erase(K const& key);
+
+	void clear();
+
+	const_iterator begin() const { return const_iterator(this, 0); }
+
+	const_iterator end() const { return const_iterator(); }
+private:
+	static int chunkFor(K const& key);
+
+	/**
+	 * Returns the entries of a chunk this instance may modify,
+	 * copying a shared chunk or creating a missing one.
+	 */
+	Entries& writableEntries(int chunk);
+
+	/** Null pointers stand for empty chunks. */
+	IntrusivePtr<Chunk> m_chunks[NUM_CHUNKS];
+
+	size_t m_size;
+};
+
+
+template<typename K, typename V>
+ChunkedMap<K, V>::ChunkedMap()
+:	m_size(0)
+{
+}
+
+template<typename K, typename V>
+void
+ChunkedMap<K, V>::swap(ChunkedMap& other)
+{
+	for (int i = 0; i < NUM_CHUNKS; ++i) {
+		m_chunks[i].swap(other.m_chunks[i]);
+	}
+	std::swap(m_size, other.m_size);
+}
+
+template<typename K, typename V>
+V const*
+ChunkedMap<K, V>::find(K const& key) const
+{
+	Chunk const* const chunk = m_chunks[chunkFor(key)].get();
+	if (!chunk) {
+		return 0;
+	}
+
+	typename Entries::const_iterator const it(chunk->entries.find(key));
+	if (it == chunk->entries.end()) {
+		return 0;
+	}
+
+	return &it->second;
+}
+
+template<typename K, typename V>
+void
+ChunkedMap<K, V>::set(K const& key, V const& value)
+{
+	Entries& entries = writableEntries(chunkFor(key));
+
+	typename Entries::iterator const it(entries.lower_bound(key));
+	if (it == entries.end() || entries.key_comp()(key, it->first)) {
+		entries.insert(it, typename Entries::value_type(key, value));
+		++m_size;
+	} else {
+		it->second = value;
+	}
+}
+
+template<typename K, typename V>
+void
+ChunkedMap<K, V>::erase(K const& key)
+{
+	int const chunk = chunkFor(key);
+	if (!find(key)) {
+		return;
+	}
+
+	writableEntries(chunk).erase(key);
+	--m_size;
+}
+
+template<typename K, typename V>
+void
+ChunkedMap<K, V>::clear()
+{
+	ChunkedMap().swap(*this);
+}
+
+template<typename K, typename V>
+int
+ChunkedMap<K, V>::chunkFor(K const& key)
+{
+	return qHash(key) % NUM_CHUNKS;
+}
+
+template<typename K, typename V>
+typename ChunkedMap<K, V>::Entries&
+ChunkedMap<K, V>::writableEntries(int const chunk)
+{
+	IntrusivePtr<Chunk>& ptr = m_chunks[chunk];
+	if (!ptr.get()) {
+		ptr.reset(new Chunk);
+	} else if (ptr->isShared()) {
+		Chunk* const copy = new Chunk;
+		copy->entries = ptr->entries;
+		ptr.reset(copy);
+	}
+	return ptr->entries;
+}
+
+
+/*============================ const_iterator ============================*/
+
+template<typename K, typename V>
+ChunkedMap<K, V>::const_iterator::const_iterator(ChunkedMap const* map, int const chunk)
+:	m_pMap(map),
+	m_chunk(chunk)
+{
+	skipEmptyChunks();
+}
+
+template<typename K, typename V>
+typename ChunkedMap<K, V>::const_iterator&
+ChunkedMap<K, V>::const_iterator::operator++()
+{
+	if (++m_it == m_pMap->m_chunks[m_chunk]->entries.end()) {
+		++m_chunk;
+		skipEmptyChunks();
+	}
+	return *this;
+}
+
+template<typename K, typename V>
+void
+ChunkedMap<K, V>::const_iterator::skipEmptyChunks()
+{
+	for (; m_chunk < NUM_CHUNKS; ++m_chunk) {
+		Chunk const* const chunk = m_pMap->m_chunks[m_chunk].get();
+		if (chunk && !chunk->entries.empty()) {
+			m_it = chunk->entries.begin();
+			return;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,83 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ParallelFor.h"
+#include "ThreadPool.h"
+#include <QAtomicInt>
+#include <algorithm>
+
+namespace
+{
+
+class ChunkJob : public ThreadPool::Job
+{
+public:
+	ChunkJob(int num_items, int grain, VirtualFunction2<void, int, int>& func)
+	:	m_rFunc(func),
+		m_numItems(num_items),
+		m_grain(grain),
+		m_nextChunk(0) {}
+protected:
+	virtual bool doRunOne()
+	{
+		if (isCancelled()) {
+			return false;
+		}
+
+		int const chunk = m_nextChunk.fetchAndAddRelaxed(1);
+		if (chunk >= numChunks()) {
+			return false;
+		}
+
+		int const begin = chunk * m_grain;
+		m_rFunc(begin, std::min(begin + m_grain, m_numItems));
+		return true;
+	}
+
+	virtual bool hasUnclaimedUnits() const
+	{
+		return !isCancelled() && int(m_nextChunk) < numChunks();
+	}
+private:
+	int numChunks() const { return (m_numItems + m_grain - 1) / m_grain; }
+
+	VirtualFunction2<void, int, int>& m_rFunc;
+	int m_numItems;
+	int m_grain;
+	QAtomicInt m_nextChunk;
+};
+
+} // anonymous namespace
+
+void parallelForImpl(
+	int const num_items, int const grain, VirtualFunction2<void, int, int>& func)
+{
+	if (num_items <= 0) {
+		return;
+	}
+
+	if (num_items <= grain) {
+		// A single chunk.  No point in involving other threads.
+		func(0, num_items);
+		return;
+	}
+
+	ChunkJob job(num_items, std::max(grain, 1), func);
+	ThreadPool::instance().run(job);
+}
@@ -0,0 +1,49 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PARALLEL_FOR_H_
+#define PARALLEL_FOR_H_
+
+#include "VirtualFunction.h"
+
+/**
+ * \brief Splits a range of items into chunks and processes them
+ *        on ThreadPool.
+ *
+ * \param num_items The number of items to process.
+ * \param grain The number of items in a chunk, except possibly the last one.
+ * \param func Will be called like this: func(begin, end), with end being
+ *        exclusive, for every chunk.  It may be called concurrently for
+ *        different chunks, and it may itself call parallelFor().
+ *
+ * The calling thread processes chunks as well, and returns once all
+ * of them are done.  If \p func throws, the remaining chunks are skipped
+ * and the exception is re-thrown in the calling thread.
+ * \see ThreadPool::run()
+ */
+void parallelForImpl(int num_items, int grain, VirtualFunction2<void, int, int>& func);
+
+template<typename Func>
+void parallelFor(int num_items, int grain, Func func)
+{
+	ProxyFunction2<Func, void, int, int> proxy(func);
+	parallelForImpl(num_items, grain, proxy);
+}
+
+#endif
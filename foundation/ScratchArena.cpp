@@ -0,0 +1,155 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ScratchArena.h"
+#include <QThreadStorage>
+#include <new>
+#include <algorithm>
+#include <stdlib.h>
+#include <assert.h>
+
+namespace
+{
+
+size_t const ALIGNMENT = 16;
+
+/**
+ * The size of a regular block.  Larger requests get blocks of their own size.
+ */
+size_t const MIN_BLOCK_SIZE = 256 * 1024;
+
+size_t alignUp(size_t size)
+{
+	return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+/**
+ * A namespace-scope object, as function-local statics are not
+ * initialized in a thread-safe way by every compiler we support.
+ * QThreadStorage deletes the arenas as their threads exit.
+ */
+QThreadStorage<ScratchArena*> arenas;
+
+} // anonymous namespace
+
+
+class ScratchArena::Block
+{
+	DECLARE_NON_COPYABLE(Block)
+public:
+	Block(size_t size)
+	:	m_pStorage((char*)malloc(size + ALIGNMENT - 1)),
+		m_size(size)
+	{
+		if (!m_pStorage) {
+			throw std::bad_alloc();
+		}
+	}
+
+	~Block() { free(m_pStorage); }
+
+	char* data() const {
+		return (char*)alignUp((size_t)m_pStorage);
+	}
+
+	size_t size() const { return m_size; }
+private:
+	char* m_pStorage;
+	size_t m_size;
+};
+
+
+/*============================== ScratchArena ===============================*/
+
+ScratchArena&
+ScratchArena::forCurrentThread()
+{
+	if (!arenas.hasLocalData()) {
+		arenas.setLocalData(new ScratchArena);
+	}
+	return *arenas.localData();
+}
+
+ScratchArena::ScratchArena()
+:	m_curBlockIdx(0),
+	m_curOffset(0)
+{
+}
+
+ScratchArena::~ScratchArena()
+{
+	for (size_t i = 0; i < m_blocks.size(); ++i) {
+		delete m_blocks[i];
+	}
+}
+
+void*
+ScratchArena::allocate(size_t size)
+{
+	size = alignUp(std::max<size_t>(size, 1));
+
+	// Find a block with enough space, starting from the current one.
+	// Blocks past the current one are free, as they were rewound.
+	while (m_curBlockIdx < m_blocks.size()) {
+		Block* block = m_blocks[m_curBlockIdx];
+		if (block->size() - m_curOffset >= size) {
+			void* const ptr = block->data() + m_curOffset;
+			m_curOffset += size;
+			return ptr;
+		}
+
+		if (m_curOffset == 0) {
+			// Unused but too small.  Replace it with a bigger one.
+			m_blocks[m_curBlockIdx] = new Block(std::max(size, MIN_BLOCK_SIZE));
+			delete block;
+			continue;
+		}
+
+		++m_curBlockIdx;
+		m_curOffset = 0;
+	}
+
+	m_blocks.push_back(new Block(std::max(size, MIN_BLOCK_SIZE)));
+	m_curBlockIdx = m_blocks.size() - 1;
+	m_curOffset = size;
+	return m_blocks.back()->data();
+}
+
+void
+ScratchArena::rewind(size_t const block_idx, size_t const offset)
+{
+	assert(block_idx < m_curBlockIdx || (block_idx == m_curBlockIdx && offset <= m_curOffset));
+	m_curBlockIdx = block_idx;
+	m_curOffset = offset;
+}
+
+
+/*=========================== ScratchArena::Scope ===========================*/
+
+ScratchArena::Scope::Scope()
+:	m_rArena(ScratchArena::forCurrentThread()),
+	m_blockIdx(m_rArena.m_curBlockIdx),
+	m_offset(m_rArena.m_curOffset)
+{
+}
+
+ScratchArena::Scope::~Scope()
+{
+	m_rArena.rewind(m_blockIdx, m_offset);
+}
@@ -0,0 +1,98 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SCRATCH_ARENA_H_
+#define SCRATCH_ARENA_H_
+
+#include "NonCopyable.h"
+#include <vector>
+#include <stddef.h>
+
+/**
+ * \brief Per-thread memory for temporary buffers.
+ *
+ * Memory is handed out by bumping a pointer and given back in bulk
+ * when a Scope ends.  The underlying blocks are kept for the lifetime
+ * of the thread, so once warmed up, getting a temporary row buffer
+ * in a parallelFor() chunk doesn't involve the heap at all.
+ * \code
+ * void operator()(int begin, int end) const {
+ *     ScratchArena::Scope scratch;
+ *     unsigned* sums = scratch.alloc<unsigned>(width);
+ *     ...
+ * }
+ * \endcode
+ * Only use it for POD types, as constructors and destructors are not called.
+ */
+class ScratchArena
+{
+	DECLARE_NON_COPYABLE(ScratchArena)
+public:
+	/**
+	 * \brief Marks the current position in the calling thread's arena
+	 *        and rewinds to it on destruction.
+	 *
+	 * Scopes must be destroyed in the reverse order of creation,
+	 * which is what happens naturally with automatic variables.
+	 */
+	class Scope
+	{
+		DECLARE_NON_COPYABLE(Scope)
+	public:
+		Scope();
+
+		~Scope();
+
+		/**
+		 * \brief Returns uninitialized memory for \p count objects of type T,
+		 *        aligned to 16 bytes.
+		 *
+		 * \throw std::bad_alloc
+		 */
+		template<typename T>
+		T* alloc(size_t count) {
+			return static_cast<T*>(m_rArena.allocate(count * sizeof(T)));
+		}
+	private:
+		ScratchArena& m_rArena;
+		size_t m_blockIdx;
+		size_t m_offset;
+	};
+
+	/**
+	 * \brief Returns the arena of the calling thread, creating it if necessary.
+	 */
+	static ScratchArena& forCurrentThread();
+
+	~ScratchArena();
+private:
+	class Block;
+
+	ScratchArena();
+
+	void* allocate(size_t size);
+
+	void rewind(size_t block_idx, size_t offset);
+
+	std::vector<Block*> m_blocks;
+	size_t m_curBlockIdx;
+	size_t m_curOffset;
+};
+
+#endif
@@ -0,0 +1,167 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2007-2008  Joseph Artsimovich <joseph_a@mail.ru>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SNAPSHOTPUBLISHER_H_
+#define SNAPSHOTPUBLISHER_H_
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "NonCopyable.h"
+#include "RefCountable.h"
+#include "IntrusivePtr.h"
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QThread>
+#include <algorithm>
+
+/**
+ * \brief Holds a value that may be read without locking.
+ *
+ * Readers obtain an immutable, reference-counted snapshot of the current
+ * version of the value.  Writers build a new version and publish it,
+ * replacing the old one.  Readers holding a snapshot of an old version
+ * keep it alive for as long as they need it.
+ *
+ * snapshot() never blocks.  publish() waits for a grace period: readers
+ * that were in the middle of taking a snapshot when the new version was
+ * published have to finish doing so.  Readers arriving later don't
+ * prolong the grace period, so a steady stream of them can't starve
+ * a writer.  Writers have to be serialized by the caller.
+ */
+template<typename T>
+class SnapshotPublisher
+{
+	DECLARE_NON_COPYABLE(SnapshotPublisher)
+private:
+	class Version : public RefCountable
+	{
+	public:
+		T value;
+	};
+public:
+	class Snapshot
+	{
+		// Member-wise copying is OK.
+		friend class SnapshotPublisher;
+	public:
+		T const& operator*() const { return m_ptrVersion->value; }
+
+		T const* operator->() const { return &m_ptrVersion->value; }
+	private:
+		explicit Snapshot(Version const* version) : m_ptrVersion(version) {}
+
+		IntrusivePtr<Version const> m_ptrVersion;
+	};
+
+	SnapshotPublisher();
+
+	~SnapshotPublisher();
+
+	/**
+	 * \brief Returns the current version of the value.  Doesn't lock.
+	 */
+	Snapshot snapshot() const;
+
+	/**
+	 * \brief Makes \p value the current version.
+	 *
+	 * The contents of \p value are swapped into the new version,
+	 * leaving \p value with the contents of a default-constructed T.
+	 */
+	void publish(T& value);
+private:
+	/**
+	 * The number of readers in the middle of snapshot(), separately
+	 * for even and odd epochs.
+	 */
+	mutable QAtomicInt m_readers[2];
+
+	/** Incremented by every publish(). */
+	QAtomicInt m_epoch;
+
+	/** Holds a reference to the current version. */
+	QAtomicPointer<Version> m_pVersion;
+};
+
+
+template<typename T>
+SnapshotPublisher<T>::SnapshotPublisher()
+:	m_epoch(0),
+	m_pVersion(new Version)
+{
+	m_readers[0] = 0;
+	m_readers[1] = 0;
+	static_cast<Version*>(m_pVersion)->ref();
+}
+
+template<typename T>
+SnapshotPublisher<T>::~SnapshotPublisher()
+{
+	static_cast<Version*>(m_pVersion)->unref();
+}
+
+template<typename T>
+typename SnapshotPublisher<T>::Snapshot
+SnapshotPublisher<T>::snapshot() const
+{
+	QAtomicInt* readers;
+	for (;;) {
+		int const epoch = m_epoch;
+		readers = &m_readers[epoch & 1];
+		readers->fetchAndAddOrdered(1);
+		if (m_epoch == epoch) {
+			break;
+		}
+		// A writer has started a new epoch in the meantime.
+		// Don't hold up its grace period.
+		readers->fetchAndAddOrdered(-1);
+	}
+
+	Snapshot const result(static_cast<Version*>(m_pVersion));
+	readers->fetchAndAddOrdered(-1);
+	return result;
+}
+
+template<typename T>
+void
+SnapshotPublisher<T>::publish(T& value)
+{
+	Version* const version = new Version;
+	using std::swap;
+	swap(version->value, value);
+	version->ref();
+
+	Version* const old_version = m_pVersion.fetchAndStoreOrdered(version);
+
+	// A reader may have loaded old_version but not yet referenced it.
+	// Such a reader is counted in the current epoch's counter.  Readers
+	// arriving after we start a new epoch are counted in the other one,
+	// and they see the new version, so the counter we wait on drains
+	// within a few instructions of every reader it counts.
+	int const old_epoch = m_epoch.fetchAndAddOrdered(1);
+	QAtomicInt& old_readers = m_readers[old_epoch & 1];
+	while (!old_readers.testAndSetOrdered(0, 0)) {
+		QThread::yieldCurrentThread();
+	}
+
+	old_version->unref();
+}
+
+#endif
@@ -0,0 +1,115 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "TaskGroup.h"
+#include <QMutexLocker>
+#include <memory>
+
+TaskGroup::TaskGroup()
+{
+	ThreadPool::instance().submit(&m_job);
+}
+
+TaskGroup::~TaskGroup()
+{
+	try {
+		waitForTasks();
+	} catch (...) {
+		// Not re-throwing from a destructor.
+	}
+}
+
+void
+TaskGroup::wait()
+{
+	waitForTasks();
+
+	// Tasks added after this point should be picked up by pool
+	// threads right away, not when wait() is called again.
+	ThreadPool::instance().submit(&m_job);
+}
+
+void
+TaskGroup::addTask(Task* task)
+{
+	m_job.addTask(task);
+	ThreadPool::instance().wakeWorkers();
+}
+
+void
+TaskGroup::waitForTasks()
+{
+	do {
+		ThreadPool::instance().run(m_job);
+
+		// Tasks still running on other threads might have added
+		// more tasks after we ran out of them.
+	} while (!m_job.empty());
+}
+
+
+/*============================= TaskGroup::Job ==============================*/
+
+TaskGroup::Job::~Job()
+{
+	// Tasks skipped because of a failure.
+	while (!m_tasks.empty()) {
+		delete m_tasks.front();
+		m_tasks.pop_front();
+	}
+}
+
+void
+TaskGroup::Job::addTask(Task* task)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_tasks.push_back(task);
+}
+
+bool
+TaskGroup::Job::empty() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return isCancelled() || m_tasks.empty();
+}
+
+bool
+TaskGroup::Job::doRunOne()
+{
+	std::auto_ptr<Task> task;
+
+	{
+		QMutexLocker const locker(&m_mutex);
+		if (isCancelled() || m_tasks.empty()) {
+			return false;
+		}
+		task.reset(m_tasks.front());
+		m_tasks.pop_front();
+	}
+
+	(*task)();
+	return true;
+}
+
+bool
+TaskGroup::Job::hasUnclaimedUnits() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return !isCancelled() && !m_tasks.empty();
+}
@@ -0,0 +1,119 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef TASK_GROUP_H_
+#define TASK_GROUP_H_
+
+#include "NonCopyable.h"
+#include "ThreadPool.h"
+#include <QMutex>
+#include <deque>
+
+/**
+ * \brief A set of independent tasks to be run on ThreadPool.
+ *
+ * \code
+ * TaskGroup group;
+ * group.run(boost::bind(&processLeftPage, ...));
+ * group.run(boost::bind(&processRightPage, ...));
+ * group.wait();
+ * \endcode
+ * Tasks may be run by any pool thread, or by the thread calling wait().
+ * They may use parallelFor() or TaskGroup themselves, and they may add
+ * more tasks to the group they belong to.
+ */
+class TaskGroup
+{
+	DECLARE_NON_COPYABLE(TaskGroup)
+public:
+	TaskGroup();
+
+	/**
+	 * \brief Waits for the tasks, ignoring their exceptions.
+	 *
+	 * Call wait() explicitly to get them re-thrown.
+	 */
+	~TaskGroup();
+
+	/**
+	 * \brief Adds a task.
+	 *
+	 * \param func A functor to be called without arguments.
+	 *        It will be copied.
+	 */
+	template<typename Func>
+	void run(Func const& func) { addTask(new TaskImpl<Func>(func)); }
+
+	/**
+	 * \brief Runs tasks until all of them are done.
+	 *
+	 * If a task throws, the tasks that haven't started yet are skipped
+	 * and the exception is re-thrown here.  The group then remains
+	 * cancelled, so any tasks added later are skipped as well.
+	 * \see ThreadPool::run()
+	 */
+	void wait();
+private:
+	class Task
+	{
+	public:
+		virtual ~Task() {}
+
+		virtual void operator()() = 0;
+	};
+
+	template<typename Func>
+	class TaskImpl : public Task
+	{
+	public:
+		TaskImpl(Func const& func) : m_func(func) {}
+
+		virtual void operator()() { m_func(); }
+	private:
+		Func m_func;
+	};
+
+	class Job : public ThreadPool::Job
+	{
+	public:
+		virtual ~Job();
+
+		void addTask(Task* task);
+
+		bool empty() const;
+	protected:
+		virtual bool doRunOne();
+
+		virtual bool hasUnclaimedUnits() const;
+	private:
+		mutable QMutex m_mutex;
+		std::deque<Task*> m_tasks;
+	};
+
+	void addTask(Task* task);
+
+	/**
+	 * Leaves the job withdrawn from ThreadPool.
+	 */
+	void waitForTasks();
+
+	Job m_job;
+};
+
+#endif
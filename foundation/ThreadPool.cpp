@@ -0,0 +1,327 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ThreadPool.h"
+#include <QThread>
+#include <QMutexLocker>
+#include <QByteArray>
+#include <algorithm>
+#include <stdexcept>
+#include <exception>
+#include <new>
+#include <assert.h>
+
+class ThreadPool::Worker : public QThread
+{
+public:
+	Worker(ThreadPool& owner, int index)
+	: m_rOwner(owner), m_index(index), m_exiting(false) {}
+
+	/**
+	 * Workers with an index at or above the target number of workers
+	 * leave workerLoop() and get started again if the limit goes up.
+	 */
+	int index() const { return m_index; }
+
+	/**
+	 * Set by a worker leaving workerLoop().  Protected by ThreadPool::m_mutex.
+	 */
+	bool isExiting() const { return m_exiting; }
+
+	void setExiting(bool exiting) { m_exiting = exiting; }
+protected:
+	virtual void run() { m_rOwner.workerLoop(this); }
+private:
+	ThreadPool& m_rOwner;
+	int m_index;
+	bool m_exiting;
+};
+
+
+/*=============================== ThreadPool ================================*/
+
+ThreadPool&
+ThreadPool::instance()
+{
+	static ThreadPool object;
+	return object;
+}
+
+ThreadPool::ThreadPool()
+:	m_maxThreads(0),
+	m_shuttingDown(false)
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		QMutexLocker const locker(&m_mutex);
+		m_shuttingDown = true;
+		m_workAvailable.wakeAll();
+	}
+
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		m_workers[i]->wait();
+		delete m_workers[i];
+	}
+}
+
+void
+ThreadPool::setMaxThreads(int const max_threads)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_maxThreads = std::max(max_threads, 0);
+
+	// Workers above the new limit will exit when they wake up.
+	m_workAvailable.wakeAll();
+}
+
+int
+ThreadPool::maxThreads() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return targetNumWorkersLocked() + 1;
+}
+
+void
+ThreadPool::run(Job& job)
+{
+	submit(&job);
+
+	try {
+		while (job.doRunOne()) {
+			// The calling thread does its share of work as well.
+		}
+	} catch (...) {
+		job.cancel();
+		withdraw(&job);
+		throw;
+	}
+
+	withdraw(&job);
+	job.throwIfFailed();
+}
+
+void
+ThreadPool::submit(Job* job)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	if (targetNumWorkersLocked() == 0) {
+		// The submitting thread will do everything itself.
+		return;
+	}
+
+	if (std::find(m_jobs.begin(), m_jobs.end(), job) != m_jobs.end()) {
+		return;
+	}
+
+	startWorkersLocked();
+	m_jobs.push_back(job);
+	m_workAvailable.wakeAll();
+}
+
+void
+ThreadPool::wakeWorkers()
+{
+	QMutexLocker const locker(&m_mutex);
+	m_workAvailable.wakeAll();
+}
+
+void
+ThreadPool::withdraw(Job* job)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	std::vector<Job*>::iterator const it(
+		std::find(m_jobs.begin(), m_jobs.end(), job)
+	);
+	if (it != m_jobs.end()) {
+		m_jobs.erase(it);
+	}
+
+	while (job->m_numVisitors > 0) {
+		m_jobReleased.wait(&m_mutex);
+	}
+}
+
+void
+ThreadPool::workerLoop(Worker* worker)
+{
+	QMutexLocker locker(&m_mutex);
+
+	for (;;) {
+		if (m_shuttingDown) {
+			break;
+		}
+
+		if (worker->index() >= targetNumWorkersLocked()) {
+			// The limit was lowered.  startWorkersLocked() will
+			// restart us if it goes up again.
+			worker->setExiting(true);
+			break;
+		}
+
+		Job* const job = pickJobLocked();
+		if (!job) {
+			m_workAvailable.wait(&m_mutex);
+			continue;
+		}
+
+		++job->m_numVisitors;
+		locker.unlock();
+
+		job->runOne();
+
+		locker.relock();
+		if (--job->m_numVisitors == 0) {
+			m_jobReleased.wakeAll();
+		}
+	}
+}
+
+ThreadPool::Job*
+ThreadPool::pickJobLocked()
+{
+	// The most recently submitted jobs go first.  Those are likely
+	// to be nested ones, which the outer ones are waiting for.
+	for (size_t i = m_jobs.size(); i > 0; --i) {
+		Job* job = m_jobs[i - 1];
+		if (job->hasUnclaimedUnits()) {
+			return job;
+		}
+	}
+	return 0;
+}
+
+int
+ThreadPool::targetNumWorkersLocked() const
+{
+	int max_threads = m_maxThreads;
+	if (max_threads <= 0) {
+		max_threads = QThread::idealThreadCount();
+	}
+
+	// The submitting thread is not a worker.
+	return std::max(max_threads, 1) - 1;
+}
+
+void
+ThreadPool::startWorkersLocked()
+{
+	int const target = targetNumWorkersLocked();
+	int const num_existing = std::min<int>(target, m_workers.size());
+	for (int i = 0; i < num_existing; ++i) {
+		Worker* worker = m_workers[i];
+		if (worker->isExiting()) {
+			// It doesn't need m_mutex to finish exiting.
+			worker->wait();
+			worker->setExiting(false);
+			worker->start();
+		}
+	}
+
+	while ((int)m_workers.size() < target) {
+		Worker* worker = new Worker(*this, (int)m_workers.size());
+		m_workers.push_back(worker);
+		worker->start();
+	}
+}
+
+
+/*============================ ThreadPool::Job ==============================*/
+
+ThreadPool::Job::Job()
+:	m_failure(NO_FAILURE),
+	m_cancelled(0),
+	m_numVisitors(0)
+{
+}
+
+ThreadPool::Job::~Job()
+{
+	assert(m_numVisitors == 0);
+}
+
+void
+ThreadPool::Job::runOne()
+{
+	try {
+		doRunOne();
+	} catch (std::bad_alloc const&) {
+		recordFailure(OUT_OF_MEMORY, 0);
+	} catch (TransferableException const& e) {
+		recordFailure(e);
+	} catch (std::exception const& e) {
+		recordFailure(EXCEPTION, e.what());
+	} catch (...) {
+		recordFailure(EXCEPTION, 0);
+	}
+}
+
+void
+ThreadPool::Job::throwIfFailed() const
+{
+	QMutexLocker const locker(&m_failureMutex);
+
+	switch (m_failure) {
+		case NO_FAILURE:
+			break;
+		case OUT_OF_MEMORY:
+			throw std::bad_alloc();
+		case TRANSFERABLE:
+			m_ptrTransferable->raise();
+			break;
+		case EXCEPTION:
+			throw std::runtime_error(m_failureMessage.toLocal8Bit().constData());
+	}
+}
+
+void
+ThreadPool::Job::recordFailure(Failure const failure, char const* what)
+{
+	QMutexLocker const locker(&m_failureMutex);
+
+	if (m_failure == NO_FAILURE) {
+		m_failure = failure;
+		m_failureMessage = QString::fromLocal8Bit(what ? what : "Unknown exception");
+		m_cancelled.fetchAndStoreRelaxed(1);
+	}
+}
+
+void
+ThreadPool::Job::recordFailure(TransferableException const& e)
+{
+	std::auto_ptr<TransferableException> copy;
+	try {
+		copy.reset(e.clone());
+	} catch (std::bad_alloc const&) {
+		recordFailure(OUT_OF_MEMORY, 0);
+		return;
+	}
+
+	QMutexLocker const locker(&m_failureMutex);
+
+	if (m_failure == NO_FAILURE) {
+		m_failure = TRANSFERABLE;
+		m_ptrTransferable = copy;
+		m_cancelled.fetchAndStoreRelaxed(1);
+	}
+}
@@ -0,0 +1,208 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include "NonCopyable.h"
+#include "TransferableException.h"
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QString>
+#include <memory>
+#include <vector>
+
+/**
+ * \brief A process-wide pool of threads for data parallelism.
+ *
+ * Work is submitted in the form of jobs, which consist of units that
+ * may be claimed by any thread.  Idle pool threads keep picking units
+ * from the most recently submitted jobs that still have any.  The thread
+ * that submitted a job claims its units as well, until there are none
+ * left, and then waits for units claimed by others to finish.
+ *
+ * Because the submitting thread always takes part, a job completes
+ * even when all pool threads are busy.  That makes nesting safe:
+ * a unit of one job may submit another job and wait for it.  As jobs
+ * don't bring their own threads, nested jobs don't oversubscribe CPUs.
+ *
+ * Pool threads are started on demand.  When the thread limit gets lowered,
+ * the threads above it exit once they finish what they are running.
+ *
+ * Don't use this class directly.  Use parallelFor() or TaskGroup.
+ *
+ * \note All methods of this class are thread-safe.
+ */
+class ThreadPool
+{
+	DECLARE_NON_COPYABLE(ThreadPool)
+public:
+	class Job;
+
+	/**
+	 * \brief Returns the global instance.
+	 *
+	 * It's to be called from the main thread early on, before
+	 * any other threads are started.
+	 */
+	static ThreadPool& instance();
+
+	/**
+	 * \brief Sets the maximum number of threads working on a job,
+	 *        including the one that submitted it.
+	 *
+	 * Zero means QThread::idealThreadCount(), which is also the default.
+	 * A value of 1 makes all jobs run entirely in the submitting thread.
+	 */
+	void setMaxThreads(int max_threads);
+
+	/**
+	 * \brief Returns the effective maximum number of threads working
+	 *        on a job, which is at least 1.
+	 */
+	int maxThreads() const;
+
+	/**
+	 * \brief Runs a job to completion, with the help of pool threads.
+	 *
+	 * The calling thread claims units until there are none left, then
+	 * waits for the units claimed by pool threads.  An exception thrown
+	 * by a unit running in the calling thread propagates as is, after
+	 * the other units are cancelled and waited for.  A failure of
+	 * a unit running elsewhere is re-thrown with Job::throwIfFailed().
+	 */
+	void run(Job& job);
+
+	/**
+	 * \brief Makes the units of a job available to pool threads.
+	 *
+	 * Submitting an already submitted job does nothing.
+	 * The job must remain alive until withdraw() returns.
+	 */
+	void submit(Job* job);
+
+	/**
+	 * \brief To be called when a submitted job gets new units.
+	 */
+	void wakeWorkers();
+
+	/**
+	 * \brief Makes a job unavailable to pool threads and waits for
+	 *        the units they are running to finish.
+	 */
+	void withdraw(Job* job);
+private:
+	class Worker;
+
+	ThreadPool();
+
+	~ThreadPool();
+
+	void workerLoop(Worker* worker);
+
+	Job* pickJobLocked();
+
+	int targetNumWorkersLocked() const;
+
+	void startWorkersLocked();
+
+	mutable QMutex m_mutex;
+	QWaitCondition m_workAvailable;
+	QWaitCondition m_jobReleased;
+	std::vector<Job*> m_jobs;
+	std::vector<Worker*> m_workers;
+	int m_maxThreads;
+	bool m_shuttingDown;
+};
+
+
+/**
+ * \brief Something ThreadPool may run pieces of, on any of its threads.
+ *
+ * Exceptions thrown by units running on pool threads are caught and
+ * recorded.  The first of them cancels the remaining units and gets
+ * re-thrown by ThreadPool::run() in the submitting thread.  In the
+ * absence of std::exception_ptr, only std::bad_alloc and subclasses of
+ * TransferableException keep their type.  Other exceptions are re-thrown
+ * as std::runtime_error.
+ */
+class ThreadPool::Job
+{
+	DECLARE_NON_COPYABLE(Job)
+	friend class ThreadPool;
+public:
+	Job();
+
+	virtual ~Job();
+
+	/**
+	 * \brief Re-throws the first exception thrown by a unit
+	 *        on a pool thread, if any.
+	 *
+	 * To be called after ThreadPool::withdraw().
+	 */
+	void throwIfFailed() const;
+protected:
+	/**
+	 * \brief Claims and runs a single unit.  May be called concurrently.
+	 *
+	 * \return false if there was nothing left to claim.
+	 */
+	virtual bool doRunOne() = 0;
+
+	/**
+	 * \brief A hint whether doRunOne() would find anything to claim.
+	 */
+	virtual bool hasUnclaimedUnits() const = 0;
+
+	/**
+	 * \brief Returns true if a unit has failed.  Implementations of
+	 *        doRunOne() should stop handing out units then.
+	 */
+	bool isCancelled() const { return m_cancelled != 0; }
+private:
+	enum Failure { NO_FAILURE, OUT_OF_MEMORY, TRANSFERABLE, EXCEPTION };
+
+	/**
+	 * Used by pool threads.  Like doRunOne(), but records exceptions
+	 * rather than letting them through.
+	 */
+	void runOne();
+
+	void recordFailure(Failure failure, char const* what);
+
+	void recordFailure(TransferableException const& e);
+
+	void cancel() { m_cancelled.fetchAndStoreRelaxed(1); }
+
+	mutable QMutex m_failureMutex;
+	QString m_failureMessage;
+	std::auto_ptr<TransferableException> m_ptrTransferable;
+	Failure m_failure;
+	QAtomicInt m_cancelled;
+
+	/**
+	 * The number of pool threads that picked this job and didn't
+	 * yet finish running its unit.  Protected by ThreadPool::m_mutex.
+	 */
+	int m_numVisitors;
+};
+
+#endif
@@ -0,0 +1,49 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef TRANSFERABLE_EXCEPTION_H_
+#define TRANSFERABLE_EXCEPTION_H_
+
+#include <exception>
+
+/**
+ * \brief An exception that keeps its type when re-thrown in another thread.
+ *
+ * ThreadPool records exceptions thrown on its threads and re-throws them
+ * in the thread that submitted the job.  Without std::exception_ptr, it can
+ * only do so for exceptions that know how to copy and throw themselves.
+ * Others are re-thrown as std::runtime_error.
+ */
+class TransferableException : public std::exception
+{
+public:
+	virtual ~TransferableException() throw() {}
+
+	/**
+	 * \brief Returns a heap-allocated copy, to be deleted by the caller.
+	 */
+	virtual TransferableException* clone() const = 0;
+
+	/**
+	 * \brief Throws *this, by its most derived type.
+	 */
+	virtual void raise() const = 0;
+};
+
+#endif
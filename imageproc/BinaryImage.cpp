@@ -19,6 +19,8 @@
 #include "BinaryImage.h"
 #include "ByteOrder.h"
 #include "BitOps.h"
+#include "SpillStorage.h"
+#include "IntrusivePtr.h"
 #include <QAtomicInt>
 #include <QImage>
 #include <QRect>
@@ -52,12 +54,18 @@ private:
 	};
 public:
 	static SharedData* create(size_t num_words) {
+		IntrusivePtr<StorageBlock> const block(
+			SpillStorage::instance().allocate(num_words * 4)
+		);
+		if (block.get()) {
+			return new(NumWords(0)) SharedData(block);
+		}
 		return new(NumWords(num_words)) SharedData();
 	}
 	
-	uint32_t* data() { return m_data; }
+	uint32_t* data() { return m_pWords; }
 	
-	uint32_t const* data() const { return m_data; }
+	uint32_t const* data() const { return m_pWords; }
 	
 	bool isShared() const {
 		return m_refCounter.fetchAndAddRelaxed(0) > 1;
@@ -71,11 +79,22 @@ public:
 	
 	static void operator delete(void* addr, NumWords num_words);
 private:
-	SharedData() : m_refCounter(1) {}
+	SharedData() : m_refCounter(1), m_pWords(m_data) {}
+	
+	/**
+	 * Large images may be backed by a StorageBlock rather than
+	 * by memory following this object.
+	 */
+	SharedData(IntrusivePtr<StorageBlock> const& block)
+	:	m_refCounter(1),
+		m_ptrBlock(block),
+		m_pWords(reinterpret_cast<uint32_t*>(block->data())) {}
 	
 	SharedData& operator=(SharedData const&); // forbidden
 	
 	mutable QAtomicInt m_refCounter;
+	IntrusivePtr<StorageBlock> m_ptrBlock;
+	uint32_t* m_pWords;
 	uint32_t m_data[1]; // more data follows
 };
 
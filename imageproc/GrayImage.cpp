@@ -19,6 +19,7 @@
 #include "GrayImage.h"
 #include "Grayscale.h"
 #include <new>
+#include <string.h>
 
 namespace imageproc
 {
@@ -29,7 +30,25 @@ GrayImage::GrayImage(QSize size)
 		return;
 	}
 
-	m_image = QImage(size, QImage::Format_Indexed8);
+	// The same alignment QImage provides.
+	int const stride = (size.width() + 3) & ~3;
+	IntrusivePtr<StorageBlock> const block(
+		SpillStorage::instance().allocate(size_t(stride) * size.height())
+	);
+
+	// A QImage over external memory can't release it, so a shallow copy
+	// handed out by toQImage() would have to be kept from outliving it.
+	// That's only worth doing for spilled data.
+	if (block.get() && block->isSpilled()) {
+		m_image = QImage(
+			block->data(), size.width(), size.height(),
+			stride, QImage::Format_Indexed8
+		);
+		m_ptrBlock = block;
+	} else {
+		m_image = QImage(size, QImage::Format_Indexed8);
+	}
+
 	m_image.setColorTable(createGrayscalePalette());
 	if (m_image.isNull()) {
 		throw std::bad_alloc();
@@ -41,4 +60,56 @@ GrayImage::GrayImage(QImage const& image)
 {
 }
 
+QImage
+GrayImage::toQImage() const
+{
+	if (m_ptrBlock.get()) {
+		return m_image.copy();
+	} else {
+		return m_image;
+	}
+}
+
+void
+GrayImage::fill(uint8_t const color)
+{
+	detach();
+	m_image.fill(color);
+}
+
+uint8_t*
+GrayImage::data()
+{
+	detach();
+	return m_image.bits();
+}
+
+void
+GrayImage::detach()
+{
+	if (!m_ptrBlock.get() || m_image.isDetached()) {
+		// Either QImage takes care of copy-on-write itself,
+		// or we are the only user of the block.
+		return;
+	}
+
+	// Non-const QImage::bits() would detach onto the heap.
+	GrayImage const& src = *this;
+
+	GrayImage copy(size());
+	int const line_bytes = width();
+	uint8_t const* src_line = src.data();
+	uint8_t* dst_line = copy.m_image.bits();
+	int const src_stride = src.stride();
+	int const dst_stride = copy.stride();
+	for (int y = height(); y > 0; --y) {
+		memcpy(dst_line, src_line, line_bytes);
+		src_line += src_stride;
+		dst_line += dst_stride;
+	}
+
+	m_ptrBlock = copy.m_ptrBlock;
+	m_image = copy.m_image;
+}
+
 } // namespace imageproc
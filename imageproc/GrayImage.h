@@ -19,6 +19,8 @@
 #ifndef IMAGEPROC_GRAYIMAGE_H_
 #define IMAGEPROC_GRAYIMAGE_H_
 
+#include "SpillStorage.h"
+#include "IntrusivePtr.h"
 #include <QImage>
 #include <QSize>
 #include <QRect>
@@ -29,6 +31,9 @@ namespace imageproc
 
 /**
  * \brief A wrapper class around QImage that is always guaranteed to be 8-bit grayscale.
+ *
+ * Large images may have their data spilled to disk by SpillStorage.
+ * The QImage over such data never leaves this class.
  */
 class GrayImage
 {
@@ -42,6 +47,7 @@ public:
 	 * \throw std::bad_alloc Unlike the underlying QImage, GrayImage reacts to
 	 *        out-of-memory situations by throwing an exception rather than
 	 *        constructing a null image.
+	 * \see SpillStorage
 	 */
 	explicit GrayImage(QSize size = QSize());
 
@@ -53,20 +59,26 @@ public:
 	explicit GrayImage(QImage const& image);
 
 	/**
-	 * \brief Returns a const reference to the underlying QImage.
+	 * \brief Returns the underlying QImage.
 	 *
 	 * The underlying QImage is either a null image or a 8-bit indexed
-	 * image with a grayscale palette.
+	 * image with a grayscale palette.  For a spilled image, a deep copy
+	 * on the heap is returned, as a shallow one could outlive the data.
 	 */
-	QImage const& toQImage() const { return m_image; }
+	QImage toQImage() const;
 
-	operator QImage const&() const { return m_image; }
+	operator QImage() const { return toQImage(); }
 
 	bool isNull() const { return m_image.isNull(); }
 
-	void fill(uint8_t color) { m_image.fill(color); }
+	/**
+	 * \brief Returns true if the data lives in a memory-mapped file.
+	 */
+	bool isSpilled() const { return m_ptrBlock.get() != 0; }
+
+	void fill(uint8_t color);
 
-	uint8_t* data() { return m_image.bits(); }
+	uint8_t* data();
 
 	uint8_t const* data() const { return m_image.bits(); }
 
@@ -86,18 +98,24 @@ public:
 	int width() const { return m_image.width(); }
 
 	int height() const { return m_image.height(); }
+
+	bool operator==(GrayImage const& other) const { return m_image == other.m_image; }
+
+	bool operator!=(GrayImage const& other) const { return m_image != other.m_image; }
 private:
+	/**
+	 * Makes sure no other GrayImage shares the data, before modifying it.
+	 */
+	void detach();
+
+	/**
+	 * The spilled block m_image was constructed over, if any.
+	 * Shared among copies, like the data of m_image.
+	 */
+	IntrusivePtr<StorageBlock> m_ptrBlock;
 	QImage m_image;
 };
 
-inline bool operator==(GrayImage const& lhs, GrayImage const& rhs) {
-	return lhs.toQImage() == rhs.toQImage();
-}
-
-inline bool operator!=(GrayImage const& lhs, GrayImage const& rhs) {
-	return lhs.toQImage() != rhs.toQImage();
-}
-
 } // namespace imageproc
 
 #endif
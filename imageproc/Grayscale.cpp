@@ -20,6 +20,7 @@
 #include "GrayImage.h"
 #include "BinaryImage.h"
 #include "BitOps.h"
+#include "ParallelLines.h"
 #include <QImage>
 #include <QColor>
 #include <QtGlobal>
@@ -29,6 +30,11 @@
 #include <string.h>
 #include <stdint.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GRAYSCALE_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace imageproc
 {
 
@@ -118,6 +124,111 @@ static QImage monoLsbToGrayscale(QImage const& src)
 	return dst;
 }
 
+namespace
+{
+
+/**
+ * The weights below reproduce qGray() exactly:
+ * gray = (r * 11 + g * 16 + b * 5) / 32
+ */
+
+/**
+ * Converts a line of RGB32 or ARGB32 pixels.  Alpha is ignored,
+ * just like qGray() does.
+ */
+void rgb32LineToGray(uint8_t const* src, uint8_t* dst, int width, uint8_t const*)
+{
+	uint32_t const* src_px = reinterpret_cast<uint32_t const*>(src);
+	int x = 0;
+	
+#ifdef GRAYSCALE_USE_SSE2
+	// Every 32-bit lane is 0xAARRGGBB.  We split it into 16-bit (B, R) and
+	// (G, A) pairs and let _mm_madd_epi16() do the multiply-add.  The largest
+	// intermediate value is 255 * 32, so nothing overflows.
+	__m128i const low_bytes = _mm_set1_epi32(0x00ff00ff);
+	__m128i const br_weights = _mm_set1_epi32((11 << 16) | 5);
+	__m128i const ga_weights = _mm_set1_epi32(16);
+	
+	for (; x + 16 <= width; x += 16) {
+		__m128i gray[4];
+		for (int i = 0; i < 4; ++i) {
+			__m128i const px = _mm_loadu_si128(
+				reinterpret_cast<__m128i const*>(src_px + x + i * 4)
+			);
+			__m128i const br = _mm_and_si128(px, low_bytes);
+			__m128i const ga = _mm_and_si128(_mm_srli_epi16(px, 8), low_bytes);
+			__m128i const sum = _mm_add_epi32(
+				_mm_madd_epi16(br, br_weights), _mm_madd_epi16(ga, ga_weights)
+			);
+			gray[i] = _mm_srli_epi32(sum, 5);
+		}
+		__m128i const words0 = _mm_packs_epi32(gray[0], gray[1]);
+		__m128i const words1 = _mm_packs_epi32(gray[2], gray[3]);
+		_mm_storeu_si128(
+			reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(words0, words1)
+		);
+	}
+#endif
+	
+	for (; x < width; ++x) {
+		dst[x] = static_cast<uint8_t>(qGray(src_px[x]));
+	}
+}
+
+void rgb888LineToGray(uint8_t const* src, uint8_t* dst, int width, uint8_t const*)
+{
+	for (int x = 0; x < width; ++x, src += 3) {
+		dst[x] = static_cast<uint8_t>((src[0] * 11 + src[1] * 16 + src[2] * 5) >> 5);
+	}
+}
+
+void indexed8LineToGray(uint8_t const* src, uint8_t* dst, int width, uint8_t const* lut)
+{
+	for (int x = 0; x < width; ++x) {
+		dst[x] = lut[src[x]];
+	}
+}
+
+typedef void (*LineToGrayFunc)(uint8_t const* src, uint8_t* dst, int width, uint8_t const* lut);
+
+/**
+ * Converts bands of lines with a given line converter.
+ */
+class LineBandToGray
+{
+public:
+	LineBandToGray(QImage const& src, QImage& dst,
+		LineToGrayFunc line_func, uint8_t const* lut)
+	:	m_pSrcBits(src.bits()),
+		m_pDstBits(dst.bits()),
+		m_srcBpl(src.bytesPerLine()),
+		m_dstBpl(dst.bytesPerLine()),
+		m_width(src.width()),
+		m_pLineFunc(line_func),
+		m_pLut(lut) {}
+	
+	void operator()(int const first_line, int const end_line) const
+	{
+		uint8_t const* src_line = m_pSrcBits + first_line * m_srcBpl;
+		uint8_t* dst_line = m_pDstBits + first_line * m_dstBpl;
+		for (int y = first_line; y < end_line; ++y) {
+			m_pLineFunc(src_line, dst_line, m_width, m_pLut);
+			src_line += m_srcBpl;
+			dst_line += m_dstBpl;
+		}
+	}
+private:
+	uint8_t const* m_pSrcBits;
+	uint8_t* m_pDstBits;
+	int m_srcBpl;
+	int m_dstBpl;
+	int m_width;
+	LineToGrayFunc m_pLineFunc;
+	uint8_t const* m_pLut;
+};
+
+} // anonymous namespace
+
 static QImage anyToGrayscale(QImage const& src)
 {
 	int const width = src.width();
@@ -129,14 +240,46 @@ static QImage anyToGrayscale(QImage const& src)
 		throw std::bad_alloc();
 	}
 	
-	uint8_t* dst_line = dst.bits();
-	int const dst_bpl = dst.bytesPerLine();
+	LineToGrayFunc line_func = 0;
+	uint8_t lut[256];
 	
-	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width; ++x) {
-			dst_line[x] = static_cast<uint8_t>(qGray(src.pixel(x, y)));
+	switch (src.format()) {
+	case QImage::Format_RGB32:
+	case QImage::Format_ARGB32:
+		line_func = &rgb32LineToGray;
+		break;
+	case QImage::Format_RGB888:
+		line_func = &rgb888LineToGray;
+		break;
+	case QImage::Format_Indexed8: {
+		int const num_colors = src.numColors();
+		for (int i = 0; i < 256; ++i) {
+			lut[i] = i < num_colors ? static_cast<uint8_t>(qGray(src.color(i))) : 0;
+		}
+		line_func = &indexed8LineToGray;
+		break;
+	}
+	default:
+		// Premultiplied and less common formats go through QImage::pixel(),
+		// which takes care of un-premultiplying and unpacking them.
+		break;
+	}
+	
+	if (line_func) {
+		processLinesInParallel(
+			height, 64, double(width) * height,
+			LineBandToGray(src, dst, line_func, lut)
+		);
+	} else {
+		uint8_t* dst_line = dst.bits();
+		int const dst_bpl = dst.bytesPerLine();
+		
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; x < width; ++x) {
+				dst_line[x] = static_cast<uint8_t>(qGray(src.pixel(x, y)));
+			}
+			dst_line += dst_bpl;
 		}
-		dst_line += dst_bpl;
 	}
 	
 	dst.setDotsPerMeterX(src.dotsPerMeterX());
@@ -0,0 +1,57 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ParallelLines.h"
+#include "ParallelFor.h"
+#include <algorithm>
+
+namespace imageproc
+{
+
+namespace
+{
+
+/**
+ * Below that, handing work to other threads costs more than it saves.
+ */
+double const MIN_PIXELS_FOR_PARALLEL_PROCESSING = 1 << 20;
+
+} // anonymous namespace
+
+void processLinesInParallelImpl(
+	int const num_lines, int const lines_per_band, double const num_pixels,
+	VirtualFunction2<void, int, int>& func)
+{
+	if (num_lines <= 0) {
+		return;
+	}
+	
+	int const band_size = std::max(lines_per_band, 1);
+	
+	if (num_pixels >= MIN_PIXELS_FOR_PARALLEL_PROCESSING) {
+		parallelForImpl(num_lines, band_size, func);
+		return;
+	}
+	
+	for (int first_line = 0; first_line < num_lines; first_line += band_size) {
+		func(first_line, std::min(first_line + band_size, num_lines));
+	}
+}
+
+} // namespace imageproc
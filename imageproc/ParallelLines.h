@@ -0,0 +1,60 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef IMAGEPROC_PARALLEL_LINES_H_
+#define IMAGEPROC_PARALLEL_LINES_H_
+
+#include "VirtualFunction.h"
+
+namespace imageproc
+{
+
+/**
+ * \brief Splits lines of an image into bands and processes them,
+ *        possibly on several ThreadPool threads.
+ *
+ * \param num_lines The number of lines to process.
+ * \param lines_per_band The number of lines in a band, except possibly
+ *        the last one.
+ * \param num_pixels The number of pixels involved, used to decide
+ *        whether it's worth involving other threads.
+ * \param func Will be called like this: func(first_line, end_line),
+ *        with end_line being exclusive, for every band.  It may be
+ *        called concurrently for different bands.
+ *
+ * The calling thread processes bands as well, so when no other
+ * threads are involved, everything happens right in the calling thread.
+ * Small images are always processed that way.
+ * \see parallelFor()
+ */
+void processLinesInParallelImpl(
+	int num_lines, int lines_per_band, double num_pixels,
+	VirtualFunction2<void, int, int>& func);
+
+template<typename Func>
+void processLinesInParallel(
+	int num_lines, int lines_per_band, double num_pixels, Func func)
+{
+	ProxyFunction2<Func, void, int, int> proxy(func);
+	processLinesInParallelImpl(num_lines, lines_per_band, num_pixels, proxy);
+}
+
+} // namespace imageproc
+
+#endif
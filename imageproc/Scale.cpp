@@ -18,63 +18,167 @@
 
 #include "Scale.h"
 #include "GrayImage.h"
+#include "ParallelLines.h"
+#include "ScratchArena.h"
 #include <QImage>
 #include <QSize>
+#include <vector>
+#include <algorithm>
 #include <stdexcept>
 #include <stdint.h>
 #include <assert.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCALE_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace imageproc
 {
 
 /**
- * This is an optimized implementation for the case when every destination
- * pixel maps exactly to a M x N block of source pixels.
+ * Adds sums of horizontal runs of \p xscale pixels of a line
+ * to \p sums, one run per element.
  */
-static GrayImage scaleDownIntGrayToGray(GrayImage const& src, QSize const& dst_size)
+static void addRunSums(uint8_t const* src, unsigned* sums, int const dw, int const xscale)
 {
-	int const sw = src.width();
-	int const sh = src.height();
-	int const dw = dst_size.width();
-	int const dh = dst_size.height();
+	int dx = 0;
 	
-	int const xscale = sw / dw;
-	int const yscale = sh / dh;
-	int const total_area = xscale * yscale;
-	
-	GrayImage dst(dst_size);
+#ifdef SCALE_USE_SSE2
+	// We take 16 source pixels at a time and sum adjacent pairs of them
+	// in 16-bit lanes.  For 4x reduction, adjacent pairs of those are then
+	// summed in 32-bit lanes.
+	if (xscale == 2 || xscale == 4) {
+		__m128i const low_bytes = _mm_set1_epi16(0x00ff);
+		__m128i const low_words = _mm_set1_epi32(0x0000ffff);
+		__m128i const zero = _mm_setzero_si128();
+		
+		if (xscale == 2) {
+			for (; dx + 8 <= dw; dx += 8) {
+				__m128i const px = _mm_loadu_si128(
+					reinterpret_cast<__m128i const*>(src + dx * 2)
+				);
+				__m128i const pairs = _mm_add_epi16(
+					_mm_and_si128(px, low_bytes), _mm_srli_epi16(px, 8)
+				);
+				__m128i* const psums = reinterpret_cast<__m128i*>(sums + dx);
+				_mm_storeu_si128(psums, _mm_add_epi32(
+					_mm_loadu_si128(psums), _mm_unpacklo_epi16(pairs, zero)
+				));
+				_mm_storeu_si128(psums + 1, _mm_add_epi32(
+					_mm_loadu_si128(psums + 1), _mm_unpackhi_epi16(pairs, zero)
+				));
+			}
+		} else {
+			for (; dx + 4 <= dw; dx += 4) {
+				__m128i const px = _mm_loadu_si128(
+					reinterpret_cast<__m128i const*>(src + dx * 4)
+				);
+				__m128i const pairs = _mm_add_epi16(
+					_mm_and_si128(px, low_bytes), _mm_srli_epi16(px, 8)
+				);
+				__m128i const quads = _mm_add_epi32(
+					_mm_and_si128(pairs, low_words), _mm_srli_epi32(pairs, 16)
+				);
+				__m128i* const psums = reinterpret_cast<__m128i*>(sums + dx);
+				_mm_storeu_si128(psums, _mm_add_epi32(_mm_loadu_si128(psums), quads));
+			}
+		}
+	}
+#endif
 	
-	uint8_t const* src_line = src.data();
-	uint8_t* dst_line = dst.data();
-	int const src_stride = src.stride();
-	int const src_stride_scaled = src_stride * yscale;
-	int const dst_stride = dst.stride();
+	uint8_t const* psrc = src + dx * xscale;
+	switch (xscale) {
+		case 1:
+			for (; dx < dw; ++dx, ++psrc) {
+				sums[dx] += psrc[0];
+			}
+			break;
+		case 2:
+			for (; dx < dw; ++dx, psrc += 2) {
+				sums[dx] += psrc[0] + psrc[1];
+			}
+			break;
+		case 3:
+			for (; dx < dw; ++dx, psrc += 3) {
+				sums[dx] += psrc[0] + psrc[1] + psrc[2];
+			}
+			break;
+		case 4:
+			for (; dx < dw; ++dx, psrc += 4) {
+				sums[dx] += psrc[0] + psrc[1] + psrc[2] + psrc[3];
+			}
+			break;
+		default:
+			for (; dx < dw; ++dx, psrc += xscale) {
+				unsigned sum = 0;
+				for (int j = 0; j < xscale; ++j) {
+					sum += psrc[j];
+				}
+				sums[dx] += sum;
+			}
+			break;
+	}
+}
+
+/**
+ * Produces lines of the destination image for scaleDownIntGrayToGray().
+ */
+class IntReduction
+{
+public:
+	IntReduction(GrayImage const& src, GrayImage& dst, int xscale, int yscale)
+	:	m_pSrc(src.data()), m_pDst(dst.data()),
+		m_srcStride(src.stride()), m_dstStride(dst.stride()),
+		m_dw(dst.width()), m_xscale(xscale), m_yscale(yscale) {}
 	
-	int sy = 0;
-	int dy = 0;
-	for (; dy < dh; ++dy, sy += yscale) {
+	void operator()(int const first_line, int const end_line) const
+	{
+		unsigned const total_area = m_xscale * m_yscale;
+		ScratchArena::Scope scratch;
+		unsigned* const sums = scratch.alloc<unsigned>(m_dw);
 		
-		int sx = 0;
-		int dx = 0;
-		for (; dx < dw; ++dx, sx += xscale) {
-			
-			unsigned gray_level = 0;
-			uint8_t const* psrc = src_line + sx;
+		for (int dy = first_line; dy < end_line; ++dy) {
+			std::fill(sums, sums + m_dw, 0);
 			
-			for (int i = 0; i < yscale; ++i, psrc += src_stride) {
-				for (int j = 0; j < xscale; ++j) {
-					gray_level += psrc[j];
-				}
+			uint8_t const* src_line = m_pSrc + dy * m_yscale * m_srcStride;
+			for (int i = 0; i < m_yscale; ++i, src_line += m_srcStride) {
+				addRunSums(src_line, sums, m_dw, m_xscale);
 			}
 			
-			unsigned const pix_value = (gray_level + (total_area >> 1)) / total_area;
-			assert(pix_value < 256);
-			dst_line[dx] = static_cast<uint8_t>(pix_value);
+			uint8_t* const dst_line = m_pDst + dy * m_dstStride;
+			for (int dx = 0; dx < m_dw; ++dx) {
+				unsigned const pix_value = (sums[dx] + (total_area >> 1)) / total_area;
+				assert(pix_value < 256);
+				dst_line[dx] = static_cast<uint8_t>(pix_value);
+			}
 		}
-		
-		src_line += src_stride_scaled;
-		dst_line += dst_stride;
 	}
+private:
+	uint8_t const* m_pSrc;
+	uint8_t* m_pDst;
+	int m_srcStride;
+	int m_dstStride;
+	int m_dw;
+	int m_xscale;
+	int m_yscale;
+};
+
+/**
+ * This is an optimized implementation for the case when every destination
+ * pixel maps exactly to a M x N block of source pixels.
+ */
+static GrayImage scaleDownIntGrayToGray(GrayImage const& src, QSize const& dst_size)
+{
+	int const xscale = src.width() / dst_size.width();
+	int const yscale = src.height() / dst_size.height();
+	
+	GrayImage dst(dst_size);
+	
+	processLinesInParallel(
+		dst_size.height(), 32, double(src.width()) * src.height(),
+		IntReduction(src, dst, xscale, yscale)
+	);
 	
 	return dst;
 }
@@ -103,7 +207,7 @@ static GrayImage scaleUpIntGrayToGray(GrayImage const& src, QSize const& dst_siz
 	
 	int sy = 0;
 	int dy = 0;
-	for (; dy < dh; ++sy, dy += xscale) {
+	for (; dy < dh; ++sy, dy += yscale) {
 		int sx = 0;
 		int dx = 0;
 		
@@ -146,6 +250,68 @@ static double calc32xRatio1(int const dst, int const src)
 	return ratio;
 }
 
+/**
+ * Produces lines of the destination image for scaleUpGrayToGray().
+ */
+class Upscaling
+{
+public:
+	Upscaling(GrayImage const& src, GrayImage& dst)
+	:	m_pSrc(src.data()), m_pDst(dst.data()),
+		m_srcStride(src.stride()), m_dstStride(dst.stride()),
+		m_sw(src.width()), m_sh(src.height()), m_dw(dst.width()),
+		m_dx2sx32(calc32xRatio1(dst.width(), src.width())),
+		m_dy2sy32(calc32xRatio1(dst.height(), src.height())) {}
+	
+	void operator()(int const first_line, int const end_line) const
+	{
+		uint8_t* dst_line = m_pDst + first_line * m_dstStride;
+		for (int dy = first_line; dy < end_line; ++dy, dst_line += m_dstStride) {
+			int const sy32 = (int)(dy * m_dy2sy32);
+			int const sy = sy32 >> 5;
+			unsigned const top_fraction = 32 - (sy32 & 31);
+			unsigned const bottom_fraction = sy32 & 31;
+			assert(sy + 1 < m_sh); // calc32xRatio1() ensures that.
+			
+			uint8_t const* src_line = m_pSrc + sy * m_srcStride;
+			
+			for (int dx = 0; dx < m_dw; ++dx) {
+				int const sx32 = (int)(dx * m_dx2sx32);
+				int const sx = sx32 >> 5;
+				unsigned const left_fraction = 32 - (sx32 & 31);
+				unsigned const right_fraction = sx32 & 31;
+				assert(sx + 1 < m_sw); // calc32xRatio1() ensures that.
+				
+				unsigned gray_level = 0;
+				
+				uint8_t const* psrc = src_line + sx;
+				gray_level += *psrc * left_fraction * top_fraction;
+				++psrc;
+				gray_level += *psrc * right_fraction * top_fraction;
+				psrc += m_srcStride;
+				gray_level += *psrc * right_fraction * bottom_fraction;
+				--psrc;
+				gray_level += *psrc * left_fraction * bottom_fraction;
+				
+				unsigned const total_area = 32 * 32;
+				unsigned const pix_value = (gray_level + (total_area >> 1)) / total_area;
+				assert(pix_value < 256);
+				dst_line[dx] = static_cast<uint8_t>(pix_value);
+			}
+		}
+	}
+private:
+	uint8_t const* m_pSrc;
+	uint8_t* m_pDst;
+	int m_srcStride;
+	int m_dstStride;
+	int m_sw;
+	int m_sh;
+	int m_dw;
+	double m_dx2sx32;
+	double m_dy2sy32;
+};
+
 /**
  * This is an optimized implementation for the case when
  * the destination image is larger than the source image both
@@ -153,54 +319,12 @@ static double calc32xRatio1(int const dst, int const src)
  */
 static GrayImage scaleUpGrayToGray(GrayImage const& src, QSize const& dst_size)
 {
-	int const sw = src.width();
-	int const sh = src.height();
-	int const dw = dst_size.width();
-	int const dh = dst_size.height();
-	
-	double const dx2sx32 = calc32xRatio1(dw, sw);
-	double const dy2sy32 = calc32xRatio1(dh, sh);
-	
 	GrayImage dst(dst_size);
 	
-	uint8_t const* const src_data = src.data();
-	uint8_t* dst_line = dst.data();
-	int const src_stride = src.stride();
-	int const dst_stride = dst.stride();
-	
-	for (int dy = 0; dy < dh; ++dy, dst_line += dst_stride) {
-		int const sy32 = (int)(dy * dy2sy32);
-		int const sy = sy32 >> 5;
-		unsigned const top_fraction = 32 - (sy32 & 31);
-		unsigned const bottom_fraction = sy32 & 31;
-		assert(sy + 1 < sh); // calc32xRatio1() ensures that.
-		
-		uint8_t const* src_line = src_data + sy * src_stride;
-		
-		for (int dx = 0; dx < dw; ++dx) {
-			int const sx32 = (int)(dx * dx2sx32);
-			int const sx = sx32 >> 5;
-			unsigned const left_fraction = 32 - (sx32 & 31);
-			unsigned const right_fraction = sx32 & 31;
-			assert(sx + 1 < sw); // calc32xRatio1() ensures that.
-			
-			unsigned gray_level = 0;
-			
-			uint8_t const* psrc = src_line + sx;
-			gray_level += *psrc * left_fraction * top_fraction;
-			++psrc;
-			gray_level += *psrc * right_fraction * top_fraction;
-			psrc += src_stride;
-			gray_level += *psrc * right_fraction * bottom_fraction;
-			--psrc;
-			gray_level += *psrc * left_fraction * bottom_fraction;
-			
-			unsigned const total_area = 32 * 32;
-			unsigned const pix_value = (gray_level + (total_area >> 1)) / total_area;
-			assert(pix_value < 256);
-			dst_line[dx] = static_cast<uint8_t>(pix_value);
-		}
-	}
+	processLinesInParallel(
+		dst_size.height(), 32, double(dst_size.width()) * dst_size.height(),
+		Upscaling(src, dst)
+	);
 	
 	return dst;
 }
@@ -227,6 +351,150 @@ static double calc32xRatio2(int const dst, int const src)
 	return ratio;
 }
 
+/**
+ * The range of source pixels along one axis a destination pixel covers,
+ * along with their weights, in 1/32 of a source pixel.  Pixels between
+ * the first and the last one have the weight of 32.
+ */
+struct AreaSpan
+{
+	int first;
+	int last;
+	unsigned firstWeight;
+	unsigned lastWeight;
+	unsigned totalWeight;
+};
+
+static void calcAreaSpans(int const dst_len, int const src_len, std::vector<AreaSpan>& spans)
+{
+	double const d2s32 = calc32xRatio2(dst_len, src_len);
+	
+	spans.resize(dst_len);
+	int s32_end = 0;
+	for (int d = 0; d < dst_len; ++d) {
+		int const s32_begin = s32_end;
+		s32_end = (int)((d + 1) * d2s32);
+		
+		AreaSpan& span = spans[d];
+		span.first = s32_begin >> 5;
+		span.last = (s32_end - 1) >> 5;
+		span.totalWeight = s32_end - s32_begin;
+		assert(span.last < src_len); // calc32xRatio2() ensures that.
+		
+		if (span.totalWeight == 0) {
+			// Happens when enlarging by more than 32 times along this axis.
+			// Take a single source pixel with a non-zero weight then.
+			span.first = std::min(span.first, src_len - 1);
+			span.last = span.first;
+			span.firstWeight = 1;
+			span.lastWeight = 0;
+			span.totalWeight = 1;
+		} else if (span.first == span.last) {
+			span.firstWeight = span.totalWeight;
+			span.lastWeight = 0;
+		} else {
+			span.firstWeight = 32 - (s32_begin & 31);
+			span.lastWeight = s32_end - (span.last << 5);
+		}
+	}
+}
+
+/**
+ * Produces lines of the destination image for scaleGrayToGray().
+ *
+ * The weight of a source pixel is the product of its horizontal and
+ * vertical weights, so we first do a horizontal pass over a source line,
+ * then accumulate its results with the vertical weight of the line.
+ * The integer sums are the same as if we went over the block of source
+ * pixels of every destination pixel, so is the result.
+ */
+class AreaAveraging
+{
+public:
+	AreaAveraging(GrayImage const& src, GrayImage& dst)
+	:	m_pSrc(src.data()), m_pDst(dst.data()),
+		m_srcStride(src.stride()), m_dstStride(dst.stride())
+	{
+		calcAreaSpans(dst.width(), src.width(), m_hSpans);
+		calcAreaSpans(dst.height(), src.height(), m_vSpans);
+	}
+	
+	void operator()(int const first_line, int const end_line) const
+	{
+		int const dw = m_hSpans.size();
+		ScratchArena::Scope scratch;
+		unsigned* const hsums = scratch.alloc<unsigned>(dw);
+		unsigned* const sums = scratch.alloc<unsigned>(dw);
+		int hsums_line = -1;
+		
+		for (int dy = first_line; dy < end_line; ++dy) {
+			AreaSpan const& vspan = m_vSpans[dy];
+			std::fill(sums, sums + dw, 0);
+			
+			for (int sy = vspan.first; sy <= vspan.last; ++sy) {
+				// Adjacent destination lines may share a source line.
+				if (sy != hsums_line) {
+					horizontalPass(m_pSrc + sy * m_srcStride, hsums);
+					hsums_line = sy;
+				}
+				
+				unsigned weight = 32;
+				if (sy == vspan.first) {
+					weight = vspan.firstWeight;
+				} else if (sy == vspan.last) {
+					weight = vspan.lastWeight;
+				}
+				
+				for (int dx = 0; dx < dw; ++dx) {
+					sums[dx] += hsums[dx] * weight;
+				}
+			}
+			
+			uint8_t* const dst_line = m_pDst + dy * m_dstStride;
+			for (int dx = 0; dx < dw; ++dx) {
+				AreaSpan const& hspan = m_hSpans[dx];
+				if (vspan.first == vspan.last && hspan.first == hspan.last) {
+					// dst pixel maps to a single src pixel
+					dst_line[dx] = m_pSrc[vspan.first * m_srcStride + hspan.first];
+					continue;
+				}
+				
+				unsigned const total_area = vspan.totalWeight * hspan.totalWeight;
+				unsigned const pix_value = (sums[dx] + (total_area >> 1)) / total_area;
+				assert(pix_value < 256);
+				dst_line[dx] = static_cast<uint8_t>(pix_value);
+			}
+		}
+	}
+private:
+	void horizontalPass(uint8_t const* src_line, unsigned* hsums) const
+	{
+		int const dw = m_hSpans.size();
+		for (int dx = 0; dx < dw; ++dx) {
+			AreaSpan const& span = m_hSpans[dx];
+			if (span.first == span.last) {
+				hsums[dx] = src_line[span.first] * span.firstWeight;
+				continue;
+			}
+			
+			unsigned middle = 0;
+			for (int sx = span.first + 1; sx < span.last; ++sx) {
+				middle += src_line[sx];
+			}
+			
+			hsums[dx] = src_line[span.first] * span.firstWeight
+				+ (middle << 5) + src_line[span.last] * span.lastWeight;
+		}
+	}
+	
+	uint8_t const* m_pSrc;
+	uint8_t* m_pDst;
+	int m_srcStride;
+	int m_dstStride;
+	std::vector<AreaSpan> m_hSpans;
+	std::vector<AreaSpan> m_vSpans;
+};
+
 /**
  * This is a generic implementation of the scaling algorithm.
  */
@@ -248,134 +516,14 @@ static GrayImage scaleGrayToGray(GrayImage const& src, QSize const& dst_size)
 		return scaleUpGrayToGray(src, dst_size);
 	}
 	
-	double const dx2sx32 = calc32xRatio2(dw, sw);
-	double const dy2sy32 = calc32xRatio2(dh, sh);
-	
 	GrayImage dst(dst_size);
 	
-	uint8_t const* const src_data = src.data();
-	uint8_t* dst_line = dst.data();
-	int const src_stride = src.stride();
-	int const dst_stride = dst.stride();
-	
-	int sy32bottom = 0;
-	for (int dy1 = 1; dy1 <= dh; ++dy1, dst_line += dst_stride) {
-		int const sy32top = sy32bottom;
-		sy32bottom = (int)(dy1 * dy2sy32);
-		int const sytop = sy32top >> 5;
-		int const sybottom = (sy32bottom - 1) >> 5;
-		unsigned const top_fraction = 32 - (sy32top & 31);
-		unsigned const bottom_fraction = sy32bottom - (sybottom << 5);
-		assert(sybottom < sh); // calc32xRatio2() ensures that.
-		
-		unsigned const top_area = top_fraction << 5;
-		unsigned const bottom_area = bottom_fraction << 5;
-		
-		uint8_t const* const src_line_const = src_data + sytop * src_stride;
-		
-		int sx32right = 0;
-		for (int dx = 0; dx < dw; ++dx) {
-			int const sx32left = sx32right;
-			sx32right = (int)((dx + 1) * dx2sx32);
-			int const sxleft = sx32left >> 5;
-			int const sxright = (sx32right - 1) >> 5;
-			unsigned const left_fraction = 32 - (sx32left & 31);
-			unsigned const right_fraction = sx32right - (sxright << 5);
-			assert(sxright < sw); // calc32xRatio2() ensures that.
-			
-			uint8_t const* src_line = src_line_const;
-			unsigned gray_level = 0;
-			
-			if (sytop == sybottom) {
-				if (sxleft == sxright) {
-					// dst pixel maps to a single src pixel
-					dst_line[dx] = src_line[sxleft];
-					continue;
-				} else {
-					// dst pixel maps to a horizontal line of src pixels
-					unsigned const vert_fraction = sy32bottom - sy32top;
-					unsigned const left_area = vert_fraction * left_fraction;
-					unsigned const middle_area = vert_fraction << 5;
-					unsigned const right_area = vert_fraction * right_fraction;
-					
-					gray_level += src_line[sxleft] * left_area;
-					
-					for (int sx = sxleft + 1; sx < sxright; ++sx) {
-						gray_level += src_line[sx] * middle_area;
-					}
-					
-					gray_level += src_line[sxright] * right_area;
-				}
-			} else if (sxleft == sxright) {
-				// dst pixel maps to a vertical line of src pixels
-				unsigned const hor_fraction = sx32right - sx32left;
-				unsigned const top_area = hor_fraction * top_fraction;
-				unsigned const middle_area = hor_fraction << 5;
-				unsigned const bottom_area =  hor_fraction * bottom_fraction;
-				
-				gray_level += src_line[sxleft] * top_area;
-				
-				src_line += src_stride;
-				
-				for (int sy = sytop + 1; sy < sybottom; ++sy) {
-					gray_level += src_line[sxleft] * middle_area;
-					src_line += src_stride;
-				}
-				
-				gray_level += src_line[sxleft] * bottom_area;
-			} else {
-				// dst pixel maps to a block of src pixels
-				unsigned const left_area = left_fraction << 5;
-				unsigned const right_area = right_fraction << 5;
-				unsigned const topleft_area = top_fraction * left_fraction;
-				unsigned const topright_area = top_fraction * right_fraction;
-				unsigned const bottomleft_area = bottom_fraction * left_fraction;
-				unsigned const bottomright_area = bottom_fraction * right_fraction;
-				
-				// process the top-left corner
-				gray_level += src_line[sxleft] * topleft_area;
-				
-				// process the top line (without corners)
-				for (int sx = sxleft + 1; sx < sxright; ++sx) {
-					gray_level += src_line[sx] * top_area;
-				}
-				
-				// process the top-right corner
-				gray_level += src_line[sxright] * topright_area;
-				
-				src_line += src_stride;
-				
-				// process middle lines
-				for (int sy = sytop + 1; sy < sybottom; ++sy) {
-					gray_level += src_line[sxleft] * left_area;
-					
-					for (int sx = sxleft + 1; sx < sxright; ++sx) {
-						gray_level += src_line[sx] << (5 + 5);
-					}
-					
-					gray_level += src_line[sxright] * right_area;
-					
-					src_line += src_stride;
-				}
-				
-				// process bottom-left corner
-				gray_level += src_line[sxleft] * bottomleft_area;
-				
-				// process the bottom line (without corners)
-				for (int sx = sxleft + 1; sx < sxright; ++sx) {
-					gray_level += src_line[sx] * bottom_area;
-				}
-				
-				// process the bottom-right corner
-				gray_level += src_line[sxright] * bottomright_area;
-			}
-			
-			unsigned const total_area = (sy32bottom - sy32top) * (sx32right - sx32left);
-			unsigned const pix_value = (gray_level + (total_area >> 1)) / total_area;
-			assert(pix_value < 256);
-			dst_line[dx] = static_cast<uint8_t>(pix_value);
-		}
-	}
+	// Lines of a band are processed top to bottom, so fewer lines
+	// per band means more source lines going through the horizontal
+	// pass twice.
+	processLinesInParallel(
+		dh, 32, double(sw) * sh, AreaAveraging(src, dst)
+	);
 	
 	return dst;
 }
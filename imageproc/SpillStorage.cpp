@@ -0,0 +1,244 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "SpillStorage.h"
+#include <QTemporaryFile>
+#include <QMutexLocker>
+#include <QDir>
+#include <new>
+#include <stdlib.h>
+#include <assert.h>
+
+namespace imageproc
+{
+
+/*============================= StorageBlock ==============================*/
+
+StorageBlock::StorageBlock(
+	uint8_t* data, size_t size, std::auto_ptr<QTemporaryFile> file)
+:	m_pData(data),
+	m_size(size),
+	m_ptrFile(file)
+{
+}
+
+StorageBlock::~StorageBlock()
+{
+	SpillStorage::instance().blockDestroyed(*this);
+
+	if (m_ptrFile.get()) {
+		m_ptrFile->unmap(m_pData);
+		// QTemporaryFile removes the file when destroyed.
+	} else {
+		free(m_pData);
+	}
+}
+
+
+/*============================= SpillStorage ==============================*/
+
+SpillStorage::SpillStorage()
+:	m_sizeThreshold(0),
+	m_memoryBudget(0),
+	m_enabled(false)
+{
+}
+
+SpillStorage&
+SpillStorage::instance()
+{
+	static SpillStorage object;
+	return object;
+}
+
+bool
+SpillStorage::isEnabled() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_enabled;
+}
+
+void
+SpillStorage::setEnabled(bool const enabled)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_enabled = enabled;
+}
+
+QString
+SpillStorage::directory() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_directory;
+}
+
+void
+SpillStorage::setDirectory(QString const& dir)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_directory = dir;
+}
+
+qint64
+SpillStorage::sizeThreshold() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_sizeThreshold;
+}
+
+void
+SpillStorage::setSizeThreshold(qint64 const bytes)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_sizeThreshold = bytes;
+}
+
+qint64
+SpillStorage::memoryBudget() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_memoryBudget;
+}
+
+void
+SpillStorage::setMemoryBudget(qint64 const bytes)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_memoryBudget = bytes;
+}
+
+SpillStorage::Statistics
+SpillStorage::statistics() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_stats;
+}
+
+IntrusivePtr<StorageBlock>
+SpillStorage::allocate(size_t const bytes)
+{
+	if (bytes < MIN_BLOCK_SIZE) {
+		return IntrusivePtr<StorageBlock>();
+	}
+
+	bool spill = false;
+
+	{
+		QMutexLocker const locker(&m_mutex);
+
+		if (!m_enabled) {
+			return IntrusivePtr<StorageBlock>();
+		}
+
+		if (m_sizeThreshold > 0 && qint64(bytes) >= m_sizeThreshold) {
+			spill = true;
+		} else if (m_memoryBudget > 0 && m_stats.heapBytes + qint64(bytes) > m_memoryBudget) {
+			spill = true;
+		}
+	}
+
+	IntrusivePtr<StorageBlock> block;
+	if (spill) {
+		block = allocateInFile(bytes);
+		if (!block.get()) {
+			// Going over the budget is better than failing.
+			block = allocateOnHeap(bytes);
+		}
+	} else {
+		block = allocateOnHeap(bytes);
+		if (!block.get()) {
+			block = allocateInFile(bytes);
+		}
+	}
+
+	if (!block.get()) {
+		throw std::bad_alloc();
+	}
+
+	return block;
+}
+
+IntrusivePtr<StorageBlock>
+SpillStorage::allocateOnHeap(size_t const bytes)
+{
+	uint8_t* const data = static_cast<uint8_t*>(malloc(bytes));
+	if (!data) {
+		return IntrusivePtr<StorageBlock>();
+	}
+
+	IntrusivePtr<StorageBlock> const block(
+		new StorageBlock(data, bytes, std::auto_ptr<QTemporaryFile>())
+	);
+
+	QMutexLocker const locker(&m_mutex);
+	m_stats.heapBytes += bytes;
+
+	return block;
+}
+
+IntrusivePtr<StorageBlock>
+SpillStorage::allocateInFile(size_t const bytes)
+{
+	QString dir(directory());
+	if (dir.isEmpty()) {
+		dir = QDir::tempPath();
+	}
+
+	std::auto_ptr<QTemporaryFile> file(
+		new QTemporaryFile(QDir(dir).filePath("scantailor-spill-XXXXXX"))
+	);
+
+	uint8_t* data = 0;
+	if (file->open() && file->resize(bytes)) {
+		data = file->map(0, bytes);
+	}
+
+	if (!data) {
+		QMutexLocker const locker(&m_mutex);
+		++m_stats.failedSpills;
+		return IntrusivePtr<StorageBlock>();
+	}
+
+	IntrusivePtr<StorageBlock> const block(new StorageBlock(data, bytes, file));
+
+	QMutexLocker const locker(&m_mutex);
+	++m_stats.numSpilledBlocks;
+	++m_stats.totalSpills;
+	m_stats.spilledBytes += bytes;
+	m_stats.peakSpilledBytes = qMax(m_stats.peakSpilledBytes, m_stats.spilledBytes);
+
+	return block;
+}
+
+void
+SpillStorage::blockDestroyed(StorageBlock const& block)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	if (block.isSpilled()) {
+		--m_stats.numSpilledBlocks;
+		m_stats.spilledBytes -= block.size();
+	} else {
+		m_stats.heapBytes -= block.size();
+	}
+	assert(m_stats.numSpilledBlocks >= 0);
+	assert(m_stats.heapBytes >= 0);
+}
+
+} // namespace imageproc
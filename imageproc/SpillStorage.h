@@ -0,0 +1,170 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef IMAGEPROC_SPILL_STORAGE_H_
+#define IMAGEPROC_SPILL_STORAGE_H_
+
+#include "NonCopyable.h"
+#include "RefCountable.h"
+#include "IntrusivePtr.h"
+#include <QMutex>
+#include <QString>
+#include <QtGlobal>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+class QTemporaryFile;
+
+namespace imageproc
+{
+
+/**
+ * \brief A block of memory that lives either on the heap or in
+ *        a memory-mapped temporary file.
+ *
+ * Blocks are obtained from SpillStorage::allocate().  The memory
+ * is released when the last reference to a block goes away.
+ */
+class StorageBlock : public RefCountable
+{
+	DECLARE_NON_COPYABLE(StorageBlock)
+	friend class SpillStorage;
+public:
+	virtual ~StorageBlock();
+
+	uint8_t* data() const { return m_pData; }
+
+	size_t size() const { return m_size; }
+
+	bool isSpilled() const { return m_ptrFile.get() != 0; }
+private:
+	StorageBlock(uint8_t* data, size_t size, std::auto_ptr<QTemporaryFile> file);
+
+	uint8_t* m_pData;
+	size_t m_size;
+	std::auto_ptr<QTemporaryFile> m_ptrFile;
+};
+
+
+/**
+ * \brief Decides whether large image buffers go to the heap
+ *        or to memory-mapped temporary files.
+ *
+ * A buffer is spilled to disk if it's at least sizeThreshold() bytes
+ * large, if keeping it on the heap would exceed memoryBudget(), or if
+ * the heap allocation fails.  Spilled buffers are paged in and out
+ * by the operating system, so code processing them sequentially keeps
+ * working, just slower.
+ *
+ * The storage is disabled by default, in which case allocate() always
+ * returns a null pointer and callers use their usual allocation path.
+ *
+ * \note All methods of this class are thread-safe.
+ */
+class SpillStorage
+{
+	DECLARE_NON_COPYABLE(SpillStorage)
+	friend class StorageBlock;
+public:
+	struct Statistics
+	{
+		/** The number of spilled blocks currently alive. */
+		int numSpilledBlocks;
+
+		/** The total size of spilled blocks currently alive. */
+		qint64 spilledBytes;
+
+		/** The maximum value spilledBytes ever reached. */
+		qint64 peakSpilledBytes;
+
+		/** The number of blocks ever spilled. */
+		int totalSpills;
+
+		/** The number of times creating or mapping a temporary file failed. */
+		int failedSpills;
+
+		/** The total size of heap blocks currently alive. */
+		qint64 heapBytes;
+
+		Statistics()
+		:	numSpilledBlocks(0), spilledBytes(0), peakSpilledBytes(0),
+			totalSpills(0), failedSpills(0), heapBytes(0) {}
+	};
+
+	/** Smaller buffers are never handled by this class. */
+	enum { MIN_BLOCK_SIZE = 1 << 20 };
+
+	static SpillStorage& instance();
+
+	bool isEnabled() const;
+
+	void setEnabled(bool enabled);
+
+	/**
+	 * \brief The directory to create temporary files in.
+	 *
+	 * An empty string stands for the system's temporary directory.
+	 */
+	QString directory() const;
+
+	void setDirectory(QString const& dir);
+
+	/** Blocks this large or larger are always spilled.  Zero means no limit. */
+	qint64 sizeThreshold() const;
+
+	void setSizeThreshold(qint64 bytes);
+
+	/** The maximum size of heap blocks alive at once.  Zero means no limit. */
+	qint64 memoryBudget() const;
+
+	void setMemoryBudget(qint64 bytes);
+
+	/**
+	 * \brief Allocates a block of memory, possibly spilling it to disk.
+	 *
+	 * \return A null pointer if the storage is disabled or \p bytes
+	 *         is less than MIN_BLOCK_SIZE.  The contents of a returned
+	 *         block are not initialized.
+	 * \throw std::bad_alloc If neither the heap nor a temporary file
+	 *        could provide the memory.
+	 */
+	IntrusivePtr<StorageBlock> allocate(size_t bytes);
+
+	Statistics statistics() const;
+private:
+	SpillStorage();
+
+	IntrusivePtr<StorageBlock> allocateOnHeap(size_t bytes);
+
+	IntrusivePtr<StorageBlock> allocateInFile(size_t bytes);
+
+	void blockDestroyed(StorageBlock const& block);
+
+	mutable QMutex m_mutex;
+	QString m_directory;
+	qint64 m_sizeThreshold;
+	qint64 m_memoryBudget;
+	Statistics m_stats;
+	bool m_enabled;
+};
+
+} // namespace imageproc
+
+#endif
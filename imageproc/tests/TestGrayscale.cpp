@@ -81,6 +81,73 @@ BOOST_AUTO_TEST_CASE(test_argb32_to_grayscale)
 	BOOST_CHECK(toGrayscale(argb32) == gray);
 }
 
+static QImage referenceGrayscale(QImage const& src)
+{
+	QImage dst(src.width(), src.height(), QImage::Format_Indexed8);
+	dst.setColorTable(createGrayscalePalette());
+	
+	for (int y = 0; y < src.height(); ++y) {
+		for (int x = 0; x < src.width(); ++x) {
+			dst.setPixel(x, y, qGray(src.pixel(x, y)));
+		}
+	}
+	
+	return dst;
+}
+
+static QImage randomColorImage(int const w, int const h, QImage::Format const format)
+{
+	QImage argb32(w, h, QImage::Format_ARGB32);
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			argb32.setPixel(x, y, qRgba(rand() & 0xff, rand() & 0xff, rand() & 0xff, rand() & 0xff));
+		}
+	}
+	return argb32.convertToFormat(format);
+}
+
+BOOST_AUTO_TEST_CASE(test_color_formats_match_qgray)
+{
+	// Odd widths exercise the tails of vectorized loops.
+	int const widths[] = { 1, 15, 16, 17, 53 };
+	QImage::Format const formats[] = {
+		QImage::Format_RGB32, QImage::Format_ARGB32,
+		QImage::Format_ARGB32_Premultiplied, QImage::Format_RGB888
+	};
+	
+	for (unsigned w = 0; w < sizeof(widths)/sizeof(widths[0]); ++w) {
+		for (unsigned f = 0; f < sizeof(formats)/sizeof(formats[0]); ++f) {
+			QImage const src(randomColorImage(widths[w], 7, formats[f]));
+			BOOST_CHECK(toGrayscale(src) == referenceGrayscale(src));
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_color_palette_to_grayscale)
+{
+	QImage indexed(37, 11, QImage::Format_Indexed8);
+	QVector<QRgb> palette(200);
+	for (int i = 0; i < palette.size(); ++i) {
+		palette[i] = qRgb(rand() & 0xff, rand() & 0xff, rand() & 0xff);
+	}
+	indexed.setColorTable(palette);
+	
+	for (int y = 0; y < indexed.height(); ++y) {
+		for (int x = 0; x < indexed.width(); ++x) {
+			indexed.setPixel(x, y, rand() % palette.size());
+		}
+	}
+	
+	BOOST_CHECK(toGrayscale(indexed) == referenceGrayscale(indexed));
+}
+
+BOOST_AUTO_TEST_CASE(test_large_image_to_grayscale)
+{
+	// Large enough to be split between several threads.
+	QImage const src(randomColorImage(1031, 1029, QImage::Format_RGB32));
+	BOOST_CHECK(toGrayscale(src) == referenceGrayscale(src));
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
@@ -27,6 +27,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <math.h>
+#include <algorithm>
 
 namespace imageproc
 {
@@ -100,6 +101,167 @@ BOOST_AUTO_TEST_CASE(test_random_image)
 	//BOOST_CHECK(checkScale(img, QSize(145, 55)));
 }
 
+static GrayImage randomGrayImage(QSize const& size)
+{
+	GrayImage img(size);
+	uint8_t* line = img.data();
+	for (int y = 0; y < img.height(); ++y) {
+		for (int x = 0; x < img.width(); ++x) {
+			line[x] = rand() % 256;
+		}
+		line += img.stride();
+	}
+	return img;
+}
+
+static bool exactCompare(GrayImage const& img1, GrayImage const& img2)
+{
+	BOOST_REQUIRE(img1.width() == img2.width());
+	BOOST_REQUIRE(img1.height() == img2.height());
+	
+	uint8_t const* line1 = img1.data();
+	uint8_t const* line2 = img2.data();
+	for (int y = 0; y < img1.height(); ++y) {
+		if (!std::equal(line1, line1 + img1.width(), line2)) {
+			return false;
+		}
+		line1 += img1.stride();
+		line2 += img2.stride();
+	}
+	
+	return true;
+}
+
+/**
+ * The ratio scaleToGray() uses when going from destination
+ * to source coordinates multiplied by 32, when downscaling.
+ */
+static double areaRatio32(int const dst, int const src)
+{
+	int src32 = src << 5;
+	double ratio = (double)src32 / dst;
+	while ((int(ratio * dst) - 1) >> 5 >= src) {
+		--src32;
+		ratio = (double)src32 / dst;
+	}
+	return ratio;
+}
+
+/**
+ * Averages the source pixels a destination pixel covers, weighted
+ * by the covered area in 1/32 of a source pixel, one pixel at a time.
+ */
+static GrayImage referenceAreaScale(GrayImage const& src, QSize const& dst_size)
+{
+	double const x_ratio = areaRatio32(dst_size.width(), src.width());
+	double const y_ratio = areaRatio32(dst_size.height(), src.height());
+	
+	GrayImage dst(dst_size);
+	for (int dy = 0; dy < dst.height(); ++dy) {
+		int const sy32_begin = (int)(dy * y_ratio);
+		int const sy32_end = (int)((dy + 1) * y_ratio);
+		
+		for (int dx = 0; dx < dst.width(); ++dx) {
+			int const sx32_begin = (int)(dx * x_ratio);
+			int const sx32_end = (int)((dx + 1) * x_ratio);
+			
+			unsigned sum = 0;
+			for (int sy = sy32_begin >> 5; sy <= (sy32_end - 1) >> 5; ++sy) {
+				int const h = std::min(sy32_end, (sy + 1) << 5)
+					- std::max(sy32_begin, sy << 5);
+				for (int sx = sx32_begin >> 5; sx <= (sx32_end - 1) >> 5; ++sx) {
+					int const w = std::min(sx32_end, (sx + 1) << 5)
+						- std::max(sx32_begin, sx << 5);
+					sum += src.data()[sy * src.stride() + sx] * unsigned(w * h);
+				}
+			}
+			
+			unsigned const area = (sy32_end - sy32_begin) * (sx32_end - sx32_begin);
+			dst.data()[dy * dst.stride() + dx] = (sum + area / 2) / area;
+		}
+	}
+	
+	return dst;
+}
+
+static GrayImage referenceIntReduction(GrayImage const& src, int const xscale, int const yscale)
+{
+	GrayImage dst(QSize(src.width() / xscale, src.height() / yscale));
+	unsigned const area = xscale * yscale;
+	
+	for (int dy = 0; dy < dst.height(); ++dy) {
+		for (int dx = 0; dx < dst.width(); ++dx) {
+			unsigned sum = 0;
+			for (int sy = dy * yscale; sy < (dy + 1) * yscale; ++sy) {
+				for (int sx = dx * xscale; sx < (dx + 1) * xscale; ++sx) {
+					sum += src.data()[sy * src.stride() + sx];
+				}
+			}
+			dst.data()[dy * dst.stride() + dx] = (sum + area / 2) / area;
+		}
+	}
+	
+	return dst;
+}
+
+BOOST_AUTO_TEST_CASE(test_integer_reductions)
+{
+	int const widths[] = { 1, 7, 8, 15, 16, 17, 53 };
+	for (int scale = 2; scale <= 4; ++scale) {
+		for (unsigned i = 0; i < sizeof(widths)/sizeof(widths[0]); ++i) {
+			GrayImage const img(randomGrayImage(QSize(widths[i] * scale, 11 * scale)));
+			BOOST_CHECK(exactCompare(
+				scaleToGray(img, QSize(widths[i], 11)),
+				referenceIntReduction(img, scale, scale)
+			));
+		}
+	}
+	
+	GrayImage const img(randomGrayImage(QSize(60, 60)));
+	BOOST_CHECK(exactCompare(scaleToGray(img, QSize(30, 20)), referenceIntReduction(img, 2, 3)));
+	BOOST_CHECK(exactCompare(scaleToGray(img, QSize(12, 30)), referenceIntReduction(img, 5, 2)));
+	
+	// Large enough to be processed by several threads.
+	GrayImage const large(randomGrayImage(QSize(2048, 1536)));
+	BOOST_CHECK(exactCompare(scaleToGray(large, QSize(512, 384)), referenceIntReduction(large, 4, 4)));
+}
+
+BOOST_AUTO_TEST_CASE(test_arbitrary_reductions)
+{
+	GrayImage const img(randomGrayImage(QSize(101, 97)));
+	BOOST_CHECK(exactCompare(scaleToGray(img, QSize(50, 50)), referenceAreaScale(img, QSize(50, 50))));
+	BOOST_CHECK(exactCompare(scaleToGray(img, QSize(33, 71)), referenceAreaScale(img, QSize(33, 71))));
+	BOOST_CHECK(exactCompare(scaleToGray(img, QSize(1, 1)), referenceAreaScale(img, QSize(1, 1))));
+	
+	// Downscaling along one axis while upscaling along the other.
+	BOOST_CHECK(exactCompare(scaleToGray(img, QSize(150, 40)), referenceAreaScale(img, QSize(150, 40))));
+	BOOST_CHECK(exactCompare(scaleToGray(img, QSize(20, 130)), referenceAreaScale(img, QSize(20, 130))));
+	
+	GrayImage const large(randomGrayImage(QSize(2001, 1499)));
+	BOOST_CHECK(exactCompare(scaleToGray(large, QSize(700, 600)), referenceAreaScale(large, QSize(700, 600))));
+}
+
+BOOST_AUTO_TEST_CASE(test_integer_enlargement)
+{
+	GrayImage const img(randomGrayImage(QSize(13, 7)));
+	QSize const sizes[] = { QSize(26, 14), QSize(26, 35), QSize(52, 14) };
+	
+	for (unsigned i = 0; i < sizeof(sizes)/sizeof(sizes[0]); ++i) {
+		int const xscale = sizes[i].width() / img.width();
+		int const yscale = sizes[i].height() / img.height();
+		GrayImage const scaled(scaleToGray(img, sizes[i]));
+		
+		bool ok = true;
+		for (int y = 0; y < scaled.height(); ++y) {
+			for (int x = 0; x < scaled.width(); ++x) {
+				uint8_t const expected = img.data()[(y / yscale) * img.stride() + x / xscale];
+				ok = ok && scaled.data()[y * scaled.stride() + x] == expected;
+			}
+		}
+		BOOST_CHECK(ok);
+	}
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
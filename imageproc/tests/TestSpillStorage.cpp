@@ -0,0 +1,219 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "SpillStorage.h"
+#include "BinaryImage.h"
+#include "GrayImage.h"
+#include "BWColor.h"
+#include "RasterOp.h"
+#include <QImage>
+#include <QDir>
+#ifndef Q_MOC_RUN
+#include <boost/test/auto_unit_test.hpp>
+#endif
+#include <stdlib.h>
+#include <string.h>
+
+namespace imageproc
+{
+
+namespace tests
+{
+
+BOOST_AUTO_TEST_SUITE(SpillStorageTestSuite);
+
+namespace
+{
+
+/**
+ * Enables SpillStorage with the given settings for as long as it lives.
+ */
+class SpillStorageEnabler
+{
+public:
+	SpillStorageEnabler(qint64 size_threshold, qint64 memory_budget) {
+		SpillStorage& storage = SpillStorage::instance();
+		storage.setDirectory(QDir::tempPath());
+		storage.setSizeThreshold(size_threshold);
+		storage.setMemoryBudget(memory_budget);
+		storage.setEnabled(true);
+	}
+
+	~SpillStorageEnabler() {
+		SpillStorage& storage = SpillStorage::instance();
+		storage.setEnabled(false);
+		storage.setSizeThreshold(0);
+		storage.setMemoryBudget(0);
+	}
+};
+
+BinaryImage randomBinaryImage(int const width, int const height)
+{
+	QImage qimg(width, height, QImage::Format_Mono);
+	qimg.setNumColors(2);
+	qimg.setColor(0, 0xffffffff);
+	qimg.setColor(1, 0xff000000);
+	for (int y = 0; y < height; ++y) {
+		uchar* line = qimg.scanLine(y);
+		for (int i = 0; i < qimg.bytesPerLine(); ++i) {
+			line[i] = static_cast<uchar>(rand());
+		}
+	}
+	return BinaryImage(qimg);
+}
+
+void drawGradient(GrayImage& image)
+{
+	uint8_t* line = image.data();
+	for (int y = 0; y < image.height(); ++y) {
+		for (int x = 0; x < image.width(); ++x) {
+			line[x] = static_cast<uint8_t>(x + y);
+		}
+		line += image.stride();
+	}
+}
+
+bool hasGradient(QImage const& image)
+{
+	for (int y = 0; y < image.height(); ++y) {
+		uchar const* line = image.scanLine(y);
+		for (int x = 0; x < image.width(); ++x) {
+			if (line[x] != static_cast<uchar>(x + y)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_disabled_by_default)
+{
+	BOOST_CHECK(!SpillStorage::instance().isEnabled());
+	BOOST_CHECK(!SpillStorage::instance().allocate(SpillStorage::MIN_BLOCK_SIZE));
+}
+
+BOOST_AUTO_TEST_CASE(test_small_blocks_are_not_handled)
+{
+	SpillStorageEnabler const enabler(1, 0);
+	BOOST_CHECK(!SpillStorage::instance().allocate(SpillStorage::MIN_BLOCK_SIZE - 1));
+}
+
+BOOST_AUTO_TEST_CASE(test_size_threshold)
+{
+	SpillStorageEnabler const enabler(2 << 20, 0);
+	SpillStorage& storage = SpillStorage::instance();
+	SpillStorage::Statistics const before(storage.statistics());
+
+	{
+		IntrusivePtr<StorageBlock> const small(storage.allocate(1 << 20));
+		BOOST_REQUIRE(small);
+		BOOST_CHECK(!small->isSpilled());
+
+		IntrusivePtr<StorageBlock> const large(storage.allocate(2 << 20));
+		BOOST_REQUIRE(large);
+		BOOST_REQUIRE(large->isSpilled());
+		memset(large->data(), 0x5a, large->size());
+		BOOST_CHECK(large->data()[large->size() - 1] == 0x5a);
+
+		SpillStorage::Statistics const during(storage.statistics());
+		BOOST_CHECK_EQUAL(during.numSpilledBlocks, before.numSpilledBlocks + 1);
+		BOOST_CHECK_EQUAL(during.spilledBytes, before.spilledBytes + (2 << 20));
+		BOOST_CHECK_EQUAL(during.heapBytes, before.heapBytes + (1 << 20));
+		BOOST_CHECK_EQUAL(during.totalSpills, before.totalSpills + 1);
+	}
+
+	SpillStorage::Statistics const after(storage.statistics());
+	BOOST_CHECK_EQUAL(after.numSpilledBlocks, before.numSpilledBlocks);
+	BOOST_CHECK_EQUAL(after.spilledBytes, before.spilledBytes);
+	BOOST_CHECK_EQUAL(after.heapBytes, before.heapBytes);
+	BOOST_CHECK(after.peakSpilledBytes >= 2 << 20);
+}
+
+BOOST_AUTO_TEST_CASE(test_memory_budget)
+{
+	SpillStorageEnabler const enabler(0, 3 << 20);
+	SpillStorage& storage = SpillStorage::instance();
+
+	IntrusivePtr<StorageBlock> const first(storage.allocate(2 << 20));
+	BOOST_REQUIRE(first);
+	BOOST_CHECK(!first->isSpilled());
+
+	IntrusivePtr<StorageBlock> const second(storage.allocate(2 << 20));
+	BOOST_REQUIRE(second);
+	BOOST_CHECK(second->isSpilled());
+}
+
+BOOST_AUTO_TEST_CASE(test_spilled_binary_image)
+{
+	BinaryImage const reference(randomBinaryImage(4001, 2999));
+	
+	SpillStorageEnabler const enabler(1, 0);
+	int const spills_before = SpillStorage::instance().statistics().totalSpills;
+
+	BinaryImage spilled(reference.size());
+	BOOST_CHECK_EQUAL(SpillStorage::instance().statistics().totalSpills, spills_before + 1);
+	rasterOp<RopSrc>(spilled, reference);
+	BOOST_CHECK(spilled == reference);
+
+	// Copy-on-write has to go through the storage as well.
+	BinaryImage copy(spilled);
+	copy.invert();
+	BOOST_CHECK_EQUAL(SpillStorage::instance().statistics().totalSpills, spills_before + 2);
+	copy.invert();
+	BOOST_CHECK(copy == reference);
+}
+
+BOOST_AUTO_TEST_CASE(test_spilled_gray_image)
+{
+	SpillStorageEnabler const enabler(1, 0);
+	int const spills_before = SpillStorage::instance().statistics().totalSpills;
+
+	GrayImage spilled(QSize(1100, 1000));
+	BOOST_REQUIRE(spilled.isSpilled());
+	BOOST_CHECK_EQUAL(SpillStorage::instance().statistics().totalSpills, spills_before + 1);
+	drawGradient(spilled);
+
+	// The QImage handed out has to outlive the spilled data.
+	QImage qimg;
+	{
+		GrayImage const copy(spilled);
+		qimg = copy.toQImage();
+	}
+	spilled = GrayImage();
+	BOOST_CHECK(hasGradient(qimg));
+	BOOST_CHECK(qimg.isGrayscale());
+
+	// Copy-on-write has to go through the storage as well.
+	GrayImage original(QSize(1100, 1000));
+	drawGradient(original);
+	GrayImage copy(original);
+	copy.fill(0);
+	BOOST_CHECK(copy.isSpilled());
+	BOOST_CHECK_EQUAL(SpillStorage::instance().statistics().totalSpills, spills_before + 3);
+	BOOST_CHECK(hasGradient(original.toQImage()));
+	BOOST_CHECK(copy != original);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace imageproc
@@ -24,6 +24,12 @@
 
 #include "CommandLine.h"
 #include "ConsoleBatch.h"
+#include "ImageIdTable.h"
+#include "TiffDirectoryIndex.h"
+#include "InputPrefetcher.h"
+#include "PerformanceStats.h"
+#include "imageproc/SpillStorage.h"
+#include "ThreadPool.h"
 
 
 int main(int argc, char **argv)
@@ -44,6 +50,22 @@ int main(int argc, char **argv)
 		return 0;
 	}
 
+	// Instantiate the singletons while we are still single-threaded.
+	ImageIdTable::instance();
+	TiffDirectoryIndex::instance();
+	InputPrefetcher::instance();
+	PerformanceStats::instance();
+
+	imageproc::SpillStorage& spill_storage = imageproc::SpillStorage::instance();
+	if (cli.hasSpillStorage()) {
+		spill_storage.setDirectory(cli.getSpillDirectory());
+		spill_storage.setSizeThreshold(qint64(cli.getSpillThreshold()) << 20);
+		spill_storage.setMemoryBudget(qint64(cli.getMemoryBudget()) << 20);
+		spill_storage.setEnabled(true);
+	}
+
+	ThreadPool::instance().setMaxThreads(cli.getThreads());
+
 	std::auto_ptr<ConsoleBatch> cbatch;
 
 	try {
@@ -60,4 +82,14 @@ int main(int argc, char **argv)
 
 	if (cli.hasOutputProject())
 		cbatch->saveProject(cli.outputProjectFile());
+
+	if (cli.hasSpillStorage() && cli.isVerbose()) {
+		imageproc::SpillStorage::Statistics const stats(spill_storage.statistics());
+		std::cout << "Spilled buffers: " << stats.totalSpills
+			<< ", peak disk usage: " << (stats.peakSpilledBytes >> 20) << " MB";
+		if (stats.failedSpills) {
+			std::cout << ", failed spills: " << stats.failedSpills;
+		}
+		std::cout << "\n";
+	}
 }
@@ -22,6 +22,13 @@
 #include "PngMetadataLoader.h"
 #include "TiffMetadataLoader.h"
 #include "JpegMetadataLoader.h"
+#include "ImageIdTable.h"
+#include "TiffDirectoryIndex.h"
+#include "InputPrefetcher.h"
+#include "PerformanceStats.h"
+#include "SettingsDialog.h"
+#include "imageproc/SpillStorage.h"
+#include "ThreadPool.h"
 #include <QMetaType>
 #include <QtPlugin>
 #include <QLocale>
@@ -184,6 +191,19 @@ int main(int argc, char** argv)
 	TiffMetadataLoader::registerMyself();
 	JpegMetadataLoader::registerMyself();
 	
+	// Instantiate the singletons while we are still single-threaded.
+	ImageIdTable::instance();
+	TiffDirectoryIndex::instance();
+	InputPrefetcher::instance();
+	PerformanceStats::instance();
+	imageproc::SpillStorage::instance();
+	SettingsDialog::applySpillStorageSettings();
+	ThreadPool::instance();
+	SettingsDialog::applyThreadPoolSettings();
+	if (cli.hasThreads()) {
+		ThreadPool::instance().setMaxThreads(cli.getThreads());
+	}
+	
 	MainWindow* main_wnd = new MainWindow();
 	main_wnd->setAttribute(Qt::WA_DeleteOnClose);
 	if (settings.value("mainWindow/maximized") == false) {
@@ -0,0 +1,186 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "dewarping/DirectionalPathSearch.h"
+#include "Grid.h"
+#include "VecNT.h"
+#include "NumericTraits.h"
+#include <boost/test/auto_unit_test.hpp>
+#include <vector>
+#include <stdint.h>
+#include <stdlib.h>
+
+namespace dewarping
+{
+
+namespace tests
+{
+
+BOOST_AUTO_TEST_SUITE(DirectionalPathSearchTestSuite);
+
+namespace
+{
+
+struct Node
+{
+	static uint32_t const INVALID_HEAP_IDX = ~uint32_t(0);
+
+	float pathCost;
+	float step;
+	int prevNbhIdx;
+	uint32_t heapIdx_;
+
+	float stepCost() const { return step; }
+
+	void setPrevNeighbourIdx(uint32_t idx) { prevNbhIdx = idx; }
+
+	uint32_t heapIdx() const { return heapIdx_; }
+
+	void setHeapIdx(uint32_t idx) { heapIdx_ = idx; }
+};
+
+int const nbh_dx[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+int const nbh_dy[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+
+/**
+ * Step costs are quantized to just a few levels, to get plenty
+ * of paths of the same cost.
+ */
+Grid<Node> makeRandomGrid(int width, int height, int num_levels, int source_permille)
+{
+	Grid<Node> grid(width, height, /*padding=*/1);
+
+	Node padding_node;
+	padding_node.pathCost = -1;
+	padding_node.step = 1;
+	padding_node.prevNbhIdx = -1;
+	padding_node.heapIdx_ = Node::INVALID_HEAP_IDX;
+	grid.initPadding(padding_node);
+
+	Node* line = grid.data();
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			Node& node = line[x];
+			node.step = float(rand() % (num_levels + 1)) / num_levels;
+			node.pathCost = (rand() % 1000 < source_permille) ? 0.0f : NumericTraits<float>::max();
+			node.prevNbhIdx = -1;
+			node.heapIdx_ = Node::INVALID_HEAP_IDX;
+		}
+		line += grid.stride();
+	}
+
+	return grid;
+}
+
+/**
+ * Follows the path back to its source, making sure its cost matches
+ * the one stored in the endpoint.
+ */
+bool checkPath(Grid<Node> const& grid, int x, int y, Vec2f const& direction)
+{
+	Node const* const data = grid.data();
+	int const stride = grid.stride();
+	float const expected_cost = data[y * stride + x].pathCost;
+	float cost = 0;
+
+	for (;;) {
+		Node const& node = data[y * stride + x];
+		if (node.prevNbhIdx < 0) {
+			return node.pathCost == 0 && cost == expected_cost;
+		}
+
+		int const px = x + nbh_dx[node.prevNbhIdx];
+		int const py = y + nbh_dy[node.prevNbhIdx];
+		if (px < 0 || py < 0 || px >= grid.width() || py >= grid.height()) {
+			return false;
+		}
+		if (Vec2f(x - px, y - py).dot(direction) <= 0) {
+			return false; // A step against the direction of propagation.
+		}
+
+		x = px;
+		y = py;
+		cost = std::max<float>(cost, data[y * stride + x].step);
+	}
+}
+
+void compareEngines(int width, int height, int num_levels, int source_permille, Vec2f const& direction)
+{
+	Grid<Node> heap_grid(makeRandomGrid(width, height, num_levels, source_permille));
+	Grid<Node> wavefront_grid(heap_grid);
+
+	DirectionalPathSearch<Node>::propagateWithPriorityQueue(heap_grid, direction);
+	DirectionalPathSearch<Node>::propagateWavefront(wavefront_grid, direction);
+
+	Node const* heap_line = heap_grid.data();
+	Node const* wavefront_line = wavefront_grid.data();
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			BOOST_REQUIRE_EQUAL(heap_line[x].pathCost, wavefront_line[x].pathCost);
+			if (wavefront_line[x].pathCost != NumericTraits<float>::max()) {
+				BOOST_REQUIRE(checkPath(wavefront_grid, x, y, direction));
+			}
+		}
+		heap_line += heap_grid.stride();
+		wavefront_line += wavefront_grid.stride();
+	}
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_same_costs_as_priority_queue)
+{
+	static float const directions[][2] = {
+		{ 1.0f, 0.0f }, { 0.0f, 1.0f }, { -1.0f, 0.0f }, { 0.0f, -1.0f },
+		{ 1.0f, 0.3f }, { 1.0f, -0.3f }, { -1.0f, 0.7f }, { -1.0f, -0.7f },
+		{ 0.2f, 1.0f }, { -0.2f, -1.0f }, { 0.7f, 0.7f }, { -0.7f, 0.7f }
+	};
+
+	srand(0);
+
+	for (unsigned i = 0; i < sizeof(directions) / sizeof(directions[0]); ++i) {
+		Vec2f const direction(directions[i][0], directions[i][1]);
+		compareEngines(37, 23, 4, 5, direction);
+		compareEngines(50, 50, 100, 1, direction);
+		compareEngines(1, 30, 3, 50, direction);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_single_source_reaches_its_cone_only)
+{
+	Grid<Node> grid(makeRandomGrid(9, 9, 2, 0));
+	Node* const data = grid.data();
+	int const stride = grid.stride();
+	data[4 * stride + 0].pathCost = 0;
+
+	DirectionalPathSearch<Node>::propagateWavefront(grid, Vec2f(1.0f, 0.0f));
+
+	for (int y = 0; y < 9; ++y) {
+		for (int x = 0; x < 9; ++x) {
+			bool const reachable = abs(y - 4) <= x;
+			BOOST_CHECK_EQUAL(reachable, data[y * stride + x].pathCost != NumericTraits<float>::max());
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace dewarping
@@ -0,0 +1,166 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MrcLayers.h"
+#include "Dpm.h"
+#include "filters/output/ColorParams.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/BWColor.h"
+#include <QImage>
+#include <QColor>
+#include <boost/test/auto_unit_test.hpp>
+
+namespace Tests
+{
+
+using namespace imageproc;
+using output::ColorParams;
+
+BOOST_AUTO_TEST_SUITE(OutputFileLayoutTestSuite);
+
+namespace
+{
+
+/**
+ * What the output generator produces for a Mixed page:
+ * a picture on the left and B/W text on the right.
+ */
+class MixedPage
+{
+public:
+	MixedPage()
+	:	m_text(WIDTH, HEIGHT, WHITE),
+		m_mask(WIDTH, HEIGHT, WHITE),
+		m_image(WIDTH, HEIGHT, QImage::Format_RGB32)
+	{
+		for (int y = 0; y < HEIGHT; ++y) {
+			for (int x = 0; x < WIDTH; ++x) {
+				if (x < WIDTH / 2) {
+					// Mixed output never has pure black or white in pictures.
+					m_image.setPixel(x, y, qRgb(40 + x * 5, 60 + y * 3, 200 - x * 2));
+					continue;
+				}
+				m_mask.setPixel(x, y, BLACK);
+				if ((x / 2 + y) % 5 == 0) {
+					m_text.setPixel(x, y, BLACK);
+					m_image.setPixel(x, y, qRgb(0x00, 0x00, 0x00));
+				} else {
+					m_image.setPixel(x, y, qRgb(0xff, 0xff, 0xff));
+				}
+			}
+		}
+	}
+
+	/** What a fresh reprocess writes as a plain file. */
+	QImage const& image() const { return m_image; }
+
+	/** What a fresh reprocess writes as a layered file. */
+	MrcLayers layers() const {
+		return MrcLayers::fromMixed(m_image, m_text, m_mask, Dpm(m_image));
+	}
+private:
+	enum { WIDTH = 64, HEIGHT = 48 };
+
+	BinaryImage m_text;
+	BinaryImage m_mask;
+	QImage m_image;
+};
+
+ColorParams mixedParams(bool const layered)
+{
+	ColorParams params;
+	params.setColorMode(ColorParams::MIXED);
+	params.setLayeredOutput(layered);
+	return params;
+}
+
+/**
+ * Brings the output file of \p page from \p stored to \p wanted layout
+ * the way output::Task does, returning the output image as read back.
+ * Loading a layered file composes its layers, as TiffReader does.
+ */
+QImage switchLayout(MixedPage const& page,
+	ColorParams const& stored, ColorParams const& wanted)
+{
+	QImage const stored_file(
+		stored.layeredOutput() ? page.layers().compose() : page.image()
+	);
+
+	switch (ColorParams::fileUpdateFor(stored, wanted)) {
+		case ColorParams::KEEP_FILE:
+			return stored_file;
+		case ColorParams::REWRITE_FILE:
+			if (wanted.layeredOutput()) {
+				return MrcLayers::split(stored_file).compose();
+			}
+			return stored_file;
+		case ColorParams::REGENERATE_FILE:
+			break;
+	}
+
+	return wanted.layeredOutput() ? page.layers().compose() : page.image();
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_layered_to_plain_matches_reprocess)
+{
+	MixedPage const page;
+
+	// Otherwise this test would pass even if the layered file
+	// was simply loaded and written back.
+	BOOST_REQUIRE(page.layers().compose() != page.image());
+
+	QImage const output(switchLayout(page, mixedParams(true), mixedParams(false)));
+	BOOST_CHECK(output == page.image());
+}
+
+BOOST_AUTO_TEST_CASE(test_plain_to_layered_rewrite_matches_reprocess)
+{
+	MixedPage const page;
+
+	BOOST_CHECK_EQUAL(
+		ColorParams::fileUpdateFor(mixedParams(false), mixedParams(true)),
+		ColorParams::REWRITE_FILE
+	);
+
+	MrcLayers const rewritten(MrcLayers::split(page.image()));
+	MrcLayers const reprocessed(page.layers());
+	BOOST_CHECK(rewritten.text() == reprocessed.text());
+	BOOST_CHECK(rewritten.mask() == reprocessed.mask());
+	BOOST_CHECK(rewritten.background() == reprocessed.background());
+
+	QImage const output(switchLayout(page, mixedParams(false), mixedParams(true)));
+	BOOST_CHECK(output == reprocessed.compose());
+}
+
+BOOST_AUTO_TEST_CASE(test_layout_is_irrelevant_outside_mixed_mode)
+{
+	ColorParams stored;
+	stored.setColorMode(ColorParams::COLOR_GRAYSCALE);
+	ColorParams wanted(stored);
+	wanted.setLayeredOutput(true);
+
+	BOOST_CHECK_EQUAL(
+		ColorParams::fileUpdateFor(stored, wanted), ColorParams::KEEP_FILE
+	);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
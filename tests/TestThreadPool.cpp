@@ -0,0 +1,336 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ThreadPool.h"
+#include "ParallelFor.h"
+#include "TaskGroup.h"
+#include "ScratchArena.h"
+#include "TransferableException.h"
+#include <QThread>
+#include <QAtomicInt>
+#include <boost/test/auto_unit_test.hpp>
+#include <stdexcept>
+#include <vector>
+#include <stddef.h>
+
+namespace Tests
+{
+
+BOOST_AUTO_TEST_SUITE(ThreadPoolTestSuite);
+
+namespace
+{
+
+/**
+ * ThreadPool is process-wide, so tests changing
+ * its limit have to restore the default.
+ */
+class MaxThreadsGuard
+{
+public:
+	MaxThreadsGuard(int max_threads) {
+		ThreadPool::instance().setMaxThreads(max_threads);
+	}
+
+	~MaxThreadsGuard() { ThreadPool::instance().setMaxThreads(0); }
+};
+
+class TestException : public TransferableException
+{
+public:
+	virtual char const* what() const throw() { return "TestException"; }
+
+	virtual TransferableException* clone() const { return new TestException(*this); }
+
+	virtual void raise() const { throw *this; }
+};
+
+void spin()
+{
+	// Gives pool threads a chance to pick up some chunks.
+	volatile int counter = 0;
+	for (int i = 0; i < 100000; ++i) {
+		counter = counter + 1;
+	}
+}
+
+struct MarkItems
+{
+	std::vector<int>* items;
+	int offset;
+
+	MarkItems(std::vector<int>& v, int o) : items(&v), offset(o) {}
+
+	void operator()(int begin, int end) const {
+		spin();
+		for (int i = begin; i < end; ++i) {
+			++(*items)[offset + i];
+		}
+	}
+};
+
+struct NestedLoop
+{
+	std::vector<int>* items;
+	int innerSize;
+
+	NestedLoop(std::vector<int>& v, int inner_size) : items(&v), innerSize(inner_size) {}
+
+	void operator()(int begin, int end) const {
+		for (int i = begin; i < end; ++i) {
+			parallelFor(innerSize, 3, MarkItems(*items, i * innerSize));
+		}
+	}
+};
+
+struct RecordThreads
+{
+	QThread* caller;
+	QAtomicInt* foreignChunks;
+
+	RecordThreads(QAtomicInt& counter)
+	: caller(QThread::currentThread()), foreignChunks(&counter) {}
+
+	void operator()(int, int) const {
+		spin();
+		if (QThread::currentThread() != caller) {
+			foreignChunks->fetchAndAddRelaxed(1);
+		}
+	}
+};
+
+struct ThrowOnPoolThreads
+{
+	QThread* caller;
+
+	ThrowOnPoolThreads() : caller(QThread::currentThread()) {}
+
+	void operator()(int, int) const {
+		spin();
+		if (QThread::currentThread() != caller) {
+			throw TestException();
+		}
+	}
+};
+
+struct ThrowLogicError
+{
+	void operator()(int, int) const {
+		spin();
+		throw std::logic_error("ThrowLogicError");
+	}
+};
+
+struct MarkItem
+{
+	std::vector<int>* items;
+	int idx;
+
+	MarkItem(std::vector<int>& v, int i) : items(&v), idx(i) {}
+
+	void operator()() const {
+		spin();
+		++(*items)[idx];
+	}
+};
+
+struct AddMarkers
+{
+	TaskGroup* group;
+	std::vector<int>* items;
+
+	AddMarkers(TaskGroup& g, std::vector<int>& v) : group(&g), items(&v) {}
+
+	void operator()() const {
+		for (size_t i = 0; i < items->size(); ++i) {
+			group->run(MarkItem(*items, i));
+		}
+	}
+};
+
+struct ThrowTestException
+{
+	void operator()() const {
+		spin();
+		throw TestException();
+	}
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_every_item_processed_once)
+{
+	std::vector<int> items(1000, 0);
+	parallelFor(items.size(), 7, MarkItems(items, 0));
+
+	for (size_t i = 0; i < items.size(); ++i) {
+		BOOST_REQUIRE_EQUAL(items[i], 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_nested_parallel_for)
+{
+	int const outer_size = 16;
+	int const inner_size = 50;
+	std::vector<int> items(outer_size * inner_size, 0);
+	parallelFor(outer_size, 1, NestedLoop(items, inner_size));
+
+	for (size_t i = 0; i < items.size(); ++i) {
+		BOOST_REQUIRE_EQUAL(items[i], 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_single_thread_runs_inline)
+{
+	MaxThreadsGuard const guard(1);
+	BOOST_CHECK_EQUAL(ThreadPool::instance().maxThreads(), 1);
+
+	QAtomicInt foreign_chunks(0);
+	parallelFor(100, 1, RecordThreads(foreign_chunks));
+	BOOST_CHECK_EQUAL(foreign_chunks.fetchAndAddRelaxed(0), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_transferable_exception_keeps_type)
+{
+	// Make sure there are pool threads, even on a single core.
+	MaxThreadsGuard const guard(4);
+
+	bool caught = false;
+	try {
+		parallelFor(1000, 1, ThrowOnPoolThreads());
+	} catch (TestException const&) {
+		caught = true;
+	}
+	BOOST_CHECK(caught);
+}
+
+BOOST_AUTO_TEST_CASE(test_other_exceptions_propagate)
+{
+	// Depending on which thread throws first, it's either re-thrown
+	// as is, or as std::runtime_error.
+	BOOST_CHECK_THROW(parallelFor(100, 1, ThrowLogicError()), std::exception);
+
+	// The pool must still be usable.
+	std::vector<int> items(100, 0);
+	parallelFor(items.size(), 1, MarkItems(items, 0));
+	for (size_t i = 0; i < items.size(); ++i) {
+		BOOST_REQUIRE_EQUAL(items[i], 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_lowering_and_raising_limit)
+{
+	std::vector<int> items(500, 0);
+	{
+		MaxThreadsGuard const guard(2);
+		parallelFor(items.size(), 1, MarkItems(items, 0));
+		ThreadPool::instance().setMaxThreads(1);
+		parallelFor(items.size(), 1, MarkItems(items, 0));
+	}
+	// Workers that exited due to the lower limit get restarted.
+	parallelFor(items.size(), 1, MarkItems(items, 0));
+
+	for (size_t i = 0; i < items.size(); ++i) {
+		BOOST_REQUIRE_EQUAL(items[i], 3);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_task_group_runs_every_task_once)
+{
+	std::vector<int> items(100, 0);
+
+	TaskGroup group;
+	for (size_t i = 0; i < items.size(); ++i) {
+		group.run(MarkItem(items, i));
+	}
+	group.wait();
+
+	for (size_t i = 0; i < items.size(); ++i) {
+		BOOST_REQUIRE_EQUAL(items[i], 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_task_group_tasks_adding_tasks)
+{
+	std::vector<int> items(100, 0);
+
+	TaskGroup group;
+	group.run(AddMarkers(group, items));
+	group.wait();
+
+	for (size_t i = 0; i < items.size(); ++i) {
+		BOOST_REQUIRE_EQUAL(items[i], 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_task_group_rethrows_from_wait)
+{
+	MaxThreadsGuard const guard(4);
+
+	std::vector<int> items(50, 0);
+
+	TaskGroup group;
+	for (size_t i = 0; i < items.size(); ++i) {
+		group.run(MarkItem(items, i));
+	}
+	group.run(ThrowTestException());
+	BOOST_CHECK_THROW(group.wait(), TestException);
+}
+
+BOOST_AUTO_TEST_CASE(test_scratch_arena_scopes_rewind)
+{
+	char* outer_first = 0;
+	char* inner_first = 0;
+	{
+		ScratchArena::Scope outer;
+		outer_first = outer.alloc<char>(100);
+		BOOST_CHECK_EQUAL((size_t)outer_first % 16, size_t(0));
+		{
+			ScratchArena::Scope inner;
+			inner_first = inner.alloc<char>(100);
+			BOOST_CHECK(inner_first != outer_first);
+			BOOST_CHECK_EQUAL((size_t)inner_first % 16, size_t(0));
+		}
+		{
+			// Memory of the finished inner scope gets reused.
+			ScratchArena::Scope inner;
+			BOOST_CHECK_EQUAL(inner.alloc<char>(100), inner_first);
+		}
+	}
+
+	ScratchArena::Scope scope;
+	BOOST_CHECK_EQUAL(scope.alloc<char>(100), outer_first);
+}
+
+BOOST_AUTO_TEST_CASE(test_scratch_arena_large_allocations)
+{
+	ScratchArena::Scope outer;
+	char* const small = outer.alloc<char>(16);
+	{
+		// Bigger than any block, so a new one has to be made.
+		ScratchArena::Scope inner;
+		char* const big = inner.alloc<char>(16 << 20);
+		big[0] = big[(16 << 20) - 1] = 1;
+	}
+	small[0] = 1;
+	BOOST_CHECK_EQUAL(outer.alloc<char>(16), small + 16);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace Tests
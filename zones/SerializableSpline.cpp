@@ -83,13 +83,9 @@ SerializableSpline::transformed(QTransform const& xform) const
 
 SerializableSpline
 SerializableSpline::transformed(
-	boost::function<QPointF(QPointF const&)> const& xform) const
+	boost::function<QPolygonF(QPolygonF const&)> const& xform) const
 {
 	SerializableSpline transformed(*this);
-
-	BOOST_FOREACH(QPointF& pt, transformed.m_points) {
-		pt = xform(pt);
-	}
-
+	transformed.m_points = xform(toPolygon());
 	return transformed;
 }
@@ -43,8 +43,14 @@ public:
 
 	SerializableSpline transformed(QTransform const& xform) const;
 
+	/**
+	 * \brief Maps all the points at once.
+	 *
+	 * The whole polygon is passed to \p xform, making it possible
+	 * to map the points in batch.
+	 */
 	SerializableSpline transformed(
-		boost::function<QPointF(QPointF const&)> const& xform) const;
+		boost::function<QPolygonF(QPolygonF const&)> const& xform) const;
 
 	QPolygonF toPolygon() const { return QPolygonF(m_points); }
 private: